@@ -0,0 +1,130 @@
+/*****************************************************************************
+ * Copyright 2014 Christoph Wick
+ *
+ * This file is part of Zelda.
+ *
+ * Zelda is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zelda is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Zelda. If not, see http://www.gnu.org/licenses/.
+ *****************************************************************************/
+
+#include "CookedScene.hpp"
+#include <string.h>
+#include "../Util/Assert.hpp"
+
+using namespace CookedScene;
+
+// the sizes are also defined by the formats of tools/CookScene.py
+static_assert(sizeof(SHeader) == 64, "Cooked scene header does not match the cooker");
+static_assert(sizeof(SNode) == 72, "Cooked scene node does not match the cooker");
+static_assert(sizeof(SEntity) == 36, "Cooked scene entity does not match the cooker");
+static_assert(sizeof(SUserData) == 12, "Cooked scene user data does not match the cooker");
+
+CCookedScene::CCookedScene()
+  : m_pData(nullptr),
+    m_pHeader(nullptr) {
+}
+
+bool CCookedScene::isCookedScene(const char *pData, size_t uiSize) {
+  return uiSize >= sizeof(COOKED_SCENE_MAGIC) && memcmp(pData, COOKED_SCENE_MAGIC, sizeof(COOKED_SCENE_MAGIC)) == 0;
+}
+
+bool CCookedScene::load(const char *pData, size_t uiSize) {
+  m_pData = nullptr;
+  m_pHeader = nullptr;
+
+  // the tables are used in place
+  if (reinterpret_cast<uintptr_t>(pData) % 4 != 0) {return false;}
+  if (uiSize < sizeof(SHeader) || !isCookedScene(pData, uiSize)) {return false;}
+
+  const SHeader *pHeader = reinterpret_cast<const SHeader*>(pData);
+  if (pHeader->uiVersion != COOKED_SCENE_VERSION) {return false;}
+
+  auto tableFits = [uiSize](uint32_t uiOffset, uint64_t uiBytes) {
+    return uiOffset % 4 == 0 && uiOffset + uiBytes <= uiSize;
+  };
+  if (!tableFits(pHeader->uiNodeOffset, static_cast<uint64_t>(pHeader->uiNodeCount) * sizeof(SNode))
+      || !tableFits(pHeader->uiEntityOffset, static_cast<uint64_t>(pHeader->uiEntityCount) * sizeof(SEntity))
+      || !tableFits(pHeader->uiUserDataOffset, static_cast<uint64_t>(pHeader->uiUserDataCount) * sizeof(SUserData))
+      || !tableFits(pHeader->uiStringsOffset, pHeader->uiStringsSize)) {
+    return false;
+  }
+  // the string table has to end with a terminator, so that no string can exceed it
+  if (pHeader->uiStringsSize == 0 || pData[pHeader->uiStringsOffset + pHeader->uiStringsSize - 1] != '\0') {
+    return false;
+  }
+  if (pHeader->uiRootNodeCount > pHeader->uiNodeCount) {return false;}
+
+  m_pData = pData;
+  m_pHeader = pHeader;
+  if (!checkReferences()) {
+    m_pData = nullptr;
+    m_pHeader = nullptr;
+    return false;
+  }
+  return true;
+}
+
+bool CCookedScene::checkReferences() const {
+  auto rangeFits = [](uint32_t uiFirst, uint32_t uiCount, uint32_t uiSize) {
+    return static_cast<uint64_t>(uiFirst) + uiCount <= uiSize;
+  };
+  const uint32_t uiStringsSize = m_pHeader->uiStringsSize;
+
+  for (uint32_t i = 0; i < m_pHeader->uiNodeCount; i++) {
+    const SNode &node(getNode(i));
+    // children are stored behind their parent, this excludes cycles
+    if (node.uiChildCount > 0 && node.uiFirstChild <= i) {return false;}
+    if (!rangeFits(node.uiFirstChild, node.uiChildCount, m_pHeader->uiNodeCount)
+        || !rangeFits(node.uiFirstEntity, node.uiEntityCount, m_pHeader->uiEntityCount)
+        || !rangeFits(node.uiFirstUserData, node.uiUserDataCount, m_pHeader->uiUserDataCount)
+        || node.uiName >= uiStringsSize) {
+      return false;
+    }
+  }
+  for (uint32_t i = 0; i < m_pHeader->uiEntityCount; i++) {
+    const SEntity &entity(getEntity(i));
+    if (!rangeFits(entity.uiFirstUserData, entity.uiUserDataCount, m_pHeader->uiUserDataCount)
+        || entity.uiName >= uiStringsSize || entity.uiMeshFile >= uiStringsSize
+        || entity.uiMaterialFile >= uiStringsSize || entity.uiPhysicsType >= uiStringsSize
+        || entity.uiCollisionPrim >= uiStringsSize) {
+      return false;
+    }
+  }
+  for (uint32_t i = 0; i < m_pHeader->uiUserDataCount; i++) {
+    const SUserData &userData(getUserData(i));
+    if (userData.uiName >= uiStringsSize || userData.uiType >= uiStringsSize || userData.uiValue >= uiStringsSize) {
+      return false;
+    }
+  }
+  return true;
+}
+
+const SNode &CCookedScene::getNode(uint32_t uiIndex) const {
+  ASSERT(m_pHeader && uiIndex < m_pHeader->uiNodeCount);
+  return reinterpret_cast<const SNode*>(m_pData + m_pHeader->uiNodeOffset)[uiIndex];
+}
+
+const SEntity &CCookedScene::getEntity(uint32_t uiIndex) const {
+  ASSERT(m_pHeader && uiIndex < m_pHeader->uiEntityCount);
+  return reinterpret_cast<const SEntity*>(m_pData + m_pHeader->uiEntityOffset)[uiIndex];
+}
+
+const SUserData &CCookedScene::getUserData(uint32_t uiIndex) const {
+  ASSERT(m_pHeader && uiIndex < m_pHeader->uiUserDataCount);
+  return reinterpret_cast<const SUserData*>(m_pData + m_pHeader->uiUserDataOffset)[uiIndex];
+}
+
+const char *CCookedScene::getString(uint32_t uiOffset) const {
+  ASSERT(m_pHeader && uiOffset < m_pHeader->uiStringsSize);
+  return m_pData + m_pHeader->uiStringsOffset + uiOffset;
+}
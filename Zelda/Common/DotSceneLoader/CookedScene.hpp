@@ -0,0 +1,135 @@
+/*****************************************************************************
+ * Copyright 2014 Christoph Wick
+ *
+ * This file is part of Zelda.
+ *
+ * Zelda is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zelda is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Zelda. If not, see http://www.gnu.org/licenses/.
+ *****************************************************************************/
+
+#ifndef _COOKED_SCENE_HPP_
+#define _COOKED_SCENE_HPP_
+
+#include <stdint.h>
+#include <stddef.h>
+
+//! Binary version of a .scene file, written by tools/CookScene.py
+/**
+  * The cooked file is stored as '<scene>.bin' next to the scene file. All
+  * values are little endian and 4 byte aligned. The tables are used in place,
+  * nothing has to be parsed:
+  *  - header
+  *  - node table: the root nodes first, the children of a node are stored
+  *    consecutively so that the loader visits them in the order of the xml file
+  *  - entity table: the entities of a node are stored consecutively
+  *  - user data table: (name, type, value) triples of the nodes and entities
+  *  - string table: zero terminated strings, referenced by their byte offset
+  *
+  * If the cooker or the loader changes, COOKED_SCENE_VERSION has to be
+  * increased, old cooked files are ignored and the xml file is loaded.
+  */
+namespace CookedScene {
+  const uint32_t COOKED_SCENE_VERSION = 1;
+  const char COOKED_SCENE_MAGIC[4] = {'Z', 'S', 'C', 'N'};
+  const char * const COOKED_SCENE_EXTENSION = ".bin";
+
+  enum EHeaderFlags {
+    HF_AMBIENT_COLOUR = 1,
+  };
+  enum ENodeFlags {
+    NF_POSITION = 1,
+    NF_ROTATION = 2,
+    NF_SCALE = 4,
+  };
+  enum EEntityFlags {
+    EF_STATIC = 1,
+    EF_CAST_SHADOWS = 2,
+    EF_GHOST = 4,
+  };
+
+  struct SHeader {
+    char acMagic[4];
+    uint32_t uiVersion;
+    uint32_t uiFlags;
+    float afAmbientColour[4];
+    uint32_t uiRootNodeCount;
+    uint32_t uiNodeCount;
+    uint32_t uiNodeOffset;
+    uint32_t uiEntityCount;
+    uint32_t uiEntityOffset;
+    uint32_t uiUserDataCount;
+    uint32_t uiUserDataOffset;
+    uint32_t uiStringsSize;
+    uint32_t uiStringsOffset;
+  };
+
+  struct SNode {
+    uint32_t uiName;
+    uint32_t uiFlags;
+    float afPosition[3];
+    float afRotation[4];              //!< w, x, y, z
+    float afScale[3];
+    uint32_t uiFirstChild;
+    uint32_t uiChildCount;
+    uint32_t uiFirstEntity;
+    uint32_t uiEntityCount;
+    uint32_t uiFirstUserData;
+    uint32_t uiUserDataCount;
+  };
+
+  struct SEntity {
+    uint32_t uiName;
+    uint32_t uiMeshFile;
+    uint32_t uiMaterialFile;
+    uint32_t uiPhysicsType;
+    uint32_t uiCollisionPrim;
+    float fMass;
+    uint32_t uiFlags;
+    uint32_t uiFirstUserData;
+    uint32_t uiUserDataCount;
+  };
+
+  struct SUserData {
+    uint32_t uiName;
+    uint32_t uiType;
+    uint32_t uiValue;
+  };
+};
+
+//! View on a cooked scene in memory, the memory is not copied
+class CCookedScene {
+private:
+  const char *m_pData;
+  const CookedScene::SHeader *m_pHeader;
+public:
+  CCookedScene();
+
+  //! true if the data starts with the magic of a cooked scene (of any version)
+  static bool isCookedScene(const char *pData, size_t uiSize);
+
+  //! check the header and the table bounds, false if the data can not be used
+  bool load(const char *pData, size_t uiSize);
+  bool isLoaded() const {return m_pHeader != nullptr;}
+
+  const CookedScene::SHeader &getHeader() const {return *m_pHeader;}
+  const CookedScene::SNode &getNode(uint32_t uiIndex) const;
+  const CookedScene::SEntity &getEntity(uint32_t uiIndex) const;
+  const CookedScene::SUserData &getUserData(uint32_t uiIndex) const;
+  const char *getString(uint32_t uiOffset) const;
+
+private:
+  //! check that all indices and string offsets are inside of their tables
+  bool checkReferences() const;
+};
+
+#endif // _COOKED_SCENE_HPP_
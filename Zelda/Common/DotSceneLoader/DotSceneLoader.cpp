@@ -25,7 +25,9 @@
 #include <btBulletDynamicsCommon.h>
 #include "../Physics/BtOgreGP.hpp"
 #include "../Physics/BtOgrePG.hpp"
+#include "../Physics/BvhTriangleMeshCache.hpp"
 #include "UserData.hpp"
+#include "CookedScene.hpp"
 #include "../Physics/PhysicsManager.hpp"
 #include "../Physics/PhysicsMasks.hpp"
 #include <regex>
@@ -49,7 +51,13 @@ void DotSceneLoader::cleanup() {
 	}
 	m_lEntityBufferMap.clear();
 }
-void DotSceneLoader::parseDotScene(const String &SceneName, const String &groupName, SceneManager *yourSceneMgr, CPhysicsManager *pPhysicsManager, SceneNode *pAttachNode, const String &sPrependNode)
+void DotSceneLoader::releaseCollisionShapes() {
+	for (const CAtom &id : m_vCollisionShapes) {
+		m_pPhysicsManager->releaseCollisionShape(id);
+	}
+	m_vCollisionShapes.clear();
+}
+void DotSceneLoader::parseDotScene(const String &SceneName, const String &groupName, SceneManager *yourSceneMgr, CPhysicsManager *pPhysicsManager, SceneNode *pAttachNode, const String &sPrependNode, const String &sSceneData)
 {
 	cleanup();
 
@@ -63,61 +71,42 @@ void DotSceneLoader::parseDotScene(const String &SceneName, const String &groupN
 
 	mStaticSceneNode = pAttachNode->createChildSceneNode(sPrependNode + "StaticSceneNode");
 
-    XMLDocument   *XMLDoc = 0;
-    XMLElement   *XMLRoot;
+    // figure out where to attach any nodes we create
+    mAttachNode = pAttachNode;
+    if(!mAttachNode)
+        mAttachNode = mSceneMgr->getRootSceneNode();
 
-    try
-    {
-        // Strip the path
-        Ogre::String basename, path;
-        Ogre::StringUtil::splitFilename(SceneName, basename, path);
+    // Strip the path
+    Ogre::String basename, path;
+    Ogre::StringUtil::splitFilename(SceneName, basename, path);
 
-        // Do not look in other groups but the given one
+    // prefer the cooked scene, the xml file is the fallback
+    String data(sSceneData);
+    const String cookedName(basename + CookedScene::COOKED_SCENE_EXTENSION);
+    if (data.empty() && ResourceGroupManager::getSingleton().resourceExists(groupName, cookedName))
+    {
         DataStreamPtr pStream = ResourceGroupManager::getSingleton().
-            openResource( basename, groupName, false );
-
-        //DataStreamPtr pStream = ResourceGroupManager::getSingleton().
-        //    openResource( SceneName, groupName );
-
-        String data = pStream->getAsString();
-        // Open the .scene File
-        XMLDoc = new XMLDocument();
-        XMLDoc->Parse( data.c_str() );
+            openResource( cookedName, groupName, false );
+        data = pStream->getAsString();
         pStream->close();
-        pStream.setNull();
-
-        if( XMLDoc->Error() )
-        {
-            //We'll just log, and continue on gracefully
-            LogManager::getSingleton().logMessage("[DotSceneLoader] The TiXmlDocument reported an error");
-            delete XMLDoc;
-            return;
-        }
     }
-    catch(...)
+
+    CCookedScene cookedScene;
+    if (cookedScene.load(data.data(), data.size()))
     {
-        //We'll just log, and continue on gracefully
-        LogManager::getSingleton().logMessage("[DotSceneLoader] Error creating TiXmlDocument");
-        delete XMLDoc;
-        return;
+        LogManager::getSingleton().logMessage("[DotSceneLoader] Using cooked scene " + cookedName);
+        processCookedScene(cookedScene);
     }
-
-    // Validate the File
-    XMLRoot = XMLDoc->RootElement();
-    if( String( XMLRoot->Value()) != "scene"  ) {
-        LogManager::getSingleton().logMessage( "[DotSceneLoader] Error: Invalid .scene File. Missing <scene>" );
-        delete XMLDoc;
-        return;
+    else
+    {
+        if (CCookedScene::isCookedScene(data.data(), data.size()))
+        {
+            LogManager::getSingleton().logMessage("[DotSceneLoader] Cooked scene " + cookedName + " is invalid or outdated, using the xml file");
+            data.clear();
+        }
+        processXMLScene(basename, groupName, data);
     }
 
-    // figure out where to attach any nodes we create
-    mAttachNode = pAttachNode;
-    if(!mAttachNode)
-        mAttachNode = mSceneMgr->getRootSceneNode();
-
-    // Process the scene
-    processScene(XMLRoot);
-
 	/*for (auto &m : m_mStaticGeometryMap) {
 		m.second->build();
 	}*/
@@ -161,14 +150,66 @@ void DotSceneLoader::parseDotScene(const String &SceneName, const String &groupN
 		mSceneMgr->destroyEntity(m.second);
 	}*/
 
-    // Close the XML File
-    delete XMLDoc;
-
 	// remove callbacks
 	m_lCallbacks.clear();
   cleanup();
 }
 
+void DotSceneLoader::processXMLScene(const String &basename, const String &groupName, const String &sSceneData)
+{
+    XMLDocument   *XMLDoc = 0;
+    XMLElement   *XMLRoot;
+
+    try
+    {
+        String data(sSceneData);
+        if (data.empty()) {
+            // Do not look in other groups but the given one
+            DataStreamPtr pStream = ResourceGroupManager::getSingleton().
+                openResource( basename, groupName, false );
+
+            //DataStreamPtr pStream = ResourceGroupManager::getSingleton().
+            //    openResource( SceneName, groupName );
+
+            data = pStream->getAsString();
+            pStream->close();
+            pStream.setNull();
+        }
+        // Open the .scene File
+        XMLDoc = new XMLDocument();
+        XMLDoc->Parse( data.c_str() );
+
+        if( XMLDoc->Error() )
+        {
+            //We'll just log, and continue on gracefully
+            LogManager::getSingleton().logMessage("[DotSceneLoader] The TiXmlDocument reported an error");
+            delete XMLDoc;
+            return;
+        }
+    }
+    catch(...)
+    {
+        //We'll just log, and continue on gracefully
+        LogManager::getSingleton().logMessage("[DotSceneLoader] Error creating TiXmlDocument");
+        delete XMLDoc;
+        return;
+    }
+
+    // Validate the File
+    XMLRoot = XMLDoc->RootElement();
+    if( String( XMLRoot->Value()) != "scene"  ) {
+        LogManager::getSingleton().logMessage( "[DotSceneLoader] Error: Invalid .scene File. Missing <scene>" );
+        delete XMLDoc;
+        return;
+    }
+
+    // Process the scene
+    processScene(XMLRoot);
+
+    // Close the XML File
+    delete XMLDoc;
+}
+
 void DotSceneLoader::processScene(XMLElement *XMLRoot)
 {
     // Process the scene parameters
@@ -494,23 +535,7 @@ void DotSceneLoader::processNode(XMLElement *XMLNode, SceneNode *pParent)
 	}*/
 
     // Create the scene node
-    SceneNode *pNode;
-    if(name.empty())
-    {
-        // Let Ogre choose the name
-        if(pParent)
-            pNode = pParent->createChildSceneNode();
-        else
-            pNode = mAttachNode->createChildSceneNode();
-    }
-    else
-    {
-        // Provide the name
-        if(pParent)
-            pNode = pParent->createChildSceneNode(name);
-        else
-            pNode = mAttachNode->createChildSceneNode(name);
-    }
+    SceneNode *pNode = createSceneNode(name, pParent);
 
     // Process other attributes
     String id = getAttrib(XMLNode, "id");
@@ -544,6 +569,13 @@ void DotSceneLoader::processNode(XMLElement *XMLNode, SceneNode *pParent)
         pNode->setInitialState();
     }
 
+    // place the root nodes before the entities create their rigid bodies
+    if(!pParent && m_vWorldOffset != Vector3::ZERO)
+    {
+        pNode->translate(m_vWorldOffset);
+        pNode->setInitialState();
+    }
+
     // Process lookTarget (?)
     pElement = XMLNode->FirstChildElement("lookTarget");
     if(pElement)
@@ -623,6 +655,26 @@ void DotSceneLoader::processNode(XMLElement *XMLNode, SceneNode *pParent)
 	}*/
 }
 
+SceneNode *DotSceneLoader::createSceneNode(const String &name, SceneNode *pParent)
+{
+    if(name.empty())
+    {
+        // Let Ogre choose the name
+        if(pParent)
+            return pParent->createChildSceneNode();
+        else
+            return mAttachNode->createChildSceneNode();
+    }
+    else
+    {
+        // Provide the name
+        if(pParent)
+            return pParent->createChildSceneNode(name);
+        else
+            return mAttachNode->createChildSceneNode(name);
+    }
+}
+
 void DotSceneLoader::processLookTarget(XMLElement *XMLNode, SceneNode *pParent)
 {
     //! @todo Is this correct? Cause I don't have a clue actually
@@ -705,27 +757,46 @@ void DotSceneLoader::processEntity(XMLElement *XMLNode, SceneNode *pParent, CUse
   // parse user data
   userData.parseNode(XMLNode);
 
+  // Process attributes
+  EntityParameters entity;
+  entity.name = getAttrib(XMLNode, "name");
+  entity.meshFile = getAttrib(XMLNode, "meshFile");
+  entity.materialFile = getAttrib(XMLNode, "materialFile");
+  entity.physicsType = getAttrib(XMLNode, "physics_type");
+  entity.collisionPrim = getAttrib(XMLNode, "collisionPrim");
+  entity.mass = getAttribReal(XMLNode, "mass", 0);
+  entity.isStatic = getAttribBool(XMLNode, "static", false);
+  entity.castShadows = getAttribBool(XMLNode, "castShadows", true);
+  entity.isGhost = getAttribBool(XMLNode, "ghost");
+
+  Entity *pEntity = createEntity(entity, pParent, userData);
+
+  // Process userDataReference (?)
+  XMLElement *pElement = XMLNode->FirstChildElement("userDataReference");
+  if(pElement && pEntity)
+      processUserDataReference(pElement, pEntity);
+}
+
+Entity *DotSceneLoader::createEntity(const EntityParameters &entity, SceneNode *pParent, CUserData &userData) {
   for (auto &cb : m_lCallbacks) {
-    if (cb->preEntityAdded(XMLNode, pParent, userData) == CDotSceneLoaderCallback::R_CANCEL) {
-      return;
+    if (cb->preEntityAdded(entity.meshFile, pParent, userData) == CDotSceneLoaderCallback::R_CANCEL) {
+      return 0;
     }
   }
 
-  // Process attributes
-  String name = getAttrib(XMLNode, "name");
-  String id = getAttrib(XMLNode, "id");
-  String meshFile = getAttrib(XMLNode, "meshFile");
+  const String &name = entity.name;
+  const String &meshFile = entity.meshFile;
   String meshName = meshFile.substr(0, meshFile.length() - 5); // without .mesh
-  String materialFile = getAttrib(XMLNode, "materialFile");
-  String physicsType = getAttrib(XMLNode, "physics_type");
+  const String &materialFile = entity.materialFile;
+  const String &physicsType = entity.physicsType;
 
-  bool isStatic = getAttribBool(XMLNode, "static", false) || physicsType == "STATIC" || physicsType == "NO_COLLISION";
+  bool isStatic = entity.isStatic || physicsType == "STATIC" || physicsType == "NO_COLLISION";
   if (!userData.getBoolUserData("static", true)) {
     isStatic = false;
   }
 
-  bool castShadows = getAttribBool(XMLNode, "castShadows", true);
-  bool isGhost = getAttribBool(XMLNode, "ghost");
+  bool castShadows = entity.castShadows;
+  bool isGhost = entity.isGhost;
 
   // user data properties
   bool bIsBorder = userData.getBoolUserData("border", false);               // is this object a wall? this will set COL_WALL as collision group
@@ -759,18 +830,6 @@ void DotSceneLoader::processEntity(XMLElement *XMLNode, SceneNode *pParent, CUse
   else
     dynamicObjects.push_back(name);
 
-  XMLElement *pElement;
-
-  // Process vertexBuffer (?)
-  pElement = XMLNode->FirstChildElement("vertexBuffer");
-  if(pElement)
-      ;//processVertexBuffer(pElement);
-
-  // Process indexBuffer (?)
-  pElement = XMLNode->FirstChildElement("indexBuffer");
-  if(pElement)
-      ;//processIndexBuffer(pElement);
-
   // Create the entity
   Entity *pEntity = 0;
   btRigidBody *pRB(NULL);
@@ -796,11 +855,11 @@ void DotSceneLoader::processEntity(XMLElement *XMLNode, SceneNode *pParent, CUse
 
   // okay, now do the physics
       if (!physicsType.empty()) {
-          String collisionPrim = getAttrib(XMLNode, "collisionPrim");
+          const String &collisionPrim = entity.collisionPrim;
           btMotionState *ms(NULL);
           btCollisionShape* shape(NULL);
           Ogre::Vector3 centerOffset(Ogre::Vector3::ZERO);
-          Ogre::Real mass = getAttribReal(XMLNode, "mass", 0);
+          Ogre::Real mass = entity.mass;
     pParent->attachObject(pEntity);
           BtOgre::StaticMeshToShapeConverter converter(pEntity);
 
@@ -827,14 +886,20 @@ void DotSceneLoader::processEntity(XMLElement *XMLNode, SceneNode *pParent, CUse
 
     // if there is a motion state, create the shape
           if (ms) {
-      if (m_pPhysicsManager->hasCollisionShape(meshName)) {
-        auto colShape = m_pPhysicsManager->getCollisionShape(meshName);
+      // shapes of meshes that are used in several maps are shared, but the map
+      // packs ship different meshes with the same name (e.g. physics_floor.mesh),
+      // so the key is the content of the converted mesh including its scaling
+      const CAtom shapeID(meshName + "_" + collisionPrim + "_"
+                          + std::to_string(CBvhTriangleMeshCache::hashMesh(converter)));
+      if (m_pPhysicsManager->acquireCollisionShape(shapeID)) {
+        m_vCollisionShapes.push_back(shapeID);
+        auto colShape = m_pPhysicsManager->getCollisionShape(shapeID);
         shape = colShape.getShape();
         centerOffset = colShape.getOffset();
       }
       else {
         if (collisionPrim == "triangle_mesh" || collisionPrim == "") {
-          shape = converter.createTrimesh();
+          shape = CBvhTriangleMeshCache::createTrimesh(converter, meshName, m_sGroupName);
           //Ogre::LogManager::getSingleton().logMessage("Creating TriMesh");
         }
         else if (collisionPrim == "box") {
@@ -866,7 +931,8 @@ void DotSceneLoader::processEntity(XMLElement *XMLNode, SceneNode *pParent, CUse
         }
 
         for (auto &cb : m_lCallbacks) {cb->physicsShapeCreated(shape, meshName);}
-        m_pPhysicsManager->addCollisionShape(meshName, CPhysicsCollisionObject(shape, centerOffset));
+        m_pPhysicsManager->addCollisionShape(shapeID, CPhysicsCollisionObject(shape, centerOffset));
+        m_vCollisionShapes.push_back(shapeID);
       }
           }
     pParent->detachObject(pEntity);
@@ -949,12 +1015,6 @@ void DotSceneLoader::processEntity(XMLElement *XMLNode, SceneNode *pParent, CUse
 
   }
 
-  // Process userDataReference (?)
-  pElement = XMLNode->FirstChildElement("userDataReference");
-  if(pElement)
-      processUserDataReference(pElement, pEntity);
-
-
   if (isStatic && pRB) {
     for (auto &cb : m_lCallbacks) {cb->worldPhysicsAdded(pRB);}
   }
@@ -975,7 +1035,86 @@ void DotSceneLoader::processEntity(XMLElement *XMLNode, SceneNode *pParent, CUse
           delete pRB->getCollisionShape();
           delete pRB;
       }*/
+      return 0;
   }
+  return pEntity;
+}
+
+void DotSceneLoader::processCookedScene(const CCookedScene &scene)
+{
+    const CookedScene::SHeader &header(scene.getHeader());
+
+    // same order as in the xml file: nodes, environment
+    for (uint32_t i = 0; i < header.uiRootNodeCount; i++)
+        processCookedNode(scene, i);
+
+    if (header.uiFlags & CookedScene::HF_AMBIENT_COLOUR)
+    {
+        mSceneMgr->setAmbientLight(ColourValue(header.afAmbientColour[0], header.afAmbientColour[1],
+                                               header.afAmbientColour[2], header.afAmbientColour[3]));
+    }
+}
+
+void DotSceneLoader::processCookedNode(const CCookedScene &scene, uint32_t uiNode, SceneNode *pParent)
+{
+    const CookedScene::SNode &node(scene.getNode(uiNode));
+    const String nodeName(scene.getString(node.uiName));
+    SceneNode *pNode = createSceneNode(m_sPrependNode + nodeName, pParent);
+
+    CUserData userData;
+    for (uint32_t i = node.uiFirstUserData; i < node.uiFirstUserData + node.uiUserDataCount; i++)
+        addCookedUserData(scene, scene.getUserData(i), userData);
+    userData.setUserData("name", nodeName);
+
+    if (node.uiFlags & CookedScene::NF_POSITION)
+    {
+        pNode->setPosition(Vector3(node.afPosition[0], node.afPosition[1], node.afPosition[2]));
+        pNode->setInitialState();
+    }
+    if (node.uiFlags & CookedScene::NF_ROTATION)
+    {
+        pNode->setOrientation(Quaternion(node.afRotation[0], node.afRotation[1], node.afRotation[2], node.afRotation[3]));
+        pNode->setInitialState();
+    }
+    if (node.uiFlags & CookedScene::NF_SCALE)
+    {
+        pNode->setScale(Vector3(node.afScale[0], node.afScale[1], node.afScale[2]));
+        pNode->setInitialState();
+    }
+    if (!pParent && m_vWorldOffset != Vector3::ZERO)
+    {
+        pNode->translate(m_vWorldOffset);
+        pNode->setInitialState();
+    }
+
+    for (uint32_t i = node.uiFirstChild; i < node.uiFirstChild + node.uiChildCount; i++)
+        processCookedNode(scene, i, pNode);
+
+    for (uint32_t i = node.uiFirstEntity; i < node.uiFirstEntity + node.uiEntityCount; i++)
+    {
+        const CookedScene::SEntity &cookedEntity(scene.getEntity(i));
+        for (uint32_t j = cookedEntity.uiFirstUserData; j < cookedEntity.uiFirstUserData + cookedEntity.uiUserDataCount; j++)
+            addCookedUserData(scene, scene.getUserData(j), userData);
+
+        EntityParameters entity;
+        entity.name = scene.getString(cookedEntity.uiName);
+        entity.meshFile = scene.getString(cookedEntity.uiMeshFile);
+        entity.materialFile = scene.getString(cookedEntity.uiMaterialFile);
+        entity.physicsType = scene.getString(cookedEntity.uiPhysicsType);
+        entity.collisionPrim = scene.getString(cookedEntity.uiCollisionPrim);
+        entity.mass = cookedEntity.fMass;
+        entity.isStatic = (cookedEntity.uiFlags & CookedScene::EF_STATIC) != 0;
+        entity.castShadows = (cookedEntity.uiFlags & CookedScene::EF_CAST_SHADOWS) != 0;
+        entity.isGhost = (cookedEntity.uiFlags & CookedScene::EF_GHOST) != 0;
+        createEntity(entity, pNode, userData);
+    }
+}
+
+void DotSceneLoader::addCookedUserData(const CCookedScene &scene, const CookedScene::SUserData &cookedUserData, CUserData &userData)
+{
+    userData.addAttribute(scene.getString(cookedUserData.uiName),
+                          scene.getString(cookedUserData.uiType),
+                          scene.getString(cookedUserData.uiValue));
 }
 
 void DotSceneLoader::processParticleSystem(XMLElement *XMLNode, SceneNode *pParent)
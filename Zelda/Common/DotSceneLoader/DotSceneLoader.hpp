@@ -22,9 +22,16 @@
 
 // Includes
 #include "DotSceneLoaderCallback.hpp"
+#include "../Util/Atom.hpp"
+#include <stdint.h>
+#include <OgreVector3.h>
 
 class CUserData;
 class CPhysicsManager;
+class CCookedScene;
+namespace CookedScene {
+    struct SUserData;
+}
 
 // Forward declarations
 namespace tinyxml2 {
@@ -54,21 +61,44 @@ namespace Ogre
     class DotSceneLoader
     {
 	private:
+		//! attributes of an entity, read from the xml or the cooked scene
+		struct EntityParameters {
+			String name;
+			String meshFile;
+			String materialFile;
+			String physicsType;
+			String collisionPrim;
+			Real mass;
+			bool isStatic;
+			bool castShadows;
+			bool isGhost;
+		};
+
 		std::list<CDotSceneLoaderCallback*> m_lCallbacks;
 		std::map<Ogre::String, Ogre::Entity*> m_lEntityBufferMap;
 		CPhysicsManager *m_pPhysicsManager;
+		Vector3 m_vWorldOffset;
+		std::vector<CAtom> m_vCollisionShapes;		//!< shapes acquired in the physics manager for the entities of the scene
 	public:
-        DotSceneLoader() : mSceneMgr(0) {}
+        DotSceneLoader() : mSceneMgr(0), m_vWorldOffset(Vector3::ZERO) {}
         virtual ~DotSceneLoader() {cleanup();}
 
 		void cleanup();
+		//! release the shapes of the scene in the physics manager, its rigid bodies must be deleted before
+		/**
+		  * Only required if the physics manager is shared with other scenes and
+		  * outlives this one, an own manager releases all shapes on exit.
+		  */
+		void releaseCollisionShapes();
 
 		void addCallback(CDotSceneLoaderCallback *pCallback) {m_lCallbacks.push_back(pCallback);}
 
-        void parseDotScene(const String &SceneName, const String &groupName, SceneManager *yourSceneMgr, CPhysicsManager *pPhysicsManager, SceneNode *pAttachNode = NULL, const String &sPrependNode = "");
+        void parseDotScene(const String &SceneName, const String &groupName, SceneManager *yourSceneMgr, CPhysicsManager *pPhysicsManager, SceneNode *pAttachNode = NULL, const String &sPrependNode = "", const String &sSceneData = "");
         String getProperty(const String &ndNm, const String &prop);
 
 		const Ogre::String &getPrependNode() const {return m_sPrependNode;}
+		//! translation of the root nodes (and their rigid bodies), to place the scene in a world shared with other scenes
+		void setWorldOffset(const Vector3 &vOffset) {m_vWorldOffset = vOffset;}
 
         std::vector<nodeProperty> nodeProperties;
         std::vector<String> staticObjects;
@@ -77,8 +107,17 @@ namespace Ogre
 
 
     protected:
+        void processXMLScene(const String &basename, const String &groupName, const String &sSceneData);
         void processScene(tinyxml2::XMLElement *XMLRoot);
 
+        void processCookedScene(const CCookedScene &scene);
+        void processCookedNode(const CCookedScene &scene, uint32_t uiNode, SceneNode *pParent = 0);
+        void addCookedUserData(const CCookedScene &scene, const CookedScene::SUserData &cookedUserData, CUserData &userData);
+
+        SceneNode *createSceneNode(const String &name, SceneNode *pParent);
+        //! returns the entity if it was added to the scene
+        Entity *createEntity(const EntityParameters &entity, SceneNode *pParent, CUserData &userData);
+
         void processNodes(tinyxml2::XMLElement *XMLNode);
         void processExternals(tinyxml2::XMLElement *XMLNode);
         void processEnvironment(tinyxml2::XMLElement *XMLNode);
@@ -39,7 +39,7 @@ public:
 
   virtual void physicsShapeCreated(btCollisionShape *pShape, const std::string &sMeshName) {}
   virtual void worldPhysicsAdded(btRigidBody *pRigidBody) {}
-  virtual EResults preEntityAdded(tinyxml2::XMLElement *XMLNode, Ogre::SceneNode *pParent, CUserData &userData) {return R_CONTINUE;}
+  virtual EResults preEntityAdded(const Ogre::String &sMeshFile, Ogre::SceneNode *pParent, CUserData &userData) {return R_CONTINUE;}
 	virtual void postEntityAdded(Ogre::Entity *pEntity, Ogre::SceneNode *pParent, btRigidBody *pRigidBody, const CUserData &userData) {}
 	virtual void staticObjectAdded(Ogre::Entity *pEntity, Ogre::SceneNode *pParent) {}
 
@@ -36,7 +36,10 @@ void CUserData::parseNode(tinyxml2::XMLElement *pNode) {
     }
 }
 void CUserData::readAttributes(tinyxml2::XMLElement *pElem) {
-    m_lAttributeList.push_back({pElem->Attribute("name"), pElem->Attribute("type"), pElem->Attribute("value")});
+    addAttribute(pElem->Attribute("name"), pElem->Attribute("type"), pElem->Attribute("value"));
+}
+void CUserData::addAttribute(const Ogre::String &label, const Ogre::String &type, const Ogre::String &value) {
+    m_lAttributeList.push_back({label, type, value});
 }
 const Ogre::String CUserData::getStringUserData(const Ogre::String &name, const Ogre::String &defaultValue) const {
     for (auto &attr : m_lAttributeList) {
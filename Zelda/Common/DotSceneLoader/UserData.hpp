@@ -47,6 +47,8 @@ public:
 
 	void setUserData(const Ogre::String &label, bool value);
 	void setUserData(const Ogre::String &label, const Ogre::String &value);
+	//! add an attribute as if it was read from a user_data element
+	void addAttribute(const Ogre::String &label, const Ogre::String &type, const Ogre::String &value);
 
 	const CUserData &operator=(const CUserData &src) {
         m_lAttributeList = src.m_lAttributeList;
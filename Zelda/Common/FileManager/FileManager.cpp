@@ -161,6 +161,11 @@ std::string CFileManager::getValidPath(const std::string &sFileName,
 
   return dataPath + "/" + sFileName;
 #else
+  std::string::size_type pos(sFileName.rfind("/"));
+  if (pos != std::string::npos && pos > 0) {
+    // create the directory(s) of the file if required
+    mkpath(sFileName.substr(0, pos).c_str(), 0755);
+  }
   return sFileName;
 #endif
 }
@@ -0,0 +1,518 @@
+/*****************************************************************************
+ * Copyright 2014 Christoph Wick
+ *
+ * This file is part of Zelda.
+ *
+ * Zelda is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zelda is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Zelda. If not, see http://www.gnu.org/licenses/.
+ *****************************************************************************/
+
+#include "PackArchive.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "../Util/Assert.hpp"
+#if OGRE_PLATFORM == OGRE_PLATFORM_WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+using namespace PackArchive;
+
+namespace {
+  //! compare like the sorting of the packer (lower case, byte wise)
+  int compareNames(const char *a, const char *b) {
+    for (;; ++a, ++b) {
+      const int ca(std::tolower(static_cast<unsigned char>(*a)));
+      const int cb(std::tolower(static_cast<unsigned char>(*b)));
+      if (ca != cb || ca == 0) {return ca - cb;}
+    }
+  }
+
+  //! stream on memory that is owned by someone else, the owner is kept alive by the stream
+  class CPackDataStream : public Ogre::MemoryDataStream {
+  private:
+    std::shared_ptr<const void> m_pOwner;
+  public:
+    CPackDataStream(const Ogre::String &sName, const std::shared_ptr<const void> &pOwner, const void *pData, size_t uiSize)
+      : Ogre::MemoryDataStream(sName, const_cast<void*>(pData), uiSize, false, true),
+        m_pOwner(pOwner) {
+    }
+  };
+
+  bool readLZ4Length(const unsigned char *&pSrc, const unsigned char *pSrcEnd, size_t &uiLength) {
+    unsigned char ucByte;
+    do {
+      if (pSrc >= pSrcEnd) {return false;}
+      ucByte = *pSrc++;
+      uiLength += ucByte;
+    } while (ucByte == 255);
+    return true;
+  }
+}
+
+bool PackArchive::decompressLZ4(const unsigned char *pSrc, size_t uiSrcSize, unsigned char *pDst, size_t uiDstSize) {
+  const unsigned char *pSrcEnd(pSrc + uiSrcSize);
+  unsigned char *pOut(pDst);
+  unsigned char *pDstEnd(pDst + uiDstSize);
+
+  while (pSrc < pSrcEnd) {
+    const unsigned int uiToken(*pSrc++);
+
+    // literals
+    size_t uiLiteralLength(uiToken >> 4);
+    if (uiLiteralLength == 15 && !readLZ4Length(pSrc, pSrcEnd, uiLiteralLength)) {return false;}
+    if (uiLiteralLength > static_cast<size_t>(pSrcEnd - pSrc) || uiLiteralLength > static_cast<size_t>(pDstEnd - pOut)) {return false;}
+    memcpy(pOut, pSrc, uiLiteralLength);
+    pSrc += uiLiteralLength;
+    pOut += uiLiteralLength;
+
+    // the last sequence has no match
+    if (pSrc == pSrcEnd) {break;}
+
+    // match
+    if (pSrcEnd - pSrc < 2) {return false;}
+    const size_t uiOffset(pSrc[0] | (pSrc[1] << 8));
+    pSrc += 2;
+    if (uiOffset == 0 || uiOffset > static_cast<size_t>(pOut - pDst)) {return false;}
+    size_t uiMatchLength(uiToken & 15);
+    if (uiMatchLength == 15 && !readLZ4Length(pSrc, pSrcEnd, uiMatchLength)) {return false;}
+    uiMatchLength += 4;
+    if (uiMatchLength > static_cast<size_t>(pDstEnd - pOut)) {return false;}
+    // the match may overlap the output, so copy byte wise
+    const unsigned char *pMatch(pOut - uiOffset);
+    for (size_t i = 0; i < uiMatchLength; i++) {
+      pOut[i] = pMatch[i];
+    }
+    pOut += uiMatchLength;
+  }
+  return pOut == pDstEnd;
+}
+
+CMappedFile::CMappedFile()
+  : m_pData(nullptr),
+    m_uiSize(0) {
+#if OGRE_PLATFORM == OGRE_PLATFORM_WIN32
+  m_hFile = INVALID_HANDLE_VALUE;
+  m_hMapping = nullptr;
+#else
+  m_iFile = -1;
+#endif // OGRE_PLATFORM
+}
+
+std::shared_ptr<CMappedFile> CMappedFile::open(const std::string &sFile, std::string &sError) {
+  std::shared_ptr<CMappedFile> pFile(new CMappedFile());
+  if (!pFile->map(sFile, sError)) {
+    return std::shared_ptr<CMappedFile>();
+  }
+  return pFile;
+}
+
+bool CMappedFile::map(const std::string &sFile, std::string &sError) {
+#if OGRE_PLATFORM == OGRE_PLATFORM_WIN32
+  m_hFile = CreateFileA(sFile.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (m_hFile == INVALID_HANDLE_VALUE) {
+    sError = "File " + sFile + " can not be opened";
+    return false;
+  }
+  LARGE_INTEGER size;
+  GetFileSizeEx(m_hFile, &size);
+  m_uiSize = static_cast<size_t>(size.QuadPart);
+  if (m_uiSize > 0) {
+    m_hMapping = CreateFileMappingA(m_hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (m_hMapping) {
+      m_pData = static_cast<const unsigned char*>(MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0));
+    }
+    if (!m_pData) {
+      sError = "File " + sFile + " can not be mapped";
+      return false;
+    }
+  }
+#else
+  m_iFile = ::open(sFile.c_str(), O_RDONLY);
+  if (m_iFile < 0) {
+    sError = "File " + sFile + " can not be opened";
+    return false;
+  }
+  struct stat fileStat;
+  if (fstat(m_iFile, &fileStat) != 0) {
+    sError = "File " + sFile + " can not be opened";
+    return false;
+  }
+  m_uiSize = static_cast<size_t>(fileStat.st_size);
+  if (m_uiSize > 0) {
+    void *pData(mmap(nullptr, m_uiSize, PROT_READ, MAP_PRIVATE, m_iFile, 0));
+    if (pData == MAP_FAILED) {
+      sError = "File " + sFile + " can not be mapped";
+      return false;
+    }
+    m_pData = static_cast<const unsigned char*>(pData);
+  }
+#endif // OGRE_PLATFORM
+  return true;
+}
+
+CMappedFile::~CMappedFile() {
+#if OGRE_PLATFORM == OGRE_PLATFORM_WIN32
+  if (m_pData) {UnmapViewOfFile(m_pData);}
+  if (m_hMapping) {CloseHandle(m_hMapping);}
+  if (m_hFile != INVALID_HANDLE_VALUE) {CloseHandle(m_hFile);}
+#else
+  if (m_pData) {munmap(const_cast<unsigned char*>(m_pData), m_uiSize);}
+  if (m_iFile >= 0) {::close(m_iFile);}
+#endif // OGRE_PLATFORM
+}
+
+CPackArchive::CPackArchive(const Ogre::String &sName, const Ogre::String &sArchiveType)
+  : Ogre::Archive(sName, sArchiveType),
+    m_pHeader(nullptr),
+    m_pEntries(nullptr),
+    m_pStrings(nullptr) {
+}
+
+CPackArchive::~CPackArchive() {
+  unload();
+}
+
+bool CPackArchive::isPackArchive(const Ogre::String &sFile) {
+  std::ifstream file(sFile.c_str(), std::ios::binary);
+  char acMagic[4];
+  return file.read(acMagic, sizeof(acMagic)) && memcmp(acMagic, PACK_ARCHIVE_MAGIC, sizeof(acMagic)) == 0;
+}
+
+void CPackArchive::load() {
+  std::string sError;
+  if (!load(sError)) {
+    throw Ogre::Exception(0, sError, __FILE__);
+  }
+}
+
+bool CPackArchive::load(std::string &sError) {
+  if (m_pMappedFile) {return true;}
+
+  m_pMappedFile = CMappedFile::open(mName, sError);
+  if (!m_pMappedFile) {return false;}
+  const unsigned char *pData(m_pMappedFile->getData());
+  m_pHeader = reinterpret_cast<const SHeader*>(pData);
+  if (!checkPack()) {
+    m_pMappedFile.reset();
+    m_pHeader = nullptr;
+    sError = "Pack " + mName + " is corrupt or has an unsupported version";
+    return false;
+  }
+  m_pEntries = reinterpret_cast<const SEntry*>(pData + m_pHeader->uiEntryOffset);
+  m_pStrings = reinterpret_cast<const char*>(pData + m_pHeader->uiStringsOffset);
+
+  // the file infos are only created once for the listings of the resource group manager
+  m_FileList.reserve(m_pHeader->uiEntryCount);
+  for (uint32_t i = 0; i < m_pHeader->uiEntryCount; i++) {
+    const SEntry &entry(m_pEntries[i]);
+    Ogre::FileInfo info;
+    info.archive = this;
+    info.filename = m_pStrings + entry.uiName;
+    Ogre::StringUtil::splitFilename(info.filename, info.basename, info.path);
+    info.compressedSize = entry.uiStoredSize;
+    info.uncompressedSize = entry.uiSize;
+    m_FileList.push_back(info);
+  }
+  return true;
+}
+
+void CPackArchive::unload() {
+  // open streams keep the mapping alive
+  m_pMappedFile.reset();
+  m_pHeader = nullptr;
+  m_pEntries = nullptr;
+  m_pStrings = nullptr;
+  m_FileList.clear();
+}
+
+Ogre::DataStreamPtr CPackArchive::open(const Ogre::String &sFilename, bool bReadOnly) const {
+  ASSERT(m_pMappedFile);
+  const SEntry *pEntry(findEntryOrBasename(sFilename));
+  if (!pEntry) {
+    return Ogre::DataStreamPtr();
+  }
+
+  const unsigned char *pStored(m_pMappedFile->getData() + pEntry->uiDataOffset);
+  if (pEntry->uiCompression == C_NONE) {
+    return Ogre::DataStreamPtr(OGRE_NEW CPackDataStream(sFilename, m_pMappedFile, pStored, pEntry->uiSize));
+  }
+
+  CPackArchiveFactory::DataPtr pData(getDecompressed(*pEntry));
+  if (!pData) {
+    throw Ogre::Exception(0, "Entry " + sFilename + " of pack " + mName + " can not be decompressed", __FILE__);
+  }
+  return Ogre::DataStreamPtr(OGRE_NEW CPackDataStream(sFilename, pData, pData->data(), pData->size()));
+}
+
+bool CPackArchive::read(const Ogre::String &sFilename, std::string &sData, std::string &sError) const {
+  ASSERT(m_pMappedFile);
+  const SEntry *pEntry(findEntryOrBasename(sFilename));
+  if (!pEntry) {
+    sError = "File " + sFilename + " not found in " + mName;
+    return false;
+  }
+
+  if (pEntry->uiCompression == C_NONE) {
+    const char *pStored(reinterpret_cast<const char*>(m_pMappedFile->getData() + pEntry->uiDataOffset));
+    sData.assign(pStored, pEntry->uiSize);
+    return true;
+  }
+
+  CPackArchiveFactory::DataPtr pData(getDecompressed(*pEntry));
+  if (!pData) {
+    sError = "Entry " + sFilename + " of pack " + mName + " can not be decompressed";
+    return false;
+  }
+  sData.assign(reinterpret_cast<const char*>(pData->data()), pData->size());
+  return true;
+}
+
+CPackArchiveFactory::DataPtr CPackArchive::getDecompressed(const SEntry &entry) const {
+  // compressed entries are decompressed once and shared by all archives of the pack
+  const std::string sKey(mName + "/" + (m_pStrings + entry.uiName));
+  CPackArchiveFactory *pFactory(CPackArchiveFactory::getSingletonPtr());
+  CPackArchiveFactory::DataPtr pData(pFactory ? pFactory->getCachedData(sKey) : CPackArchiveFactory::DataPtr());
+  if (pData) {return pData;}
+
+  const unsigned char *pStored(m_pMappedFile->getData() + entry.uiDataOffset);
+  std::shared_ptr<std::vector<unsigned char> > pDecompressed(new std::vector<unsigned char>(entry.uiSize));
+  if (entry.uiCompression != C_LZ4
+      || !decompressLZ4(pStored, entry.uiStoredSize, pDecompressed->data(), pDecompressed->size())) {
+    return CPackArchiveFactory::DataPtr();
+  }
+  pData = pDecompressed;
+  if (pFactory) {pFactory->addCachedData(sKey, pData);}
+  return pData;
+}
+
+Ogre::StringVectorPtr CPackArchive::list(bool bRecursive, bool bDirs) {
+  Ogre::StringVectorPtr ret(OGRE_NEW_T(Ogre::StringVector, Ogre::MEMCATEGORY_GENERAL)(), Ogre::SPFM_DELETE_T);
+  if (bDirs) {return ret;}
+  for (const Ogre::FileInfo &info : m_FileList) {
+    if (bRecursive || info.path.empty()) {
+      ret->push_back(info.filename);
+    }
+  }
+  return ret;
+}
+
+Ogre::FileInfoListPtr CPackArchive::listFileInfo(bool bRecursive, bool bDirs) {
+  Ogre::FileInfoListPtr ret(OGRE_NEW_T(Ogre::FileInfoList, Ogre::MEMCATEGORY_GENERAL)(), Ogre::SPFM_DELETE_T);
+  if (bDirs) {return ret;}
+  for (const Ogre::FileInfo &info : m_FileList) {
+    if (bRecursive || info.path.empty()) {
+      ret->push_back(info);
+    }
+  }
+  return ret;
+}
+
+Ogre::StringVectorPtr CPackArchive::find(const Ogre::String &sPattern, bool bRecursive, bool bDirs) {
+  Ogre::StringVectorPtr ret(OGRE_NEW_T(Ogre::StringVector, Ogre::MEMCATEGORY_GENERAL)(), Ogre::SPFM_DELETE_T);
+  Ogre::FileInfoListPtr infos(findFileInfo(sPattern, bRecursive, bDirs));
+  for (const Ogre::FileInfo &info : *infos) {
+    ret->push_back(info.filename);
+  }
+  return ret;
+}
+
+Ogre::FileInfoListPtr CPackArchive::findFileInfo(const Ogre::String &sPattern, bool bRecursive, bool bDirs) const {
+  Ogre::FileInfoListPtr ret(OGRE_NEW_T(Ogre::FileInfoList, Ogre::MEMCATEGORY_GENERAL)(), Ogre::SPFM_DELETE_T);
+  if (bDirs) {return ret;}
+  // same matching as the zip archive: a pattern with a directory matches the full name
+  const bool bFullMatch(sPattern.find('/') != Ogre::String::npos || sPattern.find('\\') != Ogre::String::npos);
+  const bool bWildCard(sPattern.find('*') != Ogre::String::npos);
+  for (const Ogre::FileInfo &info : m_FileList) {
+    if ((bRecursive || bFullMatch || bWildCard)
+        && Ogre::StringUtil::match(bFullMatch ? info.filename : info.basename, sPattern, false)) {
+      ret->push_back(info);
+    }
+  }
+  return ret;
+}
+
+bool CPackArchive::exists(const Ogre::String &sFilename) {
+  return findEntryOrBasename(sFilename) != nullptr;
+}
+
+time_t CPackArchive::getModifiedTime(const Ogre::String &sFilename) {
+  // the entries have the time of the pack
+  struct stat fileStat;
+  if (stat(mName.c_str(), &fileStat) != 0) {return 0;}
+  return fileStat.st_mtime;
+}
+
+const SEntry *CPackArchive::findEntry(const Ogre::String &sFilename) const {
+  if (!m_pEntries) {return nullptr;}
+  const SEntry *pEnd(m_pEntries + m_pHeader->uiEntryCount);
+  const char *pStrings(m_pStrings);
+  const SEntry *pEntry(std::lower_bound(m_pEntries, pEnd, sFilename.c_str(),
+      [pStrings](const SEntry &entry, const char *pName) {return compareNames(pStrings + entry.uiName, pName) < 0;}));
+  if (pEntry == pEnd || compareNames(m_pStrings + pEntry->uiName, sFilename.c_str()) != 0) {
+    return nullptr;
+  }
+  return pEntry;
+}
+
+const SEntry *CPackArchive::findEntryOrBasename(const Ogre::String &sFilename) const {
+  const SEntry *pEntry(findEntry(sFilename));
+  if (pEntry) {return pEntry;}
+  Ogre::String sBasename, sPath;
+  Ogre::StringUtil::splitFilename(sFilename, sBasename, sPath);
+  return findEntryByBasename(sBasename);
+}
+
+const SEntry *CPackArchive::findEntryByBasename(const Ogre::String &sBasename) const {
+  const SEntry *pFound(nullptr);
+  for (size_t i = 0; i < m_FileList.size(); i++) {
+    if (compareNames(m_FileList[i].basename.c_str(), sBasename.c_str()) == 0) {
+      // ambiguous names are not opened, like in the zip archive
+      if (pFound) {return nullptr;}
+      pFound = &m_pEntries[i];
+    }
+  }
+  return pFound;
+}
+
+bool CPackArchive::checkPack() const {
+  const size_t uiSize(m_pMappedFile->getSize());
+  if (uiSize < sizeof(SHeader)
+      || memcmp(m_pHeader->acMagic, PACK_ARCHIVE_MAGIC, sizeof(m_pHeader->acMagic)) != 0
+      || m_pHeader->uiVersion != PACK_ARCHIVE_VERSION) {
+    return false;
+  }
+  if (m_pHeader->uiEntryOffset % 4 != 0
+      || m_pHeader->uiEntryOffset > uiSize
+      || m_pHeader->uiEntryCount > (uiSize - m_pHeader->uiEntryOffset) / sizeof(SEntry)
+      || m_pHeader->uiStringsOffset > uiSize
+      || m_pHeader->uiStringsSize == 0
+      || m_pHeader->uiStringsSize > uiSize - m_pHeader->uiStringsOffset) {
+    return false;
+  }
+  const char *pStrings(reinterpret_cast<const char*>(m_pMappedFile->getData() + m_pHeader->uiStringsOffset));
+  if (pStrings[m_pHeader->uiStringsSize - 1] != 0) {return false;}
+
+  const SEntry *pEntries(reinterpret_cast<const SEntry*>(m_pMappedFile->getData() + m_pHeader->uiEntryOffset));
+  for (uint32_t i = 0; i < m_pHeader->uiEntryCount; i++) {
+    const SEntry &entry(pEntries[i]);
+    if (entry.uiName >= m_pHeader->uiStringsSize
+        || entry.uiDataOffset > uiSize
+        || entry.uiStoredSize > uiSize - entry.uiDataOffset
+        || (entry.uiCompression == C_NONE && entry.uiStoredSize != entry.uiSize)
+        // a lz4 block expands at most by 255, larger sizes would allocate huge buffers
+        || (entry.uiCompression == C_LZ4 && entry.uiSize > static_cast<uint64_t>(entry.uiStoredSize) * 255)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+template<> CPackArchiveFactory *Ogre::Singleton<CPackArchiveFactory>::msSingleton = 0;
+
+#if OGRE_PLATFORM == OGRE_PLATFORM_ANDROID
+const size_t CPackArchiveFactory::DEFAULT_CACHE_BUDGET(8 * 1024 * 1024);
+#else
+const size_t CPackArchiveFactory::DEFAULT_CACHE_BUDGET(32 * 1024 * 1024);
+#endif
+
+CPackArchiveFactory *CPackArchiveFactory::getSingletonPtr() {
+  return msSingleton;
+}
+CPackArchiveFactory &CPackArchiveFactory::getSingleton() {
+  ASSERT(msSingleton);
+  return *msSingleton;
+}
+
+CPackArchiveFactory::CPackArchiveFactory(size_t uiCacheBudget)
+  : m_uiCacheBudget(uiCacheBudget),
+    m_uiCachedBytes(0),
+    m_uiRequestCount(0),
+    m_uiHitCount(0) {
+}
+
+CPackArchiveFactory::~CPackArchiveFactory() {
+  // deleted after the root, the statistics are logged by CGame before
+}
+
+const Ogre::String &CPackArchiveFactory::getType() const {
+  static const Ogre::String sType(PACK_ARCHIVE_TYPE);
+  return sType;
+}
+
+Ogre::Archive *CPackArchiveFactory::createInstance(const Ogre::String &sName, bool bReadOnly) {
+  if (!bReadOnly) {return nullptr;}
+  return OGRE_NEW CPackArchive(sName, getType());
+}
+
+void CPackArchiveFactory::destroyInstance(Ogre::Archive *pArchive) {
+  OGRE_DELETE pArchive;
+}
+
+CPackArchiveFactory::DataPtr CPackArchiveFactory::getCachedData(const std::string &sKey) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  m_uiRequestCount++;
+  auto it = m_mCacheIndex.find(sKey);
+  if (it == m_mCacheIndex.end()) {return DataPtr();}
+
+  m_uiHitCount++;
+  m_lCache.splice(m_lCache.begin(), m_lCache, it->second);
+  return it->second->pData;
+}
+
+void CPackArchiveFactory::addCachedData(const std::string &sKey, const DataPtr &pData) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  if (m_mCacheIndex.count(sKey) > 0) {return;}
+  m_lCache.push_front({sKey, pData});
+  m_mCacheIndex[sKey] = m_lCache.begin();
+  m_uiCachedBytes += pData->size();
+  evict();
+}
+
+void CPackArchiveFactory::setCacheBudget(size_t uiCacheBudget) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  m_uiCacheBudget = uiCacheBudget;
+  evict();
+}
+
+size_t CPackArchiveFactory::getCachedBytes() const {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return m_uiCachedBytes;
+}
+
+unsigned int CPackArchiveFactory::getRequestCount() const {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return m_uiRequestCount;
+}
+
+unsigned int CPackArchiveFactory::getHitCount() const {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return m_uiHitCount;
+}
+
+void CPackArchiveFactory::evict() {
+  // entries that are still in use stay alive in their streams
+  while (m_uiCachedBytes > m_uiCacheBudget && !m_lCache.empty()) {
+    m_uiCachedBytes -= m_lCache.back().pData->size();
+    m_mCacheIndex.erase(m_lCache.back().sKey);
+    m_lCache.pop_back();
+  }
+}
@@ -0,0 +1,205 @@
+/*****************************************************************************
+ * Copyright 2014 Christoph Wick
+ *
+ * This file is part of Zelda.
+ *
+ * Zelda is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zelda is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Zelda. If not, see http://www.gnu.org/licenses/.
+ *****************************************************************************/
+
+#ifndef _PACK_ARCHIVE_HPP_
+#define _PACK_ARCHIVE_HPP_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <OgreArchive.h>
+#include <OgreArchiveFactory.h>
+#include <OgreSingleton.h>
+
+//! Read only pack file that is memory mapped, written by tools/PackArchive.py
+/**
+  * The pack is stored as '<name>.pak' and replaces the zip file of the same
+  * name. All values are little endian and 4 byte aligned:
+  *  - header
+  *  - entry table: sorted by the lower case names, so a file is found by a
+  *    binary search in the mapped table
+  *  - string table: zero terminated file names (with their directory),
+  *    referenced by their byte offset
+  *  - data of the entries, 16 byte aligned
+  *
+  * An entry is stored uncompressed or compressed as a LZ4 block. Uncompressed
+  * entries are returned as streams on the mapped memory, nothing is copied.
+  */
+namespace PackArchive {
+  const uint32_t PACK_ARCHIVE_VERSION = 1;
+  const char PACK_ARCHIVE_MAGIC[4] = {'Z', 'P', 'A', 'K'};
+  const char * const PACK_ARCHIVE_EXTENSION = ".pak";
+  const char * const PACK_ARCHIVE_TYPE = "Pack";
+
+  enum ECompression {
+    C_NONE = 0,
+    C_LZ4 = 1,
+  };
+
+  struct SHeader {
+    char acMagic[4];
+    uint32_t uiVersion;
+    uint32_t uiEntryCount;
+    uint32_t uiEntryOffset;
+    uint32_t uiStringsSize;
+    uint32_t uiStringsOffset;
+  };
+
+  struct SEntry {
+    uint32_t uiName;
+    uint32_t uiCompression;
+    uint32_t uiDataOffset;
+    uint32_t uiStoredSize;            //!< size in the pack
+    uint32_t uiSize;                  //!< size of the file
+  };
+
+  //! decompress a LZ4 block, false if the data is corrupt or does not match the size
+  bool decompressLZ4(const unsigned char *pSrc, size_t uiSrcSize, unsigned char *pDst, size_t uiDstSize);
+};
+
+//! Read only memory mapping of a whole file
+class CMappedFile {
+private:
+  const unsigned char *m_pData;
+  size_t m_uiSize;
+#if OGRE_PLATFORM == OGRE_PLATFORM_WIN32
+  void *m_hFile;
+  void *m_hMapping;
+#else
+  int m_iFile;
+#endif
+public:
+  //! nullptr and the reason in sError if the file can not be mapped, does not throw (safe on any thread)
+  static std::shared_ptr<CMappedFile> open(const std::string &sFile, std::string &sError);
+  ~CMappedFile();
+
+  const unsigned char *getData() const {return m_pData;}
+  size_t getSize() const {return m_uiSize;}
+private:
+  CMappedFile();
+  bool map(const std::string &sFile, std::string &sError);
+  CMappedFile(const CMappedFile &);
+  CMappedFile &operator=(const CMappedFile &);
+};
+
+//! Ogre archive of a pack file (see PackArchive)
+/**
+  * Like the Ogre zip archive the names are case insensitive and a file can
+  * also be opened by its name without the directory, if it is unique.
+  * The archive can be used without the archive manager (e.g. to prefetch a
+  * map pack on another thread), the streams keep the mapping alive.
+  */
+class CPackArchive : public Ogre::Archive {
+private:
+  std::shared_ptr<CMappedFile> m_pMappedFile;
+  const PackArchive::SHeader *m_pHeader;
+  const PackArchive::SEntry *m_pEntries;
+  const char *m_pStrings;
+  Ogre::FileInfoList m_FileList;
+public:
+  CPackArchive(const Ogre::String &sName, const Ogre::String &sArchiveType = PackArchive::PACK_ARCHIVE_TYPE);
+  ~CPackArchive();
+
+  //! true if the file starts with the magic of a pack (of any version)
+  static bool isPackArchive(const Ogre::String &sFile);
+
+  bool isCaseSensitive() const {return false;}
+  //! throws an Ogre::Exception if the pack can not be mapped or is corrupt
+  void load();
+  //! like load() but reports the error instead of throwing, for the prefetch thread
+  bool load(std::string &sError);
+  void unload();
+
+  Ogre::DataStreamPtr open(const Ogre::String &sFilename, bool bReadOnly = true) const;
+  //! copy a file into sData, reports the error instead of throwing, for the prefetch thread
+  bool read(const Ogre::String &sFilename, std::string &sData, std::string &sError) const;
+  Ogre::StringVectorPtr list(bool bRecursive = true, bool bDirs = false);
+  Ogre::FileInfoListPtr listFileInfo(bool bRecursive = true, bool bDirs = false);
+  Ogre::StringVectorPtr find(const Ogre::String &sPattern, bool bRecursive = true, bool bDirs = false);
+  Ogre::FileInfoListPtr findFileInfo(const Ogre::String &sPattern, bool bRecursive = true, bool bDirs = false) const;
+  bool exists(const Ogre::String &sFilename);
+  time_t getModifiedTime(const Ogre::String &sFilename);
+
+private:
+  //! binary search in the sorted entry table, nullptr if not found
+  const PackArchive::SEntry *findEntry(const Ogre::String &sFilename) const;
+  //! the entry whose name without directory is unique and equal to the given one
+  const PackArchive::SEntry *findEntryByBasename(const Ogre::String &sBasename) const;
+  //! findEntry and findEntryByBasename if the name is not found
+  const PackArchive::SEntry *findEntryOrBasename(const Ogre::String &sFilename) const;
+  //! the decompressed data of an entry (cached by the factory), nullptr if it is corrupt
+  std::shared_ptr<const std::vector<unsigned char> > getDecompressed(const PackArchive::SEntry &entry) const;
+  //! check the header and the bounds of the tables and the entries
+  bool checkPack() const;
+};
+
+//! Creates the pack archives and caches their decompressed entries
+/**
+  * A map pack is mounted every time the map is loaded, the decompressed
+  * entries are kept (up to a memory budget) so that loading a map again only
+  * costs a lookup. The least recently used entries are dropped first. The
+  * cache is thread safe.
+  */
+class CPackArchiveFactory
+  : public Ogre::ArchiveFactory,
+    public Ogre::Singleton<CPackArchiveFactory> {
+public:
+  typedef std::shared_ptr<const std::vector<unsigned char> > DataPtr;
+  static const size_t DEFAULT_CACHE_BUDGET;
+private:
+  struct SCacheEntry {
+    std::string sKey;
+    DataPtr pData;
+  };
+  mutable std::mutex m_Mutex;
+  std::list<SCacheEntry> m_lCache;        //!< most recently used first
+  std::unordered_map<std::string, std::list<SCacheEntry>::iterator> m_mCacheIndex;
+  size_t m_uiCacheBudget;
+  size_t m_uiCachedBytes;
+  unsigned int m_uiRequestCount;
+  unsigned int m_uiHitCount;
+public:
+  static CPackArchiveFactory &getSingleton();
+  static CPackArchiveFactory *getSingletonPtr();
+
+  CPackArchiveFactory(size_t uiCacheBudget = DEFAULT_CACHE_BUDGET);
+  ~CPackArchiveFactory();
+
+  const Ogre::String &getType() const;
+  Ogre::Archive *createInstance(const Ogre::String &sName, bool bReadOnly);
+  void destroyInstance(Ogre::Archive *pArchive);
+
+  //! get a decompressed entry, nullptr if it is not cached
+  DataPtr getCachedData(const std::string &sKey);
+  void addCachedData(const std::string &sKey, const DataPtr &pData);
+  void setCacheBudget(size_t uiCacheBudget);
+  size_t getCachedBytes() const;
+  unsigned int getRequestCount() const;
+  unsigned int getHitCount() const;
+
+private:
+  //! drop the least recently used entries until the budget is met, the mutex must be locked
+  void evict();
+};
+
+#endif // _PACK_ARCHIVE_HPP_
@@ -21,6 +21,7 @@
 #include "../Message/MessageDebug.hpp"
 #include "../Message/MessageHandler.hpp"
 #include "../Game.hpp"
+#include "../Physics/PhysicsTaskScheduler.hpp"
 
 using namespace CEGUI;
 
@@ -37,6 +38,9 @@ CGUIDebugPullMenu::CGUIDebugPullMenu(CEntity *pParentEntity,
   float fPos = 0;
   createButton("OgreTray/Checkbox", "debug_drawer", "Toggle debug drawer", fPos)->subscribeEvent(ToggleButton::EventSelectStateChanged, Event::Subscriber(&CGUIDebugPullMenu::onToggleDebugDrawer, this));
   createButton("OgreTray/Checkbox", "physics", "Toggle physics debug", fPos)->subscribeEvent(ToggleButton::EventSelectStateChanged, Event::Subscriber(&CGUIDebugPullMenu::onTogglePhysics, this));
+  ToggleButton *pPhysicsMt = dynamic_cast<ToggleButton*>(createButton("OgreTray/Checkbox", "physics_mt", "Multithreaded physics", fPos));
+  pPhysicsMt->setSelected(CPhysicsTaskScheduler::getSingleton().isMultithreaded());
+  pPhysicsMt->subscribeEvent(ToggleButton::EventSelectStateChanged, Event::Subscriber(&CGUIDebugPullMenu::onTogglePhysicsMultithreading, this));
 
   m_pFrameStatsGroup = m_pContent->createChild("OgreTray/Group", "frame_stats");
   m_pFrameStatsGroup->setText("fps: 0");
@@ -79,13 +83,19 @@ CEGUI::Window *CGUIDebugPullMenu::createFrameStatsButton(const CEGUI::String &id
 
 bool CGUIDebugPullMenu::onToggleDebugDrawer(const CEGUI::EventArgs &args) {
   ToggleButton *pTB = dynamic_cast<ToggleButton*>(dynamic_cast<const WindowEventArgs&>(args).window);
-  CMessageHandler::getSingleton().addMessage(new CMessageDebug(CMessageDebug::DM_TOGGLE_DEBUG_DRAWER, pTB->isSelected()));
+  CMessageHandler::getSingleton().createMessage<CMessageDebug>(CMessageDebug::DM_TOGGLE_DEBUG_DRAWER, pTB->isSelected());
   return true;
 }
 
 bool CGUIDebugPullMenu::onTogglePhysics(const CEGUI::EventArgs &args) {
   ToggleButton *pTB = dynamic_cast<ToggleButton*>(dynamic_cast<const WindowEventArgs&>(args).window);
-  CMessageHandler::getSingleton().addMessage(new CMessageDebug(CMessageDebug::DM_TOGGLE_PHYSICS, pTB->isSelected()));
+  CMessageHandler::getSingleton().createMessage<CMessageDebug>(CMessageDebug::DM_TOGGLE_PHYSICS, pTB->isSelected());
+  return true;
+}
+
+bool CGUIDebugPullMenu::onTogglePhysicsMultithreading(const CEGUI::EventArgs &args) {
+  ToggleButton *pTB = dynamic_cast<ToggleButton*>(dynamic_cast<const WindowEventArgs&>(args).window);
+  CMessageHandler::getSingleton().createMessage<CMessageDebug>(CMessageDebug::DM_TOGGLE_PHYSICS_MULTITHREADING, pTB->isSelected());
   return true;
 }
 
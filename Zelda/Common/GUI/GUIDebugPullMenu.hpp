@@ -44,6 +44,7 @@ private:
 
   bool onToggleDebugDrawer(const CEGUI::EventArgs &args);
   bool onTogglePhysics(const CEGUI::EventArgs &args);
+  bool onTogglePhysicsMultithreading(const CEGUI::EventArgs &args);
 };
 
 #endif /* defined(__Zelda__GUIDebugPullMenu__) */
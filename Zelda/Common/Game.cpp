@@ -22,17 +22,24 @@
 #include "Game.hpp"
 #include <OgreCodec.h>
 #include <OgreConfigFile.h>
+#include <OgreStringConverter.h>
 #include "Input/GameInputManager.hpp"
 #include "InputDefines.hpp"
 #include "FileManager/FileManager.hpp"
+#include "FileManager/PackArchive.hpp"
 #include "Message/MessageHandler.hpp"
 #include "GameLogic/GameStateManager.hpp"
 #include "GameLogic/EntityManager.hpp"
+#include "GameLogic/EntityRegistry.hpp"
 #include "Util/DebugDrawer.hpp"
 #include "Message/MessageDebug.hpp"
 #include "Log.hpp"
 #include "PauseManager/PauseManager.hpp"
 #include "Lua/LuaScriptManager.hpp"
+#include "Lua/LuaScheduler.hpp"
+#include "Jobs/JobSystem.hpp"
+#include "Physics/CollisionShapeLibrary.hpp"
+#include "Physics/PhysicsTaskScheduler.hpp"
 #include MESSAGE_CREATOR_HEADER
 #include "Util/GameMemory.hpp"
 
@@ -90,16 +97,26 @@ CGame::~CGame(void) {
   if (CPauseManager::getSingletonPtr()) {delete CPauseManager::getSingletonPtr();}
   if (MESSAGE_CREATOR::getSingletonPtr()) {delete MESSAGE_CREATOR::getSingletonPtr();}
   if (CGameMemory::getSingletonPtr()) {delete CGameMemory::getSingletonPtr();}
+  if (CLuaScheduler::getSingletonPtr()) {delete CLuaScheduler::getSingletonPtr();}
+  if (CPhysicsTaskScheduler::getSingletonPtr()) {delete CPhysicsTaskScheduler::getSingletonPtr();}
+  if (CJobSystem::getSingletonPtr()) {delete CJobSystem::getSingletonPtr();}
+  if (CCollisionShapeLibrary::getSingletonPtr()) {delete CCollisionShapeLibrary::getSingletonPtr();}
 
   if (CMessageHandler::getSingletonPtr()) {
     delete CMessageHandler::getSingletonPtr();
   }
   if (CEntityManager::getSingletonPtr()) {delete CEntityManager::getSingletonPtr();}
+  if (CEntityRegistry::getSingletonPtr()) {delete CEntityRegistry::getSingletonPtr();}
 
   OGRE_DELETE_T(mFSLayer, FileSystemLayer, Ogre::MEMCATEGORY_GENERAL);
   //Remove ourself as a Window listener
   Ogre::WindowEventUtilities::removeWindowEventListener(mWindow, this);
   windowClosed(mWindow);
+  if (CPackArchiveFactory::getSingletonPtr()) {
+    Ogre::LogManager::getSingleton().logMessage("Pack archive cache: "
+        + Ogre::StringConverter::toString(CPackArchiveFactory::getSingleton().getHitCount()) + " of "
+        + Ogre::StringConverter::toString(CPackArchiveFactory::getSingleton().getRequestCount()) + " decompressions were cached");
+  }
   if (mRoot) {
 #if OGRE_VERSION >= ((1 << 16) | (9 << 8) | 0)
     if (mOverlaySystem) {OGRE_DELETE mOverlaySystem;}
@@ -108,6 +125,8 @@ CGame::~CGame(void) {
 
     OGRE_DELETE mRoot;
   }
+  // the archive manager of the root unloads the archives with the factory
+  if (CPackArchiveFactory::getSingletonPtr()) {delete CPackArchiveFactory::getSingletonPtr();}
 }
 void CGame::go() {
   initApp();
@@ -209,6 +228,10 @@ void CGame::createRoot() {
 void CGame::locateResources() {
   // add custom resource managers
   new CLuaScriptManager();
+#if OGRE_PLATFORM != OGRE_PLATFORM_ANDROID
+  // the map packs are read from the apk on android
+  Ogre::ArchiveManager::getSingleton().addArchiveFactory(new CPackArchiveFactory());
+#endif
 
   // this is first added, that we use these files first if existing
   for (const std::string &path : m_vAdditionalLevelDirPaths) {
@@ -553,9 +576,19 @@ void CGame::createScene() {
   new CGameMemory();
   Ogre::LogManager::getSingletonPtr()->logMessage("    EntityManager ");
   new CEntityManager();
+  LOGI("    EntityRegistry");
+  new CEntityRegistry();
+  LOGI("    JobSystem");
+  new CJobSystem();
+  LOGI("    PhysicsTaskScheduler");
+  new CPhysicsTaskScheduler();
+  LOGI("    CollisionShapeLibrary");
+  new CCollisionShapeLibrary();
   Ogre::LogManager::getSingletonPtr()->logMessage("    MessageManager ");
   new CMessageHandler();
-  CMessageHandler::getSingleton().addInjector(this);
+  subscribeMessage(MSG_DEBUG);
+  LOGI("    LuaScheduler");
+  new CLuaScheduler();
   LOGI("    PauseManager");
   new CPauseManager();
   LOGI("    MessageCreator");
@@ -623,8 +656,12 @@ bool CGame::frameStarted(const Ogre::FrameEvent& evt) {
   mInputContext.capture();
 
   // process messages
+  CMessageHandler::getSingleton().nextFrame();
   CMessageHandler::getSingleton().process();
 
+  // resume lua scripts whose wait conditions are fulfilled
+  CLuaScheduler::getSingleton().update();
+
   // update pause
   CPauseManager::getSingleton().update();
 
@@ -871,10 +908,13 @@ void CGame::windowClosed(Ogre::RenderWindow* rw)
 // CMessageInjector
 void CGame::sendMessageToAll(const CMessage &message) {
   if (message.getType() == MSG_DEBUG) {
-    const CMessageDebug &dbg_msg(dynamic_cast<const CMessageDebug &>(message));
+    const CMessageDebug &dbg_msg(message.getAs<CMessageDebug>());
     if (dbg_msg.getDebugType() == CMessageDebug::DM_TOGGLE_DEBUG_DRAWER) {
       m_bDebugDrawerEnabled = dbg_msg.isActive();
     }
+    else if (dbg_msg.getDebugType() == CMessageDebug::DM_TOGGLE_PHYSICS_MULTITHREADING) {
+      CPhysicsTaskScheduler::getSingleton().setMultithreaded(dbg_msg.isActive());
+    }
   }
 }
 
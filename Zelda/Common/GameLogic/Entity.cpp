@@ -41,7 +41,9 @@ CEntity::CEntity(const std::string &sID, unsigned int uiType, CEntity *pParent,
     m_eState(EST_NORMAL),
     m_bPauseRender(false),
     m_bPauseUpdate(false),
-    m_pParent(pParent) {
+    m_pParent(pParent),
+    m_pChildUpdateLayout(nullptr),
+    m_uiUpdatePhases(EUPM_DEFAULT) {
   attachTo(pParent);
 }
 
@@ -53,7 +55,9 @@ CEntity::CEntity(const std::string &sID, CEntity *pParent, const std::string &sR
     m_eState(EST_NORMAL),
     m_bPauseRender(false),
     m_bPauseUpdate(false),
-    m_pParent(pParent) {
+    m_pParent(pParent),
+    m_pChildUpdateLayout(nullptr),
+    m_uiUpdatePhases(EUPM_DEFAULT) {
   attachTo(pParent);
 }
 CEntity::CEntity(const CEntity &src)
@@ -64,7 +68,9 @@ CEntity::CEntity(const CEntity &src)
     m_eState(EST_NORMAL),
     m_bPauseRender(src.m_bPauseRender),
     m_bPauseUpdate(src.m_bPauseUpdate),
-    m_pParent(src.m_pParent) {
+    m_pParent(src.m_pParent),
+    m_pChildUpdateLayout(nullptr),
+    m_uiUpdatePhases(src.m_uiUpdatePhases) {
   attachTo(src.m_pParent);
   // not copying children so far
   // and for events
@@ -75,13 +81,15 @@ CEntity::CEntity(
 		 const tinyxml2::XMLElement *pElem,
 		 const std::string &sResourceGroup)
   : CMessageInjector(false),
-    m_sID(Attribute(pElem, "id", m_sID)),
+    m_sID(Attribute(pElem, "id", "")),
     m_sResourceGroup(Attribute(pElem, "resource_group", sResourceGroup)),
     m_uiType(IntAttribute(pElem, "type", 0)),
     m_eState(ENTITY_STATE_ID_MAP.parseString(Attribute(pElem, "state", ENTITY_STATE_ID_MAP.toString(EST_NORMAL)))),
     m_bPauseRender(BoolAttribute(pElem, "pause_render", false)),
     m_bPauseUpdate(BoolAttribute(pElem, "pause_update", false)),
-    m_pParent(NULL) {
+    m_pParent(NULL),
+    m_pChildUpdateLayout(nullptr),
+    m_uiUpdatePhases(EUPM_DEFAULT) {
 
 
   readEventsFromXMLElement(pElem, false);
@@ -90,6 +98,11 @@ CEntity::CEntity(
   attachTo(pParent);
 }
 CEntity::~CEntity() {
+  if (m_Handle.isValid() && CEntityRegistry::getSingletonPtr()) {
+    CEntityRegistry::getSingleton().remove(m_Handle);
+    m_Handle = CEntityHandle();
+  }
+
   std::list<CEntity *> lClone(m_lChildren);
   m_lChildren.clear();
   while (lClone.size() > 0) {
@@ -100,6 +113,11 @@ CEntity::~CEntity() {
   clearEvents();
 
   attachTo(NULL);
+
+  if (m_pChildUpdateLayout) {
+    delete m_pChildUpdateLayout;
+    m_pChildUpdateLayout = nullptr;
+  }
 }
 void CEntity::init() {
   mEventAccessedMutex.lock();
@@ -137,11 +155,63 @@ void CEntity::stop() {
 void CEntity::attachTo(CEntity *pParent) {
   if (m_pParent) {
     m_pParent->m_lChildren.remove(this);
+    if (m_pParent->m_pChildUpdateLayout) {
+      m_pParent->m_pChildUpdateLayout->remove(this);
+    }
   }
   m_pParent = pParent;
 
   if (m_pParent) {
     m_pParent->m_lChildren.push_back(this);
+    if (m_pParent->m_pChildUpdateLayout) {
+      m_pParent->m_pChildUpdateLayout->add(this, m_uiUpdatePhases);
+    }
+  }
+
+  if (!m_Handle.isValid() && CEntityRegistry::getSingletonPtr()) {
+    m_Handle = CEntityRegistry::getSingleton().add(this);
+  }
+}
+
+void CEntity::setID(const std::string &sID) {
+  const CAtom sOldID(m_sID);
+  m_sID = sID;
+  if (m_Handle.isValid()) {
+    CEntityRegistry::getSingleton().changeID(m_Handle, sOldID);
+  }
+}
+
+void CEntity::enableChildUpdateLayout() {
+  if (m_pChildUpdateLayout) {return;}
+
+  m_pChildUpdateLayout = new CEntityUpdateLayout();
+  for (CEntity *pChild : m_lChildren) {
+    m_pChildUpdateLayout->add(pChild, pChild->m_uiUpdatePhases);
+  }
+}
+
+void CEntity::setUpdatePhases(unsigned int uiPhases) {
+  if (!m_lEvents.empty()) {
+    // events are updated in update and deleted in frameStarted
+    uiPhases |= EUPM_FRAME_STARTED | EUPM_UPDATE;
+  }
+  if (m_uiUpdatePhases == uiPhases) {return;}
+
+  m_uiUpdatePhases = uiPhases;
+  if (m_pParent && m_pParent->m_pChildUpdateLayout) {
+    m_pParent->m_pChildUpdateLayout->remove(this);
+    m_pParent->m_pChildUpdateLayout->add(this, m_uiUpdatePhases);
+  }
+}
+
+void CEntity::setType(unsigned int uiType) {
+  if (m_uiType == uiType) {return;}
+
+  m_uiType = uiType;
+  // the layout is sorted by the type
+  if (m_pParent && m_pParent->m_pChildUpdateLayout) {
+    m_pParent->m_pChildUpdateLayout->remove(this);
+    m_pParent->m_pChildUpdateLayout->add(this, m_uiUpdatePhases);
   }
 }
 
@@ -156,7 +226,7 @@ const CEntity *CEntity::getRoot() const {
   return m_pParent->getRoot();
 }
 
-CEntity *CEntity::getParent(const std::string &sID) {
+CEntity *CEntity::getParent(const CAtom &sID) {
   std::lock_guard<std::mutex> lock(mEntityMutex);
   if (!m_pParent) {return NULL;}
   if (m_pParent->m_sID == sID) {
@@ -165,7 +235,7 @@ CEntity *CEntity::getParent(const std::string &sID) {
   return m_pParent->getParent();
 }
 
-const CEntity *CEntity::getParent(const std::string &sID) const {
+const CEntity *CEntity::getParent(const CAtom &sID) const {
   std::lock_guard<std::mutex> lock(mEntityMutex);
   if (!m_pParent) {return NULL;}
   if (m_pParent->m_sID == sID) {
@@ -174,7 +244,10 @@ const CEntity *CEntity::getParent(const std::string &sID) const {
   return m_pParent->getParent();
 }
 
-CEntity *CEntity::getChild(const std::string &sID) {
+CEntity *CEntity::getChild(const CAtom &sID) {
+  if (CEntityRegistry::getSingletonPtr()) {
+    return CEntityRegistry::getSingleton().find(sID, this, false);
+  }
   std::lock_guard<std::mutex> lock(mEntityMutex);
   for (auto *pChild : m_lChildren) {
     if (pChild->m_sID == sID) {
@@ -183,7 +256,11 @@ CEntity *CEntity::getChild(const std::string &sID) {
   }
   return NULL;
 }
-CEntity *CEntity::getChildRecursive(const std::string &sID) {
+CEntity *CEntity::getChildRecursive(const CAtom &sID) {
+  if (CEntityRegistry::getSingletonPtr()) {
+    // hash lookup instead of a walk through the tree
+    return CEntityRegistry::getSingleton().find(sID, this, true);
+  }
   std::lock_guard<std::mutex> lock(mEntityMutex);
   for (auto *pChild : m_lChildren) {
     if (pChild->m_sID == sID) {
@@ -198,7 +275,10 @@ CEntity *CEntity::getChildRecursive(const std::string &sID) {
   }
   return NULL;
 }
-const CEntity *CEntity::getChild(const std::string &sID) const {
+const CEntity *CEntity::getChild(const CAtom &sID) const {
+  if (CEntityRegistry::getSingletonPtr()) {
+    return CEntityRegistry::getSingleton().find(sID, this, false);
+  }
   std::lock_guard<std::mutex> lock(mEntityMutex);
   for (auto *pChild : m_lChildren) {
     if (pChild->m_sID == sID) {
@@ -207,7 +287,10 @@ const CEntity *CEntity::getChild(const std::string &sID) const {
   }
   return NULL;
 }
-const CEntity *CEntity::getChildRecursive(const std::string &sID) const {
+const CEntity *CEntity::getChildRecursive(const CAtom &sID) const {
+  if (CEntityRegistry::getSingletonPtr()) {
+    return CEntityRegistry::getSingleton().find(sID, this, true);
+  }
   std::lock_guard<std::mutex> lock(mEntityMutex);
   for (auto *pChild : m_lChildren) {
     if (pChild->m_sID == sID) {
@@ -274,6 +357,8 @@ void CEntity::addEvent(events::CEvent *pEvent) {
   mEventAccessedMutex.lock();
   m_lEvents.push_back(pEvent);
   mEventAccessedMutex.unlock();
+
+  setUpdatePhases(m_uiUpdatePhases);
 }
 
 void CEntity::destroyEvent(CEvent *pEvent) {
@@ -291,9 +376,15 @@ void CEntity::sendMessageToAll(const CMessage &message) {
 }
 
 void CEntity::update(Ogre::Real tpf) {
-  for (auto &pEnt : m_lChildren) {
-    if (!pEnt->m_bPauseUpdate) {
-      pEnt->update(tpf);
+  if (m_pChildUpdateLayout) {
+    m_pChildUpdateLayout->prepareUpdate(tpf);
+    m_pChildUpdateLayout->update(tpf);
+  }
+  else {
+    for (auto &pEnt : m_lChildren) {
+      if (!pEnt->m_bPauseUpdate) {
+        pEnt->update(tpf);
+      }
     }
   }
   mEventAccessedMutex.lock();
@@ -304,6 +395,11 @@ void CEntity::update(Ogre::Real tpf) {
 }
 
 void CEntity::preRender(Ogre::Real tpf) {
+  if (m_pChildUpdateLayout) {
+    m_pChildUpdateLayout->preRender(tpf);
+    return;
+  }
+
   for (auto &pEnt : m_lChildren) {
     if (!pEnt->m_bPauseUpdate) {
       pEnt->preRender(tpf);
@@ -312,6 +408,11 @@ void CEntity::preRender(Ogre::Real tpf) {
 }
 
 void CEntity::render(Ogre::Real tpf) {
+  if (m_pChildUpdateLayout) {
+    m_pChildUpdateLayout->render(tpf);
+    return;
+  }
+
   for (auto &pEnt : m_lChildren) {
     if (!pEnt->m_bPauseRender) {
       pEnt->render(tpf);
@@ -320,6 +421,11 @@ void CEntity::render(Ogre::Real tpf) {
 }
 
 void CEntity::renderDebug(Ogre::Real tpf) {
+  if (m_pChildUpdateLayout) {
+    m_pChildUpdateLayout->renderDebug(tpf);
+    return;
+  }
+
   for (auto &pEnt : m_lChildren) {
     if (!pEnt->m_bPauseRender) {
       pEnt->renderDebug(tpf);
@@ -346,9 +452,14 @@ bool CEntity::frameStarted(const Ogre::FrameEvent& evt) {
   }
   mEventToDeleteAccessedMutex.unlock();
 
-  for (auto &pEnt : m_lChildren) {
-    if (!pEnt->m_bPauseUpdate) {
-      pEnt->frameStarted(evt);
+  if (m_pChildUpdateLayout) {
+    m_pChildUpdateLayout->frameStarted(evt);
+  }
+  else {
+    for (auto &pEnt : m_lChildren) {
+      if (!pEnt->m_bPauseUpdate) {
+        pEnt->frameStarted(evt);
+      }
     }
   }
 
@@ -369,7 +480,7 @@ bool CEntity::frameEnded(const Ogre::FrameEvent& evt) {
 void CEntity::writeToXMLElement(tinyxml2::XMLElement *pElement, EOutputStyle eStyle) const {
   using namespace tinyxml2;
 
-  SetAttribute(pElement, "id", m_sID);
+  SetAttribute(pElement, "id", m_sID.str());
   SetAttribute(pElement, "type", m_uiType);
   if (eStyle == OS_FULL) {
     SetAttribute(pElement, "pause_render", m_bPauseRender);
@@ -411,11 +522,11 @@ void CEntity::clearEvents() {
 void CEntity::moveToTarget(const SPATIAL_VECTOR &vPosition, const Ogre::Quaternion &qRotation, const Ogre::Real fMaxDistanceDeviation, const Ogre::Radian fMaxAngleDeviation) {
   setPosition(vPosition);
   setOrientation(qRotation);
-  CMessageHandler::getSingleton().addMessage(new CMessageTargetReached(this));
+  CMessageHandler::getSingleton().createMessage<CMessageTargetReached>(this);
 }
 
 void CEntity::changeState(EEntityStateTypes eState) {
-  CMessageHandler::getSingleton().addMessage(new CMessageEntityStateChanged(m_eState, eState, *this));
+  CMessageHandler::getSingleton().createMessage<CMessageEntityStateChanged>(m_eState, eState, *this);
 
   m_eState = eState;
 }
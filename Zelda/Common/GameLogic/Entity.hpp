@@ -28,6 +28,9 @@
 #include "../tinyxml2/tinyxml2.h"
 #include "OutputStyle.hpp"
 #include "EntityStates.hpp"
+#include "EntityRegistry.hpp"
+#include "EntityUpdateLayout.hpp"
+#include "../Util/Atom.hpp"
 #include <OgreResourceGroupManager.h>
 #include <mutex>
 
@@ -46,7 +49,7 @@ class CMessage;
 //! Class for an arbitrary entity
 class CEntity : public CMessageInjector {
 protected:
-  std::string m_sID;                          //!< id of the entity
+  CAtom m_sID;                                //!< id of the entity, interned so that comparisons are pointer compares
   std::string m_sResourceGroup;               //!< in which resource group to search for entities resources
   unsigned int m_uiType;                      //!< one can set a type
   EEntityStateTypes m_eState;                 //!< state of the entity
@@ -59,6 +62,9 @@ private:
   mutable std::mutex mEventToDeleteAccessedMutex;     //!< mutex of the entity, if the events list is accessed
 
   CEntity *m_pParent;
+  CEntityUpdateLayout *m_pChildUpdateLayout;          //!< flat update arrays of the children, if nullptr the children list is walked
+  unsigned int m_uiUpdatePhases;                      //!< EEntityUpdatePhaseMask, phases in which the layout of the parent calls this entity
+  CEntityHandle m_Handle;                             //!< handle in the CEntityRegistry
   std::list<CEntity*> m_lChildren;
   std::list<events::CEvent*> m_lEvents;
   std::list<events::CEvent*> m_lEventsToDelete;
@@ -75,21 +81,32 @@ public:
   void attachTo(CEntity *pParent);
   CEntity *getParent() {return m_pParent;}
   const CEntity *getParent() const {return m_pParent;}
-  CEntity *getParent(const std::string &sID);
-  const CEntity *getParent(const std::string &sID) const;
+  CEntity *getParent(const CAtom &sID);
+  const CEntity *getParent(const CAtom &sID) const;
   std::list<CEntity *> &getChildren() {return m_lChildren;}
   const std::list<CEntity *> &getChildren() const {return m_lChildren;}
   CEntity *getRoot();
   const CEntity *getRoot() const;
-  CEntity *getChild(const std::string &sID);
-  CEntity *getChildRecursive(const std::string &sID);
-  const CEntity *getChild(const std::string &sID) const ;
-  const CEntity *getChildRecursive(const std::string &sID) const;
+  CEntity *getChild(const CAtom &sID);
+  CEntity *getChildRecursive(const CAtom &sID);
+  const CEntity *getChild(const CAtom &sID) const ;
+  const CEntity *getChildRecursive(const CAtom &sID) const;
   void destroyChildren();
   void destroy();
   void deleteLater();
   void deleteNow();
 
+  //! opt in: call the children from flat per phase arrays instead of walking the children list
+  void enableChildUpdateLayout();
+  const CEntityUpdateLayout *getChildUpdateLayout() const {return m_pChildUpdateLayout;}
+  //! phases (EEntityUpdatePhaseMask) in which this entity and its children have to be called
+  /**
+    * Only used if the parent has enabled its child update layout. If the entity
+    * has events, the phases that are required to process them are always added.
+    */
+  void setUpdatePhases(unsigned int uiPhases);
+  unsigned int getUpdatePhases() const {return m_uiUpdatePhases;}
+
   void sendCallToAll(void (CEntity::*pFunction)(), bool bCallThis = true);
   void sendCallToAllChildrenFirst(void (CEntity::*pFunction)(), bool bCallThis = true);
 
@@ -111,6 +128,12 @@ public:
 
 
   virtual bool frameStarted(const Ogre::FrameEvent& evt);
+  //! called concurrently for all children of a layout before their update (EUPM_PREPARE_UPDATE)
+  /**
+    * Must only change the entity itself and only read the rest of the world,
+    * everything else has to be applied in update, that is called in a fixed order.
+    */
+  virtual void prepareUpdate(Ogre::Real tpf) {}
   virtual void update(Ogre::Real tpf);
   virtual void preRender(Ogre::Real tpf);
   virtual void render(Ogre::Real tpf);
@@ -130,9 +153,9 @@ public:
   // general
   std::mutex &getEntityMutex() {return mEntityMutex;}
 
-  const std::string &getID() const {return m_sID;}
-  std::string &getID() {return m_sID;}
-  void setID(const std::string &sID) {m_sID = sID;}
+  const CAtom &getID() const {return m_sID;}
+  void setID(const std::string &sID);
+  const CEntityHandle &getHandle() const {return m_Handle;}
 
   //! Resource group in which the assigned resources are searched for
   const std::string &getResourceGroup() const {return m_sResourceGroup;}
@@ -163,14 +186,14 @@ public:
 	virtual void setOrientation(const Ogre::Quaternion &quat) {}
 
   unsigned int getType() const {return m_uiType;}
-  void setType(unsigned int uiType) {m_uiType = uiType;}
+  void setType(unsigned int uiType);
 
   virtual void moveToTarget(const SPATIAL_VECTOR &vPosition, const Ogre::Quaternion &qRotation = Ogre::Quaternion::IDENTITY, const Ogre::Real fMaxDistanceDeviation = 0, const Ogre::Radian fMaxAngleDeviation = Ogre::Radian(Ogre::Math::TWO_PI));
 
 
   virtual Ogre::SceneNode *getSceneNode() const {return nullptr;}
   virtual btCollisionObject *getCollisionObject() const {return nullptr;}
-  virtual bool collidesWith(const std::string &sEntityID) const {return false;}
+  virtual bool collidesWith(const CAtom &sEntityID) const {return false;}
 
 protected:
 
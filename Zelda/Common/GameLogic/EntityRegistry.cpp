@@ -0,0 +1,146 @@
+/*****************************************************************************
+ * Copyright 2014 Christoph Wick
+ *
+ * This file is part of Zelda.
+ *
+ * Zelda is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zelda is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Zelda. If not, see http://www.gnu.org/licenses/.
+ *****************************************************************************/
+
+#include "EntityRegistry.hpp"
+#include "Entity.hpp"
+#include "../Util/Assert.hpp"
+
+template<> CEntityRegistry *Ogre::Singleton<CEntityRegistry>::msSingleton = 0;
+
+CEntityRegistry &CEntityRegistry::getSingleton() {
+  ASSERT(msSingleton);
+  return *msSingleton;
+}
+CEntityRegistry *CEntityRegistry::getSingletonPtr() {
+  return msSingleton;
+}
+
+CEntityRegistry::CEntityRegistry() {
+}
+
+CEntityRegistry::~CEntityRegistry() {
+}
+
+CEntityHandle CEntityRegistry::add(CEntity *pEntity) {
+  ASSERT(pEntity);
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  uint32_t uiIndex;
+  if (m_vFreeSlots.empty()) {
+    uiIndex = static_cast<uint32_t>(m_vSlots.size());
+    m_vSlots.push_back({nullptr, 0, std::list<CEntity*>::iterator()});
+  }
+  else {
+    uiIndex = m_vFreeSlots.back();
+    m_vFreeSlots.pop_back();
+  }
+
+  SSlot &slot(m_vSlots[uiIndex]);
+  slot.pEntity = pEntity;
+  // generation 0 is reserved for invalid handles
+  if (++slot.uiGeneration == 0) {
+    slot.uiGeneration = 1;
+  }
+
+  std::list<CEntity*> &lIDList(getIDList(pEntity->getID()));
+  slot.itInID = lIDList.insert(lIDList.end(), pEntity);
+
+  return CEntityHandle(uiIndex, slot.uiGeneration);
+}
+
+void CEntityRegistry::remove(const CEntityHandle &handle) {
+  std::lock_guard<std::mutex> lock(mMutex);
+  ASSERT(handle.getIndex() < m_vSlots.size());
+
+  SSlot &slot(m_vSlots[handle.getIndex()]);
+  ASSERT(slot.uiGeneration == handle.getGeneration());
+  removeFromIDList(slot.pEntity->getID(), slot.itInID);
+
+  // the generation is increased on the next add, so stale handles stay invalid
+  slot.pEntity = nullptr;
+  m_vFreeSlots.push_back(handle.getIndex());
+}
+
+void CEntityRegistry::changeID(const CEntityHandle &handle, const CAtom &sOldID) {
+  std::lock_guard<std::mutex> lock(mMutex);
+  ASSERT(handle.getIndex() < m_vSlots.size());
+
+  SSlot &slot(m_vSlots[handle.getIndex()]);
+  ASSERT(slot.uiGeneration == handle.getGeneration());
+  removeFromIDList(sOldID, slot.itInID);
+
+  std::list<CEntity*> &lIDList(getIDList(slot.pEntity->getID()));
+  slot.itInID = lIDList.insert(lIDList.end(), slot.pEntity);
+}
+
+CEntity *CEntityRegistry::get(const CEntityHandle &handle) const {
+  std::lock_guard<std::mutex> lock(mMutex);
+  if (!handle.isValid() || handle.getIndex() >= m_vSlots.size()) {
+    return nullptr;
+  }
+
+  const SSlot &slot(m_vSlots[handle.getIndex()]);
+  if (slot.uiGeneration != handle.getGeneration()) {
+    return nullptr;
+  }
+  return slot.pEntity;
+}
+
+CEntity *CEntityRegistry::find(const CAtom &sID, const CEntity *pScope, bool bRecursive) const {
+  std::lock_guard<std::mutex> lock(mMutex);
+  auto it(m_mEntitiesByID.find(sID));
+  if (it == m_mEntitiesByID.end()) {
+    return nullptr;
+  }
+
+  for (CEntity *pEntity : it->second) {
+    if (!pScope) {
+      return pEntity;
+    }
+
+    if (!bRecursive) {
+      if (pEntity->getParent() == pScope) {
+        return pEntity;
+      }
+      continue;
+    }
+
+    for (const CEntity *pParent = pEntity->getParent(); pParent; pParent = pParent->getParent()) {
+      if (pParent == pScope) {
+        return pEntity;
+      }
+    }
+  }
+
+  return nullptr;
+}
+
+size_t CEntityRegistry::getEntityCount() const {
+  std::lock_guard<std::mutex> lock(mMutex);
+  return m_vSlots.size() - m_vFreeSlots.size();
+}
+
+void CEntityRegistry::removeFromIDList(const CAtom &sID, std::list<CEntity*>::iterator it) {
+  auto itList(m_mEntitiesByID.find(sID));
+  ASSERT(itList != m_mEntitiesByID.end());
+  itList->second.erase(it);
+  if (itList->second.empty()) {
+    m_mEntitiesByID.erase(itList);
+  }
+}
@@ -0,0 +1,100 @@
+/*****************************************************************************
+ * Copyright 2014 Christoph Wick
+ *
+ * This file is part of Zelda.
+ *
+ * Zelda is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zelda is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Zelda. If not, see http://www.gnu.org/licenses/.
+ *****************************************************************************/
+
+#ifndef _ENTITY_REGISTRY_HPP_
+#define _ENTITY_REGISTRY_HPP_
+
+#include <OgreSingleton.h>
+#include <string>
+#include <list>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <cstdint>
+#include "../Util/Atom.hpp"
+
+class CEntity;
+
+//! Weak reference to an entity, that is invalidated when the entity is destroyed
+class CEntityHandle {
+private:
+  uint32_t m_uiIndex;
+  uint32_t m_uiGeneration;              //!< 0 is invalid
+public:
+  CEntityHandle()
+    : m_uiIndex(0),
+      m_uiGeneration(0) {
+  }
+  CEntityHandle(uint32_t uiIndex, uint32_t uiGeneration)
+    : m_uiIndex(uiIndex),
+      m_uiGeneration(uiGeneration) {
+  }
+
+  uint32_t getIndex() const {return m_uiIndex;}
+  uint32_t getGeneration() const {return m_uiGeneration;}
+  bool isValid() const {return m_uiGeneration != 0;}
+
+  bool operator==(const CEntityHandle &other) const {return m_uiIndex == other.m_uiIndex && m_uiGeneration == other.m_uiGeneration;}
+  bool operator!=(const CEntityHandle &other) const {return !(*this == other);}
+};
+
+//! Hash index of all entities by their id
+/**
+  * Entities register themselves when they are attached and unregister when
+  * they are destroyed. Ids are not unique (e.g. equal ids in different maps),
+  * so the lookup is scoped to the subtree of an entity.
+  */
+class CEntityRegistry : public Ogre::Singleton<CEntityRegistry> {
+private:
+  struct SSlot {
+    CEntity *pEntity;                                   //!< nullptr if free
+    uint32_t uiGeneration;
+    std::list<CEntity*>::iterator itInID;               //!< position in the id list
+  };
+
+  mutable std::mutex mMutex;
+  std::vector<SSlot> m_vSlots;
+  std::vector<uint32_t> m_vFreeSlots;
+  std::unordered_map<CAtom, std::list<CEntity*> > m_mEntitiesByID;
+public:
+  static CEntityRegistry &getSingleton();
+  static CEntityRegistry *getSingletonPtr();
+
+  CEntityRegistry();
+  ~CEntityRegistry();
+
+  //! register the entity, returns its handle
+  CEntityHandle add(CEntity *pEntity);
+  void remove(const CEntityHandle &handle);
+  void changeID(const CEntityHandle &handle, const CAtom &sOldID);
+
+  //! nullptr if the entity was destroyed
+  CEntity *get(const CEntityHandle &handle) const;
+
+  //! find an entity in the subtree of pScope (all entities if nullptr)
+  CEntity *find(const CAtom &sID, const CEntity *pScope = nullptr, bool bRecursive = true) const;
+
+  size_t getEntityCount() const;
+
+private:
+  std::list<CEntity*> &getIDList(const CAtom &sID) {return m_mEntitiesByID[sID];}
+  void removeFromIDList(const CAtom &sID, std::list<CEntity*>::iterator it);
+};
+
+#endif // _ENTITY_REGISTRY_HPP_
@@ -0,0 +1,148 @@
+/*****************************************************************************
+ * Copyright 2014 Christoph Wick
+ *
+ * This file is part of Zelda.
+ *
+ * Zelda is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zelda is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Zelda. If not, see http://www.gnu.org/licenses/.
+ *****************************************************************************/
+
+#include "EntityUpdateLayout.hpp"
+#include "Entity.hpp"
+#include "../Util/Assert.hpp"
+#include "../Jobs/JobSystem.hpp"
+#include <algorithm>
+
+CEntityUpdateLayout::CEntityUpdateLayout()
+  : m_bIterating(false),
+    m_bHasRemoved(false) {
+}
+
+void CEntityUpdateLayout::add(CEntity *pEntity, unsigned int uiPhases) {
+  ASSERT(pEntity);
+  if (m_bIterating) {
+    // inserting would move the entries that are currently called
+    m_vPendingAdds.push_back(std::make_pair(pEntity, uiPhases));
+    return;
+  }
+  insert(pEntity, uiPhases);
+}
+
+void CEntityUpdateLayout::remove(CEntity *pEntity) {
+  for (auto it = m_vPendingAdds.begin(); it != m_vPendingAdds.end();) {
+    if (it->first == pEntity) {
+      it = m_vPendingAdds.erase(it);
+    }
+    else {
+      ++it;
+    }
+  }
+
+  for (std::vector<SEntry> &vEntries : m_vEntries) {
+    for (auto it = vEntries.begin(); it != vEntries.end(); ++it) {
+      if (it->pEntity != pEntity) {continue;}
+
+      if (m_bIterating) {
+        it->pEntity = nullptr;
+        m_bHasRemoved = true;
+      }
+      else {
+        vEntries.erase(it);
+      }
+      break;
+    }
+  }
+}
+
+void CEntityUpdateLayout::insert(CEntity *pEntity, unsigned int uiPhases) {
+  const SEntry entry = {pEntity->getType(), pEntity};
+  for (int i = 0; i < EUP_COUNT; i++) {
+    if ((uiPhases & (1 << i)) == 0) {continue;}
+
+    std::vector<SEntry> &vEntries(m_vEntries[i]);
+    // behind all entries of the same type, so that the order of creation is kept
+    auto it = std::upper_bound(vEntries.begin(), vEntries.end(), entry,
+                               [](const SEntry &a, const SEntry &b) {return a.uiType < b.uiType;});
+    vEntries.insert(it, entry);
+  }
+}
+
+template <class F>
+void CEntityUpdateLayout::call(EEntityUpdatePhase ePhase, bool bRenderPhase, F f) {
+  ASSERT(!m_bIterating);
+  m_bIterating = true;
+
+  const std::vector<SEntry> &vEntries(m_vEntries[ePhase]);
+  for (size_t i = 0; i < vEntries.size(); i++) {
+    CEntity *pEntity(vEntries[i].pEntity);
+    if (!pEntity) {continue;}
+    if (bRenderPhase ? pEntity->isRenderPaused() : pEntity->isUpdatePaused()) {continue;}
+    f(pEntity);
+  }
+
+  m_bIterating = false;
+
+  if (m_bHasRemoved) {
+    m_bHasRemoved = false;
+    for (std::vector<SEntry> &v : m_vEntries) {
+      v.erase(std::remove_if(v.begin(), v.end(), [](const SEntry &e) {return e.pEntity == nullptr;}), v.end());
+    }
+  }
+
+  if (!m_vPendingAdds.empty()) {
+    std::vector<std::pair<CEntity*, unsigned int> > vAdds;
+    vAdds.swap(m_vPendingAdds);
+    for (auto &add : vAdds) {
+      insert(add.first, add.second);
+    }
+  }
+}
+
+void CEntityUpdateLayout::frameStarted(const Ogre::FrameEvent& evt) {
+  call(EUP_FRAME_STARTED, false, [&evt](CEntity *pEntity) {pEntity->frameStarted(evt);});
+}
+
+void CEntityUpdateLayout::prepareUpdate(Ogre::Real tpf) {
+  if (m_vEntries[EUP_PREPARE_UPDATE].empty()) {return;}
+  if (!CJobSystem::getSingletonPtr()) {
+    call(EUP_PREPARE_UPDATE, false, [tpf](CEntity *pEntity) {pEntity->prepareUpdate(tpf);});
+    return;
+  }
+
+  ASSERT(!m_bIterating);
+  m_bIterating = true;
+  const std::vector<SEntry> &vEntries(m_vEntries[EUP_PREPARE_UPDATE]);
+  CJobSystem::getSingleton().parallelFor(vEntries.size(), 8, [&vEntries, tpf](size_t i) {
+      CEntity *pEntity(vEntries[i].pEntity);
+      if (pEntity && !pEntity->isUpdatePaused()) {
+        pEntity->prepareUpdate(tpf);
+      }
+    });
+  m_bIterating = false;
+}
+
+void CEntityUpdateLayout::update(Ogre::Real tpf) {
+  call(EUP_UPDATE, false, [tpf](CEntity *pEntity) {pEntity->update(tpf);});
+}
+
+void CEntityUpdateLayout::preRender(Ogre::Real tpf) {
+  call(EUP_PRE_RENDER, false, [tpf](CEntity *pEntity) {pEntity->preRender(tpf);});
+}
+
+void CEntityUpdateLayout::render(Ogre::Real tpf) {
+  call(EUP_RENDER, true, [tpf](CEntity *pEntity) {pEntity->render(tpf);});
+}
+
+void CEntityUpdateLayout::renderDebug(Ogre::Real tpf) {
+  call(EUP_RENDER_DEBUG, true, [tpf](CEntity *pEntity) {pEntity->renderDebug(tpf);});
+}
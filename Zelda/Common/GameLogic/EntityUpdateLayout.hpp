@@ -0,0 +1,105 @@
+/*****************************************************************************
+ * Copyright 2014 Christoph Wick
+ *
+ * This file is part of Zelda.
+ *
+ * Zelda is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zelda is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Zelda. If not, see http://www.gnu.org/licenses/.
+ *****************************************************************************/
+
+#ifndef _ENTITY_UPDATE_LAYOUT_HPP_
+#define _ENTITY_UPDATE_LAYOUT_HPP_
+
+#include <vector>
+#include <utility>
+#include <OgrePrerequisites.h>
+#include <OgreFrameListener.h>
+
+class CEntity;
+
+//! Phases of a frame that are called on the entity tree
+enum EEntityUpdatePhase {
+  EUP_FRAME_STARTED,
+  EUP_PREPARE_UPDATE,                   //!< concurrent, see CEntity::prepareUpdate
+  EUP_UPDATE,
+  EUP_PRE_RENDER,
+  EUP_RENDER,
+  EUP_RENDER_DEBUG,
+
+  EUP_COUNT,
+};
+
+//! Bit mask of EEntityUpdatePhase
+enum EEntityUpdatePhaseMask {
+  EUPM_NONE           = 0,
+  EUPM_FRAME_STARTED  = 1 << EUP_FRAME_STARTED,
+  EUPM_PREPARE_UPDATE = 1 << EUP_PREPARE_UPDATE,
+  EUPM_UPDATE         = 1 << EUP_UPDATE,
+  EUPM_PRE_RENDER     = 1 << EUP_PRE_RENDER,
+  EUPM_RENDER         = 1 << EUP_RENDER,
+  EUPM_RENDER_DEBUG   = 1 << EUP_RENDER_DEBUG,
+
+  //! all phases that are called on every entity of the tree, prepare update is opt in
+  EUPM_DEFAULT        = EUPM_FRAME_STARTED | EUPM_UPDATE | EUPM_PRE_RENDER | EUPM_RENDER | EUPM_RENDER_DEBUG,
+};
+
+//! Flat per phase arrays of the children of an entity
+/**
+  * Opt in replacement of the walk through the children list of an entity
+  * (see CEntity::enableChildUpdateLayout). Every child is only stored in the
+  * arrays of the phases it has registered for (CEntity::setUpdatePhases), so
+  * children that do nothing in a phase are not visited at all. The arrays are
+  * sorted by the type of the entities, so that equal types (and mostly equal
+  * virtual functions) are called in a row.
+  *
+  * Entities that are added while a phase is running are called from the next
+  * phase on, entities that are removed are skipped immediately.
+  *
+  * The prepare update phase is distributed over the CJobSystem (if there is
+  * one), the update phase afterwards calls the entities in the fixed order of
+  * the arrays, so the results do not depend on the scheduling of the jobs.
+  */
+class CEntityUpdateLayout {
+private:
+  struct SEntry {
+    unsigned int uiType;                //!< sort key
+    CEntity *pEntity;                   //!< nullptr if removed while iterating
+  };
+
+  std::vector<SEntry> m_vEntries[EUP_COUNT];
+  std::vector<std::pair<CEntity*, unsigned int> > m_vPendingAdds;
+  bool m_bIterating;
+  bool m_bHasRemoved;
+public:
+  CEntityUpdateLayout();
+
+  void add(CEntity *pEntity, unsigned int uiPhases);
+  void remove(CEntity *pEntity);
+
+  void frameStarted(const Ogre::FrameEvent& evt);
+  void prepareUpdate(Ogre::Real tpf);
+  void update(Ogre::Real tpf);
+  void preRender(Ogre::Real tpf);
+  void render(Ogre::Real tpf);
+  void renderDebug(Ogre::Real tpf);
+
+  //! number of entities that are called in the phase
+  size_t getSize(EEntityUpdatePhase ePhase) const {return m_vEntries[ePhase].size();}
+
+private:
+  void insert(CEntity *pEntity, unsigned int uiPhases);
+  template <class F>
+  void call(EEntityUpdatePhase ePhase, bool bRenderPhase, F f);
+};
+
+#endif // _ENTITY_UPDATE_LAYOUT_HPP_
@@ -33,7 +33,8 @@ namespace events {
 CActionCreateObject::CActionCreateObject(const tinyxml2::XMLElement *pElem, const CEvent &owner)
   : CAction(pElem, owner),
     m_eObjectType(OBJECT_TYPE_ID_MAP.getFromID(Attribute(pElem, "object_type"))),
-    m_sLocation(Attribute(pElem, "location", "local")) {
+    m_sLocation(Attribute(pElem, "location", "local")),
+    m_CreatedID(owner.getOwner().getID().str() + "created") {
 
 }
 CActionCreateObject::~CActionCreateObject() {
@@ -47,7 +48,7 @@ void CActionCreateObject::start() {
   }
   else if (m_sLocation == "local"){
     CMap *pMap = worldEnt.getMap();
-    CObject *pObject = new CObject(worldEnt.getID() + "created", dynamic_cast<CWorldEntity*>(worldEnt.getParent()), pMap, m_eObjectType);
+    CObject *pObject = new CObject(m_CreatedID, dynamic_cast<CWorldEntity*>(worldEnt.getParent()), pMap, m_eObjectType);
     pObject->setPosition(worldEnt.getPosition());
   }
   else {
@@ -22,12 +22,14 @@
 
 #include "Action.hpp"
 #include "../../../../World/Objects/ObjectTypes.hpp"
+#include "../../../Util/Atom.hpp"
 
 namespace events {
   class CActionCreateObject : public CAction {
   protected:
     const EObjectTypes m_eObjectType;
     const std::string m_sLocation;
+    const CAtom m_CreatedID;        //!< id of the created objects, built once per action
   public:
     CActionCreateObject(const tinyxml2::XMLElement *pElem, const CEvent &owner);
     ~CActionCreateObject();
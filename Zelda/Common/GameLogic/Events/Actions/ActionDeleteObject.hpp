@@ -21,13 +21,14 @@
 #define _ACTION_DELETE_OBJECT_HPP_
 
 #include "Action.hpp"
+#include "../../../Util/Atom.hpp"
 
 class CEntity;
 
 namespace events {
   class CActionDeleteObject : public CAction {
   protected:
-    const std::string m_sID;
+    const CAtom m_sID;
     CEntity *m_pEntity;
   public:
     CActionDeleteObject(const tinyxml2::XMLElement *pElem, const CEvent &owner);
@@ -33,6 +33,8 @@ CActionStartScript::CActionStartScript(const tinyxml2::XMLElement *pElem, const
                                                                 Attribute(pElem, "resource_group", owner.getOwner().getResourceGroup()))
             .dynamicCast<CLuaScript>()) {
   ASSERT(mScript.isNull() == false);
+  // a map pack with a resource manifest only loads the scripts listed in it
+  mScript->load();
 }
 
 CActionStartScript::~CActionStartScript() {
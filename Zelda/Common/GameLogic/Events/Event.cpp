@@ -119,7 +119,7 @@ void CEvent::update(float tpf) {
 }
 
 void CEvent::writeToXMLElement(tinyxml2::XMLElement *pElement, EOutputStyle eStyle) const {
-  SetAttribute(pElement, "id", m_sID);
+  SetAttribute(pElement, "id", m_sID.str());
   if (eStyle == OS_FULL) {
     SetAttribute(pElement, "started", m_bStarted);
   }
@@ -27,6 +27,7 @@
 #include "../../Util/XMLHelper.hpp"
 #include "../../GameLogic/OutputStyle.hpp"
 #include "../../Config/TypeDefines.hpp"
+#include "../../Util/Atom.hpp"
 
 class ENTITY;
 
@@ -37,7 +38,7 @@ namespace events {
 
 class CEvent {
 private:
-  const std::string m_sID;
+  const CAtom m_sID;
   const ERepeatTypes m_eRepeatType;
   const Ogre::Real m_fRepeatTime;
   Ogre::Real m_fTimer;
@@ -62,7 +63,7 @@ public:
 
   void update(float tpf);
 
-  const std::string &getID() const {return m_sID;}
+  const CAtom &getID() const {return m_sID;}
   const std::vector<CEmitter *> &getEmitter() const {return m_lEmitter;}
   const std::vector<CAction *> &getActions() const {return m_lActions;}
   CEntity &getOwner() const {return m_Owner;}
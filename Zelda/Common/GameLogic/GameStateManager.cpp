@@ -21,7 +21,6 @@
 #include <OgreException.h>
 #include <OgreLogManager.h>
 #include "../Util/Sleep.hpp"
-#include "../Message/MessageHandler.hpp"
 
 using namespace std;
 
@@ -41,8 +40,7 @@ CGameStateManager::CGameStateManager()
   m_eNextGameState(GS_COUNT),
   m_bForce(true),
   m_bAdShown(false) {
-  // add root as message injector, since entities are not added automatically!
-  CMessageHandler::getSingleton().addInjector(this);
+  // entities subscribe for the message types they handle, no broadcast through the tree
 }
 CGameStateManager::~CGameStateManager() {
 }
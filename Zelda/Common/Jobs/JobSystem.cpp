@@ -0,0 +1,144 @@
+/*****************************************************************************
+ * Copyright 2014 Christoph Wick
+ *
+ * This file is part of Zelda.
+ *
+ * Zelda is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zelda is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Zelda. If not, see http://www.gnu.org/licenses/.
+ *****************************************************************************/
+
+#include "JobSystem.hpp"
+#include "../Util/Assert.hpp"
+#include "../Log.hpp"
+
+template<> CJobSystem *Ogre::Singleton<CJobSystem>::msSingleton = 0;
+
+CJobSystem *CJobSystem::getSingletonPtr() {
+  return msSingleton;
+}
+CJobSystem &CJobSystem::getSingleton() {
+  ASSERT(msSingleton);
+  return *msSingleton;
+}
+
+namespace {
+  // index of the queue of the current thread, threads that are no workers use queue 0
+  thread_local unsigned int tl_uiQueue = 0;
+};
+
+CJobSystem::CJobSystem(unsigned int uiWorkerCount)
+  : m_bRunning(true),
+    m_iQueuedJobs(0) {
+  if (uiWorkerCount == 0) {
+    const unsigned int uiCores = std::thread::hardware_concurrency();
+    uiWorkerCount = (uiCores > 1) ? uiCores - 1 : 0;
+  }
+
+  for (unsigned int i = 0; i <= uiWorkerCount; i++) {
+    m_vQueues.push_back(std::unique_ptr<SQueue>(new SQueue));
+  }
+  for (unsigned int i = 1; i <= uiWorkerCount; i++) {
+    m_vWorkers.push_back(std::thread(&CJobSystem::workerMain, this, i));
+  }
+
+  LOGI("Job system started with %d workers", uiWorkerCount);
+}
+
+CJobSystem::~CJobSystem() {
+  {
+    std::lock_guard<std::mutex> lock(mWakeMutex);
+    m_bRunning = false;
+  }
+  mWakeCondition.notify_all();
+  for (std::thread &worker : m_vWorkers) {
+    worker.join();
+  }
+  ASSERT(m_iQueuedJobs == 0);
+}
+
+void CJobSystem::run(CJobGroup &group, const Job &job) {
+  group.m_iPending.fetch_add(1, std::memory_order_relaxed);
+
+  SQueue &queue(*m_vQueues[getQueueOfThisThread()]);
+  {
+    std::lock_guard<std::mutex> lock(queue.mMutex);
+    queue.m_dJobs.push_back({job, &group});
+  }
+  {
+    std::lock_guard<std::mutex> lock(mWakeMutex);
+    ++m_iQueuedJobs;
+  }
+  mWakeCondition.notify_one();
+}
+
+void CJobSystem::wait(CJobGroup &group) {
+  const unsigned int uiQueue = getQueueOfThisThread();
+  while (!group.isFinished()) {
+    if (!executeOne(uiQueue)) {
+      // the remaining jobs of the group are executed by other threads
+      std::this_thread::yield();
+    }
+  }
+}
+
+void CJobSystem::workerMain(unsigned int uiQueue) {
+  tl_uiQueue = uiQueue;
+  while (true) {
+    if (executeOne(uiQueue)) {continue;}
+
+    std::unique_lock<std::mutex> lock(mWakeMutex);
+    mWakeCondition.wait(lock, [this]() {return !m_bRunning || m_iQueuedJobs > 0;});
+    if (!m_bRunning) {return;}
+  }
+}
+
+bool CJobSystem::executeOne(unsigned int uiQueue) {
+  SJob job;
+  bool bFound = false;
+
+  {
+    // newest job of the own queue
+    SQueue &queue(*m_vQueues[uiQueue]);
+    std::lock_guard<std::mutex> lock(queue.mMutex);
+    if (!queue.m_dJobs.empty()) {
+      job = std::move(queue.m_dJobs.back());
+      queue.m_dJobs.pop_back();
+      bFound = true;
+    }
+  }
+
+  // steal the oldest job of an other queue
+  for (size_t i = 1; !bFound && i < m_vQueues.size(); i++) {
+    SQueue &queue(*m_vQueues[(uiQueue + i) % m_vQueues.size()]);
+    std::lock_guard<std::mutex> lock(queue.mMutex);
+    if (!queue.m_dJobs.empty()) {
+      job = std::move(queue.m_dJobs.front());
+      queue.m_dJobs.pop_front();
+      bFound = true;
+    }
+  }
+
+  if (!bFound) {return false;}
+
+  {
+    std::lock_guard<std::mutex> lock(mWakeMutex);
+    --m_iQueuedJobs;
+  }
+  job.fJob();
+  job.pGroup->m_iPending.fetch_sub(1, std::memory_order_release);
+  return true;
+}
+
+unsigned int CJobSystem::getQueueOfThisThread() const {
+  return tl_uiQueue;
+}
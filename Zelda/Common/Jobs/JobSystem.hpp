@@ -0,0 +1,119 @@
+/*****************************************************************************
+ * Copyright 2014 Christoph Wick
+ *
+ * This file is part of Zelda.
+ *
+ * Zelda is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zelda is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Zelda. If not, see http://www.gnu.org/licenses/.
+ *****************************************************************************/
+
+#ifndef _JOB_SYSTEM_HPP_
+#define _JOB_SYSTEM_HPP_
+
+#include <OgreSingleton.h>
+#include <functional>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+
+//! Counter of the jobs of a group that are not yet finished
+class CJobGroup {
+private:
+  std::atomic<int> m_iPending;
+public:
+  CJobGroup() : m_iPending(0) {}
+
+  bool isFinished() const {return m_iPending.load(std::memory_order_acquire) == 0;}
+
+  friend class CJobSystem;
+};
+
+//! Small work stealing job system
+/**
+  * Every thread (the thread that created the job system and the workers) owns a
+  * queue. New jobs are pushed to the queue of the calling thread, the owner
+  * takes the newest job and idle threads steal the oldest job of an other
+  * queue. A thread that waits for a group executes jobs until the group is
+  * finished, so jobs can spawn and wait for jobs themselves.
+  *
+  * The system does not define in which order the jobs are executed. Jobs that
+  * have to be deterministic write their results into a slot of their own (e.g.
+  * index of parallelFor) and the results are applied in order afterwards.
+  */
+class CJobSystem : public Ogre::Singleton<CJobSystem> {
+public:
+  typedef std::function<void()> Job;
+private:
+  struct SJob {
+    Job fJob;
+    CJobGroup *pGroup;
+  };
+  struct SQueue {
+    std::mutex mMutex;
+    std::deque<SJob> m_dJobs;
+  };
+
+  std::vector<std::unique_ptr<SQueue> > m_vQueues;    //!< 0: queue of the creating thread
+  std::vector<std::thread> m_vWorkers;
+  std::atomic<bool> m_bRunning;
+  std::atomic<int> m_iQueuedJobs;
+  std::mutex mWakeMutex;
+  std::condition_variable mWakeCondition;
+public:
+  static CJobSystem &getSingleton();
+  static CJobSystem *getSingletonPtr();
+
+  //! uiWorkerCount = 0 uses one worker less than the number of cores
+  CJobSystem(unsigned int uiWorkerCount = 0);
+  ~CJobSystem();
+
+  unsigned int getWorkerCount() const {return static_cast<unsigned int>(m_vWorkers.size());}
+
+  //! queue a job, it belongs to the group until it is finished
+  void run(CJobGroup &group, const Job &job);
+  //! execute jobs until all jobs of the group are finished
+  void wait(CJobGroup &group);
+
+  //! call f(i) for all i in [0, uiCount), uiGrainSize indices are processed by one job
+  template <class F>
+  void parallelFor(size_t uiCount, size_t uiGrainSize, const F &f) {
+    if (uiCount == 0) {return;}
+    uiGrainSize = std::max<size_t>(uiGrainSize, 1);
+    if (m_vWorkers.empty() || uiCount <= uiGrainSize) {
+      for (size_t i = 0; i < uiCount; i++) {f(i);}
+      return;
+    }
+
+    CJobGroup group;
+    for (size_t uiBegin = 0; uiBegin < uiCount; uiBegin += uiGrainSize) {
+      const size_t uiEnd = std::min(uiBegin + uiGrainSize, uiCount);
+      run(group, [&f, uiBegin, uiEnd]() {
+          for (size_t i = uiBegin; i < uiEnd; i++) {f(i);}
+        });
+    }
+    wait(group);
+  }
+
+private:
+  void workerMain(unsigned int uiQueue);
+  //! execute one job of the own queue or steal one, false if there was none
+  bool executeOne(unsigned int uiQueue);
+  unsigned int getQueueOfThisThread() const;
+};
+
+#endif // _JOB_SYSTEM_HPP_
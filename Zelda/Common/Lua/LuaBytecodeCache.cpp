@@ -0,0 +1,101 @@
+#include "LuaBytecodeCache.hpp"
+#include "../FileManager/FileManager.hpp"
+#include "../Log.hpp"
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cstdint>
+extern "C"{
+  #include <lauxlib.h>
+}
+
+const Ogre::String CLuaBytecodeCache::CACHE_DIRECTORY("cache/lua/");
+
+namespace {
+  //! 64 bit FNV-1a hash of the script source
+  uint64_t hashSource(const Ogre::String &sSource) {
+    uint64_t hash(14695981039346656037ULL);
+    for (unsigned char c : sSource) {
+      hash ^= c;
+      hash *= 1099511628211ULL;
+    }
+    return hash;
+  }
+
+  int writeToString(lua_State *l, const void *p, size_t sz, void *ud) {
+    static_cast<Ogre::String*>(ud)->append(static_cast<const char*>(p), sz);
+    return 0;
+  }
+};
+
+int CLuaBytecodeCache::load(lua_State *l, const Ogre::String &sName, const Ogre::String &sChunk) {
+  if (isBytecode(sChunk)) {
+    // precompiled in the pack
+    return luaL_loadbufferx(l, sChunk.data(), sChunk.size(), sName.c_str(), "b");
+  }
+
+  Ogre::String sCacheFile(CFileManager::getValidPath(getCacheFileName(sName, sChunk)));
+  Ogre::String sBytecode;
+  if (readCacheFile(sCacheFile, sBytecode)) {
+    int status = luaL_loadbufferx(l, sBytecode.data(), sBytecode.size(), sName.c_str(), "b");
+    if (status == LUA_OK) {
+      LOGV("Loaded lua script '%s' from bytecode cache", sName.c_str());
+      return status;
+    }
+    // invalid cache file (e.g. other lua version), parse the source and replace it
+    LOGW("Invalid lua bytecode cache file '%s': %s", sCacheFile.c_str(), lua_tostring(l, -1));
+    lua_pop(l, 1);
+  }
+
+  int status = luaL_loadbufferx(l, sChunk.data(), sChunk.size(), sName.c_str(), "t");
+  if (status == LUA_OK) {
+    writeCacheFile(sCacheFile, l);
+  }
+  return status;
+}
+
+bool CLuaBytecodeCache::isBytecode(const Ogre::String &sChunk) {
+  return sChunk.compare(0, sizeof(LUA_SIGNATURE) - 1, LUA_SIGNATURE) == 0;
+}
+
+Ogre::String CLuaBytecodeCache::getCacheFileName(const Ogre::String &sName, const Ogre::String &sSource) {
+  Ogre::String sFlatName(sName);
+  for (char &c : sFlatName) {
+    if (c == '/' || c == '\\' || c == ':') {
+      c = '_';
+    }
+  }
+
+  std::stringstream ss;
+  ss << CACHE_DIRECTORY << sFlatName << "_" << std::hex << std::setw(16) << std::setfill('0') << hashSource(sSource) << ".luac";
+  return ss.str();
+}
+
+bool CLuaBytecodeCache::readCacheFile(const Ogre::String &sPath, Ogre::String &sBytecode) {
+  std::ifstream stream(sPath, std::ios::in | std::ios::binary);
+  if (!stream) {
+    return false;
+  }
+
+  std::stringstream ss;
+  ss << stream.rdbuf();
+  sBytecode = ss.str();
+  return isBytecode(sBytecode);
+}
+
+void CLuaBytecodeCache::writeCacheFile(const Ogre::String &sPath, lua_State *l) {
+  // the loaded function is on top of the stack
+  Ogre::String sBytecode;
+  if (lua_dump(l, writeToString, &sBytecode) != 0 || sBytecode.empty()) {
+    LOGW("Could not dump lua bytecode for '%s'", sPath.c_str());
+    return;
+  }
+
+  std::ofstream stream(sPath, std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!stream) {
+    LOGW("Could not create lua bytecode cache file '%s'", sPath.c_str());
+    return;
+  }
+  stream.write(sBytecode.data(), sBytecode.size());
+  LOGV("Created lua bytecode cache file '%s'", sPath.c_str());
+}
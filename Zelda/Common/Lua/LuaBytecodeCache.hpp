@@ -0,0 +1,34 @@
+#ifndef _LUA_BYTECODE_CACHE_HPP_
+#define _LUA_BYTECODE_CACHE_HPP_
+
+#include <OgreString.h>
+extern "C"{
+  #include <lua.h>
+}
+
+//! Loads lua chunks and caches their precompiled bytecode (lua_dump)
+/**
+  * The cache files are keyed by the resource name and a hash of the script source
+  * and are stored in the writable path (CFileManager::getValidPath). A changed script
+  * results in a new key, so stale cache files are never used.
+  * Chunks that were already precompiled (e.g. by tools/CreatePacks.py --precompile-lua)
+  * are loaded directly.
+  */
+class CLuaBytecodeCache {
+public:
+  //! directory of the cache files in the writable path
+  static const Ogre::String CACHE_DIRECTORY;
+
+  //! load the chunk onto the stack of the lua state, returns the lua status code
+  static int load(lua_State *l, const Ogre::String &sName, const Ogre::String &sChunk);
+
+  //! true if the chunk is precompiled lua bytecode
+  static bool isBytecode(const Ogre::String &sChunk);
+
+private:
+  static Ogre::String getCacheFileName(const Ogre::String &sName, const Ogre::String &sSource);
+  static bool readCacheFile(const Ogre::String &sPath, Ogre::String &sBytecode);
+  static void writeCacheFile(const Ogre::String &sPath, lua_State *l);
+};
+
+#endif // _LUA_BYTECODE_CACHE_HPP_
@@ -0,0 +1,177 @@
+#include "LuaScheduler.hpp"
+#include "LuaScript.hpp"
+#include "../Util/Assert.hpp"
+#include "../Log.hpp"
+extern "C"{
+  #include <lauxlib.h>
+}
+
+template<> CLuaScheduler *Ogre::Singleton<CLuaScheduler>::msSingleton = 0;
+
+CLuaScheduler *CLuaScheduler::getSingletonPtr() {
+  return msSingleton;
+}
+CLuaScheduler &CLuaScheduler::getSingleton() {
+  ASSERT(msSingleton);
+  return *msSingleton;
+}
+
+CLuaScheduler::CLuaScheduler() {
+}
+
+CLuaScheduler::~CLuaScheduler() {
+  for (auto &pCo : m_lCoroutines) {
+    if (pCo->pScript) {
+      release(*pCo);
+    }
+  }
+  m_lCoroutines.clear();
+}
+
+void CLuaScheduler::start(CLuaScript *pScript) {
+  ASSERT(pScript);
+  if (isRunning(pScript)) {
+    LOGW("Lua script already running");
+    return;
+  }
+
+  lua_State *pLuaState(pScript->getLuaState());
+  ASSERT(pLuaState);
+
+  std::unique_ptr<SCoroutine> pCo(new SCoroutine);
+  pCo->pScript = pScript;
+  pCo->bPaused = m_sPausedGroups.count(pScript->getGroup()) > 0;
+  pCo->pThread = lua_newthread(pLuaState);
+  pCo->iThreadRef = luaL_ref(pLuaState, LUA_REGISTRYINDEX);  // pops the thread
+  pScript->attachThread(pCo->pThread);
+
+  // the function is defined in the environment of the script
+  pScript->pushEnvironment(pCo->pThread);
+  lua_getfield(pCo->pThread, -1, "start");
+  lua_remove(pCo->pThread, -2);
+  if (!lua_isfunction(pCo->pThread, -1)) {
+    LOGW("Lua script '%s' has no 'start' function", pScript->getName().c_str());
+    release(*pCo);
+    return;
+  }
+
+  m_lCoroutines.push_back(std::move(pCo));
+}
+
+void CLuaScheduler::stop(CLuaScript *pScript) {
+  for (auto &pCo : m_lCoroutines) {
+    if (pCo->pScript == pScript) {
+      // only mark, the entry is removed in update
+      release(*pCo);
+    }
+  }
+}
+
+bool CLuaScheduler::isRunning(const CLuaScript *pScript) const {
+  for (auto &pCo : m_lCoroutines) {
+    if (pCo->pScript == pScript) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void CLuaScheduler::pause(const std::string &sResourceGroup, bool bPause) {
+  if (bPause) {
+    m_sPausedGroups.insert(sResourceGroup);
+  }
+  else {
+    m_sPausedGroups.erase(sResourceGroup);
+  }
+  for (auto &pCo : m_lCoroutines) {
+    if (pCo->pScript && pCo->pScript->getGroup() == sResourceGroup) {
+      pCo->bPaused = bPause;
+    }
+  }
+}
+
+void CLuaScheduler::stop(const std::string &sResourceGroup) {
+  m_sPausedGroups.erase(sResourceGroup);
+  for (auto &pCo : m_lCoroutines) {
+    if (pCo->pScript && pCo->pScript->getGroup() == sResourceGroup) {
+      release(*pCo);
+    }
+  }
+}
+
+void CLuaScheduler::update() {
+  // coroutines may be added or stopped while resuming, std::list keeps the iterators valid
+  for (auto it = m_lCoroutines.begin(); it != m_lCoroutines.end();) {
+    SCoroutine &co(**it);
+    if (!co.pScript) {
+      it = m_lCoroutines.erase(it);
+      continue;
+    }
+    if (co.bPaused || (co.pWaitCondition && !co.pWaitCondition->isFulfilled())) {
+      ++it;
+      continue;
+    }
+
+    int iNumArgs = 0;
+    if (co.pWaitCondition) {
+      iNumArgs = co.pWaitCondition->pushResults(co.pThread);
+      co.pWaitCondition.reset();
+    }
+
+    int status = lua_resume(co.pThread, nullptr, iNumArgs);
+    if (!co.pScript) {
+      // stopped during resume
+      it = m_lCoroutines.erase(it);
+      continue;
+    }
+    if (status == LUA_YIELD) {
+      ++it;
+      continue;
+    }
+    if (status != LUA_OK) {
+      LOGW("Lua call of 'start' failed: %s", lua_tostring(co.pThread, -1));
+    }
+
+    release(co);
+    it = m_lCoroutines.erase(it);
+  }
+}
+
+int CLuaScheduler::yield(lua_State *l, CLuaWaitCondition *pWaitCondition) {
+  ASSERT(pWaitCondition);
+  SCoroutine *pCo(getByThread(l));
+  if (!pCo) {
+    delete pWaitCondition;
+    return luaL_error(l, "Blocking call outside of a scheduled lua coroutine");
+  }
+
+  pCo->pWaitCondition.reset(pWaitCondition);
+  return lua_yield(l, 0);
+}
+
+void CLuaScheduler::sendMessageToAll(const CMessage &message) {
+  for (auto &pCo : m_lCoroutines) {
+    if (pCo->pWaitCondition && !pCo->bPaused) {
+      pCo->pWaitCondition->handleMessage(message);
+    }
+  }
+}
+
+CLuaScheduler::SCoroutine *CLuaScheduler::getByThread(lua_State *l) {
+  for (auto &pCo : m_lCoroutines) {
+    if (pCo->pThread == l && pCo->pScript) {
+      return pCo.get();
+    }
+  }
+  return nullptr;
+}
+
+void CLuaScheduler::release(SCoroutine &co) {
+  ASSERT(co.pScript);
+  if (co.pScript->getLuaState()) {
+    luaL_unref(co.pScript->getLuaState(), LUA_REGISTRYINDEX, co.iThreadRef);
+  }
+  co.pWaitCondition.reset();
+  co.pThread = nullptr;
+  co.pScript = nullptr;
+}
@@ -0,0 +1,80 @@
+#ifndef _LUA_SCHEDULER_HPP_
+#define _LUA_SCHEDULER_HPP_
+
+#include <OgreSingleton.h>
+#include <list>
+#include <memory>
+#include <set>
+#include <string>
+extern "C"{
+  #include <lua.h>
+}
+#include "../Message/MessageInjector.hpp"
+#include "LuaWaitCondition.hpp"
+
+class CLuaScript;
+
+//! Runs the lua scripts as coroutines on the main thread
+/**
+  * Every started script is executed in its own lua thread (lua_newthread) of the
+  * shared lua state. Blocking bridge functions yield with a CLuaWaitCondition and
+  * the coroutine is resumed in update() (called once per frame) as soon as the
+  * condition is fulfilled. No extra threads and no sleeps are required.
+  */
+class CLuaScheduler
+  : public Ogre::Singleton<CLuaScheduler>,
+    public CMessageInjector {
+private:
+  struct SCoroutine {
+    CLuaScript *pScript;                                //!< owner, nullptr if stopped
+    lua_State *pThread;                                 //!< the lua thread of the coroutine
+    int iThreadRef;                                     //!< registry reference that keeps the thread alive
+    std::unique_ptr<CLuaWaitCondition> pWaitCondition;  //!< nullptr: resume in next update
+    bool bPaused;                                       //!< neither resumed nor receives messages
+  };
+
+  std::list<std::unique_ptr<SCoroutine> > m_lCoroutines;
+  std::set<std::string> m_sPausedGroups;                //!< resource groups whose scripts are paused
+public:
+  static CLuaScheduler &getSingleton();
+  static CLuaScheduler *getSingletonPtr();
+
+  CLuaScheduler();
+  ~CLuaScheduler();
+
+  //! start the 'start' function of the script, it will be resumed in the next update
+  void start(CLuaScript *pScript);
+  //! cancel all coroutines of the script, has to be called before its lua state is closed
+  void stop(CLuaScript *pScript);
+  bool isRunning(const CLuaScript *pScript) const;
+  //! pause or continue the coroutines of all scripts in the resource group (e.g. of a pooled map)
+  /**
+    * A paused coroutine keeps its wait condition, but the messages are not
+    * passed to it. Scripts of the group started while paused are paused, too.
+    */
+  void pause(const std::string &sResourceGroup, bool bPause);
+  //! cancel the coroutines of all scripts in the resource group, it is not paused anymore
+  void stop(const std::string &sResourceGroup);
+
+  //! resume all coroutines whose wait condition is fulfilled
+  void update();
+
+  //! suspend the calling coroutine until the condition is fulfilled
+  /**
+    * Has to be used as return expression of a bridge function:
+    * return CLuaScheduler::getSingleton().yield(l, new CLuaWait...);
+    * Note that lua_yield does a longjmp, so there must not be any non trivial
+    * objects alive on the stack of the bridge function.
+    * The scheduler takes the ownership of the condition.
+    */
+  int yield(lua_State *l, CLuaWaitCondition *pWaitCondition);
+
+  // CMessageInjector
+  void sendMessageToAll(const CMessage &message);
+
+private:
+  SCoroutine *getByThread(lua_State *l);
+  void release(SCoroutine &co);
+};
+
+#endif // _LUA_SCHEDULER_HPP_
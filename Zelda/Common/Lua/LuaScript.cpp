@@ -2,6 +2,9 @@
 #include "../Util/Assert.hpp"
 #include "../Log.hpp"
 #include "LuaScriptManager.hpp"
+#include "LuaScheduler.hpp"
+#include "LuaBytecodeCache.hpp"
+#include "LuaThreadOwner.hpp"
 #include "../Config/TypeDefines.hpp"
 #include LUA_SCRIPT_BRIDGE_HEADER
 
@@ -10,7 +13,8 @@ CLuaScript::CLuaScript(Ogre::ResourceManager* creator, const Ogre::String &name,
                  Ogre::ManualResourceLoader *loader)
   : Ogre::Resource(creator, name, handle, group, isManual, loader),
     mLuaState(nullptr),
-    mStarted(false)
+    mEnvironmentRef(LUA_NOREF),
+    mMemorySize(0)
 {
   /* If you were storing a pointer to an object, then you would set that pointer to NULL here.
   */
@@ -60,84 +64,97 @@ void CLuaScript::loadImpl() {
   Ogre::DataStreamPtr stream = Ogre::ResourceGroupManager::getSingleton().openResource(mName, mGroup, false, this);
   Ogre::String script = stream->getAsString();
 
-  mLuaState = luaL_newstate();
-  luaL_openlibs(mLuaState);
-  int status = luaL_loadstring(mLuaState, script.c_str());
+  CLuaScriptManager &manager(CLuaScriptManager::getSingleton());
+  mLuaState = manager.getLuaState();
+
+  // no collection while loading, the difference of the memory usage is the size of the script
+  lua_gc(mLuaState, LUA_GCSTOP, 0);
+  size_t memoryBefore = manager.getMemoryUsage();
+
+  // own environment, undefined globals are looked up in the shared globals (libraries and c functions)
+  // the shared globals are not reachable for writing: _G is the environment
+  // itself and the metatable is hidden from getmetatable
+  lua_newtable(mLuaState);
+  lua_pushvalue(mLuaState, -1);
+  lua_setfield(mLuaState, -2, "_G");
+  lua_newtable(mLuaState);
+  lua_pushglobaltable(mLuaState);
+  lua_setfield(mLuaState, -2, "__index");
+  lua_pushboolean(mLuaState, 0);
+  lua_setfield(mLuaState, -2, "__metatable");
+  lua_setmetatable(mLuaState, -2);
+  mEnvironmentRef = luaL_ref(mLuaState, LUA_REGISTRYINDEX);
+
+  // execute the chunk in an own thread, so that bridge calls can resolve this script
+  lua_State *pThread = lua_newthread(mLuaState);
+  int threadRef = luaL_ref(mLuaState, LUA_REGISTRYINDEX);
+  attachThread(pThread);
+
+  // reuse the precompiled bytecode if available, this skips the parsing
+  Ogre::String error;
+  int status = CLuaBytecodeCache::load(pThread, mName, script);
   if (status == LUA_OK) {
-    lua_pcall(mLuaState, 0, LUA_MULTRET, 0);
+    // the first upvalue of a main chunk is its _ENV
+    pushEnvironment(pThread);
+    lua_setupvalue(pThread, -2, 1);
+    if (lua_pcall(pThread, 0, 0, 0) != LUA_OK) {
+      LOGW("Error while executing lua script '%s': %s", mName.c_str(), lua_tostring(pThread, -1));
+    }
   }
   else {
-    throw Ogre::Exception(status, "Error while loading lua script '" + script + "' from string.", __FILE__);
+    error = lua_tostring(pThread, -1);
   }
+  luaL_unref(mLuaState, LUA_REGISTRYINDEX, threadRef);
 
-  // register c functions
-  LUA_SCRIPT_BRIDGE_REGISTER_FUNCTION(mLuaState);
+  mMemorySize = manager.getMemoryUsage() - memoryBefore;
+  lua_gc(mLuaState, LUA_GCRESTART, 0);
 
-  mStarted = false;
+  if (status != LUA_OK) {
+    // Ogre does not call unloadImpl for a failed load, release the environment here
+    LuaThreadOwner::remove(pThread);
+    luaL_unref(mLuaState, LUA_REGISTRYINDEX, mEnvironmentRef);
+    mEnvironmentRef = LUA_NOREF;
+    mLuaState = nullptr;
+    mMemorySize = 0;
+    throw Ogre::Exception(status, "Error while loading lua script '" + mName + "': " + error, __FILE__);
+  }
 }
 
 void CLuaScript::unloadImpl() {
   /* If you were storing a pointer to an object, then you would check the pointer here,
   and if it is not NULL, you would destruct the object and set its pointer to NULL again.
   */
-  mLuaStateMutex.lock();
   if (mLuaState) {
-    lua_State *buffer = mLuaState;
-    mLuaState = nullptr;
-    if (mStarted) {
-      mStarted = false;
-      mLuaStateMutex.unlock();
-      mThread.join(); // w8 for finished
-    }
-    else {
-      mLuaStateMutex.unlock();
+    // cancel running coroutines before releasing the environment
+    if (CLuaScheduler::getSingletonPtr()) {
+      CLuaScheduler::getSingleton().stop(this);
     }
-    lua_close(buffer);
-  }
-  else {
-    mLuaStateMutex.unlock();
+    luaL_unref(mLuaState, LUA_REGISTRYINDEX, mEnvironmentRef);
+    mEnvironmentRef = LUA_NOREF;
+    mLuaState = nullptr;
+    mMemorySize = 0;
   }
-
 }
 
 size_t CLuaScript::calculateSize() const {
-  return sizeof(mLuaState); // correct would be to compute the total size of the action lua state
+  return sizeof(CLuaScript) + mMemorySize;
 }
 
-void startLuaScriptThread(lua_State *pLuaState, CLuaScript *script) {
-  std::mutex &luaStateMutex(script->getLuaStateMutex());
-  luaStateMutex.lock();
-  script->setStarted(true);
-  lua_getglobal(pLuaState, "start");
-  //ASSERT(lua_gettop(mLuaState) == 0); // no arguments passed
-  ASSERT(lua_isfunction(pLuaState, -1));
-  luaStateMutex.unlock();
-
-  try {
-    if (lua_pcall(pLuaState, 0, 0, 0) != LUA_OK) {
-      LOGW("Lua call of 'start' failed");
-    }
-  }
-  catch (...) {
-    LOGW("Exception during lua script.");
-  }
+void CLuaScript::pushEnvironment(lua_State *l) const {
+  ASSERT(mEnvironmentRef != LUA_NOREF);
+  lua_rawgeti(l, LUA_REGISTRYINDEX, mEnvironmentRef);
+}
 
-  luaStateMutex.lock();
-  script->setStarted(false);
-  luaStateMutex.unlock();
+void CLuaScript::attachThread(lua_State *pThread) {
+  LuaThreadOwner::set(pThread, this);
 }
 
-void CLuaScript::start() {
-  std::lock_guard<std::mutex> lock(mLuaStateMutex);
+CLuaScript *CLuaScript::getFromLuaState(lua_State *l) {
+  ASSERT(l);
+  return static_cast<CLuaScript*>(LuaThreadOwner::get(l));
+}
 
-  if (mStarted) {
-    LOGW("Lua script already running");
-    return;
-  }
+void CLuaScript::start() {
   ASSERT(mLuaState);
-  if (mThread.joinable()) {
-    mThread.join(); // old has to be finished.
-  }
-  mThread = std::thread(startLuaScriptThread, mLuaState, this);
-  //startLuaScriptThread(mLuaState, this);
+  CLuaScheduler::getSingleton().start(this);
 }
@@ -5,20 +5,18 @@
 extern "C"{
   #include <lua.h>
 }
-#include <thread>
-#include <mutex>
 
 class CLuaScript;
 
 typedef Ogre::SharedPtr<CLuaScript> CLuaScriptPtr;
 
+//! A lua script running in its own environment of the shared lua state
 class CLuaScript : public Ogre::Resource
 {
 private:
-  std::thread mThread;
-  mutable std::mutex mLuaStateMutex;
-  lua_State *mLuaState;
-  bool mStarted;
+  lua_State *mLuaState;         //!< shared state of the CLuaScriptManager, nullptr if not loaded
+  int mEnvironmentRef;          //!< registry reference of the _ENV table of the script
+  size_t mMemorySize;           //!< memory allocated by loading the script
 protected:
 
   // must implement these from the Ogre::Resource interface
@@ -36,11 +34,17 @@ public:
 
   virtual CLuaScriptPtr clone(const Ogre::String& newName, bool changeGroup = false, const Ogre::String& newGroup = Ogre::StringUtil::BLANK);
 
+  //! start the script as coroutine in the CLuaScheduler
   void start();
-  std::mutex &getLuaStateMutex() {return mLuaStateMutex;}
   lua_State *getLuaState() {return mLuaState;}
 
-  void setStarted(bool b) {mStarted = b;}
+  //! push the _ENV table of the script onto the stack of the lua state (or thread)
+  void pushEnvironment(lua_State *l) const;
+  //! mark a lua thread as owned by this script, required for bridge calls
+  void attachThread(lua_State *pThread);
+
+  //! get the script owning the lua thread, no lookup in the manager
+  static CLuaScript *getFromLuaState(lua_State *l);
 
 private:
 };
@@ -1,10 +1,10 @@
 #include "LuaScriptBridge.hpp"
 #include "LuaScriptManager.hpp"
+#include "LuaScheduler.hpp"
 #include "../Log.hpp"
 #include "../Message/MessageCreator.hpp"
 #include "../Message/MessageHandler.hpp"
 #include "../tinyxml2/tinyxml2.hpp"
-#include "../Util/Sleep.hpp"
 #include "../Util/Assert.hpp"
 #include <memory>
 #include "../Util/GameMemory.hpp"
@@ -52,23 +52,26 @@ int message(lua_State *l) {
     return -1;
   }
 
-  XMLDocument doc;
-  doc.Parse(lua_tostring(l, 1));
+  unsigned int uiMessageType;
+  {
+    // yield does a longjmp, so destroy all objects before
+    XMLDocument doc;
+    doc.Parse(lua_tostring(l, 1));
 
-  CMessageHandler::getSingleton().addMessage(CMessageCreator::getSingleton().createMessage(doc.FirstChildElement()));
-
-  while (true) {
-    LUA_WAIT(10);
+    CMessage *pMessage(CMessageCreator::getSingleton().createMessage(doc.FirstChildElement()));
+    uiMessageType = pMessage->getType();
+    CMessageHandler::getSingleton().addMessage(pMessage);
   }
 
-  return 1;
+  // continue after the message was processed
+  return CLuaScheduler::getSingleton().yield(l, new CLuaWaitForMessageType(uiMessageType));
 }
 
 int writeIntToMemory(lua_State *l) {
   LUA_BRIDGE_START;
   ASSERT(lua_gettop(l) == 2);
 
-  std::string id = lua_tostring(l, 1);
+  const CAtom id(lua_tostring(l, 1));
   int value = lua_tointeger(l, 2);
 
   CGameMemory::getSingleton().setIntData(id, value);
@@ -80,7 +83,7 @@ int readIntFromMemory(lua_State *l) {
   LUA_BRIDGE_START;
   ASSERT(lua_gettop(l) >= 1);
 
-  std::string id = lua_tostring(l, 1);
+  const CAtom id(lua_tostring(l, 1));
   int defaultValue = 0;
   if (lua_gettop(l) == 2) {
     defaultValue = lua_tointeger(l, 2);
@@ -95,7 +98,7 @@ int writeRealToMemory(lua_State *l) {
   LUA_BRIDGE_START;
   ASSERT(lua_gettop(l) == 2);
 
-  std::string id = lua_tostring(l, 1);
+  const CAtom id(lua_tostring(l, 1));
   Ogre::Real value = lua_tonumber(l, 2);
 
   CGameMemory::getSingleton().setRealData(id, value);
@@ -107,7 +110,7 @@ int readRealFromMemory(lua_State *l) {
   LUA_BRIDGE_START;
   ASSERT(lua_gettop(l) >= 1);
 
-  std::string id = lua_tostring(l, 1);
+  const CAtom id(lua_tostring(l, 1));
   Ogre::Real defaultValue = 0;
   if (lua_gettop(l) == 2) {
     defaultValue = lua_tonumber(l, 2);
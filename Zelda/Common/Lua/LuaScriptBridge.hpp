@@ -7,21 +7,11 @@ extern "C"{
   #include <lauxlib.h>
 }
 
-// generate default variables and exit if script canceled
+// resolve the script of the calling lua state (or coroutine), lock free registry lookup
 #define LUA_BRIDGE_START                                                                      \
-  CLuaScriptPtr luaScript(CLuaScriptManager::getSingleton().getByLuaState(l));                \
-  std::mutex &luaStateMutex(luaScript->getLuaStateMutex());                                   \
-  {                                                                                           \
-    std::lock_guard<std::mutex> lock(luaStateMutex);                                          \
-    if (luaScript->getLuaState() == nullptr) {return -1;}                                     \
-  }
-
-#define LUA_WAIT(t)                                                                           \
-  msleep(t);                                                                                  \
-  {                                                                                           \
-    std::lock_guard<std::mutex> lock(luaStateMutex);                                          \
-    if (luaScript->getLuaState() == nullptr) {return -1;}                                     \
-  }
+  CLuaScript *luaScript(CLuaScript::getFromLuaState(l));                                      \
+  ASSERT(luaScript);                                                                          \
+  (void)luaScript;
 
 
 //! function to register the c functions to the given lua state
@@ -1,5 +1,7 @@
 #include "LuaScriptManager.hpp"
 #include "../Util/Assert.hpp"
+#include "../Config/TypeDefines.hpp"
+#include LUA_SCRIPT_BRIDGE_HEADER
 
 template<> CLuaScriptManager *Ogre::Singleton<CLuaScriptManager>::msSingleton = 0;
 
@@ -15,6 +17,7 @@ CLuaScriptManager &CLuaScriptManager::getSingleton()
 }
 
 CLuaScriptManager::CLuaScriptManager()
+  : m_pLuaState(nullptr)
 {
    mResourceType = "LuaScript";
 
@@ -23,12 +26,23 @@ CLuaScriptManager::CLuaScriptManager()
 
    // this is how we register the ResourceManager with OGRE
    Ogre::ResourceGroupManager::getSingleton()._registerResourceManager(mResourceType, this);
+
+   // shared lua state, the libraries and c functions are registered only once
+   m_pLuaState = luaL_newstate();
+   luaL_openlibs(m_pLuaState);
+   LUA_SCRIPT_BRIDGE_REGISTER_FUNCTION(m_pLuaState);
 }
 
 CLuaScriptManager::~CLuaScriptManager()
 {
    // and this is how we unregister it
    Ogre::ResourceGroupManager::getSingleton()._unregisterResourceManager(mResourceType);
+
+   // scripts must release their environments before the state is closed
+   unloadAll();
+   removeAll();
+   lua_close(m_pLuaState);
+   m_pLuaState = nullptr;
 }
 
 CLuaScriptPtr CLuaScriptManager::load(const Ogre::String &name, const Ogre::String &group)
@@ -43,17 +57,17 @@ CLuaScriptPtr CLuaScriptManager::load(const Ogre::String &name, const Ogre::Stri
 }
 
 CLuaScriptPtr CLuaScriptManager::getByLuaState(lua_State *state) {
-  OGRE_LOCK_AUTO_MUTEX;
-  ASSERT(state);
-  ResourceMapIterator it(getResourceIterator());
-  while (it.hasMoreElements()) {
-      CLuaScriptPtr ptr(it.getNext().dynamicCast<CLuaScript>());
-    if (ptr->getLuaState() == state) {
-      return ptr;
-    }
+  CLuaScript *pScript(CLuaScript::getFromLuaState(state));
+  if (!pScript) {
+    throw Ogre::Exception(0, "Lua script not found.", __FILE__);
   }
 
-  throw Ogre::Exception(0, "Lua script not found.", __FILE__);
+  return getByHandle(pScript->getHandle()).dynamicCast<CLuaScript>();
+}
+
+size_t CLuaScriptManager::getMemoryUsage() const {
+  return static_cast<size_t>(lua_gc(m_pLuaState, LUA_GCCOUNT, 0)) * 1024
+    + static_cast<size_t>(lua_gc(m_pLuaState, LUA_GCCOUNTB, 0));
 }
 
 Ogre::Resource *CLuaScriptManager::createImpl(const Ogre::String &name, Ogre::ResourceHandle handle,
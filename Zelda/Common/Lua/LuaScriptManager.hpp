@@ -4,8 +4,15 @@
  #include <OgreResourceManager.h>
  #include "LuaScript.hpp"
 
+//! Manager of all lua scripts
+/**
+  * All scripts share one lua state that is created once with the standard libraries
+  * and the bridge functions. Every script runs in its own environment (_ENV).
+  */
 class CLuaScriptManager : public Ogre::ResourceManager, public Ogre::Singleton<CLuaScriptManager>
 {
+private:
+   lua_State *m_pLuaState;
 protected:
 
    // must implement this from ResourceManager's interface
@@ -21,6 +28,10 @@ public:
    virtual CLuaScriptPtr load(const Ogre::String &name, const Ogre::String &group);
    CLuaScriptPtr getByLuaState(lua_State *state);
 
+   lua_State *getLuaState() {return m_pLuaState;}
+   //! total memory in bytes used by the shared lua state
+   size_t getMemoryUsage() const;
+
    static CLuaScriptManager &getSingleton();
    static CLuaScriptManager *getSingletonPtr();
 };
@@ -0,0 +1,65 @@
+#ifndef _LUA_THREAD_OWNER_HPP_
+#define _LUA_THREAD_OWNER_HPP_
+
+extern "C"{
+  #include <lua.h>
+}
+
+//! Owners of the lua threads of a shared lua state
+/**
+  * A table in the registry maps every lua thread to its owner (the CLuaScript
+  * that created it), so the bridge resolves the calling script with one table
+  * lookup. The table has weak keys, finished threads are collected.
+  */
+namespace LuaThreadOwner {
+  //! the address of the local is the registry key, unique in the program
+  inline const void *getRegistryKey() {
+    static const char KEY = 0;
+    return &KEY;
+  }
+
+  //! push the table of the owners, it is created on first use
+  inline void pushTable(lua_State *l) {
+    lua_rawgetp(l, LUA_REGISTRYINDEX, getRegistryKey());
+    if (lua_istable(l, -1)) {
+      return;
+    }
+    lua_pop(l, 1);
+
+    lua_newtable(l);
+    lua_newtable(l);
+    lua_pushstring(l, "k");
+    lua_setfield(l, -2, "__mode");
+    lua_setmetatable(l, -2);
+    lua_pushvalue(l, -1);
+    lua_rawsetp(l, LUA_REGISTRYINDEX, getRegistryKey());
+  }
+
+  inline void set(lua_State *pThread, void *pOwner) {
+    pushTable(pThread);
+    lua_pushthread(pThread);
+    lua_pushlightuserdata(pThread, pOwner);
+    lua_rawset(pThread, -3);
+    lua_pop(pThread, 1);
+  }
+
+  inline void remove(lua_State *pThread) {
+    pushTable(pThread);
+    lua_pushthread(pThread);
+    lua_pushnil(pThread);
+    lua_rawset(pThread, -3);
+    lua_pop(pThread, 1);
+  }
+
+  //! owner of the running thread, nullptr if it has none
+  inline void *get(lua_State *l) {
+    pushTable(l);
+    lua_pushthread(l);
+    lua_rawget(l, -2);
+    void *pOwner(lua_touserdata(l, -1));
+    lua_pop(l, 2);
+    return pOwner;
+  }
+};
+
+#endif // _LUA_THREAD_OWNER_HPP_
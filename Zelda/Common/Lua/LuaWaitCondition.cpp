@@ -0,0 +1,28 @@
+#include "LuaWaitCondition.hpp"
+#include "../Message/Message.hpp"
+#include "../Message/MessageTargetReached.hpp"
+
+CLuaWaitForMessageType::CLuaWaitForMessageType(unsigned int uiMessageType)
+  : m_uiMessageType(uiMessageType),
+    m_bReceived(false) {
+}
+
+void CLuaWaitForMessageType::handleMessage(const CMessage &message) {
+  if (message.getType() == m_uiMessageType) {
+    m_bReceived = true;
+  }
+}
+
+CLuaWaitForTargetReached::CLuaWaitForTargetReached(const ENTITY *pEntity)
+  : m_pEntity(pEntity),
+    m_bReached(false) {
+}
+
+void CLuaWaitForTargetReached::handleMessage(const CMessage &message) {
+  if (message.getType() == MSG_TARGET_REACHED) {
+    const CMessageTargetReached &mtr(message.getAs<CMessageTargetReached>());
+    if (mtr.getEntity() == m_pEntity) {
+      m_bReached = true;
+    }
+  }
+}
@@ -0,0 +1,56 @@
+#ifndef _LUA_WAIT_CONDITION_HPP_
+#define _LUA_WAIT_CONDITION_HPP_
+
+extern "C"{
+  #include <lua.h>
+}
+#include "../Config/TypeDefines.hpp"
+
+class CMessage;
+class ENTITY;
+
+//! Condition a yielded lua coroutine is waiting for
+/**
+  * A blocking bridge function creates a wait condition and yields it to the
+  * CLuaScheduler. The scheduler forwards all processed messages to the condition
+  * and resumes the coroutine as soon as the condition is fulfilled.
+  */
+class CLuaWaitCondition {
+public:
+  virtual ~CLuaWaitCondition() {}
+
+  //! called for every message that is processed by the message handler
+  virtual void handleMessage(const CMessage &message) {}
+
+  //! if true, the coroutine will be resumed in the next scheduler update
+  virtual bool isFulfilled() const = 0;
+
+  //! push the return values of the yielded c function, returns the number of values
+  virtual int pushResults(lua_State *l) const {return 0;}
+};
+
+//! Waits until a message of the given type was processed
+class CLuaWaitForMessageType : public CLuaWaitCondition {
+private:
+  const unsigned int m_uiMessageType;
+  bool m_bReceived;
+public:
+  CLuaWaitForMessageType(unsigned int uiMessageType);
+
+  void handleMessage(const CMessage &message);
+  bool isFulfilled() const {return m_bReceived;}
+};
+
+//! Waits until the entity has reached its target (MSG_TARGET_REACHED)
+class CLuaWaitForTargetReached : public CLuaWaitCondition {
+private:
+  const ENTITY *m_pEntity;
+  bool m_bReached;
+public:
+  CLuaWaitForTargetReached(const ENTITY *pEntity);
+
+  void handleMessage(const CMessage &message);
+  bool isFulfilled() const {return m_bReached;}
+};
+
+#endif // _LUA_WAIT_CONDITION_HPP_
@@ -23,10 +23,12 @@
 using namespace XMLHelper;
 
 CMessage::CMessage(unsigned int type, const tinyxml2::XMLElement *pElement)
-  : m_Type(type) {
+  : m_Type(type),
+    m_pTarget(nullptr) {
 }
 CMessage::CMessage(unsigned int type)
-  : m_Type(type) {
+  : m_Type(type),
+    m_pTarget(nullptr) {
 }
 CMessage::~CMessage() {
 }
@@ -21,6 +21,7 @@
 #define _MESSAGE_HPP_
 
 #include "MessageTypes.hpp"
+#include "../Util/Assert.hpp"
 
 namespace tinyxml2 {
   class XMLElement;
@@ -29,6 +30,7 @@ namespace tinyxml2 {
 class CMessage {
 protected:
   const unsigned int m_Type;
+  const void *m_pTarget;          //!< object the message is about, used for subscriptions with target
 
 public:
   CMessage(unsigned int type, const tinyxml2::XMLElement *pElement);
@@ -36,6 +38,14 @@ public:
   virtual ~CMessage();
 
   unsigned int getType() const {return m_Type;}
+  const void *getTarget() const {return m_pTarget;}
+
+  //! cast by the static type tag T::MESSAGE_TYPE instead of a dynamic_cast
+  template <class T>
+  const T &getAs() const {
+    ASSERT(m_Type == T::MESSAGE_TYPE);
+    return static_cast<const T&>(*this);
+  }
 };
 
 #endif
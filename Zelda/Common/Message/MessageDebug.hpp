@@ -25,10 +25,13 @@
 
 
 class CMessageDebug: public CMessage {
+public:
+  static const unsigned int MESSAGE_TYPE = MSG_DEBUG;
 public:
   enum EDebugMessageTypes {
     DM_TOGGLE_PHYSICS,
     DM_TOGGLE_DEBUG_DRAWER,
+    DM_TOGGLE_PHYSICS_MULTITHREADING,
   };
 protected:
   const EDebugMessageTypes m_eDebugType;
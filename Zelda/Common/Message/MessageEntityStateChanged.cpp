@@ -6,4 +6,5 @@ CMessageEntityStateChanged::CMessageEntityStateChanged(EEntityStateTypes eOldSta
     m_eOldState(eOldState),
     m_eNewState(eNewState),
     m_Entity(entity) {
+  m_pTarget = &entity;
 }
\ No newline at end of file
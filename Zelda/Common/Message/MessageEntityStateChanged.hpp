@@ -8,6 +8,8 @@
 class CEntity;
 
 class CMessageEntityStateChanged: public CMessage {
+public:
+  static const unsigned int MESSAGE_TYPE = MSG_ENTITY_STATE_CHANGED;
 protected:
   const EEntityStateTypes m_eOldState;
   const EEntityStateTypes m_eNewState;
@@ -22,6 +22,7 @@
 #include "Message.hpp"
 #include "../Log.hpp"
 #include "../Util/Assert.hpp"
+#include <algorithm>
 
 template<> CMessageHandler *Ogre::Singleton<CMessageHandler>::msSingleton = 0;
 
@@ -32,32 +33,95 @@ CMessageHandler &CMessageHandler::getSingleton() {
   ASSERT(msSingleton);
   return *msSingleton;
 }
+CMessageHandler::CMessageHandler()
+  : m_bSubscriptionsToAdd(false),
+    m_bSubscriptionsRemoved(false),
+    m_bOverflowed(false),
+    m_uiOverflowCount(0),
+    m_bOverflowLogged(false) {
+}
+
+CMessageHandler::~CMessageHandler() {
+  // release the messages that were not processed
+  while (SMessageSlot *pSlot = m_Ring.front()) {
+    release(pSlot->pMessage, pSlot->eOwnership);
+    m_Ring.pop();
+  }
+  for (auto &entry : m_vOverflowProcessing) {
+    release(entry.pMessage, entry.eOwnership);
+  }
+  for (auto &entry : m_vOverflow) {
+    release(entry.pMessage, entry.eOwnership);
+  }
+}
+
 void CMessageHandler::process() {
   mInjectorMutex.lock();
-  while (m_lInjectorsToRemove.size() > 0) {
-    m_lInjectors.remove(m_lInjectorsToRemove.front());
-    m_lInjectorsToRemove.pop_front();
-  }
+  // removed injectors are only marked
+  m_lInjectors.remove(nullptr);
 
   m_lInjectors.splice(m_lInjectors.end(), m_lInjectorsToAdd);
 
 
   ASSERT(m_lInjectorsToAdd.size() == 0);
-  ASSERT(m_lInjectorsToRemove.size() == 0);
 
   mInjectorMutex.unlock();
 
-  mMutex.lock();
-  std::list<std::unique_ptr<SMessageEntry> > l;
-  l.splice(l.end(), m_lMessages);
-  mMutex.unlock();
+  updateSubscriptions();
+
+  // only process the messages that were added before, new ones are processed in the next call
+  const size_t uiEnd(m_Ring.getEnqueuePosition());
+  // taken after uiEnd, so a later ring message of a producer is not processed before its overflow messages
+  if (m_bOverflowed.load(std::memory_order_acquire)) {
+    mOverflowMutex.lock();
+    m_vOverflowProcessing.insert(m_vOverflowProcessing.end(), m_vOverflow.begin(), m_vOverflow.end());
+    m_vOverflow.clear();
+    m_bOverflowed.store(false, std::memory_order_relaxed);
+    mOverflowMutex.unlock();
+  }
+
+  // merge both queues: an overflow entry is delivered as soon as all ring messages claimed before it are
+  size_t uiOverflow(0);
+  while (true) {
+    const size_t uiPosition(m_Ring.getDequeuePosition());
+    const bool bOverflowNext(uiOverflow < m_vOverflowProcessing.size()
+                             && m_vOverflowProcessing[uiOverflow].uiRingPosition <= uiPosition);
+    SMessageSlot *pSlot(nullptr);
+    if (!bOverflowNext) {
+      if (uiPosition == uiEnd) {break;}
+      pSlot = m_Ring.front();
+      if (!pSlot) {
+        // the producer is still writing, keep the order and continue in the next call
+        break;
+      }
+    }
+
+    if (m_bSubscriptionsToAdd.load(std::memory_order_acquire)) {
+      // subscribed while handling the last message
+      updateSubscriptions();
+    }
+
+    if (bOverflowNext) {
+      const SOverflowEntry &entry(m_vOverflowProcessing[uiOverflow++]);
+      deliver(*entry.pMessage);
+      release(entry.pMessage, entry.eOwnership);
+    }
+    else {
+      deliver(*pSlot->pMessage);
+      release(pSlot->pMessage, pSlot->eOwnership);
+      pSlot->pMessage = nullptr;
 
-  while (l.size() > 0) {
-    for (auto pInjector : m_lInjectors) {
-      pInjector->sendMessageToAll(*l.front()->pMessage);
+      // free the slot for the next round
+      m_Ring.pop();
     }
+  }
 
-    l.pop_front();
+  if (uiOverflow > 0) {
+    if (!m_bOverflowLogged) {
+      LOGW("Message queue full, %u messages used the overflow queue", static_cast<unsigned int>(uiOverflow));
+      m_bOverflowLogged = true;
+    }
+    m_vOverflowProcessing.erase(m_vOverflowProcessing.begin(), m_vOverflowProcessing.begin() + uiOverflow);
   }
 }
 
@@ -69,15 +133,145 @@ void CMessageHandler::addInjector(CMessageInjector *pInjector) {
 
 void CMessageHandler::removeInjector(CMessageInjector *pInjector) {
   mInjectorMutex.lock();
-  m_lInjectorsToRemove.push_back(pInjector);
+  // the injector may be deleted while processing, so mark it immediately
+  m_lInjectorsToAdd.remove(pInjector);
+  std::replace(m_lInjectors.begin(), m_lInjectors.end(), pInjector, static_cast<CMessageInjector*>(nullptr));
+
+  for (auto &vSubscriptions : m_vSubscriptions) {
+    for (auto &subscription : vSubscriptions) {
+      if (subscription.pInjector == pInjector) {
+        subscription.pInjector = nullptr;
+        m_bSubscriptionsRemoved = true;
+      }
+    }
+  }
+  m_vSubscriptionsToAdd.erase(std::remove_if(m_vSubscriptionsToAdd.begin(), m_vSubscriptionsToAdd.end(),
+                                             [pInjector](const SPendingSubscription &s) {return s.subscription.pInjector == pInjector;}),
+                              m_vSubscriptionsToAdd.end());
+  mInjectorMutex.unlock();
+}
+
+void CMessageHandler::subscribe(CMessageInjector *pInjector, unsigned int uiMessageType, const void *pTarget) {
+  ASSERT(pInjector);
+  mInjectorMutex.lock();
+  m_vSubscriptionsToAdd.push_back({uiMessageType, {pInjector, pTarget}});
+  m_bSubscriptionsToAdd.store(true, std::memory_order_release);
+  mInjectorMutex.unlock();
+}
+
+void CMessageHandler::unsubscribe(CMessageInjector *pInjector, unsigned int uiMessageType) {
+  mInjectorMutex.lock();
+  if (uiMessageType < m_vSubscriptions.size()) {
+    for (auto &subscription : m_vSubscriptions[uiMessageType]) {
+      if (subscription.pInjector == pInjector) {
+        subscription.pInjector = nullptr;
+        m_bSubscriptionsRemoved = true;
+      }
+    }
+  }
+  m_vSubscriptionsToAdd.erase(std::remove_if(m_vSubscriptionsToAdd.begin(), m_vSubscriptionsToAdd.end(),
+                                             [pInjector, uiMessageType](const SPendingSubscription &s) {
+                                               return s.subscription.pInjector == pInjector && s.uiMessageType == uiMessageType;
+                                             }),
+                              m_vSubscriptionsToAdd.end());
   mInjectorMutex.unlock();
 }
 
+void CMessageHandler::nextFrame() {
+  m_vLastFrameDeliveries.swap(m_vDeliveries);
+  m_vDeliveries.assign(m_vLastFrameDeliveries.size(), 0);
+  m_bOverflowLogged = false;
+}
+
+unsigned int CMessageHandler::getDeliveryCount(unsigned int uiMessageType) const {
+  if (uiMessageType >= m_vLastFrameDeliveries.size()) {
+    return 0;
+  }
+  return m_vLastFrameDeliveries[uiMessageType];
+}
+
 void CMessageHandler::addMessage(const CMessage *m, bool bAutoDelete) {
-  mMutex.lock();
-  m_lMessages.push_back(std::unique_ptr<SMessageEntry>(new SMessageEntry()));
-  m_lMessages.back()->bAutoDelete = bAutoDelete;
-  m_lMessages.back()->pMessage = m;
-  mMutex.unlock();
+  const EMessageOwnership eOwnership(bAutoDelete ? MO_DELETE : MO_NONE);
+  size_t uiPosition;
+  SMessageSlot *pSlot(m_Ring.reserve(uiPosition));
+  if (!pSlot) {
+    pushOverflow(m, eOwnership);
+    return;
+  }
+  pSlot->pMessage = m;
+  pSlot->eOwnership = eOwnership;
+  m_Ring.publish(uiPosition);
+}
+
+void CMessageHandler::pushOverflow(const CMessage *m, EMessageOwnership eOwnership) {
+  mOverflowMutex.lock();
+  // read under the lock, so the positions of the entries never decrease
+  m_vOverflow.push_back({eOwnership, m, m_Ring.getEnqueuePosition()});
+  m_bOverflowed.store(true, std::memory_order_release);
+  mOverflowMutex.unlock();
+  m_uiOverflowCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+void CMessageHandler::updateSubscriptions() {
+  mInjectorMutex.lock();
+  if (m_bSubscriptionsRemoved) {
+    for (auto &vSubscriptions : m_vSubscriptions) {
+      vSubscriptions.erase(std::remove_if(vSubscriptions.begin(), vSubscriptions.end(),
+                                          [](const SSubscription &s) {return s.pInjector == nullptr;}),
+                           vSubscriptions.end());
+    }
+    m_bSubscriptionsRemoved = false;
+  }
+
+  for (const SPendingSubscription &pending : m_vSubscriptionsToAdd) {
+    if (pending.uiMessageType >= m_vSubscriptions.size()) {
+      m_vSubscriptions.resize(pending.uiMessageType + 1);
+    }
+    m_vSubscriptions[pending.uiMessageType].push_back(pending.subscription);
+  }
+  m_vSubscriptionsToAdd.clear();
+  m_bSubscriptionsToAdd.store(false, std::memory_order_release);
+  mInjectorMutex.unlock();
 }
 
+void CMessageHandler::deliver(const CMessage &message) {
+  const unsigned int uiMessageType(message.getType());
+  unsigned int uiDeliveries(0);
+
+  for (auto pInjector : m_lInjectors) {
+    if (pInjector) {
+      pInjector->sendMessageToAll(message);
+      ++uiDeliveries;
+    }
+  }
+
+  if (uiMessageType < m_vSubscriptions.size()) {
+    // new subscriptions are pending until the next message, so the vector is not reallocated
+    const std::vector<SSubscription> &vSubscriptions(m_vSubscriptions[uiMessageType]);
+    for (size_t i = 0; i < vSubscriptions.size(); ++i) {
+      const SSubscription &subscription(vSubscriptions[i]);
+      if (subscription.pInjector && (!subscription.pTarget || subscription.pTarget == message.getTarget())) {
+        subscription.pInjector->handleMessage(message);
+        ++uiDeliveries;
+      }
+    }
+  }
+
+  if (uiMessageType >= m_vDeliveries.size()) {
+    m_vDeliveries.resize(uiMessageType + 1, 0);
+  }
+  m_vDeliveries[uiMessageType] += uiDeliveries;
+}
+
+void CMessageHandler::release(const CMessage *m, EMessageOwnership eOwnership) {
+  switch (eOwnership) {
+  case MO_DELETE:
+    delete m;
+    break;
+  case MO_IN_PLACE:
+    m->~CMessage();
+    break;
+  default:
+    break;
+  }
+}
@@ -22,42 +22,132 @@
 
 #include <OgreSingleton.h>
 #include <list>
+#include <vector>
 #include <mutex>
-#include <memory>
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <utility>
 #include "Message.hpp"
+#include "MessageRing.hpp"
 
 class CMessageInjector;
 
+//! Queues the messages and delivers them to all injectors in process()
+/**
+  * The messages are stored in a multi producer single consumer ring buffer of fixed size
+  * slots. Adding a message neither locks a mutex nor allocates: messages created with
+  * createMessage are constructed in place in the slot, which serves as per frame arena
+  * and is reclaimed after the message was processed. Only if the ring buffer is full the
+  * message falls back to a mutex protected overflow queue. An overflow entry remembers
+  * the enqueue position of the ring, process() delivers it after the ring messages that
+  * were claimed before, so the messages of one producer keep their order.
+  *
+  * Injectors added with addInjector receive every message (sendMessageToAll), all other
+  * receivers subscribe for the message types (and optionally a target) they handle and
+  * only get those (handleMessage). Injectors, subscriptions and the delivery have to be
+  * modified on the main thread, only adding messages is thread safe.
+  */
 class CMessageHandler
   : public Ogre::Singleton<CMessageHandler> {
+public:
+  //! number of slots in the ring buffer, must be a power of two
+  static const size_t MESSAGE_QUEUE_CAPACITY = 1024;
+  //! maximum size of a message that is constructed in place
+  static const size_t MESSAGE_SLOT_SIZE = 128;
 private:
-  mutable std::mutex mMutex;
-  mutable std::mutex mInjectorMutex;
-  struct SMessageEntry {
-    bool bAutoDelete;
+  enum EMessageOwnership {
+    MO_NONE,                  //!< message is owned by the caller
+    MO_DELETE,                //!< heap message, delete after processing
+    MO_IN_PLACE,              //!< constructed in the slot, destruct after processing
+  };
+
+  struct SMessageSlot {
+    EMessageOwnership eOwnership;
     const CMessage *pMessage;
+    alignas(std::max_align_t) char pStorage[MESSAGE_SLOT_SIZE];
+  };
 
-    ~SMessageEntry() {
-      if (bAutoDelete) {
-        delete pMessage;
-      }
-    }
+  struct SSubscription {
+    CMessageInjector *pInjector;        //!< nullptr if removed
+    const void *pTarget;                //!< nullptr: any target
   };
 
+  struct SPendingSubscription {
+    unsigned int uiMessageType;
+    SSubscription subscription;
+  };
+
+  struct SOverflowEntry {
+    EMessageOwnership eOwnership;
+    const CMessage *pMessage;
+    size_t uiRingPosition;            //!< enqueue position of the ring when it was added
+  };
+
+  mutable std::mutex mInjectorMutex;
+  mutable std::mutex mOverflowMutex;
+
   std::list<CMessageInjector*> m_lInjectors;
   std::list<CMessageInjector*> m_lInjectorsToAdd;
-  std::list<CMessageInjector*> m_lInjectorsToRemove;
-  std::list<std::unique_ptr<SMessageEntry> > m_lMessages;
+
+  std::vector<std::vector<SSubscription> > m_vSubscriptions;      //!< indexed by message type
+  std::vector<SPendingSubscription> m_vSubscriptionsToAdd;
+  std::atomic<bool> m_bSubscriptionsToAdd;
+  bool m_bSubscriptionsRemoved;
+
+  std::vector<unsigned int> m_vDeliveries;                        //!< deliveries per message type in the current frame
+  std::vector<unsigned int> m_vLastFrameDeliveries;               //!< deliveries per message type in the last frame
+
+  CMessageRing<SMessageSlot, MESSAGE_QUEUE_CAPACITY> m_Ring;
+  std::vector<SOverflowEntry> m_vOverflow;
+  std::vector<SOverflowEntry> m_vOverflowProcessing;            //!< taken by process(), ordered by ring position
+  std::atomic<bool> m_bOverflowed;
+  std::atomic<size_t> m_uiOverflowCount;
+  bool m_bOverflowLogged;
 public:
   static CMessageHandler &getSingleton();
   static CMessageHandler *getSingletonPtr();
 
+  CMessageHandler();
+  ~CMessageHandler();
+
   void process();
 
   void addInjector(CMessageInjector *pInjector);
   void removeInjector(CMessageInjector *pInjector);
 
+  void subscribe(CMessageInjector *pInjector, unsigned int uiMessageType, const void *pTarget = nullptr);
+  void unsubscribe(CMessageInjector *pInjector, unsigned int uiMessageType);
+
+  //! start a new frame for the delivery counters
+  void nextFrame();
+  //! number of deliveries of the message type in the last frame
+  unsigned int getDeliveryCount(unsigned int uiMessageType) const;
+  //! number of messages that were added to the overflow queue since the start
+  size_t getOverflowCount() const {return m_uiOverflowCount.load(std::memory_order_relaxed);}
+
   void addMessage(const CMessage *m, bool bAutoDelete = true);
+
+  //! construct the message in place, no heap allocation (unless the queue is full)
+  template <class T, class... Args>
+  void createMessage(Args&&... args) {
+    static_assert(sizeof(T) <= MESSAGE_SLOT_SIZE, "Message type does not fit into a message slot");
+    size_t uiPosition;
+    SMessageSlot *pSlot(m_Ring.reserve(uiPosition));
+    if (!pSlot) {
+      pushOverflow(new T(std::forward<Args>(args)...), MO_DELETE);
+      return;
+    }
+    pSlot->pMessage = new (pSlot->pStorage) T(std::forward<Args>(args)...);
+    pSlot->eOwnership = MO_IN_PLACE;
+    m_Ring.publish(uiPosition);
+  }
+
+private:
+  void pushOverflow(const CMessage *m, EMessageOwnership eOwnership);
+  void updateSubscriptions();
+  void deliver(const CMessage &message);
+  static void release(const CMessage *m, EMessageOwnership eOwnership);
 };
 
 #endif
@@ -23,4 +23,5 @@
 CMessageHitpointsChanged::CMessageHitpointsChanged(const CHitableInterface &hitableInterface)
   : CMessage(MSG_HITPOINTS_CHANGED),
     m_HitableInterface(hitableInterface) {
+  m_pTarget = &hitableInterface;
 }
\ No newline at end of file
@@ -25,6 +25,8 @@
 class CHitableInterface;
 
 class CMessageHitpointsChanged : public CMessage {
+public:
+  static const unsigned int MESSAGE_TYPE = MSG_HITPOINTS_CHANGED;
 public:
 protected:
   const CHitableInterface &m_HitableInterface;
@@ -11,3 +11,11 @@ CMessageInjector::~CMessageInjector() {
     CMessageHandler::getSingleton().removeInjector(this);
   }
 }
+void CMessageInjector::subscribeMessage(unsigned int uiMessageType, const void *pTarget) {
+  CMessageHandler::getSingleton().subscribe(this, uiMessageType, pTarget);
+}
+void CMessageInjector::unsubscribeMessage(unsigned int uiMessageType) {
+  if (CMessageHandler::getSingletonPtr()) {
+    CMessageHandler::getSingleton().unsubscribe(this, uiMessageType);
+  }
+}
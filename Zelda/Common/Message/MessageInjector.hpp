@@ -22,12 +22,25 @@
 
 class CMessage;
 
+//! Receiver of messages
+/**
+  * An injector either receives all messages (added as injector to the CMessageHandler),
+  * or only the messages of the types it subscribed for.
+  */
 class CMessageInjector {
 public:
   CMessageInjector(bool bAutoAddAsInjector = true);
   virtual ~CMessageInjector();
 
+  //! called for all messages if added as injector
   virtual void sendMessageToAll(const CMessage &message) = 0;
+  //! called for the messages of the subscribed types
+  virtual void handleMessage(const CMessage &message) {sendMessageToAll(message);}
+
+protected:
+  //! receive messages of the given type (only with the given target, if not nullptr)
+  void subscribeMessage(unsigned int uiMessageType, const void *pTarget = nullptr);
+  void unsubscribeMessage(unsigned int uiMessageType);
 };
 
 #endif
@@ -23,6 +23,8 @@
 #include "Message.hpp"
 
 class CMessagePlayerPickupItem: public CMessage {
+public:
+  static const unsigned int MESSAGE_TYPE = MSG_PLAYER_PICKUP_ITEM;
 protected:
   const unsigned int m_uiItemType;
 public:
@@ -0,0 +1,104 @@
+/*****************************************************************************
+ * Copyright 2014 Christoph Wick
+ *
+ * This file is part of Zelda.
+ *
+ * Zelda is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zelda is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Zelda. If not, see http://www.gnu.org/licenses/.
+ *****************************************************************************/
+
+#ifndef _MESSAGE_RING_HPP_
+#define _MESSAGE_RING_HPP_
+
+#include <atomic>
+#include <cstddef>
+
+//! Bounded multi producer single consumer ring buffer of fixed size slots
+/**
+  * Producers claim a slot with a CAS on the enqueue position, fill it and
+  * publish it, the consumer takes the slots in the order they were claimed.
+  * Nothing is locked or allocated. Each slot carries a sequence number: a slot
+  * at position p is free if its sequence is p, published if it is p + 1.
+  *
+  * Only depends on the standard library, so it can be benchmarked on its own
+  * (see tools/benchmarks).
+  */
+template <class T, size_t CAPACITY>
+class CMessageRing {
+private:
+  static_assert((CAPACITY & (CAPACITY - 1)) == 0, "Capacity must be a power of two");
+
+  struct SSlot {
+    std::atomic<size_t> uiSequence;
+    T value;
+  };
+
+  SSlot m_Slots[CAPACITY];
+  std::atomic<size_t> m_uiEnqueuePosition;
+  size_t m_uiDequeuePosition;                   //!< only accessed by the consumer
+public:
+  CMessageRing()
+    : m_uiEnqueuePosition(0),
+      m_uiDequeuePosition(0) {
+    for (size_t i = 0; i < CAPACITY; ++i) {
+      m_Slots[i].uiSequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  //! producer: claim the next slot, nullptr if the ring is full
+  T *reserve(size_t &uiPosition) {
+    uiPosition = m_uiEnqueuePosition.load(std::memory_order_relaxed);
+    while (true) {
+      SSlot *pSlot(&m_Slots[uiPosition & (CAPACITY - 1)]);
+      const size_t uiSequence(pSlot->uiSequence.load(std::memory_order_acquire));
+      const ptrdiff_t diff(static_cast<ptrdiff_t>(uiSequence) - static_cast<ptrdiff_t>(uiPosition));
+      if (diff == 0) {
+        // slot is free, try to claim it
+        if (m_uiEnqueuePosition.compare_exchange_weak(uiPosition, uiPosition + 1, std::memory_order_relaxed)) {
+          return &pSlot->value;
+        }
+      }
+      else if (diff < 0) {
+        // full
+        return nullptr;
+      }
+      else {
+        uiPosition = m_uiEnqueuePosition.load(std::memory_order_relaxed);
+      }
+    }
+  }
+  //! producer: hand the filled slot to the consumer
+  void publish(size_t uiPosition) {
+    m_Slots[uiPosition & (CAPACITY - 1)].uiSequence.store(uiPosition + 1, std::memory_order_release);
+  }
+
+  //! consumer: position behind the last claimed slot
+  size_t getEnqueuePosition() const {return m_uiEnqueuePosition.load(std::memory_order_acquire);}
+  size_t getDequeuePosition() const {return m_uiDequeuePosition;}
+
+  //! consumer: the oldest slot, nullptr if it is empty or its producer is still writing
+  T *front() {
+    SSlot &slot(m_Slots[m_uiDequeuePosition & (CAPACITY - 1)]);
+    if (slot.uiSequence.load(std::memory_order_acquire) != m_uiDequeuePosition + 1) {
+      return nullptr;
+    }
+    return &slot.value;
+  }
+  //! consumer: free the oldest slot for the next round
+  void pop() {
+    m_Slots[m_uiDequeuePosition & (CAPACITY - 1)].uiSequence.store(m_uiDequeuePosition + CAPACITY, std::memory_order_release);
+    ++m_uiDequeuePosition;
+  }
+};
+
+#endif // _MESSAGE_RING_HPP_
@@ -41,6 +41,8 @@ extern const CSwitchMapTypes SWITCH_MAP_TYPES_ID_MAP;
 class CMap;
 
 class CMessageSwitchMap : public CMessage {
+public:
+  static const unsigned int MESSAGE_TYPE = MSG_SWITCH_MAP;
 public:
   enum ESwitchMapStatus {
     INJECT,
@@ -22,4 +22,5 @@
 CMessageTargetReached::CMessageTargetReached(ENTITY *pEntity)
   : CMessage(MSG_TARGET_REACHED),
     m_pEntity(pEntity){
+  m_pTarget = pEntity;
 }
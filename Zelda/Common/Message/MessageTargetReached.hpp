@@ -26,6 +26,8 @@
 class ENTITY;
 
 class CMessageTargetReached: public CMessage {
+public:
+  static const unsigned int MESSAGE_TYPE = MSG_TARGET_REACHED;
 protected:
   ENTITY *m_pEntity;
 
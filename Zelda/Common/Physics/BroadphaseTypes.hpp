@@ -0,0 +1,38 @@
+/*****************************************************************************
+ * Copyright 2014 Christoph Wick
+ *
+ * This file is part of Zelda.
+ *
+ * Zelda is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zelda is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Zelda. If not, see http://www.gnu.org/licenses/.
+ *****************************************************************************/
+
+#ifndef _BROADPHASE_TYPES_HPP_
+#define _BROADPHASE_TYPES_HPP_
+
+#include "../Util/EnumIdMap.hpp"
+
+//! the broadphase of a physics world (see CPhysicsManager::setBroadphase)
+enum EBroadphaseTypes {
+  BT_AXIS_SWEEP,                  //!< btAxisSweep3, fast for a static world of a known, small size
+  BT_DBVT,                        //!< btDbvtBroadphase, unbounded, better for many moving or streamed bodies
+};
+
+class CBroadphaseTypesIdMap : public CEnumIdMap<EBroadphaseTypes> {
+public:
+  CBroadphaseTypesIdMap();
+};
+
+extern CBroadphaseTypesIdMap BROADPHASE_TYPES_ID_MAP;
+
+#endif // _BROADPHASE_TYPES_HPP_
@@ -185,19 +185,88 @@ private:
   static unsigned int INSTANCES;
 protected:
 	Ogre::SceneNode *mNode;
-	btDynamicsWorld *mWorld;
-	DynamicLines *mLineDrawer;
-	bool mDebugOn;
+	btDiscreteDynamicsWorld *mWorld;
+	DynamicLines *mLineDrawer;			// active objects, rebuilt in every step
+	DynamicLines *mStaticLineDrawer;	// static and sleeping objects, only rebuilt if they change
+	DynamicLines *mCurrentLineDrawer;	// the one drawLine adds to
+	int mDebugMode;						// btIDebugDraw::DebugDrawModes, DBG_NoDebug is off
+	bool mStaticLinesValid;
+	unsigned int mGeneration;			// of the world when the static lines were built
+	int mStaticObjectCount;
+	size_t mStaticObjectHash;			// detects objects that fell asleep or woke up
+
+	static bool isStatic(const btCollisionObject *obj)
+	{
+		return obj->isStaticObject() || !obj->isActive();
+	}
+
+	static bool isVisible(const btCollisionObject *obj, const Ogre::Camera *camera)
+	{
+		btVector3 aabbMin, aabbMax;
+		obj->getCollisionShape()->getAabb(obj->getWorldTransform(), aabbMin, aabbMax);
+		return camera->isVisible(Ogre::AxisAlignedBox(Convert::toOgre(aabbMin), Convert::toOgre(aabbMax)));
+	}
+
+	void drawObject(const btCollisionObject *obj)
+	{
+		mWorld->debugDrawObject(obj->getWorldTransform(), obj->getCollisionShape(), btVector3(1, 1, 1));
+	}
+
+	void rebuildStaticLines()
+	{
+		const btCollisionObjectArray &objects(mWorld->getCollisionObjectArray());
+		mCurrentLineDrawer = mStaticLineDrawer;
+		mStaticLineDrawer->clear();
+		for (int i = 0; i < objects.size(); i++)
+		{
+			if (isStatic(objects[i]))
+				drawObject(objects[i]);
+		}
+		mStaticLineDrawer->update();
+		mCurrentLineDrawer = mLineDrawer;
+	}
+
+	//The parts of btDiscreteDynamicsWorld::debugDrawWorld that are not objects, they
+	//change in every step. The actions are not drawn, the character controller draws nothing.
+	void drawConstraintsAndContacts()
+	{
+		if (mDebugMode & (DBG_DrawConstraints | DBG_DrawConstraintLimits))
+		{
+			for (int i = mWorld->getNumConstraints() - 1; i >= 0; i--)
+				mWorld->debugDrawConstraint(mWorld->getConstraint(i));
+		}
+
+		if (mDebugMode & DBG_DrawContactPoints)
+		{
+			btDispatcher *dispatcher = mWorld->getDispatcher();
+			for (int i = 0; i < dispatcher->getNumManifolds(); i++)
+			{
+				const btPersistentManifold *manifold = dispatcher->getManifoldByIndexInternal(i);
+				for (int j = 0; j < manifold->getNumContacts(); j++)
+				{
+					const btManifoldPoint &point = manifold->getContactPoint(j);
+					drawContactPoint(point.getPositionWorldOnB(), point.m_normalWorldOnB, point.getDistance(), point.getLifeTime(), btVector3(0, 0, 0));
+				}
+			}
+		}
+	}
 
 public:
 
-	DebugDrawer(Ogre::SceneNode *node, btDynamicsWorld *world)
+	DebugDrawer(Ogre::SceneNode *node, btDiscreteDynamicsWorld *world)
 		: mNode(node),
 		  mWorld(world),
-		  mDebugOn(true)
+		  mDebugMode(DBG_DrawWireframe),
+		  mStaticLinesValid(false),
+		  mGeneration(0),
+		  mStaticObjectCount(0),
+		  mStaticObjectHash(0)
 	{
 		mLineDrawer = new DynamicLines(Ogre::RenderOperation::OT_LINE_LIST);
 		mNode->attachObject(mLineDrawer);
+		mStaticLineDrawer = new DynamicLines(Ogre::RenderOperation::OT_LINE_LIST);
+		mNode->attachObject(mStaticLineDrawer);
+		mCurrentLineDrawer = mLineDrawer;
 
     if (INSTANCES == 0) {
       Ogre::ResourceGroupManager::getSingleton().createResourceGroup("BtOgre");
@@ -207,6 +276,7 @@ public:
     }
 
 		mLineDrawer->setMaterial("BtOgre/DebugLines");
+		mStaticLineDrawer->setMaterial("BtOgre/DebugLines");
 
 		INSTANCES++;
 	}
@@ -220,36 +290,63 @@ public:
 			Ogre::ResourceGroupManager::getSingleton().destroyResourceGroup("BtOgre");
     }
 
+		delete mStaticLineDrawer;
 		delete mLineDrawer;
 	}
 
-	void step()
+	//Redraws the objects, only the active ones that are visible to the camera (if any) are
+	//drawn in every step, the lines of the static and sleeping objects are kept until they change.
+	//The generation has to change whenever an object is added to or removed from the world
+	//(see CPhysicsManager::getGeneration), counting the objects misses a removal and an
+	//addition in the same step. The constraints and contact points are drawn in every step,
+	//if the debug mode has their flags. Nothing is done while the debug mode is off.
+	void step(const Ogre::Camera *camera, unsigned int generation)
 	{
-		if (mDebugOn)
+		if (mDebugMode == DBG_NoDebug)
+			return;
+
+		const btCollisionObjectArray &objects(mWorld->getCollisionObjectArray());
+		int staticObjectCount = 0;
+		size_t staticObjectHash = 0;
+		for (int i = 0; i < objects.size(); i++)
 		{
-			mWorld->debugDrawWorld();
-			mLineDrawer->update();
-			mNode->needUpdate();
-			mLineDrawer->clear();
+			if (isStatic(objects[i]))
+			{
+				staticObjectCount++;
+				staticObjectHash ^= reinterpret_cast<size_t>(objects[i]);
+			}
 		}
-		else
+		if (!mStaticLinesValid || generation != mGeneration
+			|| staticObjectCount != mStaticObjectCount || staticObjectHash != mStaticObjectHash)
 		{
-			mLineDrawer->clear();
-			mLineDrawer->update();
-			mNode->needUpdate();
+			mStaticLinesValid = true;
+			mGeneration = generation;
+			mStaticObjectCount = staticObjectCount;
+			mStaticObjectHash = staticObjectHash;
+			rebuildStaticLines();
+		}
+
+		mLineDrawer->clear();
+		for (int i = 0; i < objects.size(); i++)
+		{
+			if (!isStatic(objects[i]) && (!camera || isVisible(objects[i], camera)))
+				drawObject(objects[i]);
 		}
+		drawConstraintsAndContacts();
+		mLineDrawer->update();
+		mNode->needUpdate();
 	}
 
 	void drawLine(const btVector3& from,const btVector3& to,const btVector3& color)
 	{
-		mLineDrawer->addPoint(Convert::toOgre(from));
-		mLineDrawer->addPoint(Convert::toOgre(to));
+		mCurrentLineDrawer->addPoint(Convert::toOgre(from));
+		mCurrentLineDrawer->addPoint(Convert::toOgre(to));
 	}
 
 	void drawContactPoint(const btVector3& PointOnB,const btVector3& normalOnB,btScalar distance,int lifeTime,const btVector3& color)
 	{
-		mLineDrawer->addPoint(Convert::toOgre(PointOnB));
-		mLineDrawer->addPoint(Convert::toOgre(PointOnB) + (Convert::toOgre(normalOnB) * distance * 20));
+		mCurrentLineDrawer->addPoint(Convert::toOgre(PointOnB));
+		mCurrentLineDrawer->addPoint(Convert::toOgre(PointOnB) + (Convert::toOgre(normalOnB) * distance * 20));
 	}
 
 	void reportErrorWarning(const char* warningString)
@@ -261,19 +358,26 @@ public:
 	{
 	}
 
-	//0 for off, anything else for on.
-	void setDebugMode(int isOn)
+	//DBG_NoDebug for off, the objects are drawn for any other mode, see drawConstraintsAndContacts
+	void setDebugMode(int mode)
 	{
-		mDebugOn = (isOn == 0) ? false : true;
+		mDebugMode = mode;
 
-		if (!mDebugOn)
+		if (mDebugMode == DBG_NoDebug)
+		{
+			// release the lines once, step() does nothing until the mode is on again
 			mLineDrawer->clear();
+			mLineDrawer->update();
+			mStaticLineDrawer->clear();
+			mStaticLineDrawer->update();
+			mNode->needUpdate();
+		}
+		mStaticLinesValid = false;
 	}
 
-	//0 for off, anything else for on.
 	int	getDebugMode() const
 	{
-		return mDebugOn;
+		return mDebugMode;
 	}
 
 };
@@ -47,6 +47,7 @@ public:
 	unsigned int getVertexCount();
 	const unsigned int* getIndices();
 	unsigned int getIndexCount();
+	const Ogre::Vector3 &getScale() const {return mScale;}
 
 protected:
 
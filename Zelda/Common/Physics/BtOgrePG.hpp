@@ -33,11 +33,16 @@ class RigidBodyState : public btMotionState
 
         Ogre::SceneNode *mNode;
 
+        bool mDeferred;                 //!< only store the transform, applyDeferred writes it to the node
+        bool mChanged;                  //!< a stored transform was not written yet
+
     public:
         RigidBodyState(Ogre::SceneNode *node, const btTransform &transform, const btTransform &offset = btTransform::getIdentity())
             : mTransform(transform),
               mCenterOfMassOffset(offset),
-              mNode(node)
+              mNode(node),
+              mDeferred(false),
+              mChanged(false)
         {
         }
 
@@ -45,7 +50,9 @@ class RigidBodyState : public btMotionState
             : mTransform(((node != NULL) ? BtOgre::Convert::toBullet(node->getOrientation()) : btQuaternion(0,0,0,1)),
                          ((node != NULL) ? BtOgre::Convert::toBullet(node->getPosition())    : btVector3(0,0,0))),
               mCenterOfMassOffset(btTransform::getIdentity()),
-              mNode(node)
+              mNode(node),
+              mDeferred(false),
+              mChanged(false)
         {
         }
 
@@ -60,13 +67,41 @@ class RigidBodyState : public btMotionState
                 return;
 
             mTransform = in;
-            btTransform transform = in * mCenterOfMassOffset;
+            if (mDeferred)
+            {
+                // the world is stepped on a worker thread, ogre must not be touched
+                mChanged = true;
+                return;
+            }
+            updateNode();
+        }
+
+        //! defer the writes to the node while the world is stepped concurrently
+        void setDeferred(bool deferred)
+        {
+            mDeferred = deferred;
+        }
+
+        //! write the transform that was stored while deferred to the node
+        void applyDeferred()
+        {
+            if (!mChanged || mNode == NULL)
+                return;
+
+            mChanged = false;
+            updateNode();
+        }
+
+        void updateNode()
+        {
+            btTransform transform = mTransform * mCenterOfMassOffset;
 
             btQuaternion rot = transform.getRotation();
             btVector3 pos = transform.getOrigin();
             mNode->setOrientation(rot.w(), rot.x(), rot.y(), rot.z());
             mNode->setPosition(pos.x(), pos.y(), pos.z());
         }
+
         void setOffset(const btTransform &offset) {
             mCenterOfMassOffset = offset;
         }
@@ -0,0 +1,298 @@
+/*****************************************************************************
+ * Copyright 2014 Christoph Wick
+ *
+ * This file is part of Zelda.
+ *
+ * Zelda is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zelda is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Zelda. If not, see http://www.gnu.org/licenses/.
+ *****************************************************************************/
+
+#include "BvhTriangleMeshCache.hpp"
+#include "BtOgreGP.hpp"
+#include "../FileManager/FileManager.hpp"
+#include "../Log.hpp"
+#include "../Util/Assert.hpp"
+#include <OgreResourceGroupManager.h>
+#include <BulletCollision/CollisionShapes/btOptimizedBvh.h>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cstring>
+
+const Ogre::String CBvhTriangleMeshCache::CACHE_DIRECTORY("cache/bvh/");
+const Ogre::String CBvhTriangleMeshCache::EXTENSION(".bvh");
+
+namespace {
+  const char BVH_CACHE_MAGIC[4] = {'Z', 'B', 'V', 'H'};
+  const uint32_t BVH_CACHE_VERSION = 2;
+  //! alignment of the buffers and of the bvh in the cache file, required by btOptimizedBvh
+  const size_t BVH_ALIGNMENT = 16;
+
+  //! the file starts with the header, followed by the vertices (3 floats each),
+  //! the indices (int32) and at bvhOffset the serialized btOptimizedBvh
+  struct SHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t hash;          //!< hash of vertices, indices and scaling
+    uint64_t meshFileHash;  //!< hash of the mesh file, lets tools/CreatePacks.py skip stale files
+    uint32_t scalarSize;    //!< sizeof(btScalar) of the bvh
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t bvhOffset;
+    uint32_t bvhSize;
+    uint32_t reserved;
+  };
+  static_assert(sizeof(SHeader) == 48, "Size of the bvh cache header changed");
+
+  size_t align(size_t size) {
+    return (size + BVH_ALIGNMENT - 1) & ~(BVH_ALIGNMENT - 1);
+  }
+
+  //! 64 bit FNV-1a hash
+  uint64_t hashData(const void *pData, size_t size, uint64_t hash = 14695981039346656037ULL) {
+    const unsigned char *p(static_cast<const unsigned char*>(pData));
+    for (size_t i = 0; i < size; ++i) {
+      hash ^= p[i];
+      hash *= 1099511628211ULL;
+    }
+    return hash;
+  }
+
+  //! hash of the content of the mesh file, 0 if it can not be read
+  uint64_t hashMeshFile(const Ogre::String &sMeshName, const Ogre::String &sResourceGroup) {
+    try {
+      Ogre::DataStreamPtr pStream(Ogre::ResourceGroupManager::getSingleton().openResource(sMeshName, sResourceGroup));
+      const Ogre::String sData(pStream->getAsString());
+      return hashData(sData.data(), sData.size());
+    }
+    catch (const Ogre::Exception &) {
+      return 0;
+    }
+  }
+
+  char *allocBuffer(size_t size) {
+    return static_cast<char*>(btAlignedAlloc(size, BVH_ALIGNMENT));
+  }
+};
+
+CCachedTriangleMesh::CCachedTriangleMesh(char *pBuffer, const float *pVertices, unsigned int uiVertexCount, const int32_t *pIndices, unsigned int uiIndexCount)
+  : m_pBuffer(pBuffer) {
+  btIndexedMesh mesh;
+  mesh.m_numTriangles = uiIndexCount / 3;
+  mesh.m_triangleIndexBase = reinterpret_cast<const unsigned char*>(pIndices);
+  mesh.m_triangleIndexStride = 3 * sizeof(int32_t);
+  mesh.m_numVertices = uiVertexCount;
+  mesh.m_vertexBase = reinterpret_cast<const unsigned char*>(pVertices);
+  mesh.m_vertexStride = 3 * sizeof(float);
+  mesh.m_vertexType = PHY_FLOAT;
+  addIndexedMesh(mesh, PHY_INTEGER);
+}
+
+CCachedTriangleMesh::~CCachedTriangleMesh() {
+  btAlignedFree(m_pBuffer);
+}
+
+btBvhTriangleMeshShape *CBvhTriangleMeshCache::createTrimesh(BtOgre::VertexIndexToShape &converter, const Ogre::String &sMeshName, const Ogre::String &sResourceGroup) {
+  const unsigned int uiVertexCount(converter.getVertexCount());
+  const unsigned int uiIndexCount(converter.getIndexCount());
+  ASSERT(uiVertexCount > 0 && uiIndexCount >= 6);
+
+  // copy the mesh data in the layout of the cache file
+  const size_t verticesSize(uiVertexCount * 3 * sizeof(float));
+  const size_t meshDataSize(sizeof(SHeader) + verticesSize + uiIndexCount * sizeof(int32_t));
+  char *pBuffer(allocBuffer(meshDataSize));
+  float *pVertices(reinterpret_cast<float*>(pBuffer + sizeof(SHeader)));
+  int32_t *pIndices(reinterpret_cast<int32_t*>(pBuffer + sizeof(SHeader) + verticesSize));
+  const Ogre::Vector3 *pSrcVertices(converter.getVertices());
+  for (unsigned int i = 0; i < uiVertexCount; ++i) {
+    pVertices[3 * i + 0] = pSrcVertices[i].x;
+    pVertices[3 * i + 1] = pSrcVertices[i].y;
+    pVertices[3 * i + 2] = pSrcVertices[i].z;
+  }
+  const unsigned int *pSrcIndices(converter.getIndices());
+  for (unsigned int i = 0; i < uiIndexCount; ++i) {
+    pIndices[i] = static_cast<int32_t>(pSrcIndices[i]);
+  }
+
+  const Ogre::Vector3 &vScale(converter.getScale());
+  const uint64_t hash(hashMesh(converter));
+  const btVector3 vBtScale(vScale.x, vScale.y, vScale.z);
+
+  const Ogre::String sFileName(getCacheFileName(sMeshName, hash));
+  const Ogre::String sCacheFile(CFileManager::getValidPath(CACHE_DIRECTORY + sFileName));
+  btBvhTriangleMeshShape *pShape(readCacheFile(sFileName, sResourceGroup, hash, vBtScale));
+  if (!pShape) {
+    pShape = readCacheFile(sCacheFile, Ogre::StringUtil::BLANK, hash, vBtScale);
+  }
+  if (pShape) {
+    btAlignedFree(pBuffer);
+    return pShape;
+  }
+
+  // build the bvh and store it for the next load
+  SHeader *pHeader(reinterpret_cast<SHeader*>(pBuffer));
+  memcpy(pHeader->magic, BVH_CACHE_MAGIC, sizeof(pHeader->magic));
+  pHeader->version = BVH_CACHE_VERSION;
+  pHeader->hash = hash;
+  pHeader->meshFileHash = hashMeshFile(sMeshName, sResourceGroup);
+  pHeader->scalarSize = sizeof(btScalar);
+  pHeader->vertexCount = uiVertexCount;
+  pHeader->indexCount = uiIndexCount;
+  pHeader->bvhOffset = align(meshDataSize);
+  pHeader->bvhSize = 0;
+  pHeader->reserved = 0;
+
+  CCachedTriangleMesh *pMesh(new CCachedTriangleMesh(pBuffer, pVertices, uiVertexCount, pIndices, uiIndexCount));
+  // scale the mesh before the bvh is built, setLocalScaling would build it again
+  pMesh->setScaling(vBtScale);
+  pShape = new btBvhTriangleMeshShape(pMesh, true);
+  writeCacheFile(sCacheFile, pBuffer, meshDataSize, pShape->getOptimizedBvh());
+  return pShape;
+}
+
+uint64_t CBvhTriangleMeshCache::hashMesh(BtOgre::VertexIndexToShape &converter) {
+  // same bytes as the mesh data of the cache file followed by the scaling
+  uint64_t hash(hashData(nullptr, 0));
+  const Ogre::Vector3 *pVertices(converter.getVertices());
+  for (unsigned int i = 0; i < converter.getVertexCount(); ++i) {
+    const float vertex[3] = {pVertices[i].x, pVertices[i].y, pVertices[i].z};
+    hash = hashData(vertex, sizeof(vertex), hash);
+  }
+  const unsigned int *pIndices(converter.getIndices());
+  for (unsigned int i = 0; i < converter.getIndexCount(); ++i) {
+    const int32_t index(static_cast<int32_t>(pIndices[i]));
+    hash = hashData(&index, sizeof(index), hash);
+  }
+  const Ogre::Vector3 &vScale(converter.getScale());
+  const float scale[3] = {vScale.x, vScale.y, vScale.z};
+  return hashData(scale, sizeof(scale), hash);
+}
+
+Ogre::String CBvhTriangleMeshCache::getCacheFileName(const Ogre::String &sMeshName, uint64_t hash) {
+  Ogre::String sFlatName(sMeshName);
+  for (char &c : sFlatName) {
+    if (c == '/' || c == '\\' || c == ':') {
+      c = '_';
+    }
+  }
+
+  std::stringstream ss;
+  ss << sFlatName << "_" << std::hex << std::setw(16) << std::setfill('0') << hash << EXTENSION;
+  return ss.str();
+}
+
+btBvhTriangleMeshShape *CBvhTriangleMeshCache::readCacheFile(const Ogre::String &sFileName, const Ogre::String &sResourceGroup, uint64_t hash, const btVector3 &vScale) {
+  char *pBuffer(nullptr);
+  size_t size(0);
+  if (!sResourceGroup.empty()) {
+    if (!Ogre::ResourceGroupManager::getSingleton().resourceExists(sResourceGroup, sFileName)) {
+      return nullptr;
+    }
+    Ogre::DataStreamPtr pStream(Ogre::ResourceGroupManager::getSingleton().openResource(sFileName, sResourceGroup, false));
+    size = pStream->size();
+    pBuffer = allocBuffer(size);
+    if (pStream->read(pBuffer, size) != size) {
+      btAlignedFree(pBuffer);
+      return nullptr;
+    }
+  }
+  else {
+    std::ifstream stream(sFileName, std::ios::in | std::ios::binary | std::ios::ate);
+    if (!stream) {
+      return nullptr;
+    }
+    size = static_cast<size_t>(stream.tellg());
+    stream.seekg(0);
+    pBuffer = allocBuffer(size);
+    if (!stream.read(pBuffer, size)) {
+      btAlignedFree(pBuffer);
+      return nullptr;
+    }
+  }
+
+  btBvhTriangleMeshShape *pShape(createFromBuffer(pBuffer, size, hash, vScale));
+  if (!pShape) {
+    // the file is replaced when the bvh is built
+    LOGW("Invalid bvh cache file '%s'", sFileName.c_str());
+    btAlignedFree(pBuffer);
+    return nullptr;
+  }
+  LOGV("Loaded triangle mesh from bvh cache file '%s'", sFileName.c_str());
+  return pShape;
+}
+
+btBvhTriangleMeshShape *CBvhTriangleMeshCache::createFromBuffer(char *pBuffer, size_t size, uint64_t hash, const btVector3 &vScale) {
+  if (size < sizeof(SHeader)) {return nullptr;}
+  const SHeader &header(*reinterpret_cast<const SHeader*>(pBuffer));
+  if (memcmp(header.magic, BVH_CACHE_MAGIC, sizeof(header.magic)) != 0
+      || header.version != BVH_CACHE_VERSION
+      || header.hash != hash
+      || header.scalarSize != sizeof(btScalar)) {
+    return nullptr;
+  }
+
+  // the hash matches, but do not trust the sizes of a damaged file
+  const size_t verticesSize(static_cast<size_t>(header.vertexCount) * 3 * sizeof(float));
+  const size_t meshDataSize(sizeof(SHeader) + verticesSize + static_cast<size_t>(header.indexCount) * sizeof(int32_t));
+  if (header.indexCount % 3 != 0
+      || header.bvhOffset < meshDataSize
+      || header.bvhOffset % BVH_ALIGNMENT != 0
+      || static_cast<size_t>(header.bvhOffset) + header.bvhSize != size) {
+    return nullptr;
+  }
+  const float *pVertices(reinterpret_cast<const float*>(pBuffer + sizeof(SHeader)));
+  const int32_t *pIndices(reinterpret_cast<const int32_t*>(pBuffer + sizeof(SHeader) + verticesSize));
+  for (uint32_t i = 0; i < header.indexCount; ++i) {
+    if (pIndices[i] < 0 || static_cast<uint32_t>(pIndices[i]) >= header.vertexCount) {
+      return nullptr;
+    }
+  }
+
+  btOptimizedBvh *pBvh(btOptimizedBvh::deSerializeInPlace(pBuffer + header.bvhOffset, header.bvhSize, false));
+  if (!pBvh) {return nullptr;}
+
+  CCachedTriangleMesh *pMesh(new CCachedTriangleMesh(pBuffer, pVertices, header.vertexCount, pIndices, header.indexCount));
+  pMesh->setScaling(vScale);
+  btBvhTriangleMeshShape *pShape(new btBvhTriangleMeshShape(pMesh, true, false));
+  // the bvh lives in the buffer of the mesh, the shape does not own it
+  pShape->setOptimizedBvh(pBvh, vScale);
+  return pShape;
+}
+
+void CBvhTriangleMeshCache::writeCacheFile(const Ogre::String &sPath, const char *pMeshData, size_t meshDataSize, const btOptimizedBvh *pBvh) {
+  ASSERT(pBvh);
+  const unsigned int uiBvhSize(pBvh->calculateSerializeBufferSize());
+  char *pBvhBuffer(allocBuffer(uiBvhSize));
+  if (!pBvh->serializeInPlace(pBvhBuffer, uiBvhSize, false)) {
+    LOGW("Could not serialize bvh for '%s'", sPath.c_str());
+    btAlignedFree(pBvhBuffer);
+    return;
+  }
+
+  std::ofstream stream(sPath, std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!stream) {
+    LOGW("Could not create bvh cache file '%s'", sPath.c_str());
+    btAlignedFree(pBvhBuffer);
+    return;
+  }
+
+  SHeader header(*reinterpret_cast<const SHeader*>(pMeshData));
+  header.bvhSize = uiBvhSize;
+  const char padding[BVH_ALIGNMENT] = {0};
+  stream.write(reinterpret_cast<const char*>(&header), sizeof(SHeader));
+  stream.write(pMeshData + sizeof(SHeader), meshDataSize - sizeof(SHeader));
+  stream.write(padding, header.bvhOffset - meshDataSize);
+  stream.write(pBvhBuffer, uiBvhSize);
+  btAlignedFree(pBvhBuffer);
+  LOGV("Created bvh cache file '%s'", sPath.c_str());
+}
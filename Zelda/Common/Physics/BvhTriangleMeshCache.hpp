@@ -0,0 +1,76 @@
+/*****************************************************************************
+ * Copyright 2014 Christoph Wick
+ *
+ * This file is part of Zelda.
+ *
+ * Zelda is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zelda is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Zelda. If not, see http://www.gnu.org/licenses/.
+ *****************************************************************************/
+
+#ifndef _BVH_TRIANGLE_MESH_CACHE_HPP_
+#define _BVH_TRIANGLE_MESH_CACHE_HPP_
+
+#include <OgreString.h>
+#include <btBulletCollisionCommon.h>
+#include <cstdint>
+
+namespace BtOgre {
+  class VertexIndexToShape;
+};
+
+//! Triangle mesh that owns its vertex, index and (if loaded from a cache file) bvh data
+/**
+  * All data is stored in a single aligned buffer, the mesh is deleted with its
+  * shape (see CCollisionShapeLibrary), which does not own a deserialized bvh.
+  */
+class CCachedTriangleMesh : public btTriangleIndexVertexArray {
+private:
+  char *m_pBuffer;
+public:
+  CCachedTriangleMesh(char *pBuffer, const float *pVertices, unsigned int uiVertexCount, const int32_t *pIndices, unsigned int uiIndexCount);
+  ~CCachedTriangleMesh();
+};
+
+//! Creates triangle mesh shapes and caches their serialized bvh (btOptimizedBvh)
+/**
+  * Building the bvh of large static meshes is the most expensive part of the
+  * physics setup of a map. The cache files are keyed by the mesh name and a hash
+  * of the converted vertices, indices and scaling, so a changed mesh results in a
+  * new key and stale cache files are never used.
+  * A cache file is searched in the resource group of the scene first (shipped in
+  * the map pack, see tools/CreatePacks.py --bvh-cache) and then in the writable
+  * path (CFileManager::getValidPath), where it is created if it does not exist.
+  */
+class CBvhTriangleMeshCache {
+public:
+  //! directory of the cache files in the writable path
+  static const Ogre::String CACHE_DIRECTORY;
+  static const Ogre::String EXTENSION;
+
+  //! replacement of BtOgre::VertexIndexToShape::createTrimesh
+  static btBvhTriangleMeshShape *createTrimesh(BtOgre::VertexIndexToShape &converter, const Ogre::String &sMeshName, const Ogre::String &sResourceGroup);
+  //! hash of the converted vertices, indices and scaling, the key of the cache files
+  /**
+    * Only equal meshes with equal scaling have the same hash, independent of
+    * their name and resource group (see DotSceneLoader, the shared shapes).
+    */
+  static uint64_t hashMesh(BtOgre::VertexIndexToShape &converter);
+
+private:
+  static Ogre::String getCacheFileName(const Ogre::String &sMeshName, uint64_t hash);
+  static btBvhTriangleMeshShape *readCacheFile(const Ogre::String &sFileName, const Ogre::String &sResourceGroup, uint64_t hash, const btVector3 &vScale);
+  static btBvhTriangleMeshShape *createFromBuffer(char *pBuffer, size_t size, uint64_t hash, const btVector3 &vScale);
+  static void writeCacheFile(const Ogre::String &sPath, const char *pMeshData, size_t meshDataSize, const btOptimizedBvh *pBvh);
+};
+
+#endif // _BVH_TRIANGLE_MESH_CACHE_HPP_
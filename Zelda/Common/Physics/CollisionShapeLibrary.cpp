@@ -0,0 +1,90 @@
+/*****************************************************************************
+ * Copyright 2014 Christoph Wick
+ *
+ * This file is part of Zelda.
+ *
+ * Zelda is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zelda is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Zelda. If not, see http://www.gnu.org/licenses/.
+ *****************************************************************************/
+
+#include "CollisionShapeLibrary.hpp"
+#include <btBulletCollisionCommon.h>
+#include "../Util/Assert.hpp"
+#include "../Log.hpp"
+
+template<> CCollisionShapeLibrary *Ogre::Singleton<CCollisionShapeLibrary>::msSingleton = 0;
+
+CCollisionShapeLibrary *CCollisionShapeLibrary::getSingletonPtr() {
+  return msSingleton;
+}
+CCollisionShapeLibrary &CCollisionShapeLibrary::getSingleton() {
+  ASSERT(msSingleton);
+  return *msSingleton;
+}
+
+CCollisionShapeLibrary::CCollisionShapeLibrary() {
+}
+
+CCollisionShapeLibrary::~CCollisionShapeLibrary() {
+  if (!m_mShapes.empty()) {
+    LOGW("%d collision shapes are still referenced", static_cast<int>(m_mShapes.size()));
+  }
+  for (auto &entry : m_mShapes) {
+    destroyShape(entry.second.collisionObject.getShape());
+  }
+  m_mShapes.clear();
+}
+
+const CPhysicsCollisionObject *CCollisionShapeLibrary::acquire(const CAtom &id) {
+  auto it = m_mShapes.find(id);
+  if (it == m_mShapes.end()) {return nullptr;}
+
+  it->second.uiRefCount++;
+  return &it->second.collisionObject;
+}
+
+void CCollisionShapeLibrary::add(const CAtom &id, const CPhysicsCollisionObject &colobj) {
+  ASSERT(colobj.getShape());
+  ASSERT(m_mShapes.find(id) == m_mShapes.end());
+
+  SEntry &entry(m_mShapes[id]);
+  entry.collisionObject = colobj;
+  entry.uiRefCount = 1;
+}
+
+void CCollisionShapeLibrary::release(const CAtom &id) {
+  auto it = m_mShapes.find(id);
+  ASSERT(it != m_mShapes.end());
+  ASSERT(it->second.uiRefCount > 0);
+
+  if (--it->second.uiRefCount == 0) {
+    destroyShape(it->second.collisionObject.getShape());
+    m_mShapes.erase(it);
+  }
+}
+
+void CCollisionShapeLibrary::destroyShape(btCollisionShape *pShape) {
+  auto pTriShape = dynamic_cast<btBvhTriangleMeshShape*>(pShape);
+  if (pTriShape) {
+    delete pTriShape->getMeshInterface();
+  }
+  auto pCompoundShape = dynamic_cast<btCompoundShape*>(pShape);
+  if (pCompoundShape) {
+    for (int i = pCompoundShape->getNumChildShapes() - 1; i >= 0; i--) {
+      btCollisionShape *pChild(pCompoundShape->getChildShape(i));
+      pCompoundShape->removeChildShapeByIndex(i);
+      destroyShape(pChild);
+    }
+  }
+  delete pShape;
+}
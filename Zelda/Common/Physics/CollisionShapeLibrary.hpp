@@ -0,0 +1,67 @@
+/*****************************************************************************
+ * Copyright 2014 Christoph Wick
+ *
+ * This file is part of Zelda.
+ *
+ * Zelda is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zelda is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Zelda. If not, see http://www.gnu.org/licenses/.
+ *****************************************************************************/
+
+#ifndef _COLLISION_SHAPE_LIBRARY_HPP_
+#define _COLLISION_SHAPE_LIBRARY_HPP_
+
+#include <OgreSingleton.h>
+#include <unordered_map>
+#include "PhysicsManager.hpp"
+
+//! Process wide, reference counted collision shapes shared by all physics managers
+/**
+  * The shapes are keyed by the same ids as in the physics managers, i.e. the ids
+  * of the global collision shapes (EGlobalCollisionShapesTypes) and for the shapes
+  * created by the DotSceneLoader the mesh name, the collision primitive and the
+  * content hash of the mesh (CBvhTriangleMeshCache::hashMesh), so only identical
+  * meshes of different map packs share a shape. A physics manager holds one
+  * reference of every shape it uses (see CPhysicsManager::acquireCollisionShape),
+  * the shape is deleted when the last one is released.
+  * Bullet shapes are immutable once in use, so sharing them between worlds is
+  * safe, but the library itself must only be used from the main thread.
+  */
+class CCollisionShapeLibrary : public Ogre::Singleton<CCollisionShapeLibrary> {
+private:
+  struct SEntry {
+    CPhysicsCollisionObject collisionObject;
+    unsigned int uiRefCount;
+  };
+
+  std::unordered_map<CAtom, SEntry> m_mShapes;
+public:
+  static CCollisionShapeLibrary &getSingleton();
+  static CCollisionShapeLibrary *getSingletonPtr();
+
+  CCollisionShapeLibrary();
+  ~CCollisionShapeLibrary();
+
+  //! take a reference of the shape, nullptr if the library does not have it
+  const CPhysicsCollisionObject *acquire(const CAtom &id);
+  //! add a new shape, the caller holds its first reference
+  void add(const CAtom &id, const CPhysicsCollisionObject &colobj);
+  //! release a reference, the shape is deleted with the last one
+  void release(const CAtom &id);
+
+  size_t getShapeCount() const {return m_mShapes.size();}
+
+private:
+  static void destroyShape(btCollisionShape *pShape);
+};
+
+#endif // _COLLISION_SHAPE_LIBRARY_HPP_
@@ -0,0 +1,144 @@
+/*****************************************************************************
+ * Copyright 2014 Christoph Wick
+ *
+ * This file is part of Zelda.
+ *
+ * Zelda is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zelda is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Zelda. If not, see http://www.gnu.org/licenses/.
+ *****************************************************************************/
+
+#include "ContactTracker.hpp"
+#include <btBulletCollisionCommon.h>
+#include "BtOgreExtras.hpp"
+
+CContactTracker::CContactTracker(unsigned int uiInterestMask)
+  : m_uiInterestMask(uiInterestMask),
+    m_bReportPersist(false) {
+}
+
+bool CContactTracker::isOfInterest(const btCollisionObject *pCO) const {
+  return pCO->getBroadphaseHandle() && (pCO->getBroadphaseHandle()->m_collisionFilterGroup & m_uiInterestMask) != 0;
+}
+
+void CContactTracker::collect(btDispatcher *pDispatcher) {
+  m_mStepContacts.clear();
+
+  const int iNumManifolds = pDispatcher->getNumManifolds();
+  for (int i = 0; i < iNumManifolds; i++) {
+    const btPersistentManifold *pManifold = pDispatcher->getManifoldByIndexInternal(i);
+    const btCollisionObject *pA = static_cast<const btCollisionObject*>(pManifold->getBody0());
+    const btCollisionObject *pB = static_cast<const btCollisionObject*>(pManifold->getBody1());
+    if (!isOfInterest(pA) && !isOfInterest(pB)) {continue;}
+
+    // the key is ordered, so that a pair is the same for all manifolds and steps
+    const bool bSwap = pB < pA;
+    const ContactPair pair(bSwap ? pB : pA, bSwap ? pA : pB);
+    if (m_mStepContacts.find(pair) != m_mStepContacts.end()) {continue;}
+
+    if (!pA->isActive() && !pB->isActive()) {
+      // sleeping pairs do not change
+      ContactMap::const_iterator it = m_mContacts.find(pair);
+      if (it != m_mContacts.end()) {
+        m_mStepContacts.insert(*it);
+      }
+      continue;
+    }
+
+    const int iNumContacts = pManifold->getNumContacts();
+    for (int j = 0; j < iNumContacts; j++) {
+      const btManifoldPoint &pt = pManifold->getContactPoint(j);
+      if (pt.getDistance() < 0.f) {
+        Ogre::Vector3 vDirection(BtOgre::Convert::toOgre(pt.m_positionWorldOnA - pt.m_positionWorldOnB));
+        vDirection.normalise();
+        m_mStepContacts[pair] = bSwap ? -vDirection : vDirection;
+        break;
+      }
+    }
+  }
+
+  for (const ContactMap::value_type &contact : m_mStepContacts) {
+    ContactMap::const_iterator it = m_mContacts.find(contact.first);
+    if (it == m_mContacts.end()) {
+      queueEvent(CET_BEGIN, contact.first, contact.second);
+    }
+    else if (m_bReportPersist) {
+      queueEvent(CET_PERSIST, contact.first, contact.second);
+    }
+  }
+  for (const ContactMap::value_type &contact : m_mContacts) {
+    if (m_mStepContacts.find(contact.first) == m_mStepContacts.end()) {
+      queueEvent(CET_END, contact.first, contact.second);
+    }
+  }
+
+  m_mContacts.swap(m_mStepContacts);
+}
+
+void CContactTracker::queueEvent(EContactEventTypes eType, const ContactPair &pair, const Ogre::Vector3 &vDirection) {
+  SContactEvent event;
+  event.eType = eType;
+  event.pA = pair.first;
+  event.pB = pair.second;
+  event.vDirection = vDirection;
+  m_vEvents.push_back(event);
+}
+
+void CContactTracker::forget(const btCollisionObject *pCO) {
+  for (ContactMap::iterator it = m_mContacts.begin(); it != m_mContacts.end();) {
+    if (it->first.first == pCO || it->first.second == pCO) {
+      it = m_mContacts.erase(it);
+    }
+    else {
+      ++it;
+    }
+  }
+
+  // the object may be removed by a listener while dispatching
+  for (std::vector<SContactEvent> *pEvents : {&m_vEvents, &m_vDispatchedEvents}) {
+    for (SContactEvent &event : *pEvents) {
+      if (event.pA == pCO || event.pB == pCO) {
+        event.pA = event.pB = nullptr;
+      }
+    }
+  }
+}
+
+void CContactTracker::dispatch(CContactListener &listener) {
+  m_vDispatchedEvents.clear();
+  m_vDispatchedEvents.swap(m_vEvents);
+
+  // a listener may remove objects, forget() clears their events in this list
+  for (size_t i = 0; i < m_vDispatchedEvents.size(); i++) {
+    const SContactEvent event(m_vDispatchedEvents[i]);
+    if (!event.pA) {continue;}
+
+    switch (event.eType) {
+    case CET_BEGIN:
+      listener.contactBegin(event.pA, event.pB, event.vDirection);
+      break;
+    case CET_PERSIST:
+      listener.contactPersist(event.pA, event.pB, event.vDirection);
+      break;
+    case CET_END:
+      listener.contactEnd(event.pA, event.pB);
+      break;
+    }
+  }
+  m_vDispatchedEvents.clear();
+}
+
+void CContactTracker::clear() {
+  m_mContacts.clear();
+  m_vEvents.clear();
+  m_vDispatchedEvents.clear();
+}
@@ -0,0 +1,102 @@
+/*****************************************************************************
+ * Copyright 2014 Christoph Wick
+ *
+ * This file is part of Zelda.
+ *
+ * Zelda is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zelda is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Zelda. If not, see http://www.gnu.org/licenses/.
+ *****************************************************************************/
+
+#ifndef _CONTACT_TRACKER_HPP_
+#define _CONTACT_TRACKER_HPP_
+
+#include <OgreVector3.h>
+#include <map>
+#include <vector>
+#include <utility>
+
+class btCollisionObject;
+class btDispatcher;
+
+//! receives the contact events of a CContactTracker
+class CContactListener {
+public:
+  virtual ~CContactListener() {}
+
+  //! vDirection is the normalised direction from the contact point on B to the one on A
+  virtual void contactBegin(const btCollisionObject *pA, const btCollisionObject *pB, const Ogre::Vector3 &vDirection) {}
+  //! only reported if enabled in the tracker
+  virtual void contactPersist(const btCollisionObject *pA, const btCollisionObject *pB, const Ogre::Vector3 &vDirection) {}
+  virtual void contactEnd(const btCollisionObject *pA, const btCollisionObject *pB) {}
+};
+
+//! tracks the touching pairs of a physics world and reports when their contact begins and ends
+/**
+  * The pairs are collected after every simulation step, only pairs with at
+  * least one object in a collision group of the interest mask (COL_*) are
+  * tracked, and each pair is taken once per step, no matter how many
+  * manifolds or contact points it has. Pairs of two sleeping objects keep
+  * their state without being looked at.
+  *
+  * The events are queued until dispatch() is called (on the main thread),
+  * an object that is removed from the world is forgotten, no queued event
+  * refers to it afterwards.
+  */
+class CContactTracker {
+public:
+  enum EContactEventTypes {
+    CET_BEGIN,
+    CET_PERSIST,
+    CET_END,
+  };
+
+private:
+  typedef std::pair<const btCollisionObject *, const btCollisionObject *> ContactPair;
+  typedef std::map<ContactPair, Ogre::Vector3> ContactMap;
+
+  struct SContactEvent {
+    EContactEventTypes eType;
+    const btCollisionObject *pA;
+    const btCollisionObject *pB;
+    Ogre::Vector3 vDirection;
+  };
+
+  unsigned int m_uiInterestMask;
+  bool m_bReportPersist;
+
+  ContactMap m_mContacts;                         //!< pairs touching in the last step
+  ContactMap m_mStepContacts;                     //!< pairs of the current step, kept to reuse the memory
+  std::vector<SContactEvent> m_vEvents;           //!< not yet dispatched events
+  std::vector<SContactEvent> m_vDispatchedEvents; //!< events of the running dispatch
+public:
+  CContactTracker(unsigned int uiInterestMask);
+
+  void setInterestMask(unsigned int uiInterestMask) {m_uiInterestMask = uiInterestMask;}
+  unsigned int getInterestMask() const {return m_uiInterestMask;}
+  void setReportPersist(bool bReport) {m_bReportPersist = bReport;}
+  bool isReportingPersist() const {return m_bReportPersist;}
+
+  //! compare the touching pairs of the dispatcher with the last step, call after each simulation step
+  void collect(btDispatcher *pDispatcher);
+  //! drop all contacts and queued events of an object, call before it is removed from the world
+  void forget(const btCollisionObject *pCO);
+  //! send the queued events to the listener
+  void dispatch(CContactListener &listener);
+  void clear();
+
+private:
+  bool isOfInterest(const btCollisionObject *pCO) const;
+  void queueEvent(EContactEventTypes eType, const ContactPair &pair, const Ogre::Vector3 &vDirection);
+};
+
+#endif // _CONTACT_TRACKER_HPP_
@@ -30,38 +30,140 @@
 #include <LinearMath/btDefaultMotionState.h>
 #include <BulletDynamics/Character/btCharacterControllerInterface.h>
 #include <BulletDynamics/Character/btKinematicCharacterController.h>
+// defines PHYSICS_MULTITHREADED
+#include "PhysicsTaskScheduler.hpp"
+#if PHYSICS_MULTITHREADED == 1
+#include <BulletCollision/CollisionDispatch/btCollisionDispatcherMt.h>
+#include <BulletDynamics/Dynamics/btDiscreteDynamicsWorldMt.h>
+#include <BulletDynamics/ConstraintSolver/btSequentialImpulseConstraintSolverMt.h>
+#endif
 #include "BtOgreExtras.hpp"
+#include "BtOgrePG.hpp"
+#include "CollisionShapeLibrary.hpp"
+#include "PhysicsMasks.hpp"
 #include <OgreSceneManager.h>
 #include <OgreLogManager.h>
+#include <OgreStringConverter.h>
 #include "../Message/MessageHandler.hpp"
 #include "../Message/MessageDebug.hpp"
+#include "../Util/Assert.hpp"
+#include "../Log.hpp"
+#include <algorithm>
 
 #define PHYSICS_DEBUG 1
+// pairs of the broadphase that are processed by one job of the multithreaded dispatcher
+#define PHYSICS_DISPATCH_GRAIN_SIZE 40
+// what the debug drawer shows: the objects, the contact points and the constraints
+#define PHYSICS_DEBUG_DRAW_MODE (btIDebugDraw::DBG_DrawWireframe | btIDebugDraw::DBG_DrawContactPoints | btIDebugDraw::DBG_DrawConstraints)
 
 const float CPhysicsManager::GRAVITY_FACTOR = 4.f;
 
+namespace {
+  btBroadphaseInterface *createBroadphase(EBroadphaseTypes eType, const Ogre::Vector3 &vWorldMin, const Ogre::Vector3 &vWorldMax) {
+    switch (eType) {
+    case BT_DBVT:
+      return new btDbvtBroadphase();
+    case BT_AXIS_SWEEP:
+    default:
+      return new btAxisSweep3(BtOgre::Convert::toBullet(vWorldMin), BtOgre::Convert::toBullet(vWorldMax));
+    }
+  }
+
+  // type of the collision filter arguments, short before bullet 2.83
+  typedef decltype(btBroadphaseProxy::m_collisionFilterGroup) CollisionFilter;
+
+  //! a world that forgets removed objects, so that no contact event or query result refers to a deleted object
+  //! World is btDiscreteDynamicsWorld or its multithreaded version, the arguments are passed to its constructor
+  //! Every addition and removal changes the generation (see CPhysicsManager::getGeneration)
+  template <class World>
+  class CContactTrackingWorld : public World {
+  private:
+    CContactTracker &m_ContactTracker;
+    CPhysicsQueries &m_Queries;
+    unsigned int &m_uiGeneration;
+  public:
+    template <class... Args>
+    CContactTrackingWorld(CContactTracker &contactTracker, CPhysicsQueries &queries, unsigned int &uiGeneration, Args... args)
+      : World(args...),
+        m_ContactTracker(contactTracker),
+        m_Queries(queries),
+        m_uiGeneration(uiGeneration) {
+    }
+
+    void addCollisionObject(btCollisionObject *pCO, CollisionFilter group, CollisionFilter mask) {
+      ++m_uiGeneration;
+      World::addCollisionObject(pCO, group, mask);
+    }
+    void addRigidBody(btRigidBody *pRB) {
+      ++m_uiGeneration;
+      World::addRigidBody(pRB);
+    }
+    void addRigidBody(btRigidBody *pRB, CollisionFilter group, CollisionFilter mask) {
+      ++m_uiGeneration;
+      World::addRigidBody(pRB, group, mask);
+    }
+    void removeCollisionObject(btCollisionObject *pCO) {
+      ++m_uiGeneration;
+      m_ContactTracker.forget(pCO);
+      m_Queries.forget(pCO);
+      World::removeCollisionObject(pCO);
+    }
+    void removeRigidBody(btRigidBody *pRB) {
+      ++m_uiGeneration;
+      m_ContactTracker.forget(pRB);
+      m_Queries.forget(pRB);
+      World::removeRigidBody(pRB);
+    }
+  };
+
+  void contactTrackingTickCallback(btDynamicsWorld *pWorld, btScalar timeStep) {
+    static_cast<CContactTracker*>(pWorld->getWorldUserInfo())->collect(pWorld->getDispatcher());
+  }
+}
+
 CPhysicsManager::CPhysicsManager(Ogre::SceneManager *pSceneManager)
-  : m_pSceneManager(pSceneManager),
-    m_pGhostPairCallback(NULL) {
+  :
+#if PHYSICS_MANAGER_DEBUG == 1
+    CMessageInjector(false),
+#endif // PHYSICS_MANAGER_DEBUG
+    m_pSceneManager(pSceneManager),
+    m_pSolverPool(nullptr),
+    m_pGhostPairCallback(NULL),
+    m_fFixedTimeStep(1.f / PHYSICS_FIXED_STEP_RATE),
+    m_iMaxSubSteps(PHYSICS_MAX_SUB_STEPS),
+    m_fAccumulatedTime(0),
+    m_fDroppedTime(0),
+    m_ContactTracker(MASK_CONTACT_EVENTS),
+    m_uiGeneration(0) {
 
 
 #if PHYSICS_MANAGER_DEBUG == 1
   CInputListenerManager::getSingleton().addInputListener(this);
+  subscribeMessage(MSG_DEBUG);
 #endif // PHYSICS_MANAGER_DEBUG
 
   Ogre::LogManager::getSingleton().logMessage("Creating new PhysicsManager");
     m_bDisplayDebugInfo = true;
 
-    //mBroadphase = new btDbvtBroadphase();
-btVector3 worldMin(-1000,-1000,-1000);
-btVector3 worldMax(1000,1000, 1000);
-    btAxisSweep3* sweepBP = new btAxisSweep3(worldMin,worldMax);
-  mBroadphaseInterface = sweepBP;
+  // the maps replace it by a broadphase of their size (see setBroadphase)
+  m_eBroadphaseType = BT_AXIS_SWEEP;
+  mBroadphaseInterface = createBroadphase(m_eBroadphaseType, Ogre::Vector3(-1000), Ogre::Vector3(1000));
     mCollisionConfig = new btDefaultCollisionConfiguration();
+#if PHYSICS_MULTITHREADED == 1
+  // the pairs and islands are processed by the task scheduler of bullet, in
+  // parallel if enabled in the CPhysicsTaskScheduler
+  mDispatcher = new btCollisionDispatcherMt(mCollisionConfig, PHYSICS_DISPATCH_GRAIN_SIZE);
+  m_pSolverPool = new btConstraintSolverPoolMt(btGetTaskScheduler()->getMaxNumThreads());
+  mSolver = new btSequentialImpulseConstraintSolverMt();
+  m_pPhyWorld = new CContactTrackingWorld<btDiscreteDynamicsWorldMt>(m_ContactTracker, m_Queries, m_uiGeneration, mDispatcher, mBroadphaseInterface,
+                                                                     m_pSolverPool, mSolver, mCollisionConfig);
+#else
     mDispatcher = new btCollisionDispatcher(mCollisionConfig);
     mSolver = new btSequentialImpulseConstraintSolver();
 
-    m_pPhyWorld = new btDiscreteDynamicsWorld(mDispatcher, mBroadphaseInterface, mSolver, mCollisionConfig);
+    m_pPhyWorld = new CContactTrackingWorld<btDiscreteDynamicsWorld>(m_ContactTracker, m_Queries, m_uiGeneration, mDispatcher, mBroadphaseInterface, mSolver, mCollisionConfig);
+#endif
+    m_pPhyWorld->setInternalTickCallback(&contactTrackingTickCallback, &m_ContactTracker);
     m_pPhyWorld->setGravity(btVector3(0,-GRAVITY_FACTOR,0));
     m_pPhyWorld->getDispatchInfo().m_allowedCcdPenetration = 0.0001f;
     m_pPhyWorld->getSolverInfo().m_splitImpulse = true;
@@ -72,8 +174,7 @@ btVector3 worldMax(1000,1000, 1000);
 #endif
 
 	m_pGhostPairCallback = new btGhostPairCallback();
-    //mBroadphase->getOverlappingPairCache()->setInternalGhostPairCallback(m_pGhostPairCallback);
-  sweepBP->getOverlappingPairCache()->setInternalGhostPairCallback(new btGhostPairCallback());
+  mBroadphaseInterface->getOverlappingPairCache()->setInternalGhostPairCallback(m_pGhostPairCallback);
     toggleDisplayDebugInfo();
 
   Ogre::LogManager::getSingleton().logMessage("PhysicsManager created.");
@@ -105,16 +206,15 @@ void CPhysicsManager::exit() {
 
     delete obj;
   }
+  m_ContactTracker.clear();
+  m_Queries.clear();
 
-	//destroy collision shapes
+	// release the shared collision shapes
 	for (auto &sh : m_CollisionObjects) {
-		auto triShape = dynamic_cast<btBvhTriangleMeshShape*>(sh.second.getShape());
-		if (triShape) {
-			delete triShape->getMeshInterface();
-		}
-		delete sh.second.getShape();
+		CCollisionShapeLibrary::getSingleton().release(sh.first);
 	}
 	m_CollisionObjects.clear();
+	m_mCollisionShapeUsers.clear();
 
 	if (m_pGhostPairCallback) {delete m_pGhostPairCallback; m_pGhostPairCallback = nullptr;}
 
@@ -123,6 +223,10 @@ void CPhysicsManager::exit() {
     m_pPhyWorld = nullptr;
 
     delete mSolver;
+#if PHYSICS_MULTITHREADED == 1
+    delete m_pSolverPool;
+    m_pSolverPool = nullptr;
+#endif
     delete mBroadphaseInterface;
     delete mDispatcher;
     delete mCollisionConfig;
@@ -137,7 +241,54 @@ btBroadphaseInterface *CPhysicsManager::getBroadphase()
 {
     return mBroadphaseInterface;
 }
-void CPhysicsManager::update(Ogre::Real tpf) {
+
+void CPhysicsManager::setBroadphase(EBroadphaseTypes eType, const Ogre::Vector3 &vWorldMin, const Ogre::Vector3 &vWorldMax) {
+  if (m_pPhyWorld->getNumCollisionObjects() > 0) {
+    throw Ogre::Exception(0, "The broadphase can not be changed in a physics world with collision objects", __FILE__);
+  }
+
+  btBroadphaseInterface *pOldBroadphase = mBroadphaseInterface;
+  mBroadphaseInterface = createBroadphase(eType, vWorldMin, vWorldMax);
+  mBroadphaseInterface->getOverlappingPairCache()->setInternalGhostPairCallback(m_pGhostPairCallback);
+  m_pPhyWorld->setBroadphase(mBroadphaseInterface);
+  delete pOldBroadphase;
+  m_eBroadphaseType = eType;
+
+  Ogre::LogManager::getSingleton().logMessage("Physics broadphase: " + BROADPHASE_TYPES_ID_MAP.toString(eType)
+                                              + " " + Ogre::StringConverter::toString(vWorldMin)
+                                              + " to " + Ogre::StringConverter::toString(vWorldMax));
+}
+void CPhysicsManager::update(Ogre::Real tpf, const Ogre::Camera *pCamera) {
+  stepSimulation(tpf);
+  updateDebugDraw(pCamera);
+}
+void CPhysicsManager::stepSimulation(Ogre::Real tpf) {
+  processMessages();
+  stepWorld(tpf);
+}
+void CPhysicsManager::stepSimulationDeferred(Ogre::Real tpf) {
+  // bodies that are created now are deferred as well
+  processMessages();
+  setMotionStatesDeferred(true);
+  stepWorld(tpf);
+}
+void CPhysicsManager::applyMotionStates() {
+  setMotionStatesDeferred(false);
+}
+void CPhysicsManager::setMotionStatesDeferred(bool bDeferred) {
+  btCollisionObjectArray &objects(m_pPhyWorld->getCollisionObjectArray());
+  for (int i = 0; i < objects.size(); i++) {
+    btRigidBody *pRB(btRigidBody::upcast(objects[i]));
+    BtOgre::RigidBodyState *pState(pRB ? dynamic_cast<BtOgre::RigidBodyState*>(pRB->getMotionState()) : nullptr);
+    if (!pState) {continue;}
+
+    pState->setDeferred(bDeferred);
+    if (!bDeferred) {
+      pState->applyDeferred();
+    }
+  }
+}
+void CPhysicsManager::processMessages() {
 	// handle Messages
 	while (m_Messages.size() > 0) {
 		switch (m_Messages.front()->getType()) {
@@ -159,27 +310,89 @@ void CPhysicsManager::update(Ogre::Real tpf) {
 		delete m_Messages.front();
 		m_Messages.pop_front();
 	}
-
-  float fixedsubstep = 1.f/60.f;
-  int maxNumSubsteps = 2;
-
-	 //Update Bullet world. Don't forget the debugDrawWorld() part!
-  m_pPhyWorld->stepSimulation(tpf, maxNumSubsteps);
-
-
+}
+void CPhysicsManager::stepWorld(Ogre::Real tpf) {
+  // bullet carries the remainder of the fixed steps to the next call and
+  // interpolates the motion states between the last two steps, it returns
+  // all steps that were due, including the dropped ones
+  m_fAccumulatedTime += tpf;
+  const int iSteps = m_pPhyWorld->stepSimulation(tpf, m_iMaxSubSteps, m_fFixedTimeStep);
+  m_fAccumulatedTime -= iSteps * m_fFixedTimeStep;
+  m_fAccumulatedTime = std::max<Ogre::Real>(0, std::min<Ogre::Real>(m_fAccumulatedTime, m_fFixedTimeStep));
+  if (iSteps > m_iMaxSubSteps) {
+    m_fDroppedTime += (iSteps - m_iMaxSubSteps) * m_fFixedTimeStep;
+    LOGV("Physics dropped %d steps, %f seconds in total", iSteps - m_iMaxSubSteps, m_fDroppedTime);
+  }
+}
+void CPhysicsManager::processQueries() {
+  m_Queries.execute(m_pPhyWorld);
+  m_Queries.dispatch();
+}
+void CPhysicsManager::setFixedTimeStep(Ogre::Real fFixedTimeStep) {
+  ASSERT(fFixedTimeStep > 0);
+  m_fFixedTimeStep = fFixedTimeStep;
+  m_fAccumulatedTime = 0;
+}
+void CPhysicsManager::updateDebugDraw(const Ogre::Camera *pCamera) {
 #ifdef PHYSICS_DEBUG
-    m_pPhyWorld->debugDrawWorld();
-    m_pDbgDraw->step();
+  // the lines are only generated while they are shown
+  if (!m_bDisplayDebugInfo) {return;}
+
+  m_pDbgDraw->step(pCamera, m_uiGeneration);
 #endif
 }
+void CPhysicsManager::setDisplayDebugInfo(bool bDisplay) {
+  if (m_bDisplayDebugInfo != bDisplay) {
+    toggleDisplayDebugInfo();
+  }
+}
 void CPhysicsManager::toggleDisplayDebugInfo() {
 #ifdef PHYSICS_DEBUG
     m_bDisplayDebugInfo = !m_bDisplayDebugInfo;
 
-    m_pDbgDraw->setDebugMode(m_bDisplayDebugInfo);
+    m_pDbgDraw->setDebugMode(m_bDisplayDebugInfo ? PHYSICS_DEBUG_DRAW_MODE : btIDebugDraw::DBG_NoDebug);
     // Ogre::LogManager::getSingleton().logMessage(Ogre::String("PhsicsDebug: ") + (m_bDisplayDebugInfo ? "yes" : "no"));
 #endif
 }
+bool CPhysicsManager::acquireCollisionShape(const CAtom &id) {
+	if (hasCollisionShape(id)) {
+		// the manager holds a single reference in the library
+		m_mCollisionShapeUsers[id]++;
+		return true;
+	}
+
+	const CPhysicsCollisionObject *pColObj(CCollisionShapeLibrary::getSingleton().acquire(id));
+	if (!pColObj) {return false;}
+	m_CollisionObjects[id] = *pColObj;
+	m_mCollisionShapeUsers[id] = 1;
+	return true;
+}
+void CPhysicsManager::releaseCollisionShape(const CAtom &id) {
+	auto it = m_mCollisionShapeUsers.find(id);
+	// already erased by eraseCollisionShape
+	if (it == m_mCollisionShapeUsers.end()) {return;}
+	if (--(it->second) > 0) {return;}
+
+	m_mCollisionShapeUsers.erase(it);
+	m_CollisionObjects.erase(id);
+	CCollisionShapeLibrary::getSingleton().release(id);
+}
+void CPhysicsManager::eraseCollisionShape(const btCollisionShape *pShape) {
+	for (auto it = m_CollisionObjects.begin(); it != m_CollisionObjects.end(); it++) {
+		if ((*it).second.getShape() == pShape) {
+			CCollisionShapeLibrary::getSingleton().release((*it).first);
+			m_mCollisionShapeUsers.erase((*it).first);
+			m_CollisionObjects.erase(it);
+			return;
+		}
+	}
+}
+void CPhysicsManager::addCollisionShape(const CAtom &id, const CPhysicsCollisionObject &colobj) {
+	assert(!hasCollisionShape(id));
+	CCollisionShapeLibrary::getSingleton().add(id, colobj);
+	m_CollisionObjects[id] = colobj;
+	m_mCollisionShapeUsers[id] = 1;
+}
 void CPhysicsManager::deleteLater(const btCollisionObject *pCO) {
 	for (auto pMsg : m_Messages) {
 		if (pMsg->getType() == CPhysicsMessage::PMT_DELETE && pCO == pMsg->getCollisionObject()) {
@@ -193,9 +406,9 @@ void CPhysicsManager::deleteLater(const btCollisionObject *pCO) {
 #if PHYSICS_MANAGER_DEBUG == 1
 void CPhysicsManager::sendMessageToAll(const CMessage &message) {
   if (message.getType() == MSG_DEBUG) {
-    const CMessageDebug &msg_dbg(dynamic_cast<const CMessageDebug &>(message));
+    const CMessageDebug &msg_dbg(message.getAs<CMessageDebug>());
     if (msg_dbg.getDebugType() == CMessageDebug::DM_TOGGLE_PHYSICS) {
-      toggleDisplayDebugInfo();
+      setDisplayDebugInfo(msg_dbg.isActive());
     }
   }
 }
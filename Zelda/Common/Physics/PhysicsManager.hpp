@@ -24,15 +24,27 @@
 #include <OgreException.h>
 #include "../Input/InputListener.hpp"
 #include "../Message/MessageInjector.hpp"
+#include "../Util/Atom.hpp"
+#include "BroadphaseTypes.hpp"
+#include "ContactTracker.hpp"
+#include "PhysicsQueries.hpp"
+#include <unordered_map>
 
 #define PHYSICS_MANAGER_DEBUG 1
 
+// the world is advanced in fixed steps of this rate, independent of the frame rate
+#define PHYSICS_FIXED_STEP_RATE 60
+// the maximum number of steps in one frame, the time beyond is dropped, so
+// that the game slows down instead of spending more and more time in physics
+#define PHYSICS_MAX_SUB_STEPS 5
+
 namespace BtOgre {class DebugDrawer;}
 class btDiscreteDynamicsWorld;
 class btBroadphaseInterface;
 class btDefaultCollisionConfiguration;
 class btCollisionDispatcher;
-class btSequentialImpulseConstraintSolver;
+class btConstraintSolver;
+class btConstraintSolverPoolMt;
 class btGhostPairCallback;
 class btCollisionObject;
 class btCollisionShape;
@@ -93,16 +105,28 @@ private:
 	btDiscreteDynamicsWorld *m_pPhyWorld;
   BtOgre::DebugDrawer *m_pDbgDraw;
   btBroadphaseInterface *mBroadphaseInterface;
+  EBroadphaseTypes m_eBroadphaseType;
 	btDefaultCollisionConfiguration *mCollisionConfig;
 	btCollisionDispatcher *mDispatcher;
-	btSequentialImpulseConstraintSolver *mSolver;
+	btConstraintSolver *mSolver;
+	btConstraintSolverPoolMt *m_pSolverPool;	//!< solvers of the islands, only if PHYSICS_MULTITHREADED
 	btGhostPairCallback *m_pGhostPairCallback;
 
 	Ogre::SceneManager *m_pSceneManager;
 
 	bool m_bDisplayDebugInfo;
 
-	std::map<Ogre::String, CPhysicsCollisionObject> m_CollisionObjects;
+	Ogre::Real m_fFixedTimeStep;
+	int m_iMaxSubSteps;
+	Ogre::Real m_fAccumulatedTime;		//!< time that is not simulated yet, less than a fixed step
+	Ogre::Real m_fDroppedTime;			//!< total time that was dropped because of the sub step limit
+
+	CContactTracker m_ContactTracker;	//!< collects the contacts after each internal step
+	CPhysicsQueries m_Queries;			//!< ray tests, sweeps and overlap tests of the gameplay
+	unsigned int m_uiGeneration;		//!< changes whenever a collision object is added or removed
+
+	std::unordered_map<CAtom, CPhysicsCollisionObject> m_CollisionObjects;	//!< shapes referenced in the CCollisionShapeLibrary
+	std::unordered_map<CAtom, unsigned int> m_mCollisionShapeUsers;		//!< acquisitions of the shapes, e.g. by the maps of a shared world
 
 	Ogre::list<CPhysicsMessage*>::type m_Messages;
 public:
@@ -111,40 +135,80 @@ public:
 
 	void exit();
 
-    void update(Ogre::Real tpf);
+	//! step the world and draw the debug lines of the objects in the camera (of all objects if nullptr)
+    void update(Ogre::Real tpf, const Ogre::Camera *pCamera);
+	//! step the world, the motion states move the scene nodes of the bodies, so it has to be called from the render thread
+	void stepSimulation(Ogre::Real tpf);
+	//! step the world without touching ogre, so that the worlds of several managers can be stepped concurrently
+	/**
+	  * The motion states of the bodies only store their transforms, applyMotionStates
+	  * writes them to the scene nodes afterwards. The actions of the world (the
+	  * character controllers) are called on the calling thread as well.
+	  */
+	void stepSimulationDeferred(Ogre::Real tpf);
+	//! write the transforms of stepSimulationDeferred to the scene nodes, has to be called from the render thread
+	void applyMotionStates();
+	//! the length of a simulation step, changing it also changes the speed of the characters
+	void setFixedTimeStep(Ogre::Real fFixedTimeStep);
+	Ogre::Real getFixedTimeStep() const {return m_fFixedTimeStep;}
+	void setMaxSubSteps(int iMaxSubSteps) {m_iMaxSubSteps = iMaxSubSteps;}
+	int getMaxSubSteps() const {return m_iMaxSubSteps;}
+	//! the elapsed fraction of the next step, to interpolate between the last two simulated states
+	Ogre::Real getInterpolationFactor() const {return m_fAccumulatedTime / m_fFixedTimeStep;}
+	Ogre::Real getDroppedTime() const {return m_fDroppedTime;}
+	//! draw the debug lines of the objects in the camera, nothing is done while they are hidden, has to be called from the render thread
+	void updateDebugDraw(const Ogre::Camera *pCamera);
+	//! changes whenever a collision object is added to or removed from the world
+	unsigned int getGeneration() const {return m_uiGeneration;}
 	void disableDebugInfo() {
 		m_bDisplayDebugInfo = true;
 		toggleDisplayDebugInfo();
 	}
+	void setDisplayDebugInfo(bool bDisplay);
 	void toggleDisplayDebugInfo();
 
 	inline btDiscreteDynamicsWorld *getWorld() const {return m_pPhyWorld;}
+	CContactTracker &getContactTracker() {return m_ContactTracker;}
+	CPhysicsQueries &getQueries() {return m_Queries;}
+	//! execute the submitted queries and call their callbacks, call after the simulation step on the main thread
+	void processQueries();
 	btCollisionWorld * getCollisionWorld();
     btBroadphaseInterface * getBroadphase();
+  EBroadphaseTypes getBroadphaseType() const {return m_eBroadphaseType;}
+  //! replace the broadphase, only possible as long as the world is empty
+  /**
+    * The bounds are only used by BT_AXIS_SWEEP. It clamps the AABBs outside of
+    * them to its border cells: those bodies still collide, but all of them
+    * overlap on the clamped axes, so their pairs degrade to narrowphase tests.
+    */
+  void setBroadphase(EBroadphaseTypes eType, const Ogre::Vector3 &vWorldMin, const Ogre::Vector3 &vWorldMax);
 
 	void deleteLater(const btCollisionObject *pCO);
 	void createLater(btCollisionObject *pCO) {m_Messages.push_back(new CPhysicsMessage(CPhysicsMessage::PMT_CREATE, pCO));}
 
-	// Collision shape handling
-	bool hasCollisionShape(const Ogre::String &id) const {
+	// Collision shape handling, the shapes are shared with the other physics managers (see CCollisionShapeLibrary)
+	bool hasCollisionShape(const CAtom &id) const {
 		return m_CollisionObjects.find(id) != m_CollisionObjects.end();
 	}
-	CPhysicsCollisionObject &getCollisionShape(const Ogre::String &id) {
+	//! make a shape of the library available in this manager, false if no shape with this id exists yet
+	/**
+	  * Every successful call (and addCollisionShape) has to be balanced by
+	  * releaseCollisionShape, if the shape is not used until exit().
+	  */
+	bool acquireCollisionShape(const CAtom &id);
+	//! release a shape that is not used anymore (e.g. by a map that left a shared world)
+	/**
+	  * The reference in the library is released with the last acquisition,
+	  * no rigid body of this manager may use the shape anymore.
+	  */
+	void releaseCollisionShape(const CAtom &id);
+	CPhysicsCollisionObject &getCollisionShape(const CAtom &id) {
 		assert(hasCollisionShape(id));
 		return m_CollisionObjects[id];
 	}
-	void eraseCollisionShape(const btCollisionShape *pShape) {
-        for (auto it = m_CollisionObjects.begin(); it != m_CollisionObjects.end(); it++) {
-			if ((*it).second.getShape() == pShape) {
-                m_CollisionObjects.erase(it);
-                return;
-			}
-		}
-	}
-	void addCollisionShape(const Ogre::String &id, const CPhysicsCollisionObject &colobj) {
-		assert(!hasCollisionShape(id));
-		m_CollisionObjects[id] = colobj;
-	}
+	void eraseCollisionShape(const btCollisionShape *pShape);
+	//! add a new shape to the library, the shape is owned by the library
+	void addCollisionShape(const CAtom &id, const CPhysicsCollisionObject &colobj);
 	CPhysicsCollisionObject *findCollisionShape(const btCollisionShape *pShape) {
 		assert(pShape);
 		for (auto &co : m_CollisionObjects) {
@@ -152,13 +216,18 @@ public:
 		}
 		return NULL;
 	}
-	const Ogre::String &getCollisionShapeKey(const CPhysicsCollisionObject &colobj) {
+	const CAtom &getCollisionShapeKey(const CPhysicsCollisionObject &colobj) {
 		for (auto &co : m_CollisionObjects) {
 			if (co.second == colobj) {return co.first;}
 		}
 		throw Ogre::Exception(0, "Collision shape key not found", __FILE__);
 	}
 
+private:
+	void processMessages();
+	void stepWorld(Ogre::Real tpf);
+	void setMotionStatesDeferred(bool bDeferred);
+public:
 
 #if PHYSICS_MANAGER_DEBUG == 1
   void sendMessageToAll(const CMessage &message);
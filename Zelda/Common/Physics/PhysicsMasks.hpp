@@ -55,6 +55,9 @@ const unsigned int MASK_SHIELD_N_COLLIDES_WITH = COL_DAMAGE_P;
 const unsigned int MASK_CAMERA_COLLIDES_WITH = COL_STATIC;
 const unsigned int MASK_DAMAGE_P_COLLIDES_WITH = COL_CHARACTER_N | COL_SHIELD_N | COL_STATIC | COL_INTERACTIVE;
 const unsigned int MASK_DAMAGE_N_COLLIDES_WITH = COL_CHARACTER_P | COL_SHIELD_P | COL_STATIC | COL_INTERACTIVE;
+
+//! the contacts of pairs with one of these are reported (see CContactTracker), e.g. not static against camera
+const unsigned int MASK_CONTACT_EVENTS = COL_INTERACTIVE | COL_CHARACTER_P | COL_CHARACTER_N | COL_DAMAGE_P | COL_DAMAGE_N;
 //int powerupCollidesWith = COL_SHIP | COL_WALL;
 
 #endif // _PHYSICS_MASKS_HPP_
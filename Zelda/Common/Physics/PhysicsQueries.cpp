@@ -0,0 +1,215 @@
+/*****************************************************************************
+ * Copyright 2014 Christoph Wick
+ *
+ * This file is part of Zelda.
+ *
+ * Zelda is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zelda is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Zelda. If not, see http://www.gnu.org/licenses/.
+ *****************************************************************************/
+
+#include "PhysicsQueries.hpp"
+#include <btBulletCollisionCommon.h>
+#include <BulletCollision/CollisionDispatch/btCollisionObjectWrapper.h>
+#include "BtOgreExtras.hpp"
+#include "../Jobs/JobSystem.hpp"
+#include <algorithm>
+
+namespace {
+  // rays are cheap, a job has to process several of them
+  const size_t QUERIES_PER_JOB = 16;
+
+  // shared by all instances, the queries are only submitted on the main thread
+  CPhysicsQueries::QueryId NEXT_QUERY_ID = 1;
+
+  //! collects all objects touching the query object, each object once
+  class COverlapResultCallback : public btCollisionWorld::ContactResultCallback {
+  private:
+    std::vector<const btCollisionObject*> &m_vOverlapping;
+  public:
+    COverlapResultCallback(short sGroup, short sMask, std::vector<const btCollisionObject*> &vOverlapping)
+      : m_vOverlapping(vOverlapping) {
+      m_collisionFilterGroup = sGroup;
+      m_collisionFilterMask = sMask;
+    }
+
+    btScalar addSingleResult(btManifoldPoint &cp, const btCollisionObjectWrapper *colObj0Wrap, int partId0, int index0,
+                             const btCollisionObjectWrapper *colObj1Wrap, int partId1, int index1) {
+      // the query object is always the first one
+      const btCollisionObject *pCO = colObj1Wrap->getCollisionObject();
+      if (std::find(m_vOverlapping.begin(), m_vOverlapping.end(), pCO) == m_vOverlapping.end()) {
+        m_vOverlapping.push_back(pCO);
+      }
+      return 0;
+    }
+  };
+}
+
+CPhysicsQueries::CPhysicsQueries()
+  : m_bParallel(PHYSICS_QUERIES_PARALLEL == 1) {
+}
+
+CPhysicsQueries::QueryId CPhysicsQueries::ray(const void *pOwner, const Ogre::Vector3 &vFrom, const Ogre::Vector3 &vTo, short sGroup, short sMask, const Callback &fCallback) {
+  return submit(QT_RAY, pOwner, vFrom, vTo, 0, sGroup, sMask, fCallback);
+}
+
+CPhysicsQueries::QueryId CPhysicsQueries::sphereSweep(const void *pOwner, const Ogre::Vector3 &vFrom, const Ogre::Vector3 &vTo, Ogre::Real fRadius, short sGroup, short sMask, const Callback &fCallback) {
+  return submit(QT_SPHERE_SWEEP, pOwner, vFrom, vTo, fRadius, sGroup, sMask, fCallback);
+}
+
+CPhysicsQueries::QueryId CPhysicsQueries::sphereOverlap(const void *pOwner, const Ogre::Vector3 &vCenter, Ogre::Real fRadius, short sGroup, short sMask, const Callback &fCallback) {
+  return submit(QT_SPHERE_OVERLAP, pOwner, vCenter, vCenter, fRadius, sGroup, sMask, fCallback);
+}
+
+CPhysicsQueries::QueryId CPhysicsQueries::submit(EQueryTypes eType, const void *pOwner, const Ogre::Vector3 &vFrom, const Ogre::Vector3 &vTo, Ogre::Real fRadius, short sGroup, short sMask, const Callback &fCallback) {
+  SQuery query;
+  query.uiId = NEXT_QUERY_ID++;
+  query.eType = eType;
+  query.pOwner = pOwner;
+  query.vFrom = vFrom;
+  query.vTo = vTo;
+  query.fRadius = fRadius;
+  query.sGroup = sGroup;
+  query.sMask = sMask;
+  query.fCallback = fCallback;
+  m_vQueries.push_back(query);
+  return query.uiId;
+}
+
+bool CPhysicsQueries::isPending(QueryId uiId) const {
+  auto fLess = [](const SQuery &query, QueryId uiOther) {return query.uiId < uiOther;};
+  for (const std::vector<SQuery> *pvQueries : {&m_vExecutedQueries, &m_vQueries}) {
+    auto it = std::lower_bound(pvQueries->begin(), pvQueries->end(), uiId, fLess);
+    if (it != pvQueries->end() && it->uiId == uiId) {
+      // a cancelled query stays in the executed list without its callback
+      return static_cast<bool>(it->fCallback);
+    }
+  }
+  return false;
+}
+
+void CPhysicsQueries::execute(btCollisionWorld *pWorld) {
+  // results that were not dispatched yet are kept
+  const size_t uiFirst = m_vExecutedQueries.size();
+  m_vExecutedQueries.insert(m_vExecutedQueries.end(), m_vQueries.begin(), m_vQueries.end());
+  m_vQueries.clear();
+  const size_t uiCount = m_vExecutedQueries.size() - uiFirst;
+  if (uiCount == 0) {return;}
+
+  // rays and sweeps only read the world, every query writes its own result
+  auto fCast = [this, pWorld, uiFirst](size_t i) {
+    SQuery &query(m_vExecutedQueries[uiFirst + i]);
+    if (query.eType != QT_SPHERE_OVERLAP) {
+      executeCast(pWorld, query);
+    }
+  };
+  if (m_bParallel && CJobSystem::getSingletonPtr()) {
+    CJobSystem::getSingleton().parallelFor(uiCount, QUERIES_PER_JOB, fCast);
+  }
+  else {
+    for (size_t i = 0; i < uiCount; i++) {fCast(i);}
+  }
+
+  // contactTest uses the dispatcher of the world, so the overlaps run one after another
+  for (size_t i = uiFirst; i < m_vExecutedQueries.size(); i++) {
+    if (m_vExecutedQueries[i].eType == QT_SPHERE_OVERLAP) {
+      executeOverlap(pWorld, m_vExecutedQueries[i]);
+    }
+  }
+}
+
+void CPhysicsQueries::executeCast(btCollisionWorld *pWorld, SQuery &query) const {
+  const btVector3 vFrom(BtOgre::Convert::toBullet(query.vFrom));
+  const btVector3 vTo(BtOgre::Convert::toBullet(query.vTo));
+  SPhysicsQueryResult &result(query.result);
+
+  if (query.eType == QT_RAY) {
+    btCollisionWorld::ClosestRayResultCallback callback(vFrom, vTo);
+    callback.m_collisionFilterGroup = query.sGroup;
+    callback.m_collisionFilterMask = query.sMask;
+    pWorld->rayTest(vFrom, vTo, callback);
+    if (callback.hasHit()) {
+      result.bHit = true;
+      result.pCollisionObject = callback.m_collisionObject;
+      result.vHitPosition = BtOgre::Convert::toOgre(callback.m_hitPointWorld);
+      result.vHitNormal = BtOgre::Convert::toOgre(callback.m_hitNormalWorld);
+      result.fHitFraction = callback.m_closestHitFraction;
+    }
+  }
+  else {
+    btSphereShape sphere(query.fRadius);
+    btCollisionWorld::ClosestConvexResultCallback callback(vFrom, vTo);
+    callback.m_collisionFilterGroup = query.sGroup;
+    callback.m_collisionFilterMask = query.sMask;
+    pWorld->convexSweepTest(&sphere, btTransform(btQuaternion::getIdentity(), vFrom), btTransform(btQuaternion::getIdentity(), vTo), callback);
+    if (callback.hasHit()) {
+      result.bHit = true;
+      result.pCollisionObject = callback.m_hitCollisionObject;
+      result.vHitPosition = BtOgre::Convert::toOgre(callback.m_hitPointWorld);
+      result.vHitNormal = BtOgre::Convert::toOgre(callback.m_hitNormalWorld);
+      result.fHitFraction = callback.m_closestHitFraction;
+    }
+  }
+}
+
+void CPhysicsQueries::executeOverlap(btCollisionWorld *pWorld, SQuery &query) const {
+  btSphereShape sphere(query.fRadius);
+  btCollisionObject queryObject;
+  queryObject.setCollisionShape(&sphere);
+  queryObject.setWorldTransform(btTransform(btQuaternion::getIdentity(), BtOgre::Convert::toBullet(query.vFrom)));
+
+  COverlapResultCallback callback(query.sGroup, query.sMask, query.result.vOverlapping);
+  pWorld->contactTest(&queryObject, callback);
+  query.result.bHit = !query.result.vOverlapping.empty();
+}
+
+void CPhysicsQueries::dispatch() {
+  // a callback may submit or cancel queries and remove objects, the list is
+  // not resized while dispatching, cancel() and forget() only change entries
+  for (size_t i = 0; i < m_vExecutedQueries.size(); i++) {
+    SQuery &query(m_vExecutedQueries[i]);
+    // the callback may cancel its own owner, which would destroy the running function
+    Callback fCallback;
+    fCallback.swap(query.fCallback);
+    if (fCallback) {
+      fCallback(query.result);
+    }
+  }
+  m_vExecutedQueries.clear();
+}
+
+void CPhysicsQueries::cancel(const void *pOwner) {
+  m_vQueries.erase(std::remove_if(m_vQueries.begin(), m_vQueries.end(),
+                                  [pOwner](const SQuery &query) {return query.pOwner == pOwner;}),
+                   m_vQueries.end());
+  for (SQuery &query : m_vExecutedQueries) {
+    if (query.pOwner == pOwner) {
+      query.fCallback = nullptr;
+    }
+  }
+}
+
+void CPhysicsQueries::forget(const btCollisionObject *pCO) {
+  for (SQuery &query : m_vExecutedQueries) {
+    SPhysicsQueryResult &result(query.result);
+    if (result.pCollisionObject == pCO) {
+      result.pCollisionObject = nullptr;
+    }
+    // a callback may be iterating the list, so the entry is only cleared
+    std::replace(result.vOverlapping.begin(), result.vOverlapping.end(), pCO, static_cast<const btCollisionObject*>(nullptr));
+  }
+}
+
+void CPhysicsQueries::clear() {
+  m_vQueries.clear();
+  m_vExecutedQueries.clear();
+}
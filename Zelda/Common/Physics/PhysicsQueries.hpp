@@ -0,0 +1,127 @@
+/*****************************************************************************
+ * Copyright 2014 Christoph Wick
+ *
+ * This file is part of Zelda.
+ *
+ * Zelda is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zelda is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Zelda. If not, see http://www.gnu.org/licenses/.
+ *****************************************************************************/
+
+#ifndef _PHYSICS_QUERIES_HPP_
+#define _PHYSICS_QUERIES_HPP_
+
+#include <OgreVector3.h>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+class btCollisionObject;
+class btCollisionWorld;
+
+// the broadphase ray test of bullet uses a stack of the broadphase, the
+// queries can only run concurrently if bullet is built thread safe
+// (BT_THREADSAFE, set by the cmake option ZELDA_BULLET_THREADSAFE)
+#ifdef BT_THREADSAFE
+#define PHYSICS_QUERIES_PARALLEL 1
+#else
+#define PHYSICS_QUERIES_PARALLEL 0
+#endif
+
+//! result of a physics query
+struct SPhysicsQueryResult {
+  bool bHit;
+  const btCollisionObject *pCollisionObject;   //!< closest hit of a ray or sweep, null if it was removed in the meantime
+  Ogre::Vector3 vHitPosition;
+  Ogre::Vector3 vHitNormal;
+  Ogre::Real fHitFraction;                      //!< 0 at the start, 1 at the end of the ray or sweep
+  std::vector<const btCollisionObject*> vOverlapping;  //!< objects of an overlap query, null entries were removed in the meantime
+
+  SPhysicsQueryResult() : bHit(false), pCollisionObject(nullptr), fHitFraction(1) {}
+};
+
+//! ray tests, sweeps and overlap tests that are executed in one batch after the physics step
+/**
+  * The gameplay code submits its queries during the frame, they are executed
+  * together after the next simulation step, which keeps the broadphase and
+  * the shapes in the cache and allows to run the rays and sweeps on the job
+  * system. The callbacks are called on the main thread by dispatch(), so
+  * the results arrive in the next frame.
+  *
+  * Every query has an owner (normally the submitting CWorldEntity), the
+  * queries of an owner have to be cancelled before it is deleted. A query
+  * is identified by the id returned on submission, the ids are unique among
+  * all instances, so they stay valid if the owner changes the world. Objects
+  * that are removed from the world are forgotten, no result refers to them.
+  * Queries that are submitted by a callback are executed in the next batch.
+  */
+class CPhysicsQueries {
+public:
+  typedef std::function<void(const SPhysicsQueryResult &)> Callback;
+  typedef uint64_t QueryId;                //!< 0 is no query
+
+  enum EQueryTypes {
+    QT_RAY,
+    QT_SPHERE_SWEEP,
+    QT_SPHERE_OVERLAP,
+  };
+
+private:
+  struct SQuery {
+    QueryId uiId;
+    EQueryTypes eType;
+    const void *pOwner;
+    Ogre::Vector3 vFrom;
+    Ogre::Vector3 vTo;            //!< unused by overlaps
+    Ogre::Real fRadius;           //!< unused by rays
+    short sGroup;
+    short sMask;
+    Callback fCallback;
+    SPhysicsQueryResult result;
+  };
+
+  bool m_bParallel;
+  std::vector<SQuery> m_vQueries;            //!< submitted, executed by the next execute(), ordered by id
+  std::vector<SQuery> m_vExecutedQueries;    //!< executed, waiting for dispatch(), ordered by id
+public:
+  CPhysicsQueries();
+
+  void setParallel(bool bParallel) {m_bParallel = bParallel;}
+  bool isParallel() const {return m_bParallel;}
+  size_t getPendingCount() const {return m_vQueries.size() + m_vExecutedQueries.size();}
+
+  //! closest object on the line from vFrom to vTo, sGroup and sMask are COL_* and MASK_* of PhysicsMasks.hpp
+  QueryId ray(const void *pOwner, const Ogre::Vector3 &vFrom, const Ogre::Vector3 &vTo, short sGroup, short sMask, const Callback &fCallback);
+  //! closest object hit by a sphere moved from vFrom to vTo
+  QueryId sphereSweep(const void *pOwner, const Ogre::Vector3 &vFrom, const Ogre::Vector3 &vTo, Ogre::Real fRadius, short sGroup, short sMask, const Callback &fCallback);
+  //! all objects touching the sphere
+  QueryId sphereOverlap(const void *pOwner, const Ogre::Vector3 &vCenter, Ogre::Real fRadius, short sGroup, short sMask, const Callback &fCallback);
+  //! true as long as the callback of the query will be called, false once it is called or cancelled
+  bool isPending(QueryId uiId) const;
+
+  //! execute the submitted queries, call after the simulation step, while the world is not changed
+  void execute(btCollisionWorld *pWorld);
+  //! call the callbacks of the executed queries
+  void dispatch();
+  //! drop all queries of the owner, their callbacks are not called anymore
+  void cancel(const void *pOwner);
+  //! drop an object from the results, call before it is removed from the world
+  void forget(const btCollisionObject *pCO);
+  void clear();
+
+private:
+  QueryId submit(EQueryTypes eType, const void *pOwner, const Ogre::Vector3 &vFrom, const Ogre::Vector3 &vTo, Ogre::Real fRadius, short sGroup, short sMask, const Callback &fCallback);
+  void executeCast(btCollisionWorld *pWorld, SQuery &query) const;
+  void executeOverlap(btCollisionWorld *pWorld, SQuery &query) const;
+};
+
+#endif // _PHYSICS_QUERIES_HPP_
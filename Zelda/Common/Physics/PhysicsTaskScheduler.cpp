@@ -0,0 +1,122 @@
+/*****************************************************************************
+ * Copyright 2014 Christoph Wick
+ *
+ * This file is part of Zelda.
+ *
+ * Zelda is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zelda is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Zelda. If not, see http://www.gnu.org/licenses/.
+ *****************************************************************************/
+
+#include "PhysicsTaskScheduler.hpp"
+#include "../Jobs/JobSystem.hpp"
+#include "../Util/Assert.hpp"
+#include "../Log.hpp"
+#include <algorithm>
+#include <vector>
+
+template<> CPhysicsTaskScheduler *Ogre::Singleton<CPhysicsTaskScheduler>::msSingleton = 0;
+
+CPhysicsTaskScheduler *CPhysicsTaskScheduler::getSingletonPtr() {
+  return msSingleton;
+}
+CPhysicsTaskScheduler &CPhysicsTaskScheduler::getSingleton() {
+  ASSERT(msSingleton);
+  return *msSingleton;
+}
+
+CPhysicsTaskScheduler::CPhysicsTaskScheduler(bool bMultithreaded)
+  :
+#if PHYSICS_MULTITHREADED == 1
+    btITaskScheduler("JobSystem"),
+#endif
+    m_bMultithreaded(false),
+    m_iThreadCount(getMaxThreadCount()),
+    m_bLoopRunning(false) {
+#if PHYSICS_MULTITHREADED == 1
+  btSetTaskScheduler(this);
+#endif
+  setMultithreaded(bMultithreaded);
+}
+
+CPhysicsTaskScheduler::~CPhysicsTaskScheduler() {
+#if PHYSICS_MULTITHREADED == 1
+  if (btGetTaskScheduler() == this) {
+    btSetTaskScheduler(btGetSequentialTaskScheduler());
+  }
+#endif
+}
+
+void CPhysicsTaskScheduler::setMultithreaded(bool bMultithreaded) {
+  if (bMultithreaded && !isSupported()) {
+    LOGW("Multithreaded physics is not supported, bullet has to be built with BT_THREADSAFE");
+    bMultithreaded = false;
+  }
+  m_bMultithreaded = bMultithreaded;
+  LOGI("Multithreaded physics: %s, %d threads", m_bMultithreaded ? "on" : "off", m_iThreadCount);
+}
+
+void CPhysicsTaskScheduler::setThreadCount(int iThreadCount) {
+  m_iThreadCount = std::max(1, std::min(iThreadCount, getMaxThreadCount()));
+}
+
+int CPhysicsTaskScheduler::getMaxThreadCount() const {
+  if (!CJobSystem::getSingletonPtr()) {return 1;}
+  return static_cast<int>(CJobSystem::getSingleton().getWorkerCount()) + 1;
+}
+
+int CPhysicsTaskScheduler::getJobSize(int iCount, int iGrainSize) const {
+  if (!m_bMultithreaded || m_iThreadCount <= 1 || iCount <= iGrainSize || !CJobSystem::getSingletonPtr()) {
+    return 0;
+  }
+  // at most one range per thread, but not smaller than the grain size of bullet
+  return std::max(std::max(iGrainSize, 1), (iCount + m_iThreadCount - 1) / m_iThreadCount);
+}
+
+#if PHYSICS_MULTITHREADED == 1
+void CPhysicsTaskScheduler::parallelFor(int iBegin, int iEnd, int grainSize, const btIParallelForBody &body) {
+  const int iJobSize = getJobSize(iEnd - iBegin, grainSize);
+  bool bIdle = false;
+  if (iJobSize == 0 || !m_bLoopRunning.compare_exchange_strong(bIdle, true)) {
+    body.forLoop(iBegin, iEnd);
+    return;
+  }
+
+  const int iJobs = (iEnd - iBegin + iJobSize - 1) / iJobSize;
+  CJobSystem::getSingleton().parallelFor(iJobs, 1, [&body, iBegin, iEnd, iJobSize](size_t i) {
+      const int iFirst = iBegin + static_cast<int>(i) * iJobSize;
+      body.forLoop(iFirst, std::min(iFirst + iJobSize, iEnd));
+    });
+  m_bLoopRunning = false;
+}
+
+btScalar CPhysicsTaskScheduler::parallelSum(int iBegin, int iEnd, int grainSize, const btIParallelSumBody &body) {
+  const int iJobSize = getJobSize(iEnd - iBegin, grainSize);
+  bool bIdle = false;
+  if (iJobSize == 0 || !m_bLoopRunning.compare_exchange_strong(bIdle, true)) {
+    return body.sumLoop(iBegin, iEnd);
+  }
+
+  // the partial sums are added in order, so the result does not depend on the threads
+  const int iJobs = (iEnd - iBegin + iJobSize - 1) / iJobSize;
+  std::vector<btScalar> vSums(iJobs, btScalar(0));
+  CJobSystem::getSingleton().parallelFor(iJobs, 1, [&body, &vSums, iBegin, iEnd, iJobSize](size_t i) {
+      const int iFirst = iBegin + static_cast<int>(i) * iJobSize;
+      vSums[i] = body.sumLoop(iFirst, std::min(iFirst + iJobSize, iEnd));
+    });
+  m_bLoopRunning = false;
+
+  btScalar fSum(0);
+  for (btScalar fPartial : vSums) {fSum += fPartial;}
+  return fSum;
+}
+#endif
@@ -0,0 +1,91 @@
+/*****************************************************************************
+ * Copyright 2014 Christoph Wick
+ *
+ * This file is part of Zelda.
+ *
+ * Zelda is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zelda is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Zelda. If not, see http://www.gnu.org/licenses/.
+ *****************************************************************************/
+
+#ifndef _PHYSICS_TASK_SCHEDULER_HPP_
+#define _PHYSICS_TASK_SCHEDULER_HPP_
+
+#include <OgreSingleton.h>
+#include <LinearMath/btScalar.h>
+#include <atomic>
+
+// the narrowphase and the constraint solver of a step can only run on several
+// threads if bullet is built thread safe (BT_THREADSAFE, version 2.88 or newer)
+#if defined(BT_THREADSAFE) && BT_BULLET_VERSION >= 288
+#define PHYSICS_MULTITHREADED 1
+#include <LinearMath/btThreads.h>
+#else
+#define PHYSICS_MULTITHREADED 0
+#endif
+
+//! runs the parallel loops of bullet on the job system
+/**
+  * The physics managers create the multithreaded dispatcher, solver pool and
+  * world of bullet, which use the global task scheduler of bullet. Bullet
+  * sizes its per thread buffers when they are created, so the scheduler is
+  * installed before the first physics manager and stays installed. Switching
+  * the multithreading off only runs the loops on the calling thread.
+  *
+  * Only one loop runs on the job system at a time. While the atlas switches
+  * maps it steps the worlds of both maps concurrently on the job system (see
+  * CAtlas::frameStarted), the loops of the second world are then executed
+  * serially on its thread.
+  *
+  * Without support of bullet this only keeps the setting.
+  */
+class CPhysicsTaskScheduler : public Ogre::Singleton<CPhysicsTaskScheduler>
+#if PHYSICS_MULTITHREADED == 1
+  , public btITaskScheduler
+#endif
+{
+private:
+  bool m_bMultithreaded;
+  int m_iThreadCount;                 //!< threads used by a loop, the calling thread included
+  std::atomic<bool> m_bLoopRunning;
+public:
+  static CPhysicsTaskScheduler &getSingleton();
+  static CPhysicsTaskScheduler *getSingletonPtr();
+
+  static bool isSupported() {return PHYSICS_MULTITHREADED == 1;}
+
+  //! has to be created after the job system
+  CPhysicsTaskScheduler(bool bMultithreaded = true);
+  ~CPhysicsTaskScheduler();
+
+  void setMultithreaded(bool bMultithreaded);
+  bool isMultithreaded() const {return m_bMultithreaded;}
+  //! limit the threads, the number of workers of the job system plus one at most
+  void setThreadCount(int iThreadCount);
+  int getThreadCount() const {return m_iThreadCount;}
+  int getMaxThreadCount() const;
+
+#if PHYSICS_MULTITHREADED == 1
+  // btITaskScheduler, bullet sizes its buffers by the number of threads, so it is always the maximum
+  int getMaxNumThreads() const {return getMaxThreadCount();}
+  int getNumThreads() const {return getMaxThreadCount();}
+  void setNumThreads(int numThreads) {setThreadCount(numThreads);}
+  void parallelFor(int iBegin, int iEnd, int grainSize, const btIParallelForBody &body);
+  btScalar parallelSum(int iBegin, int iEnd, int grainSize, const btIParallelSumBody &body);
+#endif
+
+private:
+  //! size of the ranges of a loop, 0 if it is executed on the calling thread
+  int getJobSize(int iCount, int iGrainSize) const;
+};
+
+#endif // _PHYSICS_TASK_SCHEDULER_HPP_
@@ -0,0 +1,89 @@
+/*****************************************************************************
+ * Copyright 2014 Christoph Wick
+ *
+ * This file is part of Zelda.
+ *
+ * Zelda is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zelda is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Zelda. If not, see http://www.gnu.org/licenses/.
+ *****************************************************************************/
+
+#include "Atom.hpp"
+#include <unordered_set>
+#include <mutex>
+
+namespace {
+  struct SAtomTable {
+    std::mutex mMutex;
+    std::unordered_set<std::string> m_sStrings;
+  };
+
+  // atoms are created during static initialisation (e.g. global id maps), so
+  // the table is created on first use and intentionally never deleted
+  SAtomTable &getTable() {
+    static SAtomTable *pTable = new SAtomTable;
+    return *pTable;
+  }
+
+  const std::string *intern(const std::string &sString) {
+    SAtomTable &table(getTable());
+    std::lock_guard<std::mutex> lock(table.mMutex);
+    // the nodes of an unordered_set are not moved on rehash
+    return &*table.m_sStrings.insert(sString).first;
+  }
+
+  const std::string *getEmpty() {
+    static const std::string *pEmpty = intern(std::string());
+    return pEmpty;
+  }
+};
+
+CAtom::CAtom()
+  : m_pString(getEmpty()) {
+}
+
+CAtom::CAtom(const std::string &sString)
+  : m_pString(intern(sString)) {
+}
+
+CAtom::CAtom(const char *pString)
+  : m_pString(intern(pString)) {
+}
+
+bool CAtom::find(const std::string &sString, CAtom &atom) {
+  SAtomTable &table(getTable());
+  std::lock_guard<std::mutex> lock(table.mMutex);
+  auto it(table.m_sStrings.find(sString));
+  if (it == table.m_sStrings.end()) {
+    return false;
+  }
+  atom.m_pString = &*it;
+  return true;
+}
+
+size_t CAtom::getCount() {
+  SAtomTable &table(getTable());
+  std::lock_guard<std::mutex> lock(table.mMutex);
+  return table.m_sStrings.size();
+}
+
+size_t CAtom::getMemoryUsage() {
+  SAtomTable &table(getTable());
+  std::lock_guard<std::mutex> lock(table.mMutex);
+
+  size_t uiBytes = sizeof(SAtomTable) + table.m_sStrings.bucket_count() * sizeof(void*);
+  for (const std::string &s : table.m_sStrings) {
+    // node: next pointer, cached hash and the string itself
+    uiBytes += sizeof(void*) + sizeof(size_t) + sizeof(std::string) + s.capacity() + 1;
+  }
+  return uiBytes;
+}
@@ -0,0 +1,79 @@
+/*****************************************************************************
+ * Copyright 2014 Christoph Wick
+ *
+ * This file is part of Zelda.
+ *
+ * Zelda is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zelda is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Zelda. If not, see http://www.gnu.org/licenses/.
+ *****************************************************************************/
+
+#ifndef _ATOM_HPP_
+#define _ATOM_HPP_
+
+#include <string>
+#include <functional>
+
+//! Interned string
+/**
+  * Every distinct string is stored exactly once in a process-wide table and an
+  * atom only holds a pointer to that entry. Copying, comparing and hashing an
+  * atom is therefore a pointer operation. Constructing an atom from a string
+  * requires a lookup in the table, so atoms should be created once (e.g. while
+  * parsing) and then be kept.
+  *
+  * The table is never shrunk, atoms stay valid until the process exits. So
+  * strings that are only looked up (e.g. coming from scripts) are resolved
+  * with find(), and ids generated at runtime must not grow without bound.
+  */
+class CAtom {
+private:
+  const std::string *m_pString;
+public:
+  //! the empty atom
+  CAtom();
+  CAtom(const std::string &sString);
+  CAtom(const char *pString);
+
+  const std::string &str() const {return *m_pString;}
+  const char *c_str() const {return m_pString->c_str();}
+  bool empty() const {return m_pString->empty();}
+  operator const std::string &() const {return *m_pString;}
+
+  bool operator==(const CAtom &other) const {return m_pString == other.m_pString;}
+  bool operator!=(const CAtom &other) const {return m_pString != other.m_pString;}
+  //! order by the address of the interned string, not lexicographic
+  bool operator<(const CAtom &other) const {return m_pString < other.m_pString;}
+
+  size_t hash() const {return std::hash<const void*>()(m_pString);}
+
+  //! the atom of an already interned string, false if the string was never interned
+  /**
+    * Nothing is added to the table. An id that is not interned can not be the
+    * id of any entity or resource, so a lookup can stop here.
+    */
+  static bool find(const std::string &sString, CAtom &atom);
+
+  //! number of interned strings
+  static size_t getCount();
+  //! approximated number of bytes used by the table
+  static size_t getMemoryUsage();
+};
+
+namespace std {
+  template <>
+  struct hash<CAtom> {
+    size_t operator()(const CAtom &atom) const {return atom.hash();}
+  };
+};
+
+#endif // _ATOM_HPP_
@@ -32,7 +32,7 @@ protected:
 public:
   // for using custom data
   T parseData(const DATA &str) const {
-    for (const std::pair<T, std::string> &p : m_Map) {
+    for (const std::pair<const T, DATA> &p : m_Map) {
       if (p.second == str) {
         return p.first;
       }
@@ -44,7 +44,7 @@ public:
 
   // default for using strings
   T parseString(const DATA &str) const {
-    for (const std::pair<T, std::string> &p : m_Map) {
+    for (const std::pair<const T, DATA> &p : m_Map) {
       if (p.second == str) {
         return p.first;
       }
@@ -3,17 +3,18 @@
 
 #include <OgreSingleton.h>
 #include <mutex>
-#include <map>
+#include <unordered_map>
 #include <string>
+#include "Atom.hpp"
 
 template <typename T>
 class CGameMemoryData {
 private:
-  std::map<std::string, T> mData;
+  std::unordered_map<CAtom, T> mData;
   mutable std::mutex mDataAccessMutex;
 
 public:
-  const T &getData(const std::string &id, const T &defaultValue) {
+  const T &getData(const CAtom &id, const T &defaultValue) {
     std::lock_guard<std::mutex> lock(mDataAccessMutex);
 
     auto i = mData.find(id);
@@ -21,9 +22,9 @@ public:
       mData[id] = defaultValue;
       return defaultValue;
     }
-    return mData.at(id);
+    return i->second;
   }
-  void setData(const std::string &id, const T &value) {
+  void setData(const CAtom &id, const T &value) {
     std::lock_guard<std::mutex> lock(mDataAccessMutex);
 
     mData[id] = value;
@@ -43,11 +44,11 @@ public:
   static CGameMemory &getSingleton();
   static CGameMemory *getSingletonPtr();
 
-  int getIntData(const std::string &id, const int defaultValue = 0) {return mIntData.getData(id, defaultValue);}
-  int setIntData(const std::string &id, const int value) {mIntData.setData(id, value);}
+  int getIntData(const CAtom &id, const int defaultValue = 0) {return mIntData.getData(id, defaultValue);}
+  int setIntData(const CAtom &id, const int value) {mIntData.setData(id, value);}
 
-  Ogre::Real getRealData(const std::string &id, const Ogre::Real defaultValue = 0) {return mRealData.getData(id, defaultValue);}
-  Ogre::Real setRealData(const std::string &id, const Ogre::Real value) {mRealData.setData(id, value);}
+  Ogre::Real getRealData(const CAtom &id, const Ogre::Real defaultValue = 0) {return mRealData.getData(id, defaultValue);}
+  Ogre::Real setRealData(const CAtom &id, const Ogre::Real value) {mRealData.setData(id, value);}
 };
 
 #endif // _GAME_MEMORY_HPP_
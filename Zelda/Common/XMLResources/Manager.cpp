@@ -63,23 +63,28 @@ namespace XMLResources {
   }
 
   const std::string &CManager::getString(const CEGUI::String &id, bool searchGlobal) const {
-    if (m_lStringResources.count(id) != 1) {
+    // the id is only looked up, an unknown id is not interned
+    CAtom atom;
+    auto it(CAtom::find(id.c_str(), atom) ? m_lStringResources.find(atom) : m_lStringResources.end());
+    if (it == m_lStringResources.end()) {
       if (searchGlobal && this != &GLOBAL) {
         return GLOBAL.getString(id, false);
       }
       throw Ogre::Exception(0, ("String resource with id '" + id + "' was not found").c_str(), __FILE__);
     }
-    return m_lStringResources.at(id);
+    return it->second;
   }
 
   const CEGUI::String CManager::getCEGUIString(const CEGUI::String &id, bool searchGlobal) const {
     LOGI("%s", id.c_str());
-    if (m_lStringResources.count(id) != 1) {
+    CAtom atom;
+    auto it(CAtom::find(id.c_str(), atom) ? m_lStringResources.find(atom) : m_lStringResources.end());
+    if (it == m_lStringResources.end()) {
       if (searchGlobal && this != &GLOBAL) {
         return GLOBAL.getCEGUIString(id, false);
       }
       throw Ogre::Exception(0, ("String resource with id '" + id + "' was not found").c_str(), __FILE__);
     }
-    return reinterpret_cast<const CEGUI::utf8*>(m_lStringResources.at(id).c_str());
+    return reinterpret_cast<const CEGUI::utf8*>(it->second.c_str());
   }
 };
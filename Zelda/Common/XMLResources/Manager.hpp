@@ -20,13 +20,14 @@
 #ifndef _XMLRESOURCES_MANAGER_HPP_
 #define _XMLRESOURCES_MANAGER_HPP_
 
-#include <map>
+#include <unordered_map>
 #include "../tinyxml2/tinyxml2.h"
 #include <OgrePlatform.h>
 #include <OgreException.h>
 #include <OgreResourceGroupManager.h>
 #include <CEGUI/String.h>
 #include "../Log.hpp"
+#include "../Util/Atom.hpp"
 
 namespace XMLResources {
   class CManager {
@@ -34,7 +35,7 @@ namespace XMLResources {
     static std::string LANGUAGE_CODE;
   private:
 
-    std::map<CEGUI::String, std::string> m_lStringResources;
+    std::unordered_map<CAtom, std::string> m_lStringResources;
     const std::string m_sResourceGroup;
     const std::string m_sPrefix;
   public:
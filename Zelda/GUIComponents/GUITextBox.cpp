@@ -40,7 +40,7 @@ CGUITextBox::CGUITextBox(const std::string &id,
 
 CGUITextBox::~CGUITextBox() {
   unpause(PAUSE_ALL);
-  CMessageHandler::getSingleton().addMessage(new CMessageShowText("", mResult, CMessageShowText::FINISHED));
+  CMessageHandler::getSingleton().createMessage<CMessageShowText>("", mResult, CMessageShowText::FINISHED);
 }
 
 void CGUITextBox::update(Ogre::Real tpf) {
@@ -19,7 +19,9 @@ CTextConverter *CTextConverter::getSingletonPtr() {
 }
 
 CTextConverter::CTextConverter()
-  : mCurrentMap(nullptr) {
+  : CMessageInjector(false),
+    mCurrentMap(nullptr) {
+  subscribeMessage(MSG_SWITCH_MAP);
 }
 
 CTextConverter::~CTextConverter() {
@@ -54,7 +56,7 @@ void CTextConverter::convert(CEGUI::String &text) {
 
 void CTextConverter::sendMessageToAll(const CMessage &msg) {
   if (msg.getType() == MSG_SWITCH_MAP) {
-    const CMessageSwitchMap &msg_switch_map(dynamic_cast<const CMessageSwitchMap &>(msg));
+    const CMessageSwitchMap &msg_switch_map(msg.getAs<CMessageSwitchMap>());
     if (msg_switch_map.getStatus() == CMessageSwitchMap::FINISHED) {
       mCurrentMap = msg_switch_map.getFromMap();
     }
@@ -31,24 +31,48 @@
 #include <OgreSceneManager.h>
 #include "../../Common/Game.hpp"
 #include "../../Common/Util/Assert.hpp"
+#include "../../Common/Jobs/JobSystem.hpp"
 #include "Entrance.hpp"
+#include "MapPrefetcher.hpp"
+#include "MapPool.hpp"
+#include "MapLoader.hpp"
+#include "../../Common/Physics/PhysicsManager.hpp"
+#include <chrono>
 
-CAtlas::CAtlas(CEntity *pParent, Ogre::SceneNode *pRootSceneNode)
+const Ogre::Real CAtlas::STREAM_IN_DISTANCE(1.0f);
+const Ogre::Real CAtlas::STREAM_OUT_DISTANCE(1.6f);
+
+CAtlas::CAtlas(CEntity *pParent, Ogre::SceneNode *pRootSceneNode, bool bStreaming)
   : CWorldEntity("atlas", pParent, nullptr),
-    mFirstFrame(false),
-    mFirstFrameUpdated(false),
     m_pCurrentMap(nullptr),
     m_pNextMap(nullptr),
+    m_pMapPrefetcher(nullptr),
+    m_pMapPool(nullptr),
+    m_pMapLoader(nullptr),
     m_pPlayer(nullptr),
     m_pCameraPerspective(nullptr),
+    m_bStreaming(bStreaming),
+    m_pSharedPhysicsManager(nullptr),
+    m_vStreamingOrigin(Ogre::Vector3::ZERO),
+    m_bFrameLoadBlocking(false),
+    m_fFrameLoadingTime(0),
     m_bSwitchingMaps(false),
     m_bPlayerTargetReached(false),
     mEllipticFader(CFader::ELLIPTIC_FADER, this),
     mAlphaFader(CFader::ALPHA_FADER, this) {
+  subscribeMessage(MSG_SWITCH_MAP);
+  subscribeMessage(MSG_TARGET_REACHED);
 
   LOGV("Creating the Atlas");
   m_pSceneNode = pRootSceneNode->createChildSceneNode("Atlas");
 
+  if (m_bStreaming) {
+    LOGV(" - Creating shared physics world for streaming");
+    m_pSharedPhysicsManager = new CPhysicsManager(pRootSceneNode->getCreator());
+    // the streamed world has no bounds and its bodies are added and removed all the time
+    m_pSharedPhysicsManager->setBroadphase(BT_DBVT, Ogre::Vector3::ZERO, Ogre::Vector3::ZERO);
+  }
+
   // create the world camera
   m_pWorldCamera = pRootSceneNode->getCreator()->createCamera("WorldCamera");
   m_pWorldCamera->setNearClipDistance(0.001f);
@@ -69,24 +93,28 @@ CAtlas::CAtlas(CEntity *pParent, Ogre::SceneNode *pRootSceneNode)
   //m_pCameraPerspective = new CAerialCameraPerspective(m_pWorldCamera, (Ogre::SceneNode*)m_pAtlas->getChildren().front()->getSceneNode()->getChild(0));
   m_pCameraPerspective = new CAerialCameraPerspective(m_pWorldCamera, m_pPlayer);
 
+  m_pMapPrefetcher = new CMapPrefetcher(CFileManager::getResourcePath("maps/Atlases/LightWorld/"));
+  m_pMapPool = new CMapPool(this);
+  m_pMapLoader = new CMapLoader();
+
   LOGV(" - Creating initial map");
-  m_pCurrentMap = new CMap(this, CMapPackPtr(new CMapPack(CFileManager::getResourcePath("maps/Atlases/LightWorld/"), "inner_house_link")), m_pSceneNode, m_pPlayer);
-  mFirstFrame = true;
+  m_pCurrentMap = createMap("inner_house_link");
   //m_pCurrentMap = new CMap(this, CMapPackPtr(new CMapPack(CFileManager::getResourcePath("maps/Atlases/LightWorld/"), "link_house_left")), m_pSceneNode, m_pPlayer);
-  m_pPlayer->enterMap(m_pCurrentMap, Ogre::Vector3(0, 2, 0));
-  m_pCurrentMap->start();
-
-  CMessageHandler::getSingleton().addMessage(new CMessageSwitchMap(m_pCurrentMap->getMapPack()->getName(), CMessageSwitchMap::FINISHED, m_eSwitchMapType, m_pCurrentMap, nullptr));
-
-  mEllipticFader.startFadeIn(1);
+  loadMap(m_pCurrentMap);
 }
 CAtlas::~CAtlas() {
   delete m_pCameraPerspective;
   delete m_pPlayer;
+  // the streamed maps have to be deleted before their physics world
+  deleteStreamedMaps();
+  delete m_pMapLoader;
+  delete m_pMapPool;
+  delete m_pMapPrefetcher;
+  delete m_pSharedPhysicsManager;
 }
 
 void CAtlas::update(Ogre::Real tpf) {
-  if (mFirstFrame) {return;}
+  tpf = getWorldTimeStep(tpf);
 
   mEllipticFader.fade(tpf);
   if (mEllipticFader.isFading()) {
@@ -95,9 +123,20 @@ void CAtlas::update(Ogre::Real tpf) {
   }
   mAlphaFader.fade(tpf);
 
+  if (isWorldLoading()) {return;}
+
+  if (m_bStreaming && !m_bSwitchingMaps && !m_pCurrentMap->containsPosition(m_pPlayer->getPosition())) {
+    for (CMap *pMap : m_lStreamedMaps) {
+      if (pMap != m_pCurrentMap && pMap->isLoaded() && pMap->containsPosition(m_pPlayer->getPosition())) {
+        enterStreamedMap(pMap);
+        break;
+      }
+    }
+  }
+
   if (m_bSwitchingMaps && m_eSwitchMapType == SMT_MOVE_CAMERA) {
     if (m_pCameraPerspective->isCameraInBounds() && m_bPlayerTargetReached) {
-      m_pCurrentMap->deleteNow();
+      m_pMapPool->add(m_pCurrentMap);
       m_pCurrentMap = m_pNextMap;
       m_pNextMap = nullptr;
       m_bSwitchingMaps = false;
@@ -110,50 +149,89 @@ void CAtlas::update(Ogre::Real tpf) {
 }
 
 void CAtlas::renderDebug(Ogre::Real tpf) {
-  if (mFirstFrame) {return;}
+  if (isWorldLoading()) {return;}
+  tpf = getWorldTimeStep(tpf);
 
   m_pCameraPerspective->renderDebug(tpf);
   CWorldEntity::renderDebug(tpf);
 }
 
 void CAtlas::preRender(Ogre::Real tpf) {
-  if (mFirstFrame) {return;}
+  if (isWorldLoading()) {return;}
+  tpf = getWorldTimeStep(tpf);
 
   m_pCameraPerspective->updateCamera(tpf);
   CWorldEntity::preRender(tpf);
 }
 
 bool CAtlas::frameRenderingQueued(const Ogre::FrameEvent& evt) {
-  if (mFirstFrame) {return true;}
+  if (isWorldLoading()) {return true;}
   //if (m_bSwitchingMaps) {return true;}
-  return CWorldEntity::frameRenderingQueued(evt);
+  Ogre::FrameEvent worldEvt(evt);
+  worldEvt.timeSinceLastFrame = getWorldTimeStep(evt.timeSinceLastFrame);
+  return CWorldEntity::frameRenderingQueued(worldEvt);
 }
 
 bool CAtlas::frameStarted(const Ogre::FrameEvent& evt) {
-  if (mFirstFrame) {
-    if (mFirstFrameUpdated) {
-      mFirstFrameUpdated = false;
-      mFirstFrame = false;
+  // the time of the last frame includes the time the loader blocked it, the
+  // world must not jump by it (this replaces skipping the first frame after loading)
+  // a streamed neighbour is loaded while the world continues, its time is not subtracted
+  const Ogre::Real fLoadingTime(m_pMapLoader->takeLoadingTime());
+  m_fFrameLoadingTime = m_bFrameLoadBlocking ? fLoadingTime : 0;
+  m_bFrameLoadBlocking = false;
+  m_pMapPrefetcher->logErrors();
+
+  if (m_pMapLoader->isLoading()) {
+    m_bFrameLoadBlocking = isWorldLoading();
+    CMap *pLoadedMap(m_pMapLoader->update());
+    if (pLoadedMap == m_pCurrentMap || (pLoadedMap && pLoadedMap == m_pNextMap)) {
+      m_pMapPrefetcher->mapCreated(pLoadedMap->getMapPack(), m_pMapLoader->getLongestFrame());
+      mapLoaded();
     }
-    else {
-      mFirstFrameUpdated = true;
+    else if (m_bFrameLoadBlocking) {
+      // the world is paused until the map is loaded
       return true;
     }
   }
   //if (m_bSwitchingMaps) {return true;}
-  return CWorldEntity::frameStarted(evt);
+
+  Ogre::FrameEvent worldEvt(evt);
+  worldEvt.timeSinceLastFrame = getWorldTimeStep(evt.timeSinceLastFrame);
+  if (m_bStreaming) {
+    updateStreamedMaps();
+
+    // one physics world for all streamed maps, stepped before the maps are updated
+    if (!m_pCurrentMap->isUpdatePaused()) {
+      m_pSharedPhysicsManager->update(worldEvt.timeSinceLastFrame, m_pWorldCamera);
+      m_pCurrentMap->processCollisionCheck();
+    }
+  }
+  else if (m_pNextMap && CJobSystem::getSingletonPtr()) {
+    // while switching maps two maps with independent physics worlds are alive,
+    // the workers only store the transforms of the bodies, ogre is not touched
+    CMap *apMaps[2] = {m_pCurrentMap, m_pNextMap};
+    CJobSystem::getSingleton().parallelFor(2, 1, [&apMaps, &worldEvt](size_t i) {
+        apMaps[i]->stepPhysics(worldEvt.timeSinceLastFrame);
+      });
+    for (CMap *pMap : apMaps) {
+      pMap->applyPhysicsStep();
+    }
+  }
+  return CWorldEntity::frameStarted(worldEvt);
 }
 
 bool CAtlas::frameEnded(const Ogre::FrameEvent& evt) {
-  if (mFirstFrame) {return true;}
+  if (isWorldLoading()) {return true;}
   //if (m_bSwitchingMaps) {return true;}
-  return CWorldEntity::frameEnded(evt);
+  Ogre::FrameEvent worldEvt(evt);
+  worldEvt.timeSinceLastFrame = getWorldTimeStep(evt.timeSinceLastFrame);
+  return CWorldEntity::frameEnded(worldEvt);
 }
 
 void CAtlas::handleMessage(const CMessage &message) {
   if (message.getType() == MSG_SWITCH_MAP) {
     if (m_bSwitchingMaps) {return;}
-    const CMessageSwitchMap &switch_map_message(dynamic_cast<const CMessageSwitchMap&>(message));
+    const CMessageSwitchMap &switch_map_message(message.getAs<CMessageSwitchMap>());
     if (switch_map_message.getStatus() == CMessageSwitchMap::INJECT) {
       LOGI("Atlas: changing map to '%s'", switch_map_message.getMap().c_str());
       // get new switch type
@@ -162,46 +240,14 @@ void CAtlas::handleMessage(const CMessage &message) {
       m_sNextMapEntrance = switch_map_message.getTargetEntrance();
       m_bSwitchingMaps = true;
 
-      if (m_eSwitchMapType == SMT_MOVE_CAMERA) {
-        // player position in new map
-        Ogre::Vector3 vPlayerPos, vPlayerMoveToPos;
-
-        // create next map
-        m_pNextMap = new CMap(this, CMapPackPtr(new CMapPack(CFileManager::getResourcePath("maps/Atlases/LightWorld/"), switch_map_message.getMap())), m_pSceneNode, m_pPlayer);
-        mFirstFrame = true;
-
-        CMapPackPtr nextPack = m_pNextMap->getMapPack();
-        CMapPackPtr currPack = m_pCurrentMap->getMapPack();
-
-        Ogre::Vector3 vMapPositionOffset = currPack->getGlobalPosition() - nextPack->getGlobalPosition();
-        m_pCurrentMap->moveMap(vMapPositionOffset);
-
-
-        // determine direction
-        Ogre::Vector3 vDirection(Ogre::Vector3::ZERO);
-        if (abs(nextPack->getGlobalPosition().x + nextPack->getGlobalSize().x - currPack->getGlobalPosition().x) < 0.01) {
-          vDirection.x = -1;
-        }
-        else if (abs(nextPack->getGlobalPosition().z + nextPack->getGlobalSize().y - currPack->getGlobalPosition().z) < 0.01) {
-          vDirection.z = -1;
-        }
-        else  if (abs(currPack->getGlobalPosition().x + currPack->getGlobalSize().x - nextPack->getGlobalPosition().x) < 0.01) {
-          vDirection.x = 1;
-        }
-        else if (abs(currPack->getGlobalPosition().z + currPack->getGlobalSize().y - nextPack->getGlobalPosition().z) < 0.01) {
-          vDirection.z = 1;
-        }
-
-
-        vPlayerPos = m_pPlayer->getPosition() + vMapPositionOffset;
-        vPlayerMoveToPos = vPlayerPos + vDirection * 0.2;
-
-        // change players map
-        m_pPlayer->enterMap(m_pNextMap, vPlayerMoveToPos);
-        m_pPlayer->setPosition(vPlayerPos);
-        m_bPlayerTargetReached = false;
-
-        CMessageHandler::getSingleton().addMessage(new CMessageSwitchMap(m_pNextMap->getMapPack()->getName(), CMessageSwitchMap::SWITCHING, m_eSwitchMapType, m_pCurrentMap, m_pNextMap, m_sNextMapEntrance));
+      if (m_eSwitchMapType == SMT_MOVE_CAMERA && m_bStreaming) {
+        // the neighbours are streamed by the distance, the player just walks over the border
+        m_bSwitchingMaps = false;
+      }
+      else if (m_eSwitchMapType == SMT_MOVE_CAMERA) {
+        // create next map, the switch continues in mapLoaded
+        m_pNextMap = createMap(switch_map_message.getMap());
+        loadMap(m_pNextMap);
       }
       else if (m_eSwitchMapType == SMT_FADE_ALPHA) {
         pause(PAUSE_PLAYER_UPDATE | PAUSE_MAP_UPDATE);
@@ -215,7 +261,7 @@ void CAtlas::handleMessage(const CMessage &message) {
     }
   }
   else if (message.getType() == MSG_TARGET_REACHED) {
-    const CMessageTargetReached &message_target_reached(dynamic_cast<const CMessageTargetReached &>(message));
+    const CMessageTargetReached &message_target_reached(message.getAs<CMessageTargetReached>());
     if (message_target_reached.getEntity() == m_pPlayer) {
       if (m_bSwitchingMaps) {
         CMap *pMap;
@@ -230,7 +276,7 @@ void CAtlas::handleMessage(const CMessage &message) {
         unpause(PAUSE_ALL);
 
         pMap->start();
-        CMessageHandler::getSingleton().addMessage(new CMessageSwitchMap(m_pCurrentMap->getMapPack()->getName(), CMessageSwitchMap::FINISHED, m_eSwitchMapType, pMap, nullptr, m_sNextMapEntrance));
+        CMessageHandler::getSingleton().createMessage<CMessageSwitchMap>(m_pCurrentMap->getMapPack()->getName(), CMessageSwitchMap::FINISHED, m_eSwitchMapType, pMap, nullptr, m_sNextMapEntrance);
       }
     }
   }
@@ -254,14 +300,84 @@ void CAtlas::fadeInCallback() {
 
 void CAtlas::fadeOutCallback() {
   if (m_eSwitchMapType == SMT_FADE_ALPHA || m_eSwitchMapType == SMT_FADE_ELLIPTIC) {
-    // delete old map
-    m_pCurrentMap->deleteNow();
+    if (!m_bStreaming) {
+      // keep the old map resident
+      m_pMapPool->add(m_pCurrentMap);
+    }
+    else if (m_pMapLoader->isLoading()) {
+      // a streamed neighbour, the screen is faded out anyway
+      m_pMapLoader->finish();
+    }
+    // the streamed maps are deleted in mapLoaded, after the player left them
+
+    // create next = current map, the switch continues in mapLoaded
+    m_pCurrentMap = createMap(m_sNextMap);
+    loadMap(m_pCurrentMap);
+  }
+}
+
+void CAtlas::loadMap(CMap *pMap) {
+  if (pMap->isLoaded()) {
+    // resumed from the map pool
+    mapLoaded();
+    return;
+  }
+  m_pMapLoader->load(pMap);
+}
+
+void CAtlas::mapLoaded() {
+  if (m_bStreaming) {
+    // only the initial map and the target of a fade are loaded here, a new streamed world starts at them
+    m_vStreamingOrigin = m_pCurrentMap->getMapPack()->getGlobalPosition();
+  }
+
+  if (!m_bSwitchingMaps) {
+    // initial map
+    m_pPlayer->enterMap(m_pCurrentMap, Ogre::Vector3(0, 2, 0));
+    m_pCurrentMap->start();
+
+    CMessageHandler::getSingleton().createMessage<CMessageSwitchMap>(m_pCurrentMap->getMapPack()->getName(), CMessageSwitchMap::FINISHED, m_eSwitchMapType, m_pCurrentMap, nullptr);
+
+    mEllipticFader.startFadeIn(1);
+  }
+  else if (m_eSwitchMapType == SMT_MOVE_CAMERA) {
+    // player position in new map
+    Ogre::Vector3 vPlayerPos, vPlayerMoveToPos;
 
-    // create next = current map
-    m_pCurrentMap = new CMap(this, CMapPackPtr(new CMapPack(CFileManager::getResourcePath("maps/Atlases/LightWorld/"), m_sNextMap)), m_pSceneNode, m_pPlayer);
-    mFirstFrame = true;
+    CMapPackPtr nextPack = m_pNextMap->getMapPack();
     CMapPackPtr currPack = m_pCurrentMap->getMapPack();
 
+    Ogre::Vector3 vMapPositionOffset = currPack->getGlobalPosition() - nextPack->getGlobalPosition();
+    m_pCurrentMap->moveMap(vMapPositionOffset);
+
+
+    // determine direction
+    Ogre::Vector3 vDirection(Ogre::Vector3::ZERO);
+    if (abs(nextPack->getGlobalPosition().x + nextPack->getGlobalSize().x - currPack->getGlobalPosition().x) < 0.01) {
+      vDirection.x = -1;
+    }
+    else if (abs(nextPack->getGlobalPosition().z + nextPack->getGlobalSize().y - currPack->getGlobalPosition().z) < 0.01) {
+      vDirection.z = -1;
+    }
+    else  if (abs(currPack->getGlobalPosition().x + currPack->getGlobalSize().x - nextPack->getGlobalPosition().x) < 0.01) {
+      vDirection.x = 1;
+    }
+    else if (abs(currPack->getGlobalPosition().z + currPack->getGlobalSize().y - nextPack->getGlobalPosition().z) < 0.01) {
+      vDirection.z = 1;
+    }
+
+
+    vPlayerPos = m_pPlayer->getPosition() + vMapPositionOffset;
+    vPlayerMoveToPos = vPlayerPos + vDirection * 0.2;
+
+    // change players map
+    m_pPlayer->enterMap(m_pNextMap, vPlayerMoveToPos);
+    m_pPlayer->setPosition(vPlayerPos);
+    m_bPlayerTargetReached = false;
+
+    CMessageHandler::getSingleton().createMessage<CMessageSwitchMap>(m_pNextMap->getMapPack()->getName(), CMessageSwitchMap::SWITCHING, m_eSwitchMapType, m_pCurrentMap, m_pNextMap, m_sNextMapEntrance);
+  }
+  else {
     CEntrance *pEntrance = getNextEntrancePtr();
 
     Ogre::Vector3 vPlayerPos = pEntrance->getPlayerAbsolutePosition() + m_pPlayer->getPosition() - m_pPlayer->getFloorPosition();
@@ -271,7 +387,11 @@ void CAtlas::fadeOutCallback() {
     m_bPlayerTargetReached = false;
     unpause(PAUSE_ALL);
 
-    CMessageHandler::getSingleton().addMessage(new CMessageSwitchMap(m_pCurrentMap->getMapPack()->getName(), CMessageSwitchMap::SWITCHING, m_eSwitchMapType, m_pCurrentMap, nullptr, m_sNextMapEntrance));
+    if (m_bStreaming) {
+      deleteStreamedMaps(m_pCurrentMap);
+    }
+
+    CMessageHandler::getSingleton().createMessage<CMessageSwitchMap>(m_pCurrentMap->getMapPack()->getName(), CMessageSwitchMap::SWITCHING, m_eSwitchMapType, m_pCurrentMap, nullptr, m_sNextMapEntrance);
 
     if (m_eSwitchMapType == SMT_FADE_ELLIPTIC) {
       mEllipticFader.startFadeIn(1);
@@ -283,9 +403,105 @@ void CAtlas::fadeOutCallback() {
   }
 }
 
+CMap *CAtlas::createMap(const std::string &sMap) {
+  if (m_bStreaming) {
+    // the created map is the origin of a new streamed world
+    CMap *pMap(new CMap(this, m_pMapPrefetcher->takeMapPack(sMap), m_pSceneNode, m_pPlayer, m_pSharedPhysicsManager));
+    m_lStreamedMaps.push_back(pMap);
+    return pMap;
+  }
+
+  const auto tStart(std::chrono::steady_clock::now());
+  CMap *pResumedMap(m_pMapPool->take(sMap));
+  if (pResumedMap) {
+    m_pMapPrefetcher->setCurrentMap(sMap);
+    LOGI("Resuming map '%s' took %f ms", sMap.c_str(), std::chrono::duration<Ogre::Real>(std::chrono::steady_clock::now() - tStart).count() * 1000);
+    return pResumedMap;
+  }
+
+  // the prefetcher is notified when the map is loaded
+  return new CMap(this, m_pMapPrefetcher->takeMapPack(sMap), m_pSceneNode, m_pPlayer);
+}
+
 CEntrance *CAtlas::getNextEntrancePtr() const {
   CEntity *pEntrance(m_pCurrentMap->getChild(m_sNextMapEntrance));
   ASSERT(pEntrance);
   ASSERT(dynamic_cast<CEntrance*>(pEntrance));
   return dynamic_cast<CEntrance*>(pEntrance);
 }
+
+bool CAtlas::isWorldLoading() const {
+  const CMap *pMap(m_pMapLoader->getMap());
+  if (!pMap) {return false;}
+  if (pMap == m_pCurrentMap || pMap == m_pNextMap) {return true;}
+  // the player walked into a streamed map that is not loaded yet
+  return pMap->containsPosition(m_pPlayer->getPosition());
+}
+
+void CAtlas::updateStreamedMaps() {
+  const Ogre::Vector3 vPlayerPos(m_pPlayer->getPosition());
+
+  for (auto it = m_lStreamedMaps.begin(); it != m_lStreamedMaps.end();) {
+    CMap *pMap(*it);
+    if (pMap != m_pCurrentMap && pMap != m_pMapLoader->getMap() && pMap->getDistance(vPlayerPos) > STREAM_OUT_DISTANCE) {
+      LOGI("Atlas: streaming out map '%s'", pMap->getMapPack()->getName().c_str());
+      it = m_lStreamedMaps.erase(it);
+      pMap->deleteNow();
+    }
+    else {
+      ++it;
+    }
+  }
+
+  if (m_pMapLoader->isLoading() || m_bSwitchingMaps) {return;}
+
+  // the neighbours of the current map are prefetched, load the closest one
+  CMapPackPtr closestPack;
+  Ogre::Real fClosestDistance(STREAM_IN_DISTANCE);
+  for (const CMapPackPtr &pack : m_pMapPrefetcher->getReadyMapPacks()) {
+    const bool bStreamed(std::any_of(m_lStreamedMaps.begin(), m_lStreamedMaps.end(),
+        [&pack](const CMap *pMap) {return pMap->getMapPack()->getName() == pack->getName();}));
+    if (bStreamed) {continue;}
+
+    const Ogre::Real fDistance(CMap::getDistance(vPlayerPos, pack->getGlobalPosition() - m_vStreamingOrigin, pack->getGlobalSize()));
+    if (fDistance <= fClosestDistance) {
+      fClosestDistance = fDistance;
+      closestPack = pack;
+    }
+  }
+  if (!closestPack) {return;}
+
+  LOGI("Atlas: streaming in map '%s'", closestPack->getName().c_str());
+  CMap *pMap(new CMap(this, m_pMapPrefetcher->takeMapPack(closestPack->getName()), m_pSceneNode, m_pPlayer,
+                      m_pSharedPhysicsManager, closestPack->getGlobalPosition() - m_vStreamingOrigin));
+  m_lStreamedMaps.push_back(pMap);
+  m_pMapLoader->load(pMap);
+}
+
+void CAtlas::enterStreamedMap(CMap *pMap) {
+  LOGI("Atlas: entering streamed map '%s'", pMap->getMapPack()->getName().c_str());
+  m_pPlayer->crossMapBorder(pMap);
+  m_pCurrentMap = pMap;
+  m_pCurrentMap->start();
+
+  // prefetch the neighbours of the new map, the ones of the old map are still streamed
+  m_pMapPrefetcher->setCurrentMap(pMap->getMapPack()->getName());
+
+  // the camera is not moved, only its bounds change
+  CMessageHandler::getSingleton().createMessage<CMessageSwitchMap>(pMap->getMapPack()->getName(), CMessageSwitchMap::FINISHED, SMT_MOVE_CAMERA, pMap, nullptr);
+}
+
+void CAtlas::deleteStreamedMaps(CMap *pKeep) {
+  for (CMap *pMap : m_lStreamedMaps) {
+    if (pMap == pKeep) {continue;}
+    if (pMap == m_pMapLoader->getMap()) {
+      // a partially loaded map can not be deleted
+      m_pMapLoader->finish();
+    }
+    pMap->deleteNow();
+  }
+  m_lStreamedMaps.clear();
+  if (pKeep) {
+    m_lStreamedMaps.push_back(pKeep);
+  }
+}
@@ -25,8 +25,27 @@
 #include "../../Common/PauseManager/PauseCaller.hpp"
 #include "../../Common/Fader/Fader.hpp"
 #include "../../Common/Message/MessageSwitchMap.hpp"
+#include <algorithm>
+#include <list>
+
+//! stream the maps of an atlas into one world by the distance to the player
+/**
+  * If enabled, the current map and its loaded neighbours share one physics
+  * world in which each map is placed at its global position (relative to the
+  * map the world was entered with). Walking over a border does not switch the
+  * map anymore, the player just continues in the neighbour. The maps far away
+  * from the player are deleted. Fading map switches (e.g. into houses) leave
+  * the streamed world and start a new one.
+  */
+#ifndef ATLAS_STREAMING
+#define ATLAS_STREAMING 0
+#endif
 
 class CMap;
+class CPhysicsManager;
+class CMapPrefetcher;
+class CMapPool;
+class CMapLoader;
 class CAerialCameraPerspective;
 class CEntrance;
 
@@ -37,12 +56,20 @@ class CAtlas : public CWorldEntity,
 private:
   CMap *m_pCurrentMap;
   CMap *m_pNextMap;
+  CMapPrefetcher *m_pMapPrefetcher;
+  CMapPool *m_pMapPool;
+  CMapLoader *m_pMapLoader;
   CWorldEntity *m_pPlayer;
   Ogre::Camera *m_pWorldCamera;
   CAerialCameraPerspective *m_pCameraPerspective;
 
-  bool mFirstFrame;                                             //!< First frame after loading is not updated, since delta t can be enormous
-  bool mFirstFrameUpdated;
+  const bool m_bStreaming;
+  CPhysicsManager *m_pSharedPhysicsManager;   //!< physics world of all streamed maps, nullptr if not streaming
+  std::list<CMap*> m_lStreamedMaps;           //!< loaded and loading maps of the streamed world, including the current map
+  Ogre::Vector3 m_vStreamingOrigin;           //!< global position of the map at the origin of the streamed world
+  bool m_bFrameLoadBlocking;                  //!< did the map loader block the world in the last frame
+
+  Ogre::Real m_fFrameLoadingTime;     //!< Time the map loader blocked the last frame, it is not passed to the world
   bool m_bSwitchingMaps;              //!< Is the map currently switch from current to next map
   ESwitchMapTypes m_eSwitchMapType;   //!< Type of the map switch
   std::string m_sNextMap;             //!< Next map after fading
@@ -52,10 +79,21 @@ private:
   CFader mEllipticFader;
   CFader mAlphaFader;
 public:
-  CAtlas(CEntity *pParent, Ogre::SceneNode *pRootSceneNode);
+  //! distance of the player to a neighbour map below which it is streamed in
+  static const Ogre::Real STREAM_IN_DISTANCE;
+  //! distance of the player to a streamed map above which it is deleted, larger to avoid reloading at a border
+  static const Ogre::Real STREAM_OUT_DISTANCE;
+
+  CAtlas(CEntity *pParent, Ogre::SceneNode *pRootSceneNode, bool bStreaming = ATLAS_STREAMING);
   ~CAtlas();
 
   CMap *getCurrentMap() const {return m_pCurrentMap;}
+  const CMapPrefetcher &getMapPrefetcher() const {return *m_pMapPrefetcher;}
+  CMapPool &getMapPool() {return *m_pMapPool;}
+  const CMapLoader &getMapLoader() const {return *m_pMapLoader;}
+  bool isStreaming() const {return m_bStreaming;}
+  const std::list<CMap*> &getStreamedMaps() const {return m_lStreamedMaps;}
+  const Ogre::Camera *getWorldCamera() const {return m_pWorldCamera;}
 
   void update(Ogre::Real tpf);
   void renderDebug(Ogre::Real tpf);
@@ -72,7 +110,24 @@ protected:
   virtual void fadeOutCallback();
 
 private:
+  //! resume the map from the map pool or create it from its (prefetched) pack, a created map still has to be loaded
+  CMap *createMap(const std::string &sMap);
+  //! load the map in the following frames, mapLoaded is called when it is done
+  void loadMap(CMap *pMap);
+  //! continue the map switch (or the start of the game) with the loaded map
+  void mapLoaded();
+  //! time step without the time the map loader blocked the last frame
+  Ogre::Real getWorldTimeStep(Ogre::Real tpf) const {return std::max<Ogre::Real>(0, tpf - m_fFrameLoadingTime);}
   CEntrance *getNextEntrancePtr() const;
+
+  //! the world waits for the loader only for the current and the next map, or a streamed map the player already is in
+  bool isWorldLoading() const;
+  //! start loading the closest prefetched neighbour and delete the maps far away from the player
+  void updateStreamedMaps();
+  //! continue in the streamed map the player walked into
+  void enterStreamedMap(CMap *pMap);
+  //! delete all streamed maps except pKeep
+  void deleteStreamedMaps(CMap *pKeep = nullptr);
 };
 
 #endif // _ATLAS_HPP_
@@ -25,7 +25,11 @@
 #include <OgreEntity.h>
 #include <OgreLogManager.h>
 #include <OgreAnimationState.h>
+#include <OgreStringConverter.h>
 #include <OgreMeshManager.h>
+#include <OgreSkeletonManager.h>
+#include <OgreTextureManager.h>
+#include <OgreMaterialManager.h>
 #include "Region.hpp"
 #include "Entrance.hpp"
 #include "../GlobalCollisionShapesTypes.hpp"
@@ -41,49 +45,48 @@
 #include "../../Common/DotSceneLoader/UserData.hpp"
 #include "../../Common/Util/XMLHelper.hpp"
 #include "../../Common/GameLogic/Events/Event.hpp"
+#include "../../Common/GameLogic/EntityRegistry.hpp"
+#include "../../Common/PauseManager/PauseManager.hpp"
+#include "../../Common/Util/Atom.hpp"
+#include "../../Common/Lua/LuaScheduler.hpp"
 
 #include "../Character/CharacterCreator.hpp"
+#include "Atlas.hpp"
+#include <cmath>
+#include <algorithm>
 
 
 using namespace XMLHelper;
 
 int MAP_COUNTER = 0; // Counter to make names unique if objects are switched between maps since renaming a scene node is not possible
 
-CMap::CMap(CEntity *pAtlas, CMapPackPtr mapPack, Ogre::SceneNode *pParentSceneNode, CWorldEntity *pPlayer)
+const Ogre::Real TILE_REGION_SIZE = 10;  // equals the region dimensions of the static geometries
+const Ogre::Real BROADPHASE_EXTENT_FACTOR = 1.5;  // map size to the half extent of the broadphase, see createBroadphase
+const Ogre::Real BROADPHASE_MARGIN = 5;           // for objects that leave the map or fall down
+
+CMap::CMap(CEntity *pAtlas, CMapPackPtr mapPack, Ogre::SceneNode *pParentSceneNode, CWorldEntity *pPlayer,
+           CPhysicsManager *pSharedPhysicsManager, const Ogre::Vector3 &vWorldOffset)
   : CWorldEntity(mapPack->getName(), pAtlas, this, mapPack->getResourceGroup()),
-    m_PhysicsManager(pParentSceneNode->getCreator()),
+    m_eLoadingStage(MLS_MOUNT),
+    m_pOwnPhysicsManager(pSharedPhysicsManager ? nullptr : new CPhysicsManager(pParentSceneNode->getCreator())),
+    m_pPhysicsManager(pSharedPhysicsManager ? pSharedPhysicsManager : m_pOwnPhysicsManager.get()),
+    m_vWorldOffset(vWorldOffset),
     m_MapPack(mapPack),
     m_pPlayer(pPlayer),
     m_pFirstFlowerEntity(nullptr),
-    m_pFlowerAnimationState(nullptr) {
+    m_pFlowerAnimationState(nullptr),
+    m_bPhysicsStepped(false),
+    m_bStarted(false),
+    m_bSuspended(false),
+    m_vMapOffset(Ogre::Vector3::ZERO) {
+  subscribeMessage(MSG_ENTITY_STATE_CHANGED);
+  // a map has lots of children, most of them do nothing in most phases
+  enableChildUpdateLayout();
+  // a map is not updated before it is loaded
+  m_bPauseUpdate = true;
 
   Ogre::LogManager::getSingleton().logMessage("Construction of map '" + m_MapPack->getName() + "'");
 
-  // Create global collision shapes
-  m_PhysicsManager.addCollisionShape(GLOBAL_COLLISION_SHAPES_TYPES_ID_MAP.toString(GCST_PICKABLE_OBJECT_SPHERE),
-                                     CPhysicsCollisionObject(new btSphereShape(0.04), Ogre::Vector3::NEGATIVE_UNIT_Y * 0.03));
-  m_PhysicsManager.addCollisionShape(GLOBAL_COLLISION_SHAPES_TYPES_ID_MAP.toString(GCST_PERSON_CAPSULE),
-                                     CPhysicsCollisionObject(new btCapsuleShape(CPerson::PERSON_RADIUS, CPerson::PERSON_HEIGHT - 2 * CPerson::PERSON_RADIUS)));
-  btCompoundShape *pHouseEntranceShape = new btCompoundShape();
-  pHouseEntranceShape->addChildShape(btTransform(btQuaternion::getIdentity(), btVector3(-0.069, 0.08, 0.02)), new btBoxShape(btVector3(0.01, 0.08, 0.02)));
-  pHouseEntranceShape->addChildShape(btTransform(btQuaternion::getIdentity(), btVector3(0.069, 0.08, 0.02)), new btBoxShape(btVector3(0.01, 0.08, 0.02)));
-  pHouseEntranceShape->addChildShape(btTransform(btQuaternion::getIdentity(), btVector3(0.0, 0.16, 0.02)), new btBoxShape(btVector3(0.07, 0.01, 0.02)));
-  m_PhysicsManager.addCollisionShape(GLOBAL_COLLISION_SHAPES_TYPES_ID_MAP.toString(GCST_HOUSE_ENTRANCE), CPhysicsCollisionObject(pHouseEntranceShape, Ogre::Vector3::ZERO));
-
-  btCompoundShape *pStonePileShape = new btCompoundShape();
-  pStonePileShape->addChildShape(btTransform(btQuaternion::getIdentity(), btVector3(0.05, 0.025, 0.05)), new btSphereShape(0.04));
-  pStonePileShape->addChildShape(btTransform(btQuaternion::getIdentity(), btVector3(-0.05, 0.025, 0.05)), new btSphereShape(0.04));
-  pStonePileShape->addChildShape(btTransform(btQuaternion::getIdentity(), btVector3(0.05, 0.025, -0.05)), new btSphereShape(0.04));
-  pStonePileShape->addChildShape(btTransform(btQuaternion::getIdentity(), btVector3(-0.05, 0.025, -0.05)), new btSphereShape(0.04));
-  pStonePileShape->addChildShape(btTransform(btQuaternion::getIdentity(), btVector3(-0.0, 0.06, -0.0)), new btSphereShape(0.04));
-  m_PhysicsManager.addCollisionShape(GLOBAL_COLLISION_SHAPES_TYPES_ID_MAP.toString(GCST_STONE_PILE), CPhysicsCollisionObject(pStonePileShape, Ogre::Vector3::ZERO));
-
-  m_PhysicsManager.addCollisionShape(GLOBAL_COLLISION_SHAPES_TYPES_ID_MAP.toString(GCST_TREE),
-                                     CPhysicsCollisionObject(new btCylinderShape(btVector3(0.173, 0.2, 0.173)), Ogre::Vector3::NEGATIVE_UNIT_Y * 0.2));
-  m_PhysicsManager.addCollisionShape(GLOBAL_COLLISION_SHAPES_TYPES_ID_MAP.toString(GCST_FALLING_OBJECT_SPHERE),
-                                     CPhysicsCollisionObject(new btSphereShape(0.02), Ogre::Vector3::NEGATIVE_UNIT_Y * 0));
-
-
   // Create global entites
   for (int i = 0; i < TT_COUNT; i++) {
     m_apTileEntities[i] = pParentSceneNode->getCreator()->createEntity(TILE_TYPE_ID_MAP.toData(static_cast<ETileTypes>(i)).sMeshName);
@@ -94,29 +97,142 @@ CMap::CMap(CEntity *pAtlas, CMapPackPtr mapPack, Ogre::SceneNode *pParentSceneNo
   m_pStaticGeometry = pParentSceneNode->getCreator()->createStaticGeometry(m_MapPack->getName() + "_StaticGeometry");
   m_pStaticGeometry->setRegionDimensions(Ogre::Vector3(10, 10, 10));
   m_pStaticGeometry->setCastShadows(false);
+}
+
+CMap::~CMap() {
+}
+
+const char *CMap::getLoadingStageName(ELoadingStages eStage) {
+  switch (eStage) {
+  case MLS_MOUNT: return "mount";
+  case MLS_PARSE_PACK: return "parse pack";
+  case MLS_BUILD_PHYSICS: return "build physics";
+  case MLS_PARSE_SCENE: return "parse scene";
+  case MLS_SPAWN_ENTITIES: return "spawn entities";
+  case MLS_BUILD_STATIC_GEOMETRY: return "build static geometry";
+  case MLS_INIT_EVENTS: return "init events";
+  case MLS_LOADED: return "loaded";
+  }
+  return "unknown";
+}
+
+void CMap::loadNextStage() {
+  switch (m_eLoadingStage) {
+  case MLS_MOUNT:
+    m_MapPack->init(this);
+    break;
+  case MLS_PARSE_PACK:
+    m_MapPack->readXMLFile();
+    break;
+  case MLS_BUILD_PHYSICS:
+    if (!hasSharedPhysics()) {createBroadphase();}
+    createGlobalCollisionShapes();
+    break;
+  case MLS_PARSE_SCENE:
+    parseScene();
+    break;
+  case MLS_SPAWN_ENTITIES:
+    m_MapPack->parse();
+    break;
+  case MLS_BUILD_STATIC_GEOMETRY:
+    buildStaticGeometry();
+    break;
+  case MLS_INIT_EVENTS:
+    init();
+
+    // take over the pauses that were requested while loading
+    applyPause(PAUSE_MAP_UPDATE, CPauseManager::getSingleton().isPause(PAUSE_MAP_UPDATE));
+    if (CPauseManager::getSingleton().isPause(PAUSE_MAP_RENDER)) {
+      applyPause(PAUSE_MAP_RENDER, true);
+    }
+
+    // memory footprint of the ids, the registry and the atoms are shared by all
+    // maps, so these are process wide totals
+    Ogre::LogManager::getSingleton().logMessage("Map '" + m_MapPack->getName() + "' loaded, process wide totals: "
+        + Ogre::StringConverter::toString(CEntityRegistry::getSingleton().getEntityCount()) + " entities, "
+        + Ogre::StringConverter::toString(CAtom::getCount()) + " interned ids using "
+        + Ogre::StringConverter::toString(CAtom::getMemoryUsage()) + " bytes");
+    m_MapPack->logLoadedResources();
+    break;
+  case MLS_LOADED:
+    return;
+  }
 
-  m_pStaticGeometryChangedTiles = pParentSceneNode->getCreator()->createStaticGeometry(m_MapPack->getName() + "_StaticGeometryChangedTiles");
-  m_pStaticGeometryChangedTiles->setRegionDimensions(Ogre::Vector3(10, 10, 10));
-  m_pStaticGeometryChangedTiles->setCastShadows(false);
+  m_eLoadingStage = static_cast<ELoadingStages>(m_eLoadingStage + 1);
+}
 
-  m_pStaticGeometryFixedTiles = pParentSceneNode->getCreator()->createStaticGeometry(m_MapPack->getName() + "_StaticGeometryFixedTiles");
-  m_pStaticGeometryFixedTiles->setRegionDimensions(Ogre::Vector3(10, 10, 10));
-  m_pStaticGeometryFixedTiles->setCastShadows(false);
+//! create a new shape of a global collision shape type, it is added to the CCollisionShapeLibrary
+static CPhysicsCollisionObject createGlobalCollisionShape(EGlobalCollisionShapesTypes eType) {
+  switch (eType) {
+  case GCST_PICKABLE_OBJECT_SPHERE:
+    return CPhysicsCollisionObject(new btSphereShape(0.04), Ogre::Vector3::NEGATIVE_UNIT_Y * 0.03);
+  case GCST_PERSON_CAPSULE:
+    return CPhysicsCollisionObject(new btCapsuleShape(CPerson::PERSON_RADIUS, CPerson::PERSON_HEIGHT - 2 * CPerson::PERSON_RADIUS));
+  case GCST_HOUSE_ENTRANCE:
+    {
+      btCompoundShape *pHouseEntranceShape = new btCompoundShape();
+      pHouseEntranceShape->addChildShape(btTransform(btQuaternion::getIdentity(), btVector3(-0.069, 0.08, 0.02)), new btBoxShape(btVector3(0.01, 0.08, 0.02)));
+      pHouseEntranceShape->addChildShape(btTransform(btQuaternion::getIdentity(), btVector3(0.069, 0.08, 0.02)), new btBoxShape(btVector3(0.01, 0.08, 0.02)));
+      pHouseEntranceShape->addChildShape(btTransform(btQuaternion::getIdentity(), btVector3(0.0, 0.16, 0.02)), new btBoxShape(btVector3(0.07, 0.01, 0.02)));
+      return CPhysicsCollisionObject(pHouseEntranceShape, Ogre::Vector3::ZERO);
+    }
+  case GCST_STONE_PILE:
+    {
+      btCompoundShape *pStonePileShape = new btCompoundShape();
+      pStonePileShape->addChildShape(btTransform(btQuaternion::getIdentity(), btVector3(0.05, 0.025, 0.05)), new btSphereShape(0.04));
+      pStonePileShape->addChildShape(btTransform(btQuaternion::getIdentity(), btVector3(-0.05, 0.025, 0.05)), new btSphereShape(0.04));
+      pStonePileShape->addChildShape(btTransform(btQuaternion::getIdentity(), btVector3(0.05, 0.025, -0.05)), new btSphereShape(0.04));
+      pStonePileShape->addChildShape(btTransform(btQuaternion::getIdentity(), btVector3(-0.05, 0.025, -0.05)), new btSphereShape(0.04));
+      pStonePileShape->addChildShape(btTransform(btQuaternion::getIdentity(), btVector3(-0.0, 0.06, -0.0)), new btSphereShape(0.04));
+      return CPhysicsCollisionObject(pStonePileShape, Ogre::Vector3::ZERO);
+    }
+  case GCST_TREE:
+    return CPhysicsCollisionObject(new btCylinderShape(btVector3(0.173, 0.2, 0.173)), Ogre::Vector3::NEGATIVE_UNIT_Y * 0.2);
+  case GCST_FALLING_OBJECT_SPHERE:
+    return CPhysicsCollisionObject(new btSphereShape(0.02), Ogre::Vector3::NEGATIVE_UNIT_Y * 0);
+  case GCST_COUNT:
+    break;
+  }
+  throw Ogre::Exception(0, "Unknown global collision shape type", __FILE__);
+}
 
-  m_MapPack->init(this);
+void CMap::createBroadphase() {
+  // the local frame of a map is centered, but the map is moved next to its
+  // neighbour while switching maps (SMT_MOVE_CAMERA), so the bounds have to
+  // cover one and a half map in each direction
+  const Ogre::Vector2 &vSize(m_MapPack->getGlobalSize());
+  const Ogre::Vector3 vHalfExtent(vSize.x * BROADPHASE_EXTENT_FACTOR + BROADPHASE_MARGIN,
+                                  std::max(vSize.x, vSize.y) * BROADPHASE_EXTENT_FACTOR + BROADPHASE_MARGIN,
+                                  vSize.y * BROADPHASE_EXTENT_FACTOR + BROADPHASE_MARGIN);
+  m_pPhysicsManager->setBroadphase(m_MapPack->getBroadphaseType(), -vHalfExtent, vHalfExtent);
+}
 
+void CMap::createGlobalCollisionShapes() {
+  // the shapes are constant, only the first loaded map creates them. A shared
+  // physics manager keeps them until its exit, they are not released with a map
+  for (int i = 0; i < GCST_COUNT; i++) {
+    const EGlobalCollisionShapesTypes eType(static_cast<EGlobalCollisionShapesTypes>(i));
+    const CAtom &id(GLOBAL_COLLISION_SHAPES_TYPES_ID_MAP.toString(eType));
+    if (m_pPhysicsManager->hasCollisionShape(id)) {continue;}
+    if (!m_pPhysicsManager->acquireCollisionShape(id)) {
+      m_pPhysicsManager->addCollisionShape(id, createGlobalCollisionShape(eType));
+    }
+  }
+}
 
+void CMap::parseScene() {
   m_SceneLoader.addCallback(this);
+  m_SceneLoader.setWorldOffset(m_vWorldOffset);
   m_SceneLoader.parseDotScene(m_MapPack->getSceneFile(),
                               m_MapPack->getResourceGroup(),
                               m_pSceneNode->getCreator(),
-                              &m_PhysicsManager,
+                              m_pPhysicsManager,
                               m_pSceneNode,
-                              m_MapPack->getName() + Ogre::StringConverter::toString(MAP_COUNTER++));
-
-  m_MapPack->parse();
-
+                              m_MapPack->getName() + Ogre::StringConverter::toString(MAP_COUNTER++),
+                              m_MapPack->getSceneData());
+}
 
+void CMap::buildStaticGeometry() {
   //CreateCube(btVector3(0, 10, 0.2), 1);
   //CreateCube(btVector3(0, 200, 0.3), 100);
 
@@ -125,7 +241,7 @@ CMap::CMap(CEntity *pAtlas, CMapPackPtr mapPack, Ogre::SceneNode *pParentSceneNo
   /*btCollisionShape *pBox = new btBoxShape(btVector3(10, 0.1, 10));
   btRigidBody *pRB = new btRigidBody(0, new btDefaultMotionState(), pBox);
   m_pCollisionObject = pRB;
-  m_PhysicsManager.getWorld()->addRigidBody(pRB);
+  m_pPhysicsManager->getWorld()->addRigidBody(pRB);
 
   if (mapPack->getName() == "link_house") {
     Ogre::Entity *pEnt = m_pSceneNode->getCreator()->createEntity("link_house.mesh");
@@ -136,7 +252,8 @@ CMap::CMap(CEntity *pAtlas, CMapPackPtr mapPack, Ogre::SceneNode *pParentSceneNo
   }*/
 
   m_pStaticGeometry->build();
-  rebuildStaticGeometryChangedTiles();
+  markAllTileRegionsDirty();
+  rebuildDirtyTileRegions();
 
   m_pWaterSideWaveMaterial = Ogre::MaterialManager::getSingleton().getByName("water_side_wave");
   m_pWaterSideWaveMaterial->touch();
@@ -147,14 +264,13 @@ CMap::CMap(CEntity *pAtlas, CMapPackPtr mapPack, Ogre::SceneNode *pParentSceneNo
     m_pSceneNode->getCreator()->destroyEntity(entpair.second);
   }
   m_mStaticEntitiesMap.clear();
-
-  init();
-}
-
-CMap::~CMap() {
 }
 
 void CMap::start() {
+  // a map resumed from the map pool was already started
+  if (m_bStarted) {return;}
+  m_bStarted = true;
+
   CEntity::start();
   sendCallToAll(&CEntity::start, false);
 }
@@ -168,13 +284,37 @@ void CMap::exit() {
     m_pSceneNode->getCreator()->destroyEntity(m_apTileEntities[i]);
   }
   m_pSceneNode->getCreator()->destroyStaticGeometry(m_pStaticGeometry);
-  m_pSceneNode->getCreator()->destroyStaticGeometry(m_pStaticGeometryChangedTiles);
-  m_pSceneNode->getCreator()->destroyStaticGeometry(m_pStaticGeometryFixedTiles);
+  for (auto &region : m_mTileRegions) {
+    m_pSceneNode->getCreator()->destroyStaticGeometry(region.second.pChangedTiles);
+    m_pSceneNode->getCreator()->destroyStaticGeometry(region.second.pFixedTiles);
+  }
+  m_mTileRegions.clear();
+  m_sDirtyTileRegions.clear();
   m_pStaticGeometry = nullptr;
 
+  if (hasSharedPhysics()) {
+    destroySceneInSharedPhysics();
+  }
+
+  if (m_bSuspended) {
+    // the paused scripts must not continue, a new map of the pack starts them again
+    CLuaScheduler::getSingleton().stop(m_MapPack->getResourceGroup());
+  }
+
   CWorldEntity::exit();
 }
 
+void CMap::destroySceneInSharedPhysics() {
+  for (btRigidBody *pRB : m_vSceneRigidBodies) {
+    m_pPhysicsManager->getWorld()->removeRigidBody(pRB);
+    delete pRB->getMotionState();
+    delete pRB;
+  }
+  m_vSceneRigidBodies.clear();
+  // the shared manager outlives the map, without the release it would keep the shapes of every map of the session
+  m_SceneLoader.releaseCollisionShapes();
+}
+
 void CMap::CreateCube(const btVector3 &Position, btScalar Mass)
 {
     // empty ogre vectors for the cubes size and position
@@ -230,16 +370,105 @@ void CMap::CreateCube(const btVector3 &Position, btScalar Mass)
     btRigidBody *RigidBody = new btRigidBody(Mass, MotionState, Shape, LocalInertia);
 
     // Add it to the physics world
-    m_PhysicsManager.getWorld()->addRigidBody(RigidBody, 32, 1023);
+    m_pPhysicsManager->getWorld()->addRigidBody(RigidBody, 32, 1023);
 }
 
 void CMap::moveMap(const Ogre::Vector3 &offset) {
   m_bPauseUpdate = true;
+  m_vMapOffset += offset;
   m_pSceneNode->translate(offset);
   // move static geometries
   translateStaticGeometry(m_pStaticGeometry, offset);
-  translateStaticGeometry(m_pStaticGeometryChangedTiles, offset);
-  translateStaticGeometry(m_pStaticGeometryFixedTiles, offset);
+  for (auto &region : m_mTileRegions) {
+    translateStaticGeometry(region.second.pChangedTiles, offset);
+    translateStaticGeometry(region.second.pFixedTiles, offset);
+  }
+}
+
+void CMap::suspend() {
+  ASSERT(!m_bSuspended);
+  // the bodies in a shared physics world would still collide
+  ASSERT(!hasSharedPhysics());
+  m_bSuspended = true;
+  m_bPauseUpdate = true;
+  m_bPauseRender = true;
+  m_bPhysicsStepped = false;
+  m_pSceneNode->setVisible(false);
+  setStaticGeometryVisible(false);
+
+  // the scripts of the map and its subscriptions must not run in the pool
+  CLuaScheduler::getSingleton().pause(m_MapPack->getResourceGroup(), true);
+  unsubscribeMessage(MSG_ENTITY_STATE_CHANGED);
+
+  // move back while hidden, the physics world was never moved
+  if (m_vMapOffset != Ogre::Vector3::ZERO) {
+    moveMap(-m_vMapOffset);
+  }
+
+  attachTo(nullptr);
+}
+
+void CMap::resume(CEntity *pAtlas) {
+  ASSERT(m_bSuspended);
+  attachTo(pAtlas);
+
+  m_bSuspended = false;
+  m_bPauseUpdate = false;
+  m_bPauseRender = false;
+  m_pSceneNode->setVisible(true);
+  setStaticGeometryVisible(true);
+
+  subscribeMessage(MSG_ENTITY_STATE_CHANGED);
+  CLuaScheduler::getSingleton().pause(m_MapPack->getResourceGroup(), false);
+}
+
+size_t CMap::getMemoryUsage() const {
+  size_t uiBytes(0);
+
+  // resources loaded in the resource group of the map pack
+  Ogre::ResourceManager *apManagers[] = {
+    Ogre::MeshManager::getSingletonPtr(),
+    Ogre::SkeletonManager::getSingletonPtr(),
+    Ogre::TextureManager::getSingletonPtr(),
+    Ogre::MaterialManager::getSingletonPtr(),
+  };
+  for (Ogre::ResourceManager *pManager : apManagers) {
+    if (!pManager) {continue;}
+    Ogre::ResourceManager::ResourceMapIterator it(pManager->getResourceIterator());
+    while (it.hasMoreElements()) {
+      Ogre::ResourcePtr pResource(it.getNext());
+      if (pResource->getGroup() == m_MapPack->getResourceGroup() && pResource->isLoaded()) {
+        uiBytes += pResource->getSize();
+      }
+    }
+  }
+
+  uiBytes += getStaticGeometryMemoryUsage(m_pStaticGeometry);
+  for (auto &region : m_mTileRegions) {
+    uiBytes += getStaticGeometryMemoryUsage(region.second.pChangedTiles);
+    uiBytes += getStaticGeometryMemoryUsage(region.second.pFixedTiles);
+  }
+
+  // the shapes are counted with the meshes, only the bodies are added
+  uiBytes += (hasSharedPhysics() ? m_vSceneRigidBodies.size() : m_pPhysicsManager->getWorld()->getNumCollisionObjects()) * sizeof(btRigidBody);
+
+  return uiBytes;
+}
+
+bool CMap::containsPosition(const Ogre::Vector3 &vPosition) const {
+  return getDistance(vPosition) <= 0;
+}
+
+Ogre::Real CMap::getDistance(const Ogre::Vector3 &vPosition) const {
+  return getDistance(vPosition, m_vWorldOffset, m_MapPack->getGlobalSize());
+}
+
+Ogre::Real CMap::getDistance(const Ogre::Vector3 &vPosition, const Ogre::Vector3 &vWorldOffset, const Ogre::Vector2 &vGlobalSize) {
+  // the map is centered at its world offset, the global size is in x and z
+  const Ogre::Vector2 vHalfSize(vGlobalSize / 2);
+  const Ogre::Real fDX(std::max<Ogre::Real>(0, std::abs(vPosition.x - vWorldOffset.x) - vHalfSize.x));
+  const Ogre::Real fDZ(std::max<Ogre::Real>(0, std::abs(vPosition.z - vWorldOffset.z) - vHalfSize.y));
+  return std::sqrt(fDX * fDX + fDZ * fDZ);
 }
 
 void CMap::addStaticEntity(const std::string &entity, const Ogre::Vector3 &vPosition, const Ogre::Quaternion &vRotation) {
@@ -262,6 +491,36 @@ void CMap::translateStaticGeometry(Ogre::StaticGeometry *pSG, const Ogre::Vector
   pSG->setOrigin(vVec);
 }
 
+void CMap::setStaticGeometryVisible(bool bVisible) {
+  m_pStaticGeometry->setVisible(bVisible);
+  for (auto &region : m_mTileRegions) {
+    region.second.pChangedTiles->setVisible(bVisible);
+    region.second.pFixedTiles->setVisible(bVisible);
+  }
+}
+
+size_t CMap::getStaticGeometryMemoryUsage(Ogre::StaticGeometry *pSG) {
+  size_t uiBytes(0);
+  Ogre::StaticGeometry::RegionIterator regionIt(pSG->getRegionIterator());
+  while (regionIt.hasMoreElements()) {
+    Ogre::StaticGeometry::Region::LODIterator lodIt(regionIt.getNext()->getLODIterator());
+    while (lodIt.hasMoreElements()) {
+      Ogre::StaticGeometry::LODBucket::MaterialIterator matIt(lodIt.getNext()->getMaterialIterator());
+      while (matIt.hasMoreElements()) {
+        Ogre::StaticGeometry::MaterialBucket::GeometryIterator geomIt(matIt.getNext()->getGeometryIterator());
+        while (geomIt.hasMoreElements()) {
+          const Ogre::StaticGeometry::GeometryBucket *pGeom(geomIt.getNext());
+          const Ogre::VertexData *pVertexData(pGeom->getVertexData());
+          const Ogre::IndexData *pIndexData(pGeom->getIndexData());
+          uiBytes += pVertexData->vertexCount * pVertexData->vertexDeclaration->getVertexSize(0);
+          uiBytes += pIndexData->indexCount * pIndexData->indexBuffer->getIndexSize();
+        }
+      }
+    }
+  }
+  return uiBytes;
+}
+
 void CMap::update(Ogre::Real tpf) {
   CWorldEntity::update(tpf);
 
@@ -270,9 +529,38 @@ void CMap::update(Ogre::Real tpf) {
   }
 }
 
+void CMap::preRender(Ogre::Real tpf) {
+  // all tile changes of this frame are known now
+  rebuildDirtyTileRegions();
+  CWorldEntity::preRender(tpf);
+}
+
+void CMap::stepPhysics(Ogre::Real tpf) {
+  if (m_bPauseUpdate || hasSharedPhysics()) {return;}
+  m_pPhysicsManager->stepSimulationDeferred(tpf);
+  m_bPhysicsStepped = true;
+}
+
+void CMap::applyPhysicsStep() {
+  if (!m_bPhysicsStepped) {return;}
+  m_pPhysicsManager->applyMotionStates();
+}
+
 bool CMap::frameStarted(const Ogre::FrameEvent& evt) {
   if (m_bPauseUpdate) {return true;}
-  m_PhysicsManager.update(evt.timeSinceLastFrame);
+  if (hasSharedPhysics()) {
+    // stepped by the atlas
+    return CWorldEntity::frameStarted(evt);
+  }
+  // the debug lines are drawn for the camera of the atlas
+  const CAtlas *pAtlas(dynamic_cast<const CAtlas*>(getParent()));
+  if (m_bPhysicsStepped) {
+    m_bPhysicsStepped = false;
+    m_pPhysicsManager->updateDebugDraw(pAtlas ? pAtlas->getWorldCamera() : nullptr);
+  }
+  else {
+    m_pPhysicsManager->update(evt.timeSinceLastFrame, pAtlas ? pAtlas->getWorldCamera() : nullptr);
+  }
   processCollisionCheck();
   return CWorldEntity::frameStarted(evt);
 }
@@ -284,9 +572,10 @@ bool CMap::frameEnded(const Ogre::FrameEvent& evt) {
 
 void CMap::handleMessage(const CMessage &message) {
   if (message.getType() == MSG_ENTITY_STATE_CHANGED) {
-    const CMessageEntityStateChanged &mesc(dynamic_cast<const CMessageEntityStateChanged&>(message));
+    const CMessageEntityStateChanged &mesc(message.getAs<CMessageEntityStateChanged>());
     CObject *pObject(dynamic_cast<CObject*>(&mesc.getEntity()));
-    if (!pObject) {return;}
+    // the objects of other (e.g. suspended) maps do not change this map
+    if (!pObject || pObject->getMap() != this) {return;}
     if (mesc.getOldState() == EST_NORMAL) {
       // only change request if object was in normal state before
 
@@ -295,38 +584,89 @@ void CMap::handleMessage(const CMessage &message) {
         return;
       }
 
-      m_pStaticGeometryFixedTiles->destroy();
-      rebuildStaticGeometryChangedTiles();
-
+      // queue the new tiles, the region is rebuilt with all other changes of this frame
+      const Ogre::Vector3 &vPosition(pObject->getSceneNode()->getInitialPosition());
+      const TileRegionIndex index(getTileRegionIndex(vPosition));
+      Ogre::StaticGeometry *pFixedTiles(getTileRegion(index).pFixedTiles);
       if (pObject->getType() == OBJECT_GREEN_BUSH) {
-        m_pStaticGeometryFixedTiles->addEntity(m_apTileEntities[TT_GREEN_SOIL + std::rand() % (TT_GREEN_SOIL_GRASS_BR_TL_TR - TT_GREEN_SOIL + 1)], pObject->getSceneNode()->getInitialPosition());
-        m_pStaticGeometryFixedTiles->addEntity(m_apTileEntities[TT_GREEN_BUSH_TRUNK], pObject->getSceneNode()->getInitialPosition());
+        pFixedTiles->addEntity(m_apTileEntities[TT_GREEN_SOIL + std::rand() % (TT_GREEN_SOIL_GRASS_BR_TL_TR - TT_GREEN_SOIL + 1)], vPosition);
+        pFixedTiles->addEntity(m_apTileEntities[TT_GREEN_BUSH_TRUNK], vPosition);
       }
       else {
-        m_pStaticGeometryFixedTiles->addEntity(m_apTileEntities[data.eRemovedTile], pObject->getSceneNode()->getInitialPosition());
+        pFixedTiles->addEntity(m_apTileEntities[data.eRemovedTile], vPosition);
       }
-
-      m_pStaticGeometryFixedTiles->build();
+      m_sDirtyTileRegions.insert(index);
     }
   }
 }
 
 void CMap::updatePause(int iPauseType, bool bPause) {
+  // a suspended map stays hidden and paused until it is resumed
+  if (m_bSuspended) {return;}
+  // a loading map is paused, the pause is applied when it is loaded
+  if (!isLoaded()) {return;}
+
+  applyPause(iPauseType, bPause);
+}
+
+void CMap::applyPause(int iPauseType, bool bPause) {
   if (iPauseType & PAUSE_MAP_UPDATE) {
     m_bPauseUpdate = bPause;
   }
   if (iPauseType & PAUSE_MAP_RENDER) {
     m_bPauseRender = bPause;
-    m_pStaticGeometry->setVisible(!bPause);
-    m_pStaticGeometryFixedTiles->setVisible(!bPause);
-    m_pStaticGeometryChangedTiles->setVisible(!bPause);
+    setStaticGeometryVisible(!bPause);
     m_pSceneNode->setVisible(!bPause);
   }
 }
 
-void CMap::rebuildStaticGeometryChangedTiles() {
-  m_pStaticGeometryChangedTiles->reset();
+CMap::TileRegionIndex CMap::getTileRegionIndex(const Ogre::Vector3 &vPosition) {
+  return TileRegionIndex(static_cast<int>(std::floor(vPosition.x / TILE_REGION_SIZE)),
+                         static_cast<int>(std::floor(vPosition.y / TILE_REGION_SIZE)),
+                         static_cast<int>(std::floor(vPosition.z / TILE_REGION_SIZE)));
+}
+
+CMap::STileRegion &CMap::getTileRegion(const TileRegionIndex &index) {
+  auto it = m_mTileRegions.find(index);
+  if (it != m_mTileRegions.end()) {return it->second;}
+
+  const Ogre::String sSuffix("_" + Ogre::StringConverter::toString(std::get<0>(index))
+                             + "_" + Ogre::StringConverter::toString(std::get<1>(index))
+                             + "_" + Ogre::StringConverter::toString(std::get<2>(index)));
+  STileRegion &region(m_mTileRegions[index]);
+  region.pChangedTiles = createTileStaticGeometry(m_MapPack->getName() + "_StaticGeometryChangedTiles" + sSuffix);
+  region.pFixedTiles = createTileStaticGeometry(m_MapPack->getName() + "_StaticGeometryFixedTiles" + sSuffix);
+  return region;
+}
+
+Ogre::StaticGeometry *CMap::createTileStaticGeometry(const Ogre::String &sName) {
+  Ogre::StaticGeometry *pSG(m_pSceneNode->getCreator()->createStaticGeometry(sName));
+  pSG->setRegionDimensions(Ogre::Vector3(TILE_REGION_SIZE, TILE_REGION_SIZE, TILE_REGION_SIZE));
+  pSG->setCastShadows(false);
+  pSG->setVisible(!m_bPauseRender);
+  return pSG;
+}
+
+void CMap::markAllTileRegionsDirty() {
+  for (CEntity *pChild : getChildren()) {
+    CObject *pObject(dynamic_cast<CObject*>(pChild));
+    if (!pObject) {continue;}
+
+    const SObjectTypeData &data(OBJECT_TYPE_ID_MAP.toData(static_cast<EObjectTypes>(pObject->getType())));
+    if (data.eNormalTile != TT_COUNT) {
+      m_sDirtyTileRegions.insert(getTileRegionIndex(pObject->getSceneNode()->getInitialPosition()));
+    }
+  }
+}
+
+void CMap::rebuildDirtyTileRegions() {
+  if (m_sDirtyTileRegions.empty()) {return;}
 
+  for (const TileRegionIndex &index : m_sDirtyTileRegions) {
+    getTileRegion(index).pChangedTiles->reset();
+  }
+
+  // a single pass over the children for all regions changed in this frame
   for (CEntity *pChild : getChildren()) {
     CObject *pObject(dynamic_cast<CObject*>(pChild));
     if (!pObject) {continue;}
@@ -334,41 +674,42 @@ void CMap::rebuildStaticGeometryChangedTiles() {
     if (pObject->getState() == EST_NORMAL) {
       const SObjectTypeData &data(OBJECT_TYPE_ID_MAP.toData(static_cast<EObjectTypes>(pObject->getType())));
       if (data.eNormalTile != TT_COUNT) {
-        m_pStaticGeometryChangedTiles->addEntity(m_apTileEntities[data.eNormalTile], pObject->getSceneNode()->getInitialPosition());
+        const Ogre::Vector3 &vPosition(pObject->getSceneNode()->getInitialPosition());
+        auto it = m_mTileRegions.find(getTileRegionIndex(vPosition));
+        if (it != m_mTileRegions.end() && m_sDirtyTileRegions.count(it->first) > 0) {
+          it->second.pChangedTiles->addEntity(m_apTileEntities[data.eNormalTile], vPosition);
+        }
       }
     }
   }
 
-  m_pStaticGeometryChangedTiles->build();
+  for (const TileRegionIndex &index : m_sDirtyTileRegions) {
+    STileRegion &region(m_mTileRegions.at(index));
+    region.pChangedTiles->build();
+    // destroy keeps the queued tiles, the new ones are built together with the old ones
+    region.pFixedTiles->destroy();
+    region.pFixedTiles->build();
+  }
+  m_sDirtyTileRegions.clear();
 }
 
 void CMap::processCollisionCheck() {
-	int numManifolds = m_PhysicsManager.getWorld()->getDispatcher()->getNumManifolds();
-	for (int i=0;i<numManifolds;i++)
-	{
-		btPersistentManifold* contactManifold =  m_PhysicsManager.getWorld()->getDispatcher()->getManifoldByIndexInternal(i);
-		const btCollisionObject* obA = static_cast<const btCollisionObject*>(contactManifold->getBody0());
-		const btCollisionObject* obB = static_cast<const btCollisionObject*>(contactManifold->getBody1());
-
-		int numContacts = contactManifold->getNumContacts();
-		for (int j=0;j<numContacts;j++)
-		{
-			btManifoldPoint& pt = contactManifold->getContactPoint(j);
-			if (pt.getDistance()<0.f)
-			{
-				// Contact of 2 objects
-        CWorldEntity *pWE_A(CWorldEntity::getFromUserPointer(obA));
-        CWorldEntity *pWE_B(CWorldEntity::getFromUserPointer(obB));
-        btVector3 vDistance(pt.m_positionWorldOnA - pt.m_positionWorldOnB);
-        vDistance.normalize();
-        if (pWE_A && pWE_B) {
-          pWE_A->interactOnCollision(BtOgre::Convert::toOgre(vDistance), pWE_B);
-          pWE_B->interactOnCollision(-BtOgre::Convert::toOgre(vDistance), pWE_A);
-        }
-			}
-		}
+  // the contacts are collected after each physics step (see CContactTracker)
+  m_pPhysicsManager->getContactTracker().dispatch(*this);
+  // the queries of the gameplay are answered in one batch after the step
+  m_pPhysicsManager->processQueries();
+}
 
-	}
+// ############################################################################3
+// CContactListener
+
+void CMap::contactBegin(const btCollisionObject *pA, const btCollisionObject *pB, const Ogre::Vector3 &vDirection) {
+  CWorldEntity *pWE_A(CWorldEntity::getFromUserPointer(pA));
+  CWorldEntity *pWE_B(CWorldEntity::getFromUserPointer(pB));
+  if (pWE_A && pWE_B) {
+    pWE_A->interactOnCollision(vDirection, pWE_B);
+    pWE_B->interactOnCollision(-vDirection, pWE_A);
+  }
 }
 
 // ############################################################################3
@@ -421,6 +762,11 @@ void CMap::worldPhysicsAdded(btRigidBody *pRigidBody) {
 }
 
 void CMap::postEntityAdded(Ogre::Entity *pEntity, Ogre::SceneNode *pParent, btRigidBody *pRigidBody, const CUserData &userData) {
+  if (pRigidBody && hasSharedPhysics()) {
+    // a shared physics world is not cleared with the map
+    m_vSceneRigidBodies.push_back(pRigidBody);
+  }
+
   if (pEntity->getName().find("flower") != Ogre::String::npos) {
     if (!m_pFirstFlowerEntity) {
       m_pFirstFlowerEntity = pEntity;
@@ -439,10 +785,10 @@ void CMap::staticObjectAdded(Ogre::Entity *pEntity, Ogre::SceneNode *pParent) {
   destroySceneNode(pParent, true);
 }
 
-CDotSceneLoaderCallback::EResults CMap::preEntityAdded(tinyxml2::XMLElement *XMLNode, Ogre::SceneNode *pParent, CUserData &userData) {
+CDotSceneLoaderCallback::EResults CMap::preEntityAdded(const Ogre::String &sMeshFile, Ogre::SceneNode *pParent, CUserData &userData) {
   CWorldEntity *pEntity(nullptr);
 
-  EObjectTypes objectType(OBJECT_TYPE_ID_MAP.getFromMeshFileName(XMLNode->Attribute("meshFile")));
+  EObjectTypes objectType(OBJECT_TYPE_ID_MAP.getFromMeshFileName(sMeshFile));
   if (objectType != OBJECT_COUNT && OBJECT_TYPE_ID_MAP.toData(objectType).bUserHandle) {
     pEntity = new CObject(userData.getStringUserData("name"), this, this, objectType, pParent);
 
@@ -451,7 +797,7 @@ CDotSceneLoaderCallback::EResults CMap::preEntityAdded(tinyxml2::XMLElement *XML
     return R_CANCEL;
   }
 
-  if (strcmp(XMLNode->Attribute("meshFile"), "flower.mesh") == 0) {
+  if (sMeshFile == "flower.mesh") {
     userData.setUserData("static", false);
   }
 
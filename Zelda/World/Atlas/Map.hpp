@@ -32,29 +32,76 @@
 #include "TileTypes.hpp"
 #include <OgreMaterial.h>
 #include <map>
+#include <set>
+#include <tuple>
+#include <vector>
+#include <memory>
 
 class CMap : public CWorldEntity,
              private CMapPackParserListener,
              private CDotSceneLoaderCallback,
+             private CContactListener,
              public CPauseListener {
+public:
+  //! the stages of loading a map, in order, see loadNextStage
+  enum ELoadingStages {
+    MLS_MOUNT,                                                  //!< mount the pack and load its resource group
+    MLS_PARSE_PACK,                                             //!< read the map xml file
+    MLS_BUILD_PHYSICS,                                          //!< create the global collision shapes
+    MLS_PARSE_SCENE,                                            //!< create the scene, its static entities and their rigid bodies
+    MLS_SPAWN_ENTITIES,                                         //!< create the entities of the map xml file
+    MLS_BUILD_STATIC_GEOMETRY,
+    MLS_INIT_EVENTS,
+    MLS_LOADED,
+  };
 private:
-  CPhysicsManager m_PhysicsManager;
+  ELoadingStages m_eLoadingStage;
+  std::unique_ptr<CPhysicsManager> m_pOwnPhysicsManager;        //!< nullptr if the physics world is shared with other maps
+  CPhysicsManager *m_pPhysicsManager;
+  const Ogre::Vector3 m_vWorldOffset;                           //!< position of the map in a shared physics world
   CMapPackPtr m_MapPack;
   Ogre::DotSceneLoader m_SceneLoader;
   CWorldEntity *m_pPlayer;
   Ogre::StaticGeometry *m_pStaticGeometry;
-  Ogre::StaticGeometry *m_pStaticGeometryChangedTiles;          //!< Here are the tiles added that can be remved (bush in place)
-  Ogre::StaticGeometry *m_pStaticGeometryFixedTiles;            //!< Here are new static tiles added, initially blank. Afterwards it is all static
+
+  //! index of a TILE_REGION_SIZE^3 cell of the tile static geometries
+  typedef std::tuple<int, int, int> TileRegionIndex;
+  //! the tile static geometries of a single region, so that a change only rebuilds its region
+  struct STileRegion {
+    Ogre::StaticGeometry *pChangedTiles;                        //!< Here are the tiles added that can be remved (bush in place)
+    Ogre::StaticGeometry *pFixedTiles;                          //!< Here are new static tiles added, initially blank. Afterwards it is all static
+  };
+  std::map<TileRegionIndex, STileRegion> m_mTileRegions;
+  std::set<TileRegionIndex> m_sDirtyTileRegions;                //!< rebuilt once per frame in preRender
 
   Ogre::Entity *m_apTileEntities[TT_COUNT];
   Ogre::Entity *m_pFirstFlowerEntity;
   Ogre::AnimationState *m_pFlowerAnimationState;
   Ogre::MaterialPtr m_pWaterSideWaveMaterial;
   std::map<std::string, Ogre::Entity*> m_mStaticEntitiesMap;
+  std::vector<btRigidBody*> m_vSceneRigidBodies;                //!< rigid bodies of the scene in a shared physics world
+  bool m_bPhysicsStepped;                                       //!< physics was already stepped in this frame by stepPhysics
+  bool m_bStarted;
+  bool m_bSuspended;                                            //!< map is resident in the map pool
+  Ogre::Vector3 m_vMapOffset;                                   //!< sum of all moveMap offsets
 public:
-  CMap(CEntity *pAtlas, CMapPackPtr mapPack, Ogre::SceneNode *pParentSceneNode, CWorldEntity *pPlayer);
+  //! the map is not loaded yet, this is done in stages by loadNextStage (see CMapLoader)
+  /**
+    * If a shared physics manager is given, the map is a part of a larger world
+    * (see CAtlas streaming): its content is placed at the world offset and the
+    * physics world is stepped by the owner of the physics manager. Otherwise the
+    * map is centered at the origin and has its own physics world.
+    */
+  CMap(CEntity *pAtlas, CMapPackPtr mapPack, Ogre::SceneNode *pParentSceneNode, CWorldEntity *pPlayer,
+       CPhysicsManager *pSharedPhysicsManager = nullptr, const Ogre::Vector3 &vWorldOffset = Ogre::Vector3::ZERO);
   virtual ~CMap();
 
+  ELoadingStages getLoadingStage() const {return m_eLoadingStage;}
+  bool isLoaded() const {return m_eLoadingStage == MLS_LOADED;}
+  //! run the current loading stage, the map must not be updated before it is loaded
+  void loadNextStage();
+  static const char *getLoadingStageName(ELoadingStages eStage);
+
   void start();
   void exit();
 
@@ -62,22 +109,65 @@ public:
 
   void moveMap(const Ogre::Vector3 &offset);
 
-  const CPhysicsManager *getPhysicsManager() const {return &m_PhysicsManager;}
-  CPhysicsManager *getPhysicsManager() {return &m_PhysicsManager;}
+  //! hide and detach the map from the atlas, it keeps its state and resources
+  void suspend();
+  //! attach a suspended map to the atlas again, at its original position
+  void resume(CEntity *pAtlas);
+  bool isSuspended() const {return m_bSuspended;}
+  //! estimated memory of the resources, static geometry and physics of the map in bytes
+  size_t getMemoryUsage() const;
+
+  const CPhysicsManager *getPhysicsManager() const {return m_pPhysicsManager;}
+  CPhysicsManager *getPhysicsManager() {return m_pPhysicsManager;}
+  bool hasSharedPhysics() const {return !m_pOwnPhysicsManager;}
+  const Ogre::Vector3 &getWorldOffset() const {return m_vWorldOffset;}
+  //! is the position (in the coordinates of the physics world) inside of the global size of the map
+  bool containsPosition(const Ogre::Vector3 &vPosition) const;
+  //! horizontal distance of the position to the area of the map, 0 if inside
+  Ogre::Real getDistance(const Ogre::Vector3 &vPosition) const;
+  //! distance to the area of a map that is not created yet
+  static Ogre::Real getDistance(const Ogre::Vector3 &vPosition, const Ogre::Vector3 &vWorldOffset, const Ogre::Vector2 &vGlobalSize);
   const CMapPackPtr getMapPack() const {return m_MapPack;}
 
+  //! step the own physics world before frameStarted, may be called from a worker thread
+  /**
+    * The scene nodes are not moved, applyPhysicsStep has to be called on the
+    * render thread afterwards.
+    */
+  void stepPhysics(Ogre::Real tpf);
+  void applyPhysicsStep();
+  //! send the contacts that began since the last call to the entities, for a shared world it has to be called once by its owner
+  void processCollisionCheck();
+
   void update(Ogre::Real tpf);
+  void preRender(Ogre::Real tpf);
   bool frameStarted(const Ogre::FrameEvent& evt);
   bool frameEnded(const Ogre::FrameEvent& evt);
 
   void addStaticEntity(const std::string &entity, const Ogre::Vector3 &vPosition, const Ogre::Quaternion &vRotation);
 
 private:
+  void createGlobalCollisionShapes();
+  //! fit the broadphase of an own physics world to the size of the map
+  void createBroadphase();
+  void parseScene();
+  void buildStaticGeometry();
+
   void handleMessage(const CMessage &message);
   void updatePause(int iPauseType, bool bPause);
-  void rebuildStaticGeometryChangedTiles();
-  void processCollisionCheck();
+  void applyPause(int iPauseType, bool bPause);
+  static TileRegionIndex getTileRegionIndex(const Ogre::Vector3 &vPosition);
+  STileRegion &getTileRegion(const TileRegionIndex &index);
+  Ogre::StaticGeometry *createTileStaticGeometry(const Ogre::String &sName);
+  //! mark the regions of all objects that have a tile in normal state
+  void markAllTileRegionsDirty();
+  //! rebuild the tile static geometries of all regions changed since the last call
+  void rebuildDirtyTileRegions();
+  //! delete the rigid bodies of the scene from a shared physics world, the entities remove their own
+  void destroySceneInSharedPhysics();
   void translateStaticGeometry(Ogre::StaticGeometry *pSG, const Ogre::Vector3 &vVec);
+  void setStaticGeometryVisible(bool bVisible);
+  static size_t getStaticGeometryMemoryUsage(Ogre::StaticGeometry *pSG);
 
   // CMapPackParserListener
   void parseEvent(const tinyxml2::XMLElement *);
@@ -92,7 +182,9 @@ private:
   void worldPhysicsAdded(btRigidBody *pRigidBody);
   void postEntityAdded(Ogre::Entity *pEntity, Ogre::SceneNode *pParent, btRigidBody *pRigidBody, const CUserData &userData);
 	void staticObjectAdded(Ogre::Entity *pEntity, Ogre::SceneNode *pParent);
-  EResults preEntityAdded(tinyxml2::XMLElement *XMLNode, Ogre::SceneNode *pParent, CUserData &userData);
+  EResults preEntityAdded(const Ogre::String &sMeshFile, Ogre::SceneNode *pParent, CUserData &userData);
 
+  // CContactListener
+  void contactBegin(const btCollisionObject *pA, const btCollisionObject *pB, const Ogre::Vector3 &vDirection);
 };
 #endif // _MAP_HPP_
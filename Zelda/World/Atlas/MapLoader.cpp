@@ -0,0 +1,115 @@
+/*****************************************************************************
+ * Copyright 2014 Christoph Wick
+ *
+ * This file is part of Zelda.
+ *
+ * Zelda is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zelda is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Zelda. If not, see http://www.gnu.org/licenses/.
+ *****************************************************************************/
+
+#include "MapLoader.hpp"
+#include <OgreLogManager.h>
+#include <OgreStringConverter.h>
+#include <chrono>
+#include <limits>
+#include "../../Common/Util/Assert.hpp"
+
+const Ogre::Real CMapLoader::DEFAULT_FRAME_BUDGET(0.008f);
+
+CMapLoader::CMapLoader(Ogre::Real fFrameBudget)
+  : m_pMap(nullptr),
+    m_fFrameBudget(fFrameBudget),
+    m_uiFrameCount(0),
+    m_fLongestFrame(0),
+    m_fUnclaimedLoadingTime(0) {
+  for (int i = 0; i < CMap::MLS_LOADED; i++) {
+    m_afStageTimes[i] = 0;
+    m_afStageEstimates[i] = 0;
+  }
+}
+
+void CMapLoader::load(CMap *pMap) {
+  ASSERT(pMap);
+  ASSERT(!m_pMap);
+  m_pMap = pMap;
+  m_uiFrameCount = 0;
+  m_fLongestFrame = 0;
+  for (int i = 0; i < CMap::MLS_LOADED; i++) {
+    m_afStageTimes[i] = 0;
+  }
+}
+
+CMap *CMapLoader::update() {
+  if (!m_pMap) {return nullptr;}
+
+  typedef std::chrono::steady_clock Clock;
+  const Clock::time_point tFrameStart(Clock::now());
+  Ogre::Real fElapsed(0);
+  bool bFirstStage(true);
+  while (!m_pMap->isLoaded()) {
+    const CMap::ELoadingStages eStage(m_pMap->getLoadingStage());
+    if (!bFirstStage && fElapsed + m_afStageEstimates[eStage] > m_fFrameBudget) {
+      // continue in the next frame
+      break;
+    }
+    bFirstStage = false;
+
+    const Clock::time_point tStageStart(Clock::now());
+    m_pMap->loadNextStage();
+    const Clock::time_point tStageEnd(Clock::now());
+    m_afStageTimes[eStage] += std::chrono::duration<Ogre::Real>(tStageEnd - tStageStart).count();
+    fElapsed = std::chrono::duration<Ogre::Real>(tStageEnd - tFrameStart).count();
+  }
+
+  m_uiFrameCount++;
+  m_fLongestFrame = std::max(m_fLongestFrame, fElapsed);
+  m_fUnclaimedLoadingTime += fElapsed;
+
+  if (!m_pMap->isLoaded()) {return nullptr;}
+
+  logStageTimes();
+  for (int i = 0; i < CMap::MLS_LOADED; i++) {
+    m_afStageEstimates[i] = m_afStageTimes[i];
+  }
+  CMap *pMap(m_pMap);
+  m_pMap = nullptr;
+  return pMap;
+}
+
+CMap *CMapLoader::finish() {
+  const Ogre::Real fFrameBudget(m_fFrameBudget);
+  m_fFrameBudget = std::numeric_limits<Ogre::Real>::max();
+  CMap *pMap(update());
+  m_fFrameBudget = fFrameBudget;
+  return pMap;
+}
+
+Ogre::Real CMapLoader::takeLoadingTime() {
+  Ogre::Real fTime(m_fUnclaimedLoadingTime);
+  m_fUnclaimedLoadingTime = 0;
+  return fTime;
+}
+
+void CMapLoader::logStageTimes() const {
+  Ogre::String sStages;
+  Ogre::Real fTotal(0);
+  for (int i = 0; i < CMap::MLS_LOADED; i++) {
+    sStages += Ogre::String(i > 0 ? ", " : "") + CMap::getLoadingStageName(static_cast<CMap::ELoadingStages>(i))
+        + ": " + Ogre::StringConverter::toString(m_afStageTimes[i] * 1000, 3) + " ms";
+    fTotal += m_afStageTimes[i];
+  }
+  Ogre::LogManager::getSingleton().logMessage("Loading of map '" + m_pMap->getMapPack()->getName() + "' took "
+      + Ogre::StringConverter::toString(fTotal * 1000, 3) + " ms in "
+      + Ogre::StringConverter::toString(m_uiFrameCount) + " frames (longest frame "
+      + Ogre::StringConverter::toString(m_fLongestFrame * 1000, 3) + " ms): " + sStages);
+}
@@ -0,0 +1,78 @@
+/*****************************************************************************
+ * Copyright 2014 Christoph Wick
+ *
+ * This file is part of Zelda.
+ *
+ * Zelda is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zelda is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Zelda. If not, see http://www.gnu.org/licenses/.
+ *****************************************************************************/
+
+#ifndef _MAP_LOADER_HPP_
+#define _MAP_LOADER_HPP_
+
+#include <OgrePrerequisites.h>
+#include "Map.hpp"
+
+//! Loads a map stage by stage within a time budget per frame
+/**
+  * Each frame update() runs the loading stages of the map (see CMap::loadNextStage)
+  * until the budget is used. A stage is not started if the time it took in the
+  * previous load would exceed the budget, but at least one stage is run per
+  * frame. A single stage is never interrupted, so a frame can take longer than
+  * the budget if a stage does.
+  * The time of each stage is logged when the map is loaded.
+  */
+class CMapLoader {
+public:
+  static const Ogre::Real DEFAULT_FRAME_BUDGET;       //!< seconds per frame
+private:
+  CMap *m_pMap;
+  Ogre::Real m_fFrameBudget;
+  Ogre::Real m_afStageTimes[CMap::MLS_LOADED];        //!< time of the stages of the current load
+  Ogre::Real m_afStageEstimates[CMap::MLS_LOADED];    //!< time of the stages of the last load
+  unsigned int m_uiFrameCount;                        //!< frames the current load took so far
+  Ogre::Real m_fLongestFrame;                         //!< longest time a single frame was blocked by the current load
+  Ogre::Real m_fUnclaimedLoadingTime;                 //!< loading time since the last takeLoadingTime
+public:
+  CMapLoader(Ogre::Real fFrameBudget = DEFAULT_FRAME_BUDGET);
+
+  //! start loading the map, the previous map must be loaded
+  void load(CMap *pMap);
+  bool isLoading() const {return m_pMap != nullptr;}
+  //! the map that is currently loaded, nullptr if none
+  CMap *getMap() const {return m_pMap;}
+
+  //! run loading stages until the budget of this frame is used
+  /**
+    * @return the map if it was finished in this call, else nullptr
+    */
+  CMap *update();
+  //! run all remaining stages of the current load in this frame
+  /**
+    * @return the map, nullptr if none was loading
+    */
+  CMap *finish();
+
+  //! time spent in update since the last call, it should not advance the game time
+  Ogre::Real takeLoadingTime();
+  //! longest time a single frame was blocked by the last or current load
+  Ogre::Real getLongestFrame() const {return m_fLongestFrame;}
+
+  void setFrameBudget(Ogre::Real fFrameBudget) {m_fFrameBudget = fFrameBudget;}
+  Ogre::Real getFrameBudget() const {return m_fFrameBudget;}
+
+private:
+  void logStageTimes() const;
+};
+
+#endif // _MAP_LOADER_HPP_
@@ -19,31 +19,183 @@
 
 #include "MapPack.hpp"
 #include <OgreResourceGroupManager.h>
+#include <OgreResourceManager.h>
 #include "../../Common/tinyxml2/tinyxml2.hpp"
 #include "../../Common/Util/XMLHelper.hpp"
 #include <OgreLogManager.h>
 #include "MapPackParserListener.hpp"
 #include <OgreStringConverter.h>
 #include "../../Common/Log.hpp"
+#include "../../Common/DotSceneLoader/CookedScene.hpp"
+#include "../../Common/FileManager/PackArchive.hpp"
+#include <fstream>
+#if OGRE_PLATFORM != OGRE_PLATFORM_ANDROID
+#include <OgreZip.h>
+#endif
 
 using namespace tinyxml2;
 using namespace XMLHelper;
 
+namespace {
+  // keep in sync with tools/ResourceManifest.py
+  const std::string RESOURCE_MANIFEST_EXTENSION(".manifest");
+
+  bool hasPackArchive(const std::string &sPackArchive) {
+#if OGRE_PLATFORM == OGRE_PLATFORM_ANDROID
+    // the apk assets can not be mapped
+    return false;
+#else
+    return CPackArchive::isPackArchive(sPackArchive);
+#endif // OGRE_PLATFORM
+  }
+
+#if OGRE_PLATFORM != OGRE_PLATFORM_ANDROID
+  //! reads files of a map pack on the prefetch thread
+  /**
+    * An archive that is not registered in the archive manager, the resource
+    * group manager is not thread safe. The errors are returned as strings,
+    * an Ogre::Exception would be logged by the log manager on this thread.
+    */
+  class CPrivatePackReader {
+  private:
+    const std::string m_sPackFile;
+    std::unique_ptr<CPackArchive> m_pPack;
+    std::unique_ptr<Ogre::ZipArchive> m_pZip;
+  public:
+    CPrivatePackReader(const std::string &sPackFile) : m_sPackFile(sPackFile) {}
+    ~CPrivatePackReader() {
+      if (m_pPack) {m_pPack->unload();}
+      if (m_pZip) {m_pZip->unload();}
+    }
+
+    bool open(bool bPackArchive, std::string &sError) {
+      if (bPackArchive) {
+        m_pPack.reset(new CPackArchive(m_sPackFile));
+        return m_pPack->load(sError);
+      }
+      // a missing zip is the common error, it is reported without the exception of the zip archive
+      if (!std::ifstream(m_sPackFile.c_str(), std::ios::binary)) {
+        sError = "File " + m_sPackFile + " can not be opened";
+        return false;
+      }
+      try {
+        m_pZip.reset(new Ogre::ZipArchive(m_sPackFile, "Zip"));
+        m_pZip->load();
+      }
+      catch (const Ogre::Exception &e) {
+        m_pZip.reset();
+        sError = e.getDescription();
+        return false;
+      }
+      return true;
+    }
+
+    bool exists(const std::string &sFile) {
+      return m_pPack ? m_pPack->exists(sFile) : m_pZip->exists(sFile);
+    }
+
+    bool read(const std::string &sFile, std::string &sData, std::string &sError) {
+      // opening a missing file logs, so check first
+      if (!exists(sFile)) {
+        sError = "File " + sFile + " not found in " + m_sPackFile;
+        return false;
+      }
+      if (m_pPack) {
+        return m_pPack->read(sFile, sData, sError);
+      }
+      Ogre::DataStreamPtr stream(m_pZip->open(sFile));
+      if (stream.isNull()) {
+        sError = "File " + sFile + " can not be opened in " + m_sPackFile;
+        return false;
+      }
+      sData = stream->getAsString();
+      stream->close();
+      return true;
+    }
+  };
+#endif // OGRE_PLATFORM
+}
+
 CMapPack::CMapPack(const std::string &path, const std::string &name)
   : m_sPath(path),
     m_sName(name),
     m_sResourceGroup(name + "_RG"),
+    m_bPackArchive(hasPackArchive(path + name + PackArchive::PACK_ARCHIVE_EXTENSION)),
     m_bInitialized(false),
+    m_bPrefetched(false),
     m_pListener(nullptr),
+    m_uiPackSize(0),
+    m_eBroadphaseType(BT_AXIS_SWEEP),
+    m_bResourceManifest(false),
     mLanguageManager(name + "_RG", "language/", false) {
 
-  LOGV("Created map pack for: '%s%s'", path.c_str(), name.c_str());
+  LOGV("Created map pack for: '%s%s'%s", path.c_str(), name.c_str(), m_bPackArchive ? " (pack archive)" : "");
 }
 
 CMapPack::~CMapPack() {
   exit();
 }
 
+bool CMapPack::prefetchDescription() {
+#if OGRE_PLATFORM == OGRE_PLATFORM_ANDROID
+  // the apk assets are only accessible by the archive manager
+  return false;
+#else
+  CPrivatePackReader reader(getPackFile());
+  if (!reader.open(m_bPackArchive, m_sPrefetchError)
+      || !reader.read(m_sName + ".xml", m_sXmlData, m_sPrefetchError)) {
+    m_sXmlData.clear();
+    return false;
+  }
+
+  // the parsed document is handed over to readXMLFile() and parse()
+  std::unique_ptr<XMLDocument> pDocument(new XMLDocument());
+  pDocument->Parse(m_sXmlData.c_str());
+  if (pDocument->Error() || !pDocument->FirstChildElement()) {
+    m_sXmlData.clear();
+    m_sPrefetchError = "File " + m_sName + ".xml is not valid";
+    return false;
+  }
+  if (!parseGlobalPlacement(pDocument->FirstChildElement(), m_sPrefetchError)) {
+    m_sXmlData.clear();
+    return false;
+  }
+  m_pXMLDocument = std::move(pDocument);
+  return true;
+#endif // OGRE_PLATFORM
+}
+
+bool CMapPack::prefetch() {
+  if (m_bPrefetched) {return true;}
+  if (!prefetchDescription()) {return false;}
+
+#if OGRE_PLATFORM != OGRE_PLATFORM_ANDROID
+  {
+    CPrivatePackReader reader(getPackFile());
+    if (!reader.open(m_bPackArchive, m_sPrefetchError)) {return false;}
+    // the scene loader prefers the cooked scene
+    const std::string sCookedScene(m_sName + ".scene" + CookedScene::COOKED_SCENE_EXTENSION);
+    const std::string sScene(reader.exists(sCookedScene) ? sCookedScene : m_sName + ".scene");
+    if (!reader.read(sScene, m_sSceneData, m_sPrefetchError)) {
+      m_sSceneData.clear();
+      return false;
+    }
+  }
+
+  // read the pack once, mounting it and loading its resources on the main
+  // thread will only hit the file cache
+  std::ifstream packFile(getPackFile().c_str(), std::ios::binary);
+  char buffer[64 * 1024];
+  m_uiPackSize = 0;
+  while (packFile.read(buffer, sizeof(buffer)) || packFile.gcount() > 0) {
+    m_uiPackSize += static_cast<size_t>(packFile.gcount());
+  }
+#endif // OGRE_PLATFORM
+
+  m_bPrefetched = true;
+  return true;
+}
+
 void CMapPack::init(CMapPackParserListener *pListener) {
   LOGV("Initializing map pack %s", m_sName.c_str());
   m_pListener = pListener;
@@ -51,11 +203,7 @@ void CMapPack::init(CMapPackParserListener *pListener) {
   m_bInitialized = true;
 
   Ogre::ResourceGroupManager::getSingleton().createResourceGroup(m_sResourceGroup, false);
-#if OGRE_PLATFORM == OGRE_PLATFORM_ANDROID
-  Ogre::ResourceGroupManager::getSingleton().addResourceLocation(m_sPath + m_sName + ".zip", "APKZip", m_sResourceGroup, true, true);
-#else
-  Ogre::ResourceGroupManager::getSingleton().addResourceLocation(m_sPath + m_sName + ".zip", "Zip", m_sResourceGroup, true, true);
-#endif // OGRE_PLATFORM
+  Ogre::ResourceGroupManager::getSingleton().addResourceLocation(getPackFile(), getArchiveType(), m_sResourceGroup, true, true);
   Ogre::StringVectorPtr files(Ogre::ResourceGroupManager::getSingleton().listResourceNames(m_sResourceGroup));
   for (const Ogre::String &r : *files) {
     if (r.find(".lua") != Ogre::String::npos) {
@@ -64,42 +212,98 @@ void CMapPack::init(CMapPackParserListener *pListener) {
     }
   }
   Ogre::ResourceGroupManager::getSingleton().initialiseResourceGroup(m_sResourceGroup);
-  Ogre::ResourceGroupManager::getSingleton().loadResourceGroup(m_sResourceGroup);
+  loadResources();
 
   m_sSceneFile = m_sName + ".scene";
   mLanguageManager.loadLanguage();
 }
 
-void CMapPack::parse() {
-  parseXMLFile();
-}
+void CMapPack::loadResources() {
+  Ogre::ResourceGroupManager &rgm(Ogre::ResourceGroupManager::getSingleton());
+  const std::string sManifest(m_sName + RESOURCE_MANIFEST_EXTENSION);
+  m_bResourceManifest = rgm.resourceExists(m_sResourceGroup, sManifest);
+  if (!m_bResourceManifest) {
+    LOGV("Map pack '%s' has no resource manifest, loading all resources", m_sName.c_str());
+    rgm.loadResourceGroup(m_sResourceGroup);
+    return;
+  }
 
-void CMapPack::exit() {
-  if (!m_bInitialized) {return;}
-  m_bInitialized = false;
+  // the resources that are not listed (e.g. meshes of objects that are
+  // created later) are loaded when they are used for the first time
+  Ogre::DataStreamPtr stream(rgm.openResource(sManifest, m_sResourceGroup, false));
+  while (!stream->eof()) {
+    const Ogre::String sLine(stream->getLine());
+    if (sLine.empty()) {continue;}
 
-  Ogre::ResourceGroupManager::getSingleton().unloadResourceGroup(m_sResourceGroup);
-  Ogre::ResourceGroupManager::getSingleton().destroyResourceGroup(m_sResourceGroup);
+    const Ogre::StringVector vParts(Ogre::StringUtil::split(sLine, " \t", 1));
+    if (vParts.size() != 2) {
+      LOGW("Invalid line in resource manifest '%s': '%s'", sManifest.c_str(), sLine.c_str());
+      continue;
+    }
+
+    Ogre::ResourceManager *pManager(nullptr);
+    try {
+      pManager = rgm._getResourceManager(vParts[0]);
+    }
+    catch (const Ogre::Exception &) {
+      LOGW("Unknown resource type '%s' in resource manifest '%s'", vParts[0].c_str(), sManifest.c_str());
+      continue;
+    }
+    pManager->load(vParts[1], m_sResourceGroup);
+  }
 }
 
-void CMapPack::parseXMLFile() {
-  Ogre::DataStreamPtr dataStream
-    = Ogre::ResourceGroupManager::getSingleton().openResource(m_sName + ".xml", m_sResourceGroup, false);
+void CMapPack::logLoadedResources() const {
+  if (!m_bInitialized) {return;}
 
-  if (dataStream.isNull()) {
-    throw Ogre::Exception(0, "File " + m_sName + ".zip not found in resource group " + m_sResourceGroup + "!", __FILE__);
+  size_t uiLoadedBytes(0);
+  size_t uiAvailableBytes(0);
+  size_t uiLoadedFiles(0);
+  Ogre::FileInfoListPtr files(Ogre::ResourceGroupManager::getSingleton().listResourceFileInfo(m_sResourceGroup));
+  for (const Ogre::FileInfo &info : *files) {
+    uiAvailableBytes += info.uncompressedSize;
+    if (isFileLoaded(info)) {
+      uiLoadedBytes += info.uncompressedSize;
+      ++uiLoadedFiles;
+    }
   }
 
-  Ogre::LogManager::getSingleton().logMessage("Reading map xml file.");
+  Ogre::LogManager::getSingleton().logMessage("Map pack '" + m_sName + "' "
+      + (m_bResourceManifest ? "(manifest)" : "(whole group)") + " loaded "
+      + Ogre::StringConverter::toString(uiLoadedBytes) + " of "
+      + Ogre::StringConverter::toString(uiAvailableBytes) + " bytes, "
+      + Ogre::StringConverter::toString(uiLoadedFiles) + " of "
+      + Ogre::StringConverter::toString(files->size()) + " files");
+}
 
-  XMLDocument doc;
-  doc.Parse(dataStream->getAsString().c_str());
+bool CMapPack::isFileLoaded(const Ogre::FileInfo &info) const {
+  // read directly by the map pack, the scene loader and the language manager
+  if (info.basename == m_sName + ".xml"
+      || info.basename == m_sName + RESOURCE_MANIFEST_EXTENSION
+      || Ogre::StringUtil::startsWith(info.basename, m_sName + ".scene")
+      || Ogre::StringUtil::startsWith(info.filename, "language/")) {
+    return true;
+  }
 
-  XMLElement *pMapElem = doc.FirstChildElement();
-  m_vGlobalPosition = Ogre::StringConverter::parseVector3(Attribute(pMapElem, "global_position"));
-  m_vGlobalSize = Ogre::StringConverter::parseVector2(Attribute(pMapElem, "global_size"));
-  m_fVisionLevelOffset = RealAttribute(pMapElem, "vision_level_offset", 0.f);
+  Ogre::ResourceGroupManager::ResourceManagerIterator it(Ogre::ResourceGroupManager::getSingleton().getResourceManagerIterator());
+  while (it.hasMoreElements()) {
+    Ogre::ResourceManager *pManager(it.getNext());
+    for (const Ogre::String &sName : {info.filename, info.basename}) {
+      Ogre::ResourcePtr resource(pManager->getResourceByName(sName, m_sResourceGroup));
+      if (!resource.isNull() && resource->isLoaded()) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+void CMapPack::parse() {
+  if (!m_pXMLDocument) {
+    readXMLFile();
+  }
 
+  XMLElement *pMapElem = m_pXMLDocument->FirstChildElement();
   for (XMLElement *pElem = pMapElem->FirstChildElement(); pElem; pElem = pElem->NextSiblingElement()) {
     if (strcmp(pElem->Value(), "event") == 0) {
       if (m_pListener) {m_pListener->parseEvent(pElem);}
@@ -123,4 +327,87 @@ void CMapPack::parseXMLFile() {
       LOGW("Unknown entity in map pack '%s'", pElem->Value());
     }
   }
+
+  // the document is not required anymore
+  m_pXMLDocument.reset();
+}
+
+void CMapPack::exit() {
+  if (!m_bInitialized) {return;}
+  m_bInitialized = false;
+
+  Ogre::ResourceGroupManager::getSingleton().unloadResourceGroup(m_sResourceGroup);
+  Ogre::ResourceGroupManager::getSingleton().destroyResourceGroup(m_sResourceGroup);
+}
+
+void CMapPack::readXMLFile() {
+  if (m_pXMLDocument) {
+    Ogre::LogManager::getSingleton().logMessage("Using the map xml file parsed by the prefetch.");
+    return;
+  }
+
+  m_pXMLDocument.reset(new XMLDocument());
+  XMLDocument &doc(*m_pXMLDocument);
+  if (!m_sXmlData.empty()) {
+    // the prefetched document was already consumed by parse()
+    Ogre::LogManager::getSingleton().logMessage("Reading prefetched map xml file.");
+    doc.Parse(m_sXmlData.c_str());
+  }
+  else {
+    Ogre::DataStreamPtr dataStream
+      = Ogre::ResourceGroupManager::getSingleton().openResource(m_sName + ".xml", m_sResourceGroup, false);
+
+    if (dataStream.isNull()) {
+      throw Ogre::Exception(0, "File " + m_sName + ".xml not found in resource group " + m_sResourceGroup + "!", __FILE__);
+    }
+
+    Ogre::LogManager::getSingleton().logMessage("Reading map xml file.");
+
+    doc.Parse(dataStream->getAsString().c_str());
+  }
+
+  std::string sError("File " + m_sName + ".xml is not valid");
+  if (doc.Error() || !doc.FirstChildElement() || !parseGlobalPlacement(doc.FirstChildElement(), sError)) {
+    m_pXMLDocument.reset();
+    throw Ogre::Exception(0, sError, __FILE__);
+  }
+}
+
+bool CMapPack::parseGlobalPlacement(const XMLElement *pMapElem, std::string &sError) {
+  // called on the prefetch thread, so the errors are returned instead of thrown
+  const char *pPosition(pMapElem->Attribute("global_position"));
+  const char *pSize(pMapElem->Attribute("global_size"));
+  if (!pPosition || !pSize) {
+    sError = "File " + m_sName + ".xml has no global_position or global_size";
+    return false;
+  }
+  const char *pBroadphase(pMapElem->Attribute("broadphase"));
+  EBroadphaseTypes eBroadphaseType(BT_AXIS_SWEEP);
+  if (pBroadphase) {
+    if (BROADPHASE_TYPES_ID_MAP.toString(BT_DBVT) == pBroadphase) {
+      eBroadphaseType = BT_DBVT;
+    }
+    else if (BROADPHASE_TYPES_ID_MAP.toString(BT_AXIS_SWEEP) != pBroadphase) {
+      sError = "File " + m_sName + ".xml has the unknown broadphase '" + pBroadphase + "'";
+      return false;
+    }
+  }
+
+  m_vGlobalPosition = Ogre::StringConverter::parseVector3(pPosition);
+  m_vGlobalSize = Ogre::StringConverter::parseVector2(pSize);
+  m_fVisionLevelOffset = RealAttribute(pMapElem, "vision_level_offset", 0.f);
+  m_eBroadphaseType = eBroadphaseType;
+  return true;
+}
+
+std::string CMapPack::getPackFile() const {
+  return m_sPath + m_sName + (m_bPackArchive ? PackArchive::PACK_ARCHIVE_EXTENSION : ".zip");
+}
+
+const char *CMapPack::getArchiveType() const {
+#if OGRE_PLATFORM == OGRE_PLATFORM_ANDROID
+  return "APKZip";
+#else
+  return m_bPackArchive ? PackArchive::PACK_ARCHIVE_TYPE : "Zip";
+#endif // OGRE_PLATFORM
 }
@@ -24,48 +24,99 @@
 #include <memory>
 #include <OgreVector3.h>
 #include <OgreVector2.h>
+#include <OgreArchive.h>
 #include "../../Common/XMLResources/Manager.hpp"
+#include "../../Common/Physics/BroadphaseTypes.hpp"
 
 class CMapPackParserListener;
+namespace tinyxml2 {
+  class XMLElement;
+  class XMLDocument;
+};
 
 class CMapPack {
 private:
   const std::string m_sPath;
   const std::string m_sName;
   const std::string m_sResourceGroup;
+  const bool m_bPackArchive;                //!< mount the pack archive (see CPackArchive) instead of the zip file
 
   bool m_bInitialized;
+  bool m_bPrefetched;
   CMapPackParserListener *m_pListener;
 
+  std::string m_sXmlData;                   //!< content of the map xml file, if prefetched (to read it again after parse())
+  std::string m_sSceneData;                 //!< content of the (cooked) scene file, if prefetched
+  size_t m_uiPackSize;                      //!< size of the pack file in bytes, if prefetched
+  std::string m_sPrefetchError;             //!< why the last prefetch failed, logged by the main thread
+  std::unique_ptr<tinyxml2::XMLDocument> m_pXMLDocument;  //!< read but not yet parsed map xml file, also the one of the prefetch
+
 
   std::string m_sSceneFile;
 
   Ogre::Vector3 m_vGlobalPosition;
   Ogre::Vector2 m_vGlobalSize;
   Ogre::Real    m_fVisionLevelOffset;
+  EBroadphaseTypes m_eBroadphaseType;      //!< broadphase of the physics world of the map, if it has its own
+  bool m_bResourceManifest;                 //!< only the resources of the manifest were loaded by init()
 
   XMLResources::CManager mLanguageManager;
 public:
   CMapPack(const std::string &path, const std::string &name);
   ~CMapPack();
 
+  //! read the map xml file directly from the pack without the resource group manager
+  /**
+    * This can be called from any thread, it does not touch any Ogre manager
+    * and does not throw, see getPrefetchError(). The global position and
+    * size are valid afterwards, the parsed document is kept for parse().
+    */
+  bool prefetchDescription();
+  //! read the xml and the scene file, and the whole pack once into the file cache
+  /**
+    * This can be called from any thread. init() and parse() will use the
+    * prefetched data instead of reading the files again.
+    */
+  bool prefetch();
+  bool isPrefetched() const {return m_bPrefetched;}
+  //! the reason of a failed prefetch, the worker can not log to the log manager
+  const std::string &getPrefetchError() const {return m_sPrefetchError;}
+  size_t getPackSize() const {return m_uiPackSize;}
+
   void init(CMapPackParserListener *pListener);
+  //! read the map xml file (if not prefetched), the global placement is valid afterwards
+  void readXMLFile();
+  //! create the entities of the map xml file (reads it if required)
   void parse();
   void exit();
 
   const std::string &getPath() const {return m_sPath;}
   const std::string &getName() const {return m_sName;}
   const std::string &getResourceGroup() const {return m_sResourceGroup;}
+  bool isPackArchive() const {return m_bPackArchive;}
 
   const Ogre::Vector3 &getGlobalPosition() const {return m_vGlobalPosition;}
   const Ogre::Vector2 &getGlobalSize() const {return m_vGlobalSize;}
   const Ogre::Real &getVisionLevelOffset() const {return m_fVisionLevelOffset;}
+  EBroadphaseTypes getBroadphaseType() const {return m_eBroadphaseType;}
 
   const std::string &getSceneFile() const {return m_sSceneFile;}
+  //! content of the cooked or the xml scene file if prefetched, else empty
+  const std::string &getSceneData() const {return m_sSceneData;}
   const XMLResources::CManager &getLanguageManager() const {return mLanguageManager;}
 
+  //! log how many bytes of the pack are loaded, the other resources are loaded on demand
+  void logLoadedResources() const;
+
 private:
-  void parseXMLFile();
+  //! load the resources of the manifest, or the whole group if the pack has none
+  void loadResources();
+  //! the file is loaded by a resource manager or read by the map itself
+  bool isFileLoaded(const Ogre::FileInfo &info) const;
+  //! false and the reason in sError if the placement is missing or invalid
+  bool parseGlobalPlacement(const tinyxml2::XMLElement *pMapElem, std::string &sError);
+  std::string getPackFile() const;
+  const char *getArchiveType() const;
 };
 
 typedef std::shared_ptr<CMapPack> CMapPackPtr;
@@ -0,0 +1,110 @@
+/*****************************************************************************
+ * Copyright 2014 Christoph Wick
+ *
+ * This file is part of Zelda.
+ *
+ * Zelda is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zelda is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Zelda. If not, see http://www.gnu.org/licenses/.
+ *****************************************************************************/
+
+#include "MapPool.hpp"
+#include "Map.hpp"
+#include <OgrePlatform.h>
+#include <OgreLogManager.h>
+#include <OgreStringConverter.h>
+#include "../../Common/Util/Assert.hpp"
+
+#if OGRE_PLATFORM == OGRE_PLATFORM_ANDROID
+const size_t CMapPool::DEFAULT_MEMORY_BUDGET(32 * 1024 * 1024);
+#else
+const size_t CMapPool::DEFAULT_MEMORY_BUDGET(128 * 1024 * 1024);
+#endif
+
+CMapPool::CMapPool(CEntity *pAtlas, size_t uiMemoryBudget)
+  : m_pAtlas(pAtlas),
+    m_uiMemoryBudget(uiMemoryBudget),
+    m_uiResidentBytes(0),
+    m_uiRequestCount(0),
+    m_uiHitCount(0) {
+}
+
+CMapPool::~CMapPool() {
+  for (SEntry &entry : m_lEntries) {
+    entry.pMap->deleteNow();
+  }
+  m_lEntries.clear();
+  m_uiResidentBytes = 0;
+}
+
+CMap *CMapPool::take(const std::string &sMap) {
+  m_uiRequestCount++;
+  for (auto it = m_lEntries.begin(); it != m_lEntries.end(); ++it) {
+    if (it->pMap->getMapPack()->getName() != sMap) {continue;}
+
+    CMap *pMap(it->pMap);
+    m_uiResidentBytes -= it->uiBytes;
+    m_lEntries.erase(it);
+    m_uiHitCount++;
+    pMap->resume(m_pAtlas);
+
+    Ogre::LogManager::getSingleton().logMessage("Map pool: resumed '" + sMap + "' ("
+        + Ogre::StringConverter::toString(m_uiHitCount) + " of "
+        + Ogre::StringConverter::toString(m_uiRequestCount) + " requests were hits)");
+    return pMap;
+  }
+
+  Ogre::LogManager::getSingleton().logMessage("Map pool: '" + sMap + "' is not resident ("
+      + Ogre::StringConverter::toString(m_uiHitCount) + " of "
+      + Ogre::StringConverter::toString(m_uiRequestCount) + " requests were hits)");
+  return nullptr;
+}
+
+void CMapPool::add(CMap *pMap) {
+  ASSERT(pMap);
+  pMap->suspend();
+
+  SEntry entry;
+  entry.pMap = pMap;
+  entry.uiBytes = pMap->getMemoryUsage();
+  m_lEntries.push_front(entry);
+  m_uiResidentBytes += entry.uiBytes;
+
+  evict();
+  logResidentMaps();
+}
+
+void CMapPool::setMemoryBudget(size_t uiMemoryBudget) {
+  m_uiMemoryBudget = uiMemoryBudget;
+  evict();
+}
+
+void CMapPool::evict() {
+  while (m_uiResidentBytes > m_uiMemoryBudget && !m_lEntries.empty()) {
+    SEntry &entry(m_lEntries.back());
+    Ogre::LogManager::getSingleton().logMessage("Map pool: evicting '" + entry.pMap->getMapPack()->getName() + "' ("
+        + Ogre::StringConverter::toString(entry.uiBytes) + " bytes)");
+    m_uiResidentBytes -= entry.uiBytes;
+    entry.pMap->deleteNow();
+    m_lEntries.pop_back();
+  }
+}
+
+void CMapPool::logResidentMaps() const {
+  Ogre::String sMaps;
+  for (const SEntry &entry : m_lEntries) {
+    sMaps += " '" + entry.pMap->getMapPack()->getName() + "': " + Ogre::StringConverter::toString(entry.uiBytes);
+  }
+  Ogre::LogManager::getSingleton().logMessage("Map pool: "
+      + Ogre::StringConverter::toString(m_uiResidentBytes) + " of "
+      + Ogre::StringConverter::toString(m_uiMemoryBudget) + " bytes resident" + sMaps);
+}
@@ -0,0 +1,76 @@
+/*****************************************************************************
+ * Copyright 2014 Christoph Wick
+ *
+ * This file is part of Zelda.
+ *
+ * Zelda is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zelda is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Zelda. If not, see http://www.gnu.org/licenses/.
+ *****************************************************************************/
+
+#ifndef _MAP_POOL_HPP_
+#define _MAP_POOL_HPP_
+
+#include <string>
+#include <list>
+#include <cstddef>
+
+class CEntity;
+class CMap;
+
+//! Keeps recently left maps resident, so that re-entering them is not a full load
+/**
+  * A map that is left is suspended (see CMap::suspend) instead of deleted and
+  * can be resumed with all its state (destroyed bushes, moved objects, ...).
+  * The maps are evicted in least recently used order as soon as the estimated
+  * memory of all resident maps exceeds the budget.
+  */
+class CMapPool {
+public:
+  static const size_t DEFAULT_MEMORY_BUDGET;
+private:
+  struct SEntry {
+    CMap *pMap;
+    size_t uiBytes;                   //!< estimated memory when the map was suspended
+  };
+
+  CEntity *m_pAtlas;
+  std::list<SEntry> m_lEntries;       //!< most recently used first
+  size_t m_uiMemoryBudget;
+  size_t m_uiResidentBytes;
+
+  // statistics
+  unsigned int m_uiRequestCount;
+  unsigned int m_uiHitCount;
+public:
+  CMapPool(CEntity *pAtlas, size_t uiMemoryBudget = DEFAULT_MEMORY_BUDGET);
+  ~CMapPool();
+
+  //! resume the map if it is resident, the pool releases its ownership, nullptr on a miss
+  CMap *take(const std::string &sMap);
+  //! suspend the left map and keep it, this may evict other maps or the map itself
+  void add(CMap *pMap);
+
+  void setMemoryBudget(size_t uiMemoryBudget);
+  size_t getMemoryBudget() const {return m_uiMemoryBudget;}
+  size_t getResidentBytes() const {return m_uiResidentBytes;}
+  size_t getResidentMapCount() const {return m_lEntries.size();}
+  unsigned int getRequestCount() const {return m_uiRequestCount;}
+  unsigned int getHitCount() const {return m_uiHitCount;}
+
+private:
+  //! delete the least recently used maps until the resident memory fits into the budget
+  void evict();
+  void logResidentMaps() const;
+};
+
+#endif // _MAP_POOL_HPP_
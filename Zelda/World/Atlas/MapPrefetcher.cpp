@@ -0,0 +1,227 @@
+/*****************************************************************************
+ * Copyright 2014 Christoph Wick
+ *
+ * This file is part of Zelda.
+ *
+ * Zelda is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zelda is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Zelda. If not, see http://www.gnu.org/licenses/.
+ *****************************************************************************/
+
+#include "MapPrefetcher.hpp"
+#include <OgreLogManager.h>
+#include <OgreStringConverter.h>
+#include <OgreFileSystem.h>
+#include <cmath>
+#include "../../Common/Log.hpp"
+#include "../../Common/FileManager/PackArchive.hpp"
+
+CMapPrefetcher::CMapPrefetcher(const std::string &sAtlasPath)
+  : m_sAtlasPath(sAtlasPath),
+    m_bRunning(true),
+    m_bCurrentMapChanged(false),
+    m_fLastHitch(0),
+    m_uiSwitchCount(0),
+    m_uiPrefetchHitCount(0) {
+  m_Thread = std::thread(&CMapPrefetcher::threadMain, this);
+}
+
+CMapPrefetcher::~CMapPrefetcher() {
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_bRunning = false;
+  }
+  m_Condition.notify_all();
+  m_Thread.join();
+}
+
+CMapPackPtr CMapPrefetcher::takeMapPack(const std::string &sMap) {
+  std::unique_lock<std::mutex> lock(m_Mutex);
+  auto it = m_mEntries.find(sMap);
+  if (it != m_mEntries.end() && it->second.eState == PS_LOADING) {
+    // finishing the prefetch is faster than starting again
+    m_Condition.wait(lock, [this, &sMap]() {
+        auto itEntry = m_mEntries.find(sMap);
+        return itEntry == m_mEntries.end() || itEntry->second.eState != PS_LOADING;
+      });
+    it = m_mEntries.find(sMap);
+  }
+
+  CMapPackPtr mapPack;
+  if (it != m_mEntries.end()) {
+    if (it->second.eState == PS_READY) {
+      mapPack = it->second.pMapPack;
+    }
+    m_mEntries.erase(it);
+  }
+  if (!mapPack) {
+    mapPack = CMapPackPtr(new CMapPack(m_sAtlasPath, sMap));
+  }
+  return mapPack;
+}
+
+void CMapPrefetcher::mapCreated(const CMapPackPtr &mapPack, Ogre::Real fHitch) {
+  m_fLastHitch = fHitch;
+  m_uiSwitchCount++;
+  if (mapPack->isPrefetched()) {
+    m_uiPrefetchHitCount++;
+  }
+  Ogre::LogManager::getSingleton().logMessage("Creation of map '" + mapPack->getName() + "' took "
+      + Ogre::StringConverter::toString(fHitch * 1000) + " ms"
+      + (mapPack->isPrefetched() ? " (prefetched, " : " (not prefetched, ")
+      + Ogre::StringConverter::toString(m_uiPrefetchHitCount) + " of "
+      + Ogre::StringConverter::toString(m_uiSwitchCount) + " maps were prefetched)");
+
+  setCurrentMap(mapPack->getName());
+}
+
+void CMapPrefetcher::setCurrentMap(const std::string &sMap) {
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_sCurrentMap = sMap;
+    m_bCurrentMapChanged = true;
+  }
+  m_Condition.notify_all();
+}
+
+CMapPrefetcher::EPrefetchState CMapPrefetcher::getState(const std::string &sMap) const {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  auto it = m_mEntries.find(sMap);
+  if (it == m_mEntries.end()) {return PS_NONE;}
+  return it->second.eState;
+}
+
+std::vector<CMapPackPtr> CMapPrefetcher::getReadyMapPacks() const {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  std::vector<CMapPackPtr> vPacks;
+  for (const auto &entry : m_mEntries) {
+    if (entry.second.eState == PS_READY) {
+      vPacks.push_back(entry.second.pMapPack);
+    }
+  }
+  return vPacks;
+}
+
+void CMapPrefetcher::logErrors() {
+  std::vector<std::string> vErrors;
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    if (m_vErrors.empty()) {return;}
+    vErrors.swap(m_vErrors);
+  }
+  for (const std::string &sError : vErrors) {
+    Ogre::LogManager::getSingleton().logMessage(sError, Ogre::LML_CRITICAL);
+  }
+}
+
+void CMapPrefetcher::threadMain() {
+  readMapInfos();
+
+  std::unique_lock<std::mutex> lock(m_Mutex);
+  while (true) {
+    m_Condition.wait(lock, [this]() {return !m_bRunning || m_bCurrentMapChanged || !m_dQueue.empty();});
+    if (!m_bRunning) {return;}
+
+    if (m_bCurrentMapChanged) {
+      m_bCurrentMapChanged = false;
+      updateNeighbourhood(m_sCurrentMap);
+      continue;
+    }
+
+    const std::string sMap(m_dQueue.front());
+    m_dQueue.pop_front();
+    auto it = m_mEntries.find(sMap);
+    if (it == m_mEntries.end() || it->second.eState != PS_QUEUED) {continue;}
+
+    it->second.eState = PS_LOADING;
+    CMapPackPtr mapPack(it->second.pMapPack);
+    lock.unlock();
+    const bool bSuccess = mapPack->prefetch();
+    lock.lock();
+
+    // the entry is not removed while it is loading
+    it = m_mEntries.find(sMap);
+    it->second.eState = bSuccess ? PS_READY : PS_FAILED;
+    if (!bSuccess) {
+      m_vErrors.push_back("Prefetching map pack '" + sMap + "' failed: " + mapPack->getPrefetchError());
+    }
+    LOGV("Prefetched map pack '%s': %s, %d bytes", sMap.c_str(), bSuccess ? "ready" : "failed", static_cast<int>(mapPack->getPackSize()));
+    m_Condition.notify_all();
+  }
+}
+
+void CMapPrefetcher::readMapInfos() {
+  // a private archive, the archive manager is not thread safe
+  Ogre::FileSystemArchive directory(m_sAtlasPath, "FileSystem", true);
+  directory.load();
+  // a map may have a zip file and a pack archive
+  Ogre::StringVectorPtr packs(directory.find("*.zip", false));
+  Ogre::StringVectorPtr packArchives(directory.find(Ogre::String("*") + PackArchive::PACK_ARCHIVE_EXTENSION, false));
+  packs->insert(packs->end(), packArchives->begin(), packArchives->end());
+  for (const Ogre::String &sPack : *packs) {
+    if (!m_bRunning) {break;}
+
+    const std::string sMap(sPack.substr(0, sPack.find_last_of('.')));
+    if (m_mMapInfos.count(sMap) > 0) {continue;}
+    CMapPack mapPack(m_sAtlasPath, sMap);
+    if (mapPack.prefetchDescription()) {
+      m_mMapInfos[sMap] = {mapPack.getGlobalPosition(), mapPack.getGlobalSize()};
+    }
+    else {
+      std::lock_guard<std::mutex> lock(m_Mutex);
+      m_vErrors.push_back("Reading the description of map pack '" + sMap + "' failed: " + mapPack.getPrefetchError());
+    }
+  }
+  directory.unload();
+  LOGV("Map prefetcher knows %d maps", static_cast<int>(m_mMapInfos.size()));
+}
+
+void CMapPrefetcher::updateNeighbourhood(const std::string &sCurrentMap) {
+  std::set<std::string> sNeighbours;
+  auto itCurrent = m_mMapInfos.find(sCurrentMap);
+  if (itCurrent != m_mMapInfos.end()) {
+    for (const auto &info : m_mMapInfos) {
+      if (info.first != sCurrentMap && isAdjacent(itCurrent->second, info.second)) {
+        sNeighbours.insert(info.first);
+      }
+    }
+  }
+
+  for (auto it = m_mEntries.begin(); it != m_mEntries.end();) {
+    if (sNeighbours.count(it->first) == 0 && it->second.eState != PS_LOADING) {
+      it = m_mEntries.erase(it);
+    }
+    else {
+      ++it;
+    }
+  }
+  for (const std::string &sMap : sNeighbours) {
+    if (m_mEntries.count(sMap) == 0) {
+      m_mEntries[sMap] = {PS_QUEUED, CMapPackPtr(new CMapPack(m_sAtlasPath, sMap))};
+      m_dQueue.push_back(sMap);
+    }
+  }
+}
+
+bool CMapPrefetcher::isAdjacent(const SMapInfo &a, const SMapInfo &b) {
+  // same test as the direction of a map switch in the atlas, the global size is in x and z
+  const Ogre::Real fEps = 0.01;
+  const bool bTouchX = std::abs(a.vGlobalPosition.x + a.vGlobalSize.x - b.vGlobalPosition.x) < fEps
+    || std::abs(b.vGlobalPosition.x + b.vGlobalSize.x - a.vGlobalPosition.x) < fEps;
+  const bool bTouchZ = std::abs(a.vGlobalPosition.z + a.vGlobalSize.y - b.vGlobalPosition.z) < fEps
+    || std::abs(b.vGlobalPosition.z + b.vGlobalSize.y - a.vGlobalPosition.z) < fEps;
+  const bool bOverlapX = a.vGlobalPosition.x < b.vGlobalPosition.x + b.vGlobalSize.x - fEps
+    && b.vGlobalPosition.x < a.vGlobalPosition.x + a.vGlobalSize.x - fEps;
+  const bool bOverlapZ = a.vGlobalPosition.z < b.vGlobalPosition.z + b.vGlobalSize.y - fEps
+    && b.vGlobalPosition.z < a.vGlobalPosition.z + a.vGlobalSize.y - fEps;
+  return (bTouchX && bOverlapZ) || (bTouchZ && bOverlapX);
+}
@@ -0,0 +1,119 @@
+/*****************************************************************************
+ * Copyright 2014 Christoph Wick
+ *
+ * This file is part of Zelda.
+ *
+ * Zelda is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zelda is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Zelda. If not, see http://www.gnu.org/licenses/.
+ *****************************************************************************/
+
+#ifndef _MAP_PREFETCHER_HPP_
+#define _MAP_PREFETCHER_HPP_
+
+#include <string>
+#include <map>
+#include <set>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <OgreVector3.h>
+#include <OgreVector2.h>
+#include "MapPack.hpp"
+
+//! Prefetches the map packs adjacent to the current map on a background thread
+/**
+  * The adjacency is given by the global position and size of each map of the
+  * atlas. The thread reads the descriptions of all packs once, afterwards it
+  * prefetches the neighbours of the current map (see CMapPack::prefetch) and
+  * drops the prefetched packs that are not adjacent anymore.
+  *
+  * Only the file access and the xml reading is done in the background, the
+  * Ogre managers are not thread safe, so mounting the pack and creating the
+  * scene remains on the main thread. For the same reason the errors of the
+  * thread are collected and written to the log by logErrors().
+  */
+class CMapPrefetcher {
+public:
+  enum EPrefetchState {
+    PS_NONE,                  //!< map is not adjacent to the current map
+    PS_QUEUED,
+    PS_LOADING,
+    PS_READY,
+    PS_FAILED,
+  };
+private:
+  struct SMapInfo {
+    Ogre::Vector3 vGlobalPosition;
+    Ogre::Vector2 vGlobalSize;
+  };
+  struct SEntry {
+    EPrefetchState eState;
+    CMapPackPtr pMapPack;
+  };
+
+  const std::string m_sAtlasPath;
+
+  // only used by the thread
+  std::map<std::string, SMapInfo> m_mMapInfos;
+
+  // guarded by the mutex
+  mutable std::mutex m_Mutex;
+  std::condition_variable m_Condition;
+  std::atomic<bool> m_bRunning;
+  std::string m_sCurrentMap;
+  bool m_bCurrentMapChanged;
+  std::map<std::string, SEntry> m_mEntries;
+  std::deque<std::string> m_dQueue;
+  std::vector<std::string> m_vErrors;         //!< failed prefetches, not logged yet
+
+  // statistics, main thread only
+  Ogre::Real m_fLastHitch;                    //!< time in seconds the last map creation blocked the main thread
+  unsigned int m_uiSwitchCount;
+  unsigned int m_uiPrefetchHitCount;
+
+  std::thread m_Thread;
+public:
+  CMapPrefetcher(const std::string &sAtlasPath);
+  ~CMapPrefetcher();
+
+  //! get the prefetched pack of the map, or a new one if it is not prefetched
+  /**
+    * If the pack is currently loading, this waits until it is finished.
+    */
+  CMapPackPtr takeMapPack(const std::string &sMap);
+  //! record the time the creation of the map took and prefetch its neighbours
+  void mapCreated(const CMapPackPtr &mapPack, Ogre::Real fHitch);
+  //! prefetch the neighbours of a map that was not created (e.g. taken from the map pool)
+  void setCurrentMap(const std::string &sMap);
+
+  EPrefetchState getState(const std::string &sMap) const;
+  //! the packs of all neighbours whose prefetch is finished, they stay in the prefetcher until taken
+  std::vector<CMapPackPtr> getReadyMapPacks() const;
+  //! write the errors of the thread to the log, has to be called from the main thread
+  void logErrors();
+  Ogre::Real getLastHitch() const {return m_fLastHitch;}
+  unsigned int getSwitchCount() const {return m_uiSwitchCount;}
+  unsigned int getPrefetchHitCount() const {return m_uiPrefetchHitCount;}
+
+private:
+  void threadMain();
+  void readMapInfos();
+  //! drop the entries that are not adjacent to the current map and queue the new ones
+  void updateNeighbourhood(const std::string &sCurrentMap);
+  static bool isAdjacent(const SMapInfo &a, const SMapInfo &b);
+};
+
+#endif // _MAP_PREFETCHER_HPP_
@@ -31,6 +31,8 @@ using namespace XMLHelper;
 CRegion::CRegion(CWorldEntity *pParent, const SRegionInfo &info)
   : CWorldEntity(info.ID, pParent, pParent->getMap()),
     m_Info(info) {
+  // regions are only checked for collisions by the map
+  setUpdatePhases(EUPM_NONE);
 }
 
 CRegion::CRegion(CWorldEntity *pParent, const tinyxml2::XMLElement *pElem)
@@ -39,7 +41,9 @@ CRegion::CRegion(CWorldEntity *pParent, const tinyxml2::XMLElement *pElem)
           Ogre::StringConverter::parseVector3(Attribute(pElem, "size")),
           Attribute(pElem, "id"),
           Attribute(pElem, "shape")}){
-
+  // the position in the map file is relative to the map
+  m_Info.position += m_pMap->getWorldOffset();
+  setUpdatePhases(EUPM_NONE);
 }
 
 CRegion::~CRegion() {
@@ -39,7 +39,8 @@ const Ogre::Real AERIAL_CAMERA_MOVE_SPEED(1);
 
 CAerialCameraPerspective::CAerialCameraPerspective(Ogre::Camera *pCamera,
                                                    CWorldEntity *pTarget)
-  : m_pCamera(pCamera),
+  : CMessageInjector(false),
+    m_pCamera(pCamera),
     m_pTarget(pTarget),
     m_vMinCamPoint(Ogre::Vector2::ZERO),
     m_vMaxCamPoint(Ogre::Vector2::ZERO),
@@ -50,6 +51,8 @@ CAerialCameraPerspective::CAerialCameraPerspective(Ogre::Camera *pCamera,
   //m_pSceneNode->attachObject(pCamera);
   m_pCamera->setPosition(AERIAL_CAMERA_OFFSET);
   m_pCamera->lookAt(0, 0, 0);
+
+  subscribeMessage(MSG_SWITCH_MAP);
 }
 
 CAerialCameraPerspective::~CAerialCameraPerspective() {
@@ -115,7 +118,7 @@ Ogre::Vector3 CAerialCameraPerspective::getRayPlaneHitPosition(int iRayIndex, Og
 
 void CAerialCameraPerspective::sendMessageToAll(const CMessage &message) {
   if (message.getType() == MSG_SWITCH_MAP) {
-    const CMessageSwitchMap &switch_map_message(dynamic_cast<const CMessageSwitchMap&>(message));
+    const CMessageSwitchMap &switch_map_message(message.getAs<CMessageSwitchMap>());
     if (switch_map_message.getStatus() == CMessageSwitchMap::SWITCHING) {
       if (switch_map_message.getSwitchMapType() == SMT_MOVE_CAMERA) {
         m_bSwitchingMap = true;
@@ -129,9 +132,10 @@ void CAerialCameraPerspective::sendMessageToAll(const CMessage &message) {
       }
       else {
         const CMapPackPtr pack = switch_map_message.getFromMap()->getMapPack();
+        const Ogre::Vector3 &vOffset(switch_map_message.getFromMap()->getWorldOffset());
         Ogre::Vector2 vSize(pack->getGlobalSize().x, pack->getGlobalSize().y);
-        m_vMinCamPoint = -vSize / 2;
-        m_vMaxCamPoint = vSize / 2;
+        m_vMinCamPoint = Ogre::Vector2(vOffset.x, vOffset.z) - vSize / 2;
+        m_vMaxCamPoint = Ogre::Vector2(vOffset.x, vOffset.z) + vSize / 2;
 
         m_fVisionLevelOffset = pack->getVisionLevelOffset();
 
@@ -142,10 +146,12 @@ void CAerialCameraPerspective::sendMessageToAll(const CMessage &message) {
     else if (switch_map_message.getStatus() == CMessageSwitchMap::FINISHED) {
       m_bSwitchingMap = false;
 
+      // maps in a streamed world are offset
       const CMapPackPtr pack = switch_map_message.getFromMap()->getMapPack();
+      const Ogre::Vector3 &vOffset(switch_map_message.getFromMap()->getWorldOffset());
       Ogre::Vector2 vSize(pack->getGlobalSize().x, pack->getGlobalSize().y);
-      m_vMinCamPoint = -vSize / 2;
-      m_vMaxCamPoint = vSize / 2;
+      m_vMinCamPoint = Ogre::Vector2(vOffset.x, vOffset.z) - vSize / 2;
+      m_vMaxCamPoint = Ogre::Vector2(vOffset.x, vOffset.z) + vSize / 2;
 
       m_fVisionLevelOffset = pack->getVisionLevelOffset();
 
@@ -20,6 +20,7 @@
 #include "Character.hpp"
 #include "CharacterController.hpp"
 #include "../Atlas/Map.hpp"
+#include "../../Common/Physics/PhysicsManager.hpp"
 #include "../../Common/Physics/PhysicsMasks.hpp"
 #include "../../Common/Physics/BtOgreExtras.hpp"
 #include <BulletDynamics/Character/btCharacterControllerInterface.h>
@@ -40,6 +41,9 @@ CCharacter::CCharacter(const std::string &sID, CEntity *pParent, CMap *pMap, con
   m_Anims.resize(m_uiAnimationCount);
   m_FadingStates.resize(m_uiAnimationCount);
   m_uiAnimID = m_uiAnimationCount;
+
+  // the character controllers can be prepared concurrently
+  setUpdatePhases(getUpdatePhases() | EUPM_PREPARE_UPDATE);
 }
 
 CCharacter::CCharacter(const tinyxml2::XMLElement *pElem, CEntity *pParent, CMap *pMap, const EFriendOrEnemyStates foe, unsigned int uiAnimationCount)
@@ -56,11 +60,18 @@ CCharacter::CCharacter(const tinyxml2::XMLElement *pElem, CEntity *pParent, CMap
   m_Anims.resize(m_uiAnimationCount);
   m_FadingStates.resize(m_uiAnimationCount);
   m_uiAnimID = m_uiAnimationCount;
+
+  // the character controllers can be prepared concurrently
+  setUpdatePhases(getUpdatePhases() | EUPM_PREPARE_UPDATE);
 }
 
 CCharacter::~CCharacter() {
 }
 void CCharacter::exit() {
+  if (m_pMap) {
+    // the callbacks of the queries refer to this character and its controller
+    m_pMap->getPhysicsManager()->getQueries().cancel(this);
+  }
   CWorldEntity::exit();
   destroyPhysics();
 }
@@ -68,6 +79,9 @@ void CCharacter::enterMap(CMap *pMap, const Ogre::Vector3 &vInitPosition) {
   // switch map only, if map an scene node are existing
   bool bSwitchMapOnly = m_pMap && m_pSceneNode;
 
+  if (m_pMap) {
+    m_pMap->getPhysicsManager()->getQueries().cancel(this);
+  }
   m_pMap = pMap;
 
   if (!bSwitchMapOnly) {
@@ -92,22 +106,18 @@ void CCharacter::enterMap(CMap *pMap, const Ogre::Vector3 &vInitPosition) {
 
 void CCharacter::createDamage(const Ogre::Ray &ray, const CDamage &dmg) const {
 	// try to interact with the world. So detect an object to interact with
-	btCollisionWorld::ClosestRayResultCallback rayCallback(BtOgre::Convert::toBullet(ray.getOrigin()), BtOgre::Convert::toBullet(ray.getPoint(1)));
-  if (m_eFriendOrEnemy == FOE_FRIENDLY) {
-    rayCallback.m_collisionFilterGroup = COL_DAMAGE_P;
-    rayCallback.m_collisionFilterMask = MASK_DAMAGE_P_COLLIDES_WITH;
-  }
-  else {
-    rayCallback.m_collisionFilterGroup = COL_DAMAGE_N;
-    rayCallback.m_collisionFilterMask = MASK_DAMAGE_N_COLLIDES_WITH;
-  }
-	m_pMap->getPhysicsManager()->getWorld()->rayTest(BtOgre::Convert::toBullet(ray.getOrigin()), BtOgre::Convert::toBullet(ray.getPoint(1)), rayCallback);
-	if (rayCallback.hasHit()) {
-    CWorldEntity *pWE = CWorldEntity::getFromUserPointer(rayCallback.m_collisionObject);
-    if (pWE) {
-      pWE->hit(dmg);
-		}
-	}
+	// the ray is tested with the other queries after the next physics step
+  const bool bFriendly = m_eFriendOrEnemy == FOE_FRIENDLY;
+  m_pMap->getPhysicsManager()->getQueries().ray(this, ray.getOrigin(), ray.getPoint(1),
+    bFriendly ? COL_DAMAGE_P : COL_DAMAGE_N,
+    bFriendly ? MASK_DAMAGE_P_COLLIDES_WITH : MASK_DAMAGE_N_COLLIDES_WITH,
+    [dmg](const SPhysicsQueryResult &result) {
+      if (!result.pCollisionObject) {return;}
+      CWorldEntity *pWE = CWorldEntity::getFromUserPointer(result.pCollisionObject);
+      if (pWE) {
+        pWE->hit(dmg);
+      }
+    });
 }
 
 void CCharacter::destroy() {
@@ -133,6 +143,12 @@ void CCharacter::setOrientation(const Ogre::Quaternion &vRotation) {
     m_pCharacterController->setOrientation(vRotation);
 }
 
+void CCharacter::prepareUpdate(Ogre::Real fTime) {
+  if (m_pCharacterController) {
+    m_pCharacterController->prepareCharacter(fTime);
+  }
+}
+
 void CCharacter::update(Ogre::Real fTime) {
   CWorldEntity::update(fTime);
 
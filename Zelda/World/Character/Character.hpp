@@ -138,6 +138,7 @@ public:
 
 	virtual void destroy();
 
+	void prepareUpdate(Ogre::Real fTime);
 	void update(Ogre::Real fTime);
 protected:
 	virtual void setupInternal() {};
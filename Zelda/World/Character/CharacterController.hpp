@@ -32,6 +32,8 @@ public:
 
   virtual inline void start() {}
 
+	//! thread safe part of the update, may be called concurrently for all characters before updateCharacter
+	virtual void prepareCharacter(Ogre::Real tpf) {}
 	virtual void updateCharacter(Ogre::Real tpf) = 0;
 
 	virtual void setPosition(const Ogre::Vector3 &vPos) = 0;
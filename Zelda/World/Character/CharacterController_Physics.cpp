@@ -140,6 +140,7 @@ CharacterControllerPhysics::CharacterControllerPhysics (CCharacterControllerPhys
 	m_walkDirection.setValue(0,0,0);
 	m_useGhostObjectSweepTest = true;
 	m_ghostObject = ghostObject;
+	m_previousPosition = m_ghostObject->getWorldTransform().getOrigin();
 	m_stepHeight = stepHeight;
 	m_turnAngle = btScalar(0.0);
 	m_convexShape=convexShape;
@@ -648,11 +649,13 @@ void CharacterControllerPhysics::warp (const btVector3& origin)
 	xform.setIdentity();
 	xform.setOrigin (origin);
 	m_ghostObject->setWorldTransform (xform);
+	m_previousPosition = origin;
 }
 
 
 void CharacterControllerPhysics::preStep (  btCollisionWorld* collisionWorld)
 {
+	m_previousPosition = m_ghostObject->getWorldTransform().getOrigin();
 
 	int numPenetrationLoops = 0;
 	m_touchingContact = false;
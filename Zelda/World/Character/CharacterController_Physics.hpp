@@ -72,6 +72,7 @@ protected:
 
 	//some internal variables
 	btVector3 m_currentPosition;
+	btVector3 m_previousPosition;	// position of the ghost object before the last step, for interpolation
 	btScalar  m_currentStepOffset;
 	btVector3 m_targetPosition;
 
@@ -184,6 +185,13 @@ public:
 		m_useGhostObjectSweepTest = useGhostObjectSweepTest;
 	}
 
+	/// position between the last two simulation steps, 0 is the previous, 1 the current step
+	/// (see CPhysicsManager::getInterpolationFactor)
+	btVector3 getInterpolatedPosition(btScalar factor) const
+	{
+		return m_previousPosition.lerp(m_ghostObject->getWorldTransform().getOrigin(), factor);
+	}
+
 	bool onGround () const;
   bool isStuck() const {return m_bStuck;}
 	void setUpInterpolate (bool value);
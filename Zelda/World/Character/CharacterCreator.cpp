@@ -6,6 +6,7 @@
 #include "../Character/SimpleEnemy.hpp"
 #include "../Character/StandingPerson.hpp"
 #include "../Character/LinksFather.hpp"
+#include "../Atlas/Map.hpp"
 
 using namespace XMLHelper;
 
@@ -17,7 +18,8 @@ CWorldEntity* CCharacterCreator::createCharacter(const tinyxml2::XMLElement *pEl
 
   const Ogre::Real rotation(RealAttribute(pElem, "rotation",0));
   const Ogre::Quaternion qOrientation(Ogre::Degree(rotation), Ogre::Vector3::UNIT_Y);
-  const Ogre::Vector3 position(Ogre::StringConverter::parseVector3(Attribute(pElem, "position")));
+  // the position in the map file is relative to the map
+  const Ogre::Vector3 position(Ogre::StringConverter::parseVector3(Attribute(pElem, "position")) + pMap->getWorldOffset());
 
   CWorldEntity *pEntity(nullptr);
 
@@ -189,7 +189,7 @@ void CPerson::setLeftHandleRotation(const Ogre::Degree &degree, Ogre::Real speed
 void CPerson::initBody(Ogre::SceneNode *pParentSceneNode) {
 	Ogre::String meshName = m_PersonData.sMeshName;
     // create main model
-    m_pSceneNode = pParentSceneNode->createChildSceneNode(m_sID + meshName);
+    m_pSceneNode = pParentSceneNode->createChildSceneNode(m_sID.str() + meshName);
     Ogre::SceneNode *pModelSN = m_pSceneNode->createChildSceneNode();
     pModelSN->setScale(m_PersonData.vScale);
     pModelSN->setPosition(0, -PERSON_PHYSICS_OFFSET, 0);
@@ -233,7 +233,7 @@ void CPerson::updateAnimationsCallback(const Ogre::Real fTime) {
   }
 }
 
-bool CPerson::collidesWith(const std::string &sEntityID) const {
+bool CPerson::collidesWith(const CAtom &sEntityID) const {
   for (const CWorldEntity *pWE : dynamic_cast<CharacterControllerPhysics*>(mCCPhysics)->getCollidingWorldEntities()) {
     // check if objects are part of the same map (problems when switching maps elsewise) and the ids match
     if (pWE->getMap() == m_pMap && pWE->getID() == sEntityID) {
@@ -250,7 +250,7 @@ bool CPerson::frameEnded(const Ogre::FrameEvent& evt) {
 
 void CPerson::createBlinkingMaterials() {
 	assert(m_pBodyEntity);
-  m_pMaterial = Ogre::MaterialManager::getSingleton().getByName(m_PersonData.sMaterialName)->clone(m_sID + "mat_" + m_PersonData.sMaterialName);
+  m_pMaterial = Ogre::MaterialManager::getSingleton().getByName(m_PersonData.sMaterialName)->clone(m_sID.str() + "mat_" + m_PersonData.sMaterialName);
   m_pBodyEntity->setMaterial(m_pMaterial);
 }
 void CPerson::removeBlinkingMaterials() {
@@ -64,7 +64,7 @@ public:
 
   void attack(unsigned int uiTool);
 
-  virtual bool collidesWith(const std::string &sEntityID) const;
+  virtual bool collidesWith(const CAtom &sEntityID) const;
   virtual void interact() {}
 
   virtual const Ogre::Vector3 getFloorPosition() const;
@@ -26,6 +26,8 @@
 #include "../../Common/Message/MessageHandler.hpp"
 #include "../../Common/Message/MessageTargetReached.hpp"
 #include "CharacterController_Physics.hpp"
+#include "../Atlas/Map.hpp"
+#include "../../Common/Physics/PhysicsManager.hpp"
 
 const Ogre::Real DEFAULT_PUSHED_BACK_TIME = 0.1f;
 const Ogre::Real WALK_SPEED = 6; 					//!< constant for the walk speed
@@ -46,19 +48,30 @@ CPersonController::CPersonController(CPerson * ccPlayer) {
 	mWalkDirection = Ogre::Vector3::ZERO;
 
 	m_fTimer = 0.0f;
+	m_Prepared.bValid = false;
 	changeMoveState(MS_NOT_MOVING); // default state
 }
 void CPersonController::setPosition(const Ogre::Vector3 &vPos) {
     mCCPhysics->warp(BtOgre::Convert::toBullet(vPos));
 }
 void CPersonController::setOrientation(const Ogre::Quaternion &vRotation) {
+    m_Prepared.bValid = false;
     mBodyNode->setOrientation(vRotation);
     mCCPerson->getCollisionObject()->getWorldTransform().setRotation(BtOgre::Convert::toBullet(vRotation));
 }
-void CPersonController::updateCharacter(const Ogre::Real deltaTime) {
+void CPersonController::prepareCharacter(const Ogre::Real deltaTime) {
 	using namespace Ogre;
 
-	m_fTimer -= deltaTime;
+	// only reads the world and writes the controller itself, this may run in a worker thread
+	m_Prepared.bValid = true;
+	m_Prepared.fDeltaTime = deltaTime;
+	m_Prepared.uiMoveState = m_uiCurrentMoveState;
+	m_Prepared.vTranslation = Vector3::ZERO;
+	m_Prepared.bTranslate = false;
+	m_Prepared.fYaw = 0;
+	m_Prepared.bMove = true;
+	m_Prepared.bTargetReached = false;
+
 	Real posIncrementPerSecond = m_fMoveSpeed;
 
 	Vector3 playerPos = mCCPerson->getPosition();
@@ -70,29 +83,17 @@ void CPersonController::updateCharacter(const Ogre::Real deltaTime) {
   Ogre::Vector3 vTranslateDirection = position - playerPos;
 	Vector3 physicsFloorPosition(mCCPerson->getFloorPosition() + vTranslateDirection);
 
+	// the body follows the physics between its last two fixed steps, so it moves smoothly at any frame rate
+	const Vector3 renderPosition(BtOgre::Convert::toOgre(mCCPhysics->getInterpolatedPosition(mCCPerson->getMap()->getPhysicsManager()->getInterpolationFactor())));
+	vTranslateDirection = renderPosition - playerPos;
 
-	if (position != playerPos)
+	if (renderPosition != playerPos)
 	{
 	  Ogre::Real fTranslateDistance = vTranslateDirection.normalise();
 	  Ogre::Real fDesiredDistance = 20 * deltaTime * m_fMoveSpeed / WALK_SPEED * fTranslateDistance;
 
-	  mBodyNode->translate(vTranslateDirection * std::min<Ogre::Real>(fTranslateDistance, fDesiredDistance));
-		//mBodyNode->setPosition(position);
-
-		if (!mIsFalling && !mCCPhysics->onGround()) // last frame we were on ground and now we're in "air"
-		{
-			mIsFalling = true;
-
-			if (!mJumped) // if we jumped, let the CharacterController_Player's updateAnimations take care about this
-				mCCPerson->animJumpLoop();
-		}
-		else if (mCCPhysics->onGround() && mIsFalling) // last frame we were falling and now we're on the ground
-		{
-			mIsFalling = false;
-			mJumped = false;
-
-			mCCPerson->animJumpEnd();
-		}
+	  m_Prepared.bTranslate = true;
+	  m_Prepared.vTranslation = vTranslateDirection * std::min<Ogre::Real>(fTranslateDistance, fDesiredDistance);
 	}
 
 	if (m_uiCurrentMoveState == MS_NORMAL || m_uiCurrentMoveState == MS_MOVE_TO_POINT
@@ -120,11 +121,13 @@ void CPersonController::updateCharacter(const Ogre::Real deltaTime) {
 			else {
         // move on
 			}
-			Ogre::Radian viewAngle(mGoalDirection.angleBetween(mBodyNode->_getDerivedOrientation().zAxis()));
+			// the parent nodes are not rotated, the local orientation is used, since
+			// the derived orientation would update the cache of the node
+			Ogre::Radian viewAngle(mGoalDirection.angleBetween(mBodyNode->getOrientation().zAxis()));
 			if (abs(viewAngle.valueRadians()) < getMaxTargetLookAngle()) {
 				// target reached if bMove == false
 				if (bMove == false) {
-          targetReached();
+          m_Prepared.bTargetReached = true;
 				}
 			}
 
@@ -145,7 +148,8 @@ void CPersonController::updateCharacter(const Ogre::Real deltaTime) {
 		}
 
 		if (m_uiCurrentMoveState == MS_MOVE_AROUND_TARGET) {
-			Ogre::Vector3 vTargetDir = getMoveAroundPosition() - mCCPerson->getPosition();
+			// position after the translation that is applied in updateCharacter
+			Ogre::Vector3 vTargetDir = getMoveAroundPosition() - (playerPos + m_Prepared.vTranslation);
 			Quaternion toGoal = mBodyNode->getOrientation().zAxis().getRotationTo(vTargetDir);
 
 			// calculate how much the character has to turn to face goal direction
@@ -159,7 +163,7 @@ void CPersonController::updateCharacter(const Ogre::Real deltaTime) {
 			else if (yawToGoal > 0) yawToGoal = std::max<Real>(0, std::min<Real>(yawToGoal, yawAtSpeed));
 
 
-			mBodyNode->yaw(Degree(yawToGoal));
+			m_Prepared.fYaw = yawToGoal;
 		}
 		else {
       if (vLookDirection != Vector3::ZERO) {
@@ -176,12 +180,59 @@ void CPersonController::updateCharacter(const Ogre::Real deltaTime) {
 				else if (yawToGoal > 0) yawToGoal = std::max<Real>(0, std::min<Real>(yawToGoal, yawAtSpeed));
 
 
-				mBodyNode->yaw(Degree(yawToGoal));
+				m_Prepared.fYaw = yawToGoal;
       }
 		}
 
+		m_Prepared.bMove = bMove;
+	}
+}
+void CPersonController::updateCharacter(const Ogre::Real deltaTime) {
+	using namespace Ogre;
+
+	if (!m_Prepared.bValid || m_Prepared.uiMoveState != m_uiCurrentMoveState || m_Prepared.fDeltaTime != deltaTime) {
+		// not prepared concurrently or the state was changed in the meantime
+		prepareCharacter(deltaTime);
+	}
+	m_Prepared.bValid = false;
+
+	m_fTimer -= deltaTime;
+	Real posIncrementPerSecond = m_fMoveSpeed;
+
+	if (m_Prepared.bTranslate)
+	{
+	  mBodyNode->translate(m_Prepared.vTranslation);
+		//mBodyNode->setPosition(position);
+
+		if (!mIsFalling && !mCCPhysics->onGround()) // last frame we were on ground and now we're in "air"
+		{
+			mIsFalling = true;
+
+			if (!mJumped) // if we jumped, let the CharacterController_Player's updateAnimations take care about this
+				mCCPerson->animJumpLoop();
+		}
+		else if (mCCPhysics->onGround() && mIsFalling) // last frame we were falling and now we're on the ground
+		{
+			mIsFalling = false;
+			mJumped = false;
+
+			mCCPerson->animJumpEnd();
+		}
+	}
+
+	if (m_uiCurrentMoveState == MS_NORMAL || m_uiCurrentMoveState == MS_MOVE_TO_POINT
+        || m_uiCurrentMoveState == MS_MOVE_AROUND_TARGET || m_uiCurrentMoveState == MS_AIMING) {
+
+		if (m_Prepared.bTargetReached) {
+			targetReached();
+		}
+
+		if (m_Prepared.fYaw != 0) {
+			mBodyNode->yaw(Degree(m_Prepared.fYaw));
+		}
+
     if (mGoalDirection != Vector3::ZERO) {
-      if (bMove) {
+      if (m_Prepared.bMove) {
         move(true, posIncrementPerSecond, mGoalDirection);
       }
       else {
@@ -260,6 +311,7 @@ void CPersonController::updateGoalDirection() {
 }
 void CPersonController::changeMoveState(unsigned int uiNewMoveState, const Ogre::Vector3 &vUserData, const Ogre::Real fUserData0, const Ogre::Real fUserData1) {
 	m_uiCurrentMoveState = uiNewMoveState;
+	m_Prepared.bValid = false;
 	m_fTimer = 0;
 	m_vUserData = vUserData;
 	m_fUserData0 = fUserData0;
@@ -282,7 +334,9 @@ void CPersonController::changeMoveState(unsigned int uiNewMoveState, const Ogre:
 
 void CPersonController::move(bool bMove, Ogre::Real fSpeed, const Ogre::Vector3 &vDir) {
   if (bMove) {
-		mCCPhysics->setWalkDirection(BtOgre::Convert::toBullet(vDir * fSpeed * WALK_SPEED_SCALE));
+		// the walk direction is applied in every physics step, WALK_SPEED_SCALE fits the default step rate
+		const Ogre::Real fStepScale(mCCPerson->getMap()->getPhysicsManager()->getFixedTimeStep() * PHYSICS_FIXED_STEP_RATE);
+		mCCPhysics->setWalkDirection(BtOgre::Convert::toBullet(vDir * fSpeed * WALK_SPEED_SCALE * fStepScale));
     mCCPhysics->setSubSteps(std::max<int>(ceil(fSpeed / WALK_SPEED), 1));
   }
   else {
@@ -312,5 +366,5 @@ void CPersonController::endRunning() {
 void CPersonController::targetReached() {
     changeMoveState(MS_NORMAL); // reset our state
 
-  CMessageHandler::getSingleton().addMessage(new CMessageTargetReached(mCCPerson));
+  CMessageHandler::getSingleton().createMessage<CMessageTargetReached>(mCCPerson);
 }
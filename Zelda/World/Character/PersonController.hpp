@@ -64,6 +64,18 @@ protected:
 	Ogre::Real m_fUserData0;						//!< Storage for a user data given for the move state
 	Ogre::Real m_fUserData1;						//!< Storage for a user data given for the move state
 
+	//! result of prepareCharacter that is applied in updateCharacter
+	struct SPreparedMove {
+		bool bValid;
+		Ogre::Real fDeltaTime;
+		unsigned int uiMoveState;					//!< the move state the result was calculated for
+		bool bTranslate;
+		Ogre::Vector3 vTranslation;					//!< translation of the body node towards the physics position
+		Ogre::Real fYaw;							//!< degrees to turn
+		bool bMove;
+		bool bTargetReached;
+	} m_Prepared;
+
 	// aliase, union does not work with classes (Ogre::Vector3)
 	inline Ogre::Vector3	&getPushedBackDirection() {return m_vUserData;}
 	inline Ogre::Real		&getPushedBackTime() {return m_fUserData0;}
@@ -94,6 +106,7 @@ public:
     virtual void setOrientation(const Ogre::Quaternion &vRotation);
 
 
+	void prepareCharacter(const Ogre::Real tpf);
 	void updateCharacter(const Ogre::Real tpf);
 
 	//!< change the move state
@@ -159,19 +159,18 @@ void CPlayer::interact() {
 	Ogre::Vector3 endPos(startPos + getOrientation().zAxis() * PERSON_RADIUS * 1.5f);
 
 	// try to interact with the world. So detect an object to interact with
-	btCollisionWorld::ClosestRayResultCallback rayCallback(BtOgre::Convert::toBullet(startPos), BtOgre::Convert::toBullet(endPos));
-	rayCallback.m_collisionFilterGroup = COL_CHARACTER_P;
-	rayCallback.m_collisionFilterMask = MASK_PLAYER_P_COLLIDES_WITH;
-	m_pMap->getPhysicsManager()->getWorld()->rayTest(BtOgre::Convert::toBullet(startPos), BtOgre::Convert::toBullet(endPos), rayCallback);
-	if (rayCallback.hasHit()) {
-    CWorldEntity *pWE = CWorldEntity::getFromUserPointer(rayCallback.m_collisionObject);
-    if (pWE) {
-      SInteractionResult res(pWE->interactOnActivate(getOrientation().zAxis(), this));
-			if (res.eResult == IR_LIFT) {
-        lift(pWE);
-			}
-		}
-	}
+	// the ray is tested with the other queries after the next physics step
+	m_pMap->getPhysicsManager()->getQueries().ray(this, startPos, endPos, COL_CHARACTER_P, MASK_PLAYER_P_COLLIDES_WITH,
+    [this](const SPhysicsQueryResult &result) {
+      if (!result.pCollisionObject || m_pLiftedEntity) {return;}
+      CWorldEntity *pWE = CWorldEntity::getFromUserPointer(result.pCollisionObject);
+      if (pWE) {
+        SInteractionResult res(pWE->interactOnActivate(getOrientation().zAxis(), this));
+        if (res.eResult == IR_LIFT) {
+          lift(pWE);
+        }
+      }
+    });
 }
 
 void CPlayer::update(Ogre::Real tpf) {
@@ -255,6 +254,14 @@ void CPlayer::enterMap(CMap *pMap, const Ogre::Vector3 &vInitPosition) {
   }
 }
 
+void CPlayer::crossMapBorder(CMap *pMap) {
+  CPerson::crossMapBorder(pMap);
+
+  if (m_pLiftedEntity) {
+    m_pLiftedEntity->crossMapBorder(pMap);
+  }
+}
+
 void CPlayer::lift(CWorldEntity *pObjectToLift) {
   ASSERT(!m_pLiftedEntity);
   m_pLiftedEntity = pObjectToLift;
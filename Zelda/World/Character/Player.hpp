@@ -44,6 +44,7 @@ public:
 	void startup(const Ogre::Vector3 &playerPos, const Ogre::Vector3 &playerLookDirection, const Ogre::Real cameraYaw, const Ogre::Real cameraPitch);
 protected:
   void enterMap(CMap *pMap, const Ogre::Vector3 &vInitPosition);
+  void crossMapBorder(CMap *pMap);
 	void setupInternal();
   void setupAnimations();
   EReceiveDamageResult receiveDamage(const CDamage &dmg);
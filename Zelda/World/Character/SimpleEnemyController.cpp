@@ -22,13 +22,16 @@
 #include "CharacterController_Physics.hpp"
 #include "Person.hpp"
 #include "Player.hpp"
+#include "../Atlas/Map.hpp"
+#include "../../Common/Physics/PhysicsManager.hpp"
+#include "../../Common/Physics/PhysicsMasks.hpp"
 #include <OgreMath.h>
 #include <OgreAnimationState.h>
 
 float test = 0.45;
 float test2 = 2;
 CSimpleEnemyController::CSimpleEnemyController(CPerson * ccPerson)
-  : CPersonController(ccPerson), m_pPlayer(NULL) {
+  : CPersonController(ccPerson), m_pPlayer(NULL), m_bPlayerVisible(false), m_uiVisibilityQuery(0) {
   changeMoveState(MS_USER_STATE);
 
   m_fMoveSpeed = 3;
@@ -109,7 +112,25 @@ void CSimpleEnemyController::userUpdateCharacter(const Ogre::Real tpf) {
 
 bool CSimpleEnemyController::notifiedByPlayer() {
   if (m_pPlayer->getPosition().squaredDistance(mCCPerson->getPosition()) < 0.25) {
-    return true;
+    // the player is only noticed if no wall is in between, the result of the
+    // query arrives after the next physics step
+    queryPlayerVisibility();
+    return m_bPlayerVisible;
   }
+  m_bPlayerVisible = false;
   return false;
 }
+
+void CSimpleEnemyController::queryPlayerVisibility() {
+  // the queries of the person are cancelled when it changes the map or is
+  // deleted, so ask whether the query is still pending instead of keeping a flag
+  CPhysicsQueries &queries(mCCPerson->getMap()->getPhysicsManager()->getQueries());
+  if (m_uiVisibilityQuery != 0 && queries.isPending(m_uiVisibilityQuery)) {return;}
+
+  m_uiVisibilityQuery = queries.ray(mCCPerson, mCCPerson->getPosition(), m_pPlayer->getPosition(),
+    COL_CHARACTER_N, COL_STATIC | COL_CHARACTER_P,
+    [this](const SPhysicsQueryResult &result) {
+      m_uiVisibilityQuery = 0;
+      m_bPlayerVisible = !result.bHit || (result.pCollisionObject && CWorldEntity::getFromUserPointer(result.pCollisionObject) == m_pPlayer);
+    });
+}
@@ -21,6 +21,7 @@
 #define _SIMPLE_ENEMY_CONTROLLER_H_
 
 #include "PersonController.hpp"
+#include "../../Common/Physics/PhysicsQueries.hpp"
 
 class CWorldEntity;
 
@@ -37,6 +38,8 @@ private:
   Ogre::Vector3 m_vCurrentWalkDir;
   Ogre::Real m_fTimeToNextAction;
   EKIState m_eCurrentKIState;
+  bool m_bPlayerVisible;				//!< result of the last line of sight query
+  CPhysicsQueries::QueryId m_uiVisibilityQuery;	//!< the line of sight query, a cancelled one is not pending anymore
 
 public:
 	CSimpleEnemyController(CPerson * ccPerson);
@@ -48,6 +51,7 @@ protected:
 	void userUpdateCharacter(const Ogre::Real tpf);
 	void postUpdateCharacter(Ogre::Real tpf);
   bool notifiedByPlayer();
+  void queryPlayerVisibility();
 };
 
 #endif
\ No newline at end of file
@@ -21,6 +21,7 @@
 #define _GLOBAL_COLLISION_SHAPES_TYPES_HPP_
 
 #include "../Common/Util/EnumIdMap.hpp"
+#include "../Common/Util/Atom.hpp"
 
 enum EGlobalCollisionShapesTypes {
   GCST_PICKABLE_OBJECT_SPHERE,
@@ -33,7 +34,8 @@ enum EGlobalCollisionShapesTypes {
   GCST_COUNT,
 };
 
-class CGlobalCollisionShapesTypesIdMap : public CEnumIdMap<EGlobalCollisionShapesTypes> {
+//! the ids are atoms, so that the lookup of the shapes in the physics manager does not hash the string
+class CGlobalCollisionShapesTypesIdMap : public CEnumIdMap<EGlobalCollisionShapesTypes, CAtom> {
 public:
   CGlobalCollisionShapesTypesIdMap();
 };
@@ -112,9 +112,9 @@ CHitableInterface::EReceiveDamageResult CHitableInterface::hit(const CDamage &da
 }
 
 void CHitableInterface::maxHitpointsChangedCallback() {
-  CMessageHandler::getSingleton().addMessage(new CMessageHitpointsChanged(*this));
+  CMessageHandler::getSingleton().createMessage<CMessageHitpointsChanged>(*this);
 }
 
 void CHitableInterface::hitpointsChangedCallback() {
-  CMessageHandler::getSingleton().addMessage(new CMessageHitpointsChanged(*this));
+  CMessageHandler::getSingleton().createMessage<CMessageHitpointsChanged>(*this);
 }
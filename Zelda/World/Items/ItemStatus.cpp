@@ -39,5 +39,5 @@ CItemStatusStorage::CItemStatusStorage() {
 }
 
 void CItemStatusStorage::load() {
-  CMessageHandler::getSingleton().addMessage(new CMessageItem(CMessageItem::IM_STATUS_LOADED, this));
+  CMessageHandler::getSingleton().createMessage<CMessageItem>(CMessageItem::IM_STATUS_LOADED, this);
 }
@@ -21,11 +21,14 @@
 #define _MESSAGE_ITEM_HPP_
 
 #include "../../Common/Message/Message.hpp"
+#include "UserMessageTypes.hpp"
 #include "../Items/ItemTypes.hpp"
 
 class CItemStatusStorage;
 
 class CMessageItem: public CMessage {
+public:
+  static const unsigned int MESSAGE_TYPE = MSG_ITEM;
 public:
   enum EItemMessageTypes {
     IM_SELECTION_CHANGED,
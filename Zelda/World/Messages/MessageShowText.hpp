@@ -21,11 +21,14 @@
 #define _MESSAGE_SHOW_TEXT_HPP_
 
 #include "../../Common/Message/Message.hpp"
+#include "UserMessageTypes.hpp"
 #include "../../Common/Util/EnumIdMap.hpp"
 #include "../../GUIComponents/GUITextBox.hpp"
 
 
 class CMessageShowText: public CMessage {
+public:
+  static const unsigned int MESSAGE_TYPE = MSG_SHOW_TEXT;
 public:
   enum EStatus {
     REQUEST,    //!< when a text box shall be shown
@@ -36,8 +36,6 @@
 #include "../../Common/Message/MessagePlayerPickupItem.hpp"
 #include "../Damage.hpp"
 
-unsigned int OBJECT_INNER_OBJECT_ID_NUMBER_COUNTER = 0;
-
 CObject::CObject(const std::string &id, CWorldEntity *pParent, CMap *pMap, EObjectTypes eObjectType, Ogre::SceneNode *pSceneNode)
   : CWorldEntity(id, pParent, pMap),
     m_ObjectTypeData(OBJECT_TYPE_ID_MAP.toData(eObjectType)) {
@@ -61,7 +59,8 @@ CObject::CObject(const std::string &id, CWorldEntity *pParent, CMap *pMap, EObje
     setCurAndMaxHP(HP_INFINITY);
   }
   else {
-    pEntity = pSceneManager->createEntity(id + "ent", m_ObjectTypeData.sMeshName + ".mesh", "World");
+    // named after the scene node, whose name is unique (the id may not)
+    pEntity = pSceneManager->createEntity(m_pSceneNode->getName() + "ent", m_ObjectTypeData.sMeshName + ".mesh", "World");
     pEntity->setMaterialName(m_ObjectTypeData.sMaterialName);
     m_pSceneNode->attachObject(pEntity);
     pEntity->setCastShadows(false);
@@ -201,6 +200,16 @@ void CObject::enterMap(CMap *pMap, const Ogre::Vector3 &vPosition) {
   setPosition(vPosition);
 }
 
+void CObject::crossMapBorder(CMap *pMap) {
+  attachTo(pMap);
+
+  // the scene nodes of maps sharing a world are not offset, keep the position
+  m_pSceneNode->getParent()->removeChild(m_pSceneNode);
+  pMap->getSceneNode()->addChild(m_pSceneNode);
+
+  CWorldEntity::crossMapBorder(pMap);
+}
+
 void CObject::changeState(EEntityStateTypes eState) {
   switch (m_uiType) {
   case OBJECT_GREEN_BUSH:
@@ -292,7 +301,9 @@ CObject::EReceiveDamageResult CObject::hit(const CDamage &dmg) {
 }
 
 void CObject::createInnerObject(EObjectTypes eType) {
-  CObject *pObject = new CObject(m_sID + "_inner" + Ogre::StringConverter::toString(OBJECT_INNER_OBJECT_ID_NUMBER_COUNTER++), m_pMap, m_pMap, eType);
+  // ids do not have to be unique, a counter would intern a new id for every inner object.
+  // But ogre names have to be, so ogre generates the name of the scene node
+  CObject *pObject = new CObject(m_sID.str() + "_inner", m_pMap, m_pMap, eType, m_pMap->getSceneNode()->createChildSceneNode());
   btRigidBody *pRB = btRigidBody::upcast(pObject->getCollisionObject());
   switch (m_uiType) {
   case OBJECT_GREEN_TREE:
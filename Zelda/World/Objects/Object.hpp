@@ -31,6 +31,7 @@ public:
 
 
   virtual void enterMap(CMap *pMap, const Ogre::Vector3 &vPosition);
+  virtual void crossMapBorder(CMap *pMap);
   
   void createInnerObject(EObjectTypes eType);
 
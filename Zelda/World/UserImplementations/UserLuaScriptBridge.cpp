@@ -1,21 +1,36 @@
 #include "UserLuaScriptBridge.hpp"
 #include <OgreStringConverter.h>
 #include "../../Common/Lua/LuaScriptManager.hpp"
+#include "../../Common/Lua/LuaScheduler.hpp"
 #include "../../Common/Log.hpp"
+#include "../../Common/Util/Assert.hpp"
 #include "../../Common/tinyxml2/tinyxml2.hpp"
-#include "../../Common/Util/Sleep.hpp"
 #include "../../Common/Message/MessageCreator.hpp"
 #include "../../Common/Message/MessageHandler.hpp"
-#include "../../Common/Message/MessageInjector.hpp"
 #include "../../Common/GameLogic/GameStateManager.hpp"
+#include "../../Common/GameLogic/EntityRegistry.hpp"
 
 #include "../../GUIComponents/GUITextBox.hpp"
-
-#include "../../Common/Message/MessageTargetReached.hpp"
 #include "../WorldEntity.hpp"
+#include <new>
 
 using namespace tinyxml2;
 
+namespace {
+  // metatable of the full userdata that holds an entity handle, a lua number
+  // can not represent every 64 bit key
+  const char *ENTITY_HANDLE_METATABLE = "CEntityHandle";
+}
+
+namespace luaHelper {
+  //! the entity with the id, the id is not interned if no entity has it
+  CEntity *findEntity(const char *pID) {
+    CAtom id;
+    if (!pID || !CAtom::find(pID, id)) {return nullptr;}
+    return CGameStateManager::getSingleton().getChildRecursive(id);
+  }
+};
+
 void userRegisterCFunctionsToLua(lua_State *l) {
   registerCFunctionsToLua(l); // original c bindings
 
@@ -24,110 +39,120 @@ void userRegisterCFunctionsToLua(lua_State *l) {
   registerSingleCFunctionsToLua(l, textMessage, "textMessage");
   registerSingleCFunctionsToLua(l, moveTo, "moveTo");
   registerSingleCFunctionsToLua(l, deleteEntity, "delete");
+
+  // the handle is trivially destructible, the metatable only marks the type
+  luaL_newmetatable(l, ENTITY_HANDLE_METATABLE);
+  lua_pop(l, 1);
 }
 
 
 int entity(lua_State *l) {
   LUA_BRIDGE_START;
 
-  return 1;
-}
-
-int textMessage(lua_State *l) {
-  LUA_BRIDGE_START;
-
-  LOGV("Lua call: textMessage");
+  LOGV("Lua call: entity");
 
   if (lua_gettop(l) != 1) {
-    LOGW("Wrong argument count for textMessage call");
+    LOGW("Wrong argument count for entity call");
     return -1;
   }
 
-  std::shared_ptr<CGUITextBox::SResult> result(new CGUITextBox::SResult);
-  result->mResult = CGUITextBox::RESULT_NONE;
-
-  XMLDocument doc;
-  doc.Parse(lua_tostring(l, 1));
-
-  CMessageHandler::getSingleton().addMessage(CMessageCreator::getSingleton().createMessage(doc.FirstChildElement(), Ogre::Any(result)));
-
-  while (true) {
-    LUA_WAIT(50);
-    result->mMutex.lock();
-    if (result->mResult != CGUITextBox::RESULT_NONE) {
-      break;
-    }
-    result->mMutex.unlock();
+  // return a handle, it stays safe to use if the entity is deleted
+  CEntity *pEntity = luaHelper::findEntity(lua_tostring(l, 1));
+  if (!pEntity) {
+    LOGW("Entity '%s' was not found in entity tree.", lua_tostring(l, 1));
+    lua_pushnil(l);
+    return 1;
   }
 
-  // still locked
-  lua_pushnumber(l, result->mResult);
-  result->mMutex.unlock();
-  return 1; // 1 return value
+  new (lua_newuserdata(l, sizeof(CEntityHandle))) CEntityHandle(pEntity->getHandle());
+  luaL_setmetatable(l, ENTITY_HANDLE_METATABLE);
+  return 1;
 }
 
-
-
 namespace luaHelper {
-  class CMoveToWait : public CMessageInjector {
+  //! get the entity by its id or by a handle returned from entity(), nullptr if not existing
+  CEntity *getEntity(lua_State *l, int iIndex) {
+    const CEntityHandle *pHandle = static_cast<const CEntityHandle*>(luaL_testudata(l, iIndex, ENTITY_HANDLE_METATABLE));
+    if (pHandle) {
+      return CEntityRegistry::getSingleton().get(*pHandle);
+    }
+    return findEntity(lua_tostring(l, iIndex));
+  }
+
+  //! Waits until the text box has a result, the result is returned to lua
+  class CTextBoxWait : public CLuaWaitCondition {
   private:
-    CEntity *mEntity;
-    bool mReached;
-    mutable std::mutex mMutex;
+    std::shared_ptr<CGUITextBox::SResult> mResult;
   public:
-    CMoveToWait(CEntity *pEnt)
-      : mEntity(pEnt),
-        mReached(false) {
+    CTextBoxWait(std::shared_ptr<CGUITextBox::SResult> result)
+      : mResult(result) {
+    }
+
+    bool isFulfilled() const {
+      std::lock_guard<std::mutex> lock(mResult->mMutex);
+      return mResult->mResult != CGUITextBox::RESULT_NONE;
     }
 
-    bool hasReached() const {std::lock_guard<std::mutex> lock(mMutex); return mReached;}
-  protected:
-    void sendMessageToAll(const CMessage &m) {
-      if (m.getType() == MSG_TARGET_REACHED) {
-        const CMessageTargetReached &mtr(dynamic_cast<const CMessageTargetReached&>(m));
-        if (mtr.getEntity() == mEntity) {
-          mMutex.lock();
-          mReached = true;
-          mMutex.unlock();
-        }
-      }
+    int pushResults(lua_State *l) const {
+      std::lock_guard<std::mutex> lock(mResult->mMutex);
+      lua_pushnumber(l, mResult->mResult);
+      return 1; // 1 return value
     }
   };
 };
 
-
-int moveTo(lua_State *l) {
+int textMessage(lua_State *l) {
   LUA_BRIDGE_START;
 
   LOGV("Lua call: textMessage");
 
-  if (lua_gettop(l) < 2) {
-    LOGW("Less argument count for moveTo call");
+  if (lua_gettop(l) != 1) {
+    LOGW("Wrong argument count for textMessage call");
     return -1;
   }
 
-  const std::string id(lua_tostring(l, 1));
-  const Ogre::Vector3 position(Ogre::StringConverter::parseVector3(lua_tostring(l, 2)));
+  luaHelper::CTextBoxWait *pWait;
+  {
+    // yield does a longjmp, so destroy all objects before
+    std::shared_ptr<CGUITextBox::SResult> result(new CGUITextBox::SResult);
+    result->mResult = CGUITextBox::RESULT_NONE;
 
-  CEntity *pEntity = CGameStateManager::getSingleton().getChildRecursive(id);
-  if (!pEntity) {
-    LOGW("Entity '%s' was not found in entity tree.", id.c_str());
-    return 0;
+    XMLDocument doc;
+    doc.Parse(lua_tostring(l, 1));
+
+    CMessageHandler::getSingleton().addMessage(CMessageCreator::getSingleton().createMessage(doc.FirstChildElement(), Ogre::Any(result)));
+    pWait = new luaHelper::CTextBoxWait(result);
   }
 
-  luaHelper::CMoveToWait waiter(pEntity);
+  // the text box result is returned when resuming
+  return CLuaScheduler::getSingleton().yield(l, pWait);
+}
+
+int moveTo(lua_State *l) {
+  LUA_BRIDGE_START;
+
+  LOGV("Lua call: moveTo");
 
-  pEntity->moveToTarget(position);
+  if (lua_gettop(l) < 2) {
+    LOGW("Less argument count for moveTo call");
+    return -1;
+  }
 
+  CEntity *pEntity;
+  {
+    // yield does a longjmp, so destroy all objects before
+    const Ogre::Vector3 position(Ogre::StringConverter::parseVector3(lua_tostring(l, 2)));
 
-  while (true) {
-    LUA_WAIT(50);
-    if (waiter.hasReached()) {
-      break;
+    pEntity = luaHelper::getEntity(l, 1);
+    if (!pEntity) {
+      LOGW("Entity '%s' was not found in entity tree.", lua_tostring(l, 1));
+      return 0;
     }
+
+    pEntity->moveToTarget(position);
   }
 
-  return 0; // 0 return values
+  return CLuaScheduler::getSingleton().yield(l, new CLuaWaitForTargetReached(pEntity));
 }
 
 int deleteEntity(lua_State *l) {
@@ -140,10 +165,9 @@ int deleteEntity(lua_State *l) {
     return -1;
   }
 
-  const std::string id(lua_tostring(l, 1));
-  CEntity *pEntity = CGameStateManager::getSingleton().getChildRecursive(id);
+  CEntity *pEntity = luaHelper::getEntity(l, 1);
   if (!pEntity) {
-    LOGW("Entity '%s' was not found in entity tree.", id.c_str());
+    LOGW("Entity '%s' was not found in entity tree.", lua_tostring(l, 1));
     return 0;
   }
 
@@ -196,3 +196,9 @@ void CWorldEntity::enterMap(CMap *pMap, const Ogre::Vector3 &vPosition) {
   m_sResourceGroup = pMap->getMapPack()->getResourceGroup();
   setPosition(vPosition);
 }
+
+void CWorldEntity::crossMapBorder(CMap *pMap) {
+  assert(pMap->hasSharedPhysics());
+  m_pMap = pMap;
+  m_sResourceGroup = pMap->getMapPack()->getResourceGroup();
+}
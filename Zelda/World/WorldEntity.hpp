@@ -61,6 +61,8 @@ public:
   virtual btCollisionObject *getCollisionObject() const;
   virtual CMap *getMap() const {return m_pMap;}
   virtual void enterMap(CMap *pMap, const Ogre::Vector3 &vPosition);
+  //! move to an adjacent map that shares the physics world, position and physics are kept
+  virtual void crossMapBorder(CMap *pMap);
 
   virtual void update(Ogre::Real tpf);
 
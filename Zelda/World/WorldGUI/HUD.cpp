@@ -32,6 +32,9 @@ using namespace CEGUI;
 
 CHUD::CHUD(CEntity *pParentEntity, CEGUI::Window *pParentWindow)
   : CGUIOverlay("hud", pParentEntity, pParentWindow, pParentWindow->createChild("DefaultWindow", "hud_root")) {
+  subscribeMessage(MSG_PLAYER_PICKUP_ITEM);
+  subscribeMessage(MSG_HITPOINTS_CHANGED);
+  subscribeMessage(MSG_ITEM);
 
   Window *m_pLivesText = m_pRoot->createChild("OgreTray/ShadowedLabel", "lives_text");
   m_pLivesText->setText("-- LIFE --");
@@ -56,14 +59,14 @@ void CHUD::handleMessage(const CMessage &message) {
     m_pRupeeCounter->addCount(10);
   }
   else if (message.getType() == MSG_HITPOINTS_CHANGED) {
-    const CMessageHitpointsChanged &msg_hp_change(dynamic_cast<const CMessageHitpointsChanged&>(message));
+    const CMessageHitpointsChanged &msg_hp_change(message.getAs<CMessageHitpointsChanged>());
     if (dynamic_cast<const CWorldEntity *>(&msg_hp_change.getHitableInterface()) && dynamic_cast<const CWorldEntity&>(msg_hp_change.getHitableInterface()).getID() == "player") {
       m_pHeartsDisplay->changeMaximalHitpoints(msg_hp_change.getHitableInterface().getMaxHP());
       m_pHeartsDisplay->changeCurrentHitpoints(msg_hp_change.getHitableInterface().getCurrentHP());
     }
   }
   else if (message.getType() == MSG_ITEM) {
-    const CMessageItem &msg_item(dynamic_cast<const CMessageItem&>(message));
+    const CMessageItem &msg_item(message.getAs<CMessageItem>());
     if (msg_item.getItemMessageType() == CMessageItem::IM_SELECTION_CHANGED) {
       m_pCurrentItemDisplay->setProperty("Image", "hud/" + ITEM_VARIANT_DATA_MAP.toData(msg_item.getItemVariantType()).sImagesetName);
     }
@@ -33,6 +33,7 @@
 CWorldGUI::CWorldGUI(CEntity *pParentEntity)
   : CGUIOverlay("world_gui", pParentEntity, CGUIManager::getSingleton().getRoot(),
                 CGUIManager::getSingleton().getRoot()->createChild("DefaultWindow", "world_gui_root")) {
+  subscribeMessage(MSG_SHOW_TEXT);
 
   CGUIManager::getSingleton().addGUIOverlay(this);
 
@@ -56,7 +57,7 @@ CWorldGUI::~CWorldGUI() {
 
 void CWorldGUI::handleMessage(const CMessage &message) {
   if (message.getType() == MSG_SHOW_TEXT) {
-    const CMessageShowText &msg_show_text(dynamic_cast<const CMessageShowText&>(message));
+    const CMessageShowText &msg_show_text(message.getAs<CMessageShowText>());
     if (msg_show_text.getStatus() == CMessageShowText::REQUEST) {
       new CGUITextBox("text_box", this, m_pRoot, msg_show_text.getLanguageString(), msg_show_text.getResult());
     }
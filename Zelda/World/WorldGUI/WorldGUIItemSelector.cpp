@@ -14,6 +14,7 @@ CWorldGUIItemSelector::CWorldGUIItemSelector(CEntity *pParentEntity, CEGUI::Wind
     CGameInputListener(false),
     m_eCurrentItemSlot(ITEM_SLOT_COUNT),
     m_pMultipleSelector(nullptr) {
+  subscribeMessage(MSG_ITEM);
 
   m_pRoot->setText("ITEM");
 
@@ -73,7 +74,7 @@ bool CWorldGUIItemSelector::onSelectedItemChanged(const CEGUI::EventArgs &args)
   ASSERT(items.size() > 0);
   if (items.size() == 1) {
     // just select the item
-    CMessageHandler::getSingleton().addMessage(new CMessageItem(CMessageItem::IM_SELECTION_CHANGED, items.front()));
+    CMessageHandler::getSingleton().createMessage<CMessageItem>(CMessageItem::IM_SELECTION_CHANGED, items.front());
   }
   else {
     // display a selection window
@@ -108,7 +109,7 @@ bool CWorldGUIItemSelector::updateItemStatus(const SItemStatus &itemStatus) {
 
 void CWorldGUIItemSelector::handleMessage(const CMessage &message) {
   if (message.getType() == MSG_ITEM) {
-    const CMessageItem &messageItem(dynamic_cast<const CMessageItem&>(message));
+    const CMessageItem &messageItem(message.getAs<CMessageItem>());
     if (messageItem.getItemMessageType() == CMessageItem::IM_STATUS_LOADED) {
       ASSERT(messageItem.getStatusStorage());
 
@@ -263,7 +264,7 @@ bool CWorldGUIItemSelectorMultipleSelect::onSelectedItemChanged(const CEGUI::Eve
   ASSERT(wnd_args.window->getUserData());
 
   const EItemVariantTypes eItemVariant(*static_cast<EItemVariantTypes*>(wnd_args.window->getUserData()));
-  CMessageHandler::getSingleton().addMessage(new CMessageItem(CMessageItem::IM_SELECTION_CHANGED, eItemVariant));
+  CMessageHandler::getSingleton().createMessage<CMessageItem>(CMessageItem::IM_SELECTION_CHANGED, eItemVariant);
 
   return true;
 }
@@ -0,0 +1,209 @@
+"""Cooks a dotScene file (.scene) into the binary format that is read by
+Zelda/Common/DotSceneLoader/CookedScene.hpp. The game loads '<scene>.bin'
+instead of the xml file if it is in the same resource group.
+
+usage: python CookScene.py input.scene [output.scene.bin]
+"""
+import struct
+import sys
+import xml.etree.ElementTree as ET
+
+# keep in sync with CookedScene.hpp
+COOKED_SCENE_MAGIC = b'ZSCN'
+COOKED_SCENE_VERSION = 1
+COOKED_SCENE_EXTENSION = '.bin'
+
+HF_AMBIENT_COLOUR = 1
+NF_POSITION = 1
+NF_ROTATION = 2
+NF_SCALE = 4
+EF_STATIC = 1
+EF_CAST_SHADOWS = 2
+EF_GHOST = 4
+
+HEADER_FORMAT = '<4sII4f9I'
+NODE_FORMAT = '<II3f4f3f6I'
+ENTITY_FORMAT = '<5IfIII'
+USER_DATA_FORMAT = '<3I'
+
+# elements the DotSceneLoader processes but the cooked format does not
+# support, scenes containing them can only be loaded from the xml file
+SCENE_UNSUPPORTED = ('light', 'camera')
+ENVIRONMENT_UNSUPPORTED = ('fog', 'skyBox', 'skyDome', 'skyPlane', 'clipping')
+NODES_UNSUPPORTED = ('position', 'rotation', 'scale')
+NODE_UNSUPPORTED = ('lookTarget', 'trackTarget', 'light', 'camera', 'particleSystem', 'billboardSet', 'plane')
+ENTITY_UNSUPPORTED = ('userDataReference',)
+
+
+class UnsupportedScene(Exception):
+    pass
+
+
+def toBytes(s):
+    if not isinstance(s, bytes):
+        s = s.encode('utf-8')
+    return s
+
+
+def parseReal(value):
+    # like Ogre::StringConverter::parseReal
+    try:
+        return float(value)
+    except (TypeError, ValueError):
+        return 0.0
+
+
+def parseBool(elem, attrib, default):
+    # like DotSceneLoader::getAttribBool
+    value = elem.get(attrib)
+    if value is None:
+        return default
+    return value.lower() == 'true'
+
+
+def checkChildren(elem, unsupported):
+    for child in elem:
+        if child.tag in unsupported:
+            raise UnsupportedScene('<%s> in <%s>' % (child.tag, elem.tag))
+
+
+class StringTable:
+    def __init__(self):
+        self.data = bytearray(b'\0')
+        self.offsets = {b'': 0}
+
+    def add(self, s):
+        s = toBytes(s or '')
+        if s not in self.offsets:
+            self.offsets[s] = len(self.data)
+            self.data += s + b'\0'
+        return self.offsets[s]
+
+
+def cookScene(sceneFile):
+    root = ET.parse(sceneFile).getroot()
+    if root.tag != 'scene':
+        raise UnsupportedScene('missing <scene>')
+    checkChildren(root, SCENE_UNSUPPORTED)
+
+    strings = StringTable()
+    userData = []
+
+    def addUserData(elem):
+        first = len(userData)
+        for ud in elem.findall('user_data'):
+            userData.append(struct.pack(USER_DATA_FORMAT, strings.add(ud.get('name')),
+                                        strings.add(ud.get('type')), strings.add(ud.get('value'))))
+        return first, len(userData) - first
+
+    flags = 0
+    ambient = (0.0, 0.0, 0.0, 0.0)
+    environment = root.find('environment')
+    if environment is not None:
+        checkChildren(environment, ENVIRONMENT_UNSUPPORTED)
+        colour = environment.find('colourAmbient')
+        if colour is not None:
+            flags |= HF_AMBIENT_COLOUR
+            ambient = (parseReal(colour.get('r')), parseReal(colour.get('g')), parseReal(colour.get('b')),
+                       parseReal(colour.get('a')) if colour.get('a') is not None else 1.0)
+
+    # breadth first, so that the children of a node are consecutive and stored behind it
+    nodesElem = root.find('nodes')
+    order = []
+    if nodesElem is not None:
+        checkChildren(nodesElem, NODES_UNSUPPORTED)
+        order = nodesElem.findall('node')
+    rootCount = len(order)
+
+    nodes = []
+    entities = []
+    i = 0
+    while i < len(order):
+        elem = order[i]
+        checkChildren(elem, NODE_UNSUPPORTED)
+        nodeFlags = 0
+
+        position = (0.0, 0.0, 0.0)
+        pos = elem.find('position')
+        if pos is not None:
+            nodeFlags |= NF_POSITION
+            position = (parseReal(pos.get('x')), parseReal(pos.get('y')), parseReal(pos.get('z')))
+
+        rotation = (1.0, 0.0, 0.0, 0.0)
+        rot = elem.find('rotation')
+        if rot is not None:
+            nodeFlags |= NF_ROTATION
+            if rot.get('qx') is not None:
+                rotation = (parseReal(rot.get('qw')), parseReal(rot.get('qx')),
+                            parseReal(rot.get('qy')), parseReal(rot.get('qz')))
+            elif rot.get('axisX') is not None:
+                raise UnsupportedScene('axis angle rotation')
+
+        scale = (1.0, 1.0, 1.0)
+        sc = elem.find('scale')
+        if sc is not None:
+            nodeFlags |= NF_SCALE
+            scale = (parseReal(sc.get('x')), parseReal(sc.get('y')), parseReal(sc.get('z')))
+
+        children = elem.findall('node')
+        firstChild = len(order)
+        order.extend(children)
+
+        firstEntity = len(entities)
+        for ent in elem.findall('entity'):
+            checkChildren(ent, ENTITY_UNSUPPORTED)
+            entityFlags = 0
+            if parseBool(ent, 'static', False):
+                entityFlags |= EF_STATIC
+            if parseBool(ent, 'castShadows', True):
+                entityFlags |= EF_CAST_SHADOWS
+            if parseBool(ent, 'ghost', False):
+                entityFlags |= EF_GHOST
+            firstUserData, userDataCount = addUserData(ent)
+            entities.append(struct.pack(ENTITY_FORMAT,
+                                        strings.add(ent.get('name')), strings.add(ent.get('meshFile')),
+                                        strings.add(ent.get('materialFile')), strings.add(ent.get('physics_type')),
+                                        strings.add(ent.get('collisionPrim')),
+                                        parseReal(ent.get('mass', '0')), entityFlags,
+                                        firstUserData, userDataCount))
+
+        firstUserData, userDataCount = addUserData(elem)
+        nodes.append(struct.pack(NODE_FORMAT, strings.add(elem.get('name')), nodeFlags,
+                                 *(position + rotation + scale +
+                                   (firstChild if children else 0, len(children),
+                                    firstEntity, len(entities) - firstEntity,
+                                    firstUserData, userDataCount))))
+        i += 1
+
+    while len(strings.data) % 4 != 0:
+        strings.data += b'\0'
+
+    nodeOffset = struct.calcsize(HEADER_FORMAT)
+    entityOffset = nodeOffset + len(nodes) * struct.calcsize(NODE_FORMAT)
+    userDataOffset = entityOffset + len(entities) * struct.calcsize(ENTITY_FORMAT)
+    stringsOffset = userDataOffset + len(userData) * struct.calcsize(USER_DATA_FORMAT)
+
+    header = struct.pack(HEADER_FORMAT, COOKED_SCENE_MAGIC, COOKED_SCENE_VERSION, flags,
+                         *(ambient + (rootCount,
+                                      len(nodes), nodeOffset,
+                                      len(entities), entityOffset,
+                                      len(userData), userDataOffset,
+                                      len(strings.data), stringsOffset)))
+
+    return header + b''.join(nodes) + b''.join(entities) + b''.join(userData) + bytes(strings.data)
+
+
+if __name__ == '__main__':
+    if len(sys.argv) < 2:
+        sys.stderr.write(__doc__)
+        sys.exit(1)
+
+    output = sys.argv[2] if len(sys.argv) > 2 else sys.argv[1] + COOKED_SCENE_EXTENSION
+    try:
+        data = cookScene(sys.argv[1])
+    except UnsupportedScene as e:
+        sys.stderr.write('Scene can not be cooked, use the xml file: %s\n' % e)
+        sys.exit(2)
+
+    with open(output, 'wb') as f:
+        f.write(data)
@@ -1,7 +1,38 @@
 import os
+import sys
 import zipfile
 import glob
 import ntpath
+import subprocess
+import tempfile
+import re
+import struct
+import CookScene
+import PackArchive
+import ResourceManifest
+
+# embed precompiled lua chunks instead of the sources (--precompile-lua)
+# note: the bytecode must match the lua version and architecture of the target
+precompileLua = False
+luaCompiler = os.environ.get('LUAC', 'luac5.2')
+
+# add the binary version of the map scene (--cook-scenes), see CookScene.py
+cookScenes = False
+
+# add the bvh cache files of the triangle meshes (--bvh-cache DIR), see BvhTriangleMeshCache.hpp
+# the files are created by the game in cache/bvh/ of its writable path, they are keyed
+# by a hash of the converted mesh data. The header also stores a hash of the mesh file,
+# only the files built from the current mesh file are added
+bvhCacheDir = None
+BVH_CACHE_MAGIC = b'ZBVH'
+BVH_CACHE_VERSION = 2
+# magic, version, hash, meshFileHash, see SHeader in BvhTriangleMeshCache.cpp
+BVH_CACHE_HEADER = struct.Struct('<4sIQQ')
+
+# also write the memory mapped pack of each map (--pack-archive), see PackArchive.py
+# the game prefers it over the zip, --pack-archive-store writes it without compression
+packArchive = False
+storePackArchive = False
 
 def zipdir(path, zip):
     for root, dirs, files in os.walk(path):
@@ -18,7 +49,56 @@ def copyAllOfType(zipf, pattern, outputdir, recursive=False) :
         if recursive :
             copyAllOfType(zipf, os.path.join(f, "*"), os.path.join(outputdir, ntpath.basename(f)), True)
 
-                
+
+def copyAllLuaScripts(zipf, pattern, outputdir) :
+    if not precompileLua :
+        copyAllOfType(zipf, pattern, outputdir)
+        return
+
+    for f in glob.glob(pattern) :
+        if f.endswith('~') :
+            continue
+
+        # keep the name, the game detects the bytecode by its signature
+        fd, compiled = tempfile.mkstemp(suffix='.luac')
+        os.close(fd)
+        subprocess.check_call([luaCompiler, '-o', compiled, f])
+        zipf.write(compiled, os.path.join(outputdir, ntpath.basename(f)), zipfile.ZIP_DEFLATED)
+        os.remove(compiled)
+
+# 64 bit FNV-1a, same as hashData in BvhTriangleMeshCache.cpp
+def fnv1a64(data) :
+    h = 14695981039346656037
+    for b in bytearray(data) :
+        h ^= b
+        h = (h * 1099511628211) & 0xffffffffffffffff
+    return h
+
+def isCurrentBvhCacheFile(path, meshFileHash) :
+    with open(path, 'rb') as f :
+        data = f.read(BVH_CACHE_HEADER.size)
+    if len(data) < BVH_CACHE_HEADER.size :
+        return False
+    magic, version, hash, fileHash = BVH_CACHE_HEADER.unpack(data)
+    return magic == BVH_CACHE_MAGIC and version == BVH_CACHE_VERSION and fileHash == meshFileHash
+
+def copyBvhCacheFiles(zipf, meshes, dataPath) :
+    if not bvhCacheDir :
+        return
+
+    for mesh in meshes :
+        if not mesh.endswith('.mesh') :
+            continue
+
+        with open(os.path.join(dataPath, mesh), 'rb') as f :
+            meshFileHash = fnv1a64(f.read())
+
+        # a mesh has one file per scaling it is used with, older files of the mesh are skipped
+        pattern = re.compile(re.escape(mesh[:-len('.mesh')]) + '_[0-9a-f]{16}\\.bvh$')
+        for f in os.listdir(bvhCacheDir) :
+            path = os.path.join(bvhCacheDir, f)
+            if pattern.match(f) and isCurrentBvhCacheFile(path, meshFileHash) :
+                zipf.write(path, f, zipfile.ZIP_DEFLATED)
 
 def makeLightWorldZip() :
 	print('Creating light_world.zip')
@@ -96,16 +176,40 @@ def makeMapPack(name, world, files, includeHouse=False) :
 
 	for file in files :
 		zipf.write(os.path.join(dataPath, file), file, zipfile.ZIP_DEFLATED)
+
+	copyBvhCacheFiles(zipf, files, dataPath)
+
+	if cookScenes :
+		try :
+			cooked = CookScene.cookScene(os.path.join(dataPath, name + '.scene'))
+			zipf.writestr(name + '.scene' + CookScene.COOKED_SCENE_EXTENSION, cooked, zipfile.ZIP_DEFLATED)
+		except CookScene.UnsupportedScene as e :
+			print('Scene of ' + name + ' can not be cooked, using the xml file: ' + str(e))
         # copy scripts
-        copyAllOfType(zipf, os.path.join(dataPath, 'scripts/*'), 'scripts')
+        copyAllLuaScripts(zipf, os.path.join(dataPath, 'scripts/*'), 'scripts')
         copyAllOfType(zipf, os.path.join(dataPath, 'language/*'), 'language', True)
+
+	# the resources that are loaded when the map is entered, see ResourceManifest.py
+	manifest = ResourceManifest.makeManifest(os.path.join(dataPath, name + '.scene'), os.path.join(dataPath, name + '.xml'), zipf.namelist())
+	zipf.writestr(name + ResourceManifest.MANIFEST_EXTENSION, manifest, zipfile.ZIP_DEFLATED)
 	zipf.close()
+
+	if packArchive :
+		with open(os.path.join(worldPath, name + PackArchive.PACK_ARCHIVE_EXTENSION), 'wb') as f :
+			f.write(PackArchive.packZip(os.path.join(worldPath, name + '.zip'), storePackArchive))
 	
 
 # set this as working dir
 os.chdir(os.path.dirname(os.path.realpath(__file__)))
 
 if __name__ == '__main__':
+    precompileLua = '--precompile-lua' in sys.argv
+    cookScenes = '--cook-scenes' in sys.argv
+    storePackArchive = '--pack-archive-store' in sys.argv
+    packArchive = '--pack-archive' in sys.argv or storePackArchive
+    if '--bvh-cache' in sys.argv :
+        bvhCacheDir = sys.argv[sys.argv.index('--bvh-cache') + 1]
+
     makeLightWorldZip()
     makeGameZip()
     makeSdkTrays()
@@ -0,0 +1,141 @@
+"""Writes the memory mapped pack archive that is read by
+Zelda/Common/FileManager/PackArchive.hpp. The game mounts '<name>.pak'
+instead of '<name>.zip' if both exist.
+
+usage: python PackArchive.py input.zip [output.pak] [--store]
+  --store: do not compress any entry, all files are served without a copy
+"""
+import struct
+import sys
+import zipfile
+
+# keep in sync with PackArchive.hpp
+PACK_ARCHIVE_MAGIC = b'ZPAK'
+PACK_ARCHIVE_VERSION = 1
+PACK_ARCHIVE_EXTENSION = '.pak'
+
+C_NONE = 0
+C_LZ4 = 1
+
+HEADER_FORMAT = '<4s5I'
+ENTRY_FORMAT = '<5I'
+DATA_ALIGNMENT = 16
+
+# an entry is only compressed if it gets smaller than this fraction, already
+# compressed files (e.g. png) are stored and do not have to be decompressed
+MIN_COMPRESSION_RATIO = 0.9
+
+# constants of the LZ4 block format
+LZ4_MIN_MATCH = 4
+LZ4_LAST_LITERALS = 5
+LZ4_MATCH_LIMIT = 12
+LZ4_MAX_OFFSET = 0xFFFF
+
+
+def lz4WriteLength(out, length):
+    while length >= 255:
+        out.append(255)
+        length -= 255
+    out.append(length)
+
+
+def lz4WriteSequence(out, literals, offset, matchLength):
+    literalLength = len(literals)
+    token = min(literalLength, 15) << 4
+    if offset:
+        token |= min(matchLength - LZ4_MIN_MATCH, 15)
+    out.append(token)
+    if literalLength >= 15:
+        lz4WriteLength(out, literalLength - 15)
+    out += literals
+    if offset:
+        out += struct.pack('<H', offset)
+        if matchLength - LZ4_MIN_MATCH >= 15:
+            lz4WriteLength(out, matchLength - LZ4_MIN_MATCH - 15)
+
+
+def lz4Compress(data):
+    """Compress data into a single LZ4 block (greedy, not the fastest nor the smallest)"""
+    data = bytearray(data)
+    size = len(data)
+    out = bytearray()
+    table = {}
+    anchor = 0
+    i = 0
+    while i < size - LZ4_MATCH_LIMIT:
+        sequence = bytes(data[i:i + LZ4_MIN_MATCH])
+        ref = table.get(sequence)
+        table[sequence] = i
+        if ref is None or i - ref > LZ4_MAX_OFFSET:
+            i += 1
+            continue
+
+        length = LZ4_MIN_MATCH
+        maxLength = size - LZ4_LAST_LITERALS - i
+        while length < maxLength and data[ref + length] == data[i + length]:
+            length += 1
+
+        lz4WriteSequence(out, data[anchor:i], i - ref, length)
+        i += length
+        anchor = i
+
+    lz4WriteSequence(out, data[anchor:], 0, 0)
+    return bytes(out)
+
+
+def packEntries(entries, store=False):
+    """entries: list of (name, data), returns the content of the pack file"""
+    # sorted like the lookup in the game: lower case, byte wise
+    entries = sorted(((name.encode('utf-8') if not isinstance(name, bytes) else name, data) for name, data in entries),
+                     key=lambda entry: entry[0].lower())
+
+    strings = bytearray(b'\0')
+    nameOffsets = []
+    for name, data in entries:
+        nameOffsets.append(len(strings))
+        strings += name + b'\0'
+    while len(strings) % 4 != 0:
+        strings += b'\0'
+
+    entryOffset = struct.calcsize(HEADER_FORMAT)
+    stringsOffset = entryOffset + len(entries) * struct.calcsize(ENTRY_FORMAT)
+    dataOffset = stringsOffset + len(strings)
+
+    table = bytearray()
+    blobs = bytearray()
+    for (name, data), nameOffset in zip(entries, nameOffsets):
+        compression = C_NONE
+        stored = data
+        if not store and len(data) > 0:
+            compressed = lz4Compress(data)
+            if len(compressed) < len(data) * MIN_COMPRESSION_RATIO:
+                compression = C_LZ4
+                stored = compressed
+
+        while (dataOffset + len(blobs)) % DATA_ALIGNMENT != 0:
+            blobs += b'\0'
+        table += struct.pack(ENTRY_FORMAT, nameOffset, compression, dataOffset + len(blobs), len(stored), len(data))
+        blobs += stored
+
+    header = struct.pack(HEADER_FORMAT, PACK_ARCHIVE_MAGIC, PACK_ARCHIVE_VERSION,
+                         len(entries), entryOffset, len(strings), stringsOffset)
+    return header + bytes(table) + bytes(strings) + bytes(blobs)
+
+
+def packZip(zipFile, store=False):
+    """Convert a zip file into the content of a pack file"""
+    zipf = zipfile.ZipFile(zipFile, 'r')
+    entries = [(info.filename, zipf.read(info.filename)) for info in zipf.infolist() if not info.filename.endswith('/')]
+    zipf.close()
+    return packEntries(entries, store)
+
+
+if __name__ == '__main__':
+    args = [arg for arg in sys.argv[1:] if not arg.startswith('--')]
+    if len(args) < 1:
+        sys.stderr.write(__doc__)
+        sys.exit(1)
+
+    output = args[1] if len(args) > 1 else args[0][:-len('.zip')] + PACK_ARCHIVE_EXTENSION
+    with open(output, 'wb') as f:
+        f.write(packZip(args[0], '--store' in sys.argv))
@@ -0,0 +1,72 @@
+"""Creates the resource manifest of a map pack ('<name>.manifest'). It lists the
+resources the scene and the map xml file reference, the game only loads these
+when it mounts the pack (see CMapPack::loadResources), all other resources of
+the pack are loaded on demand.
+
+One resource per line: '<resource type> <name>', e.g. 'Mesh house_wall.mesh'
+
+usage: python ResourceManifest.py input.scene input.xml [output.manifest]
+"""
+import ntpath
+import sys
+import xml.etree.ElementTree as ET
+
+# keep in sync with MapPack.cpp
+MANIFEST_EXTENSION = '.manifest'
+
+# file extension and Ogre resource type of the resources that are loaded by the
+# manifest, skeletons and materials are loaded by the meshes
+RESOURCE_TYPES = (
+    ('.mesh', 'Mesh'),
+    ('.lua', 'LuaScript'),
+)
+
+
+def resourceType(name):
+    for extension, type in RESOURCE_TYPES:
+        if name.lower().endswith(extension):
+            return type
+    return None
+
+
+def scanScene(sceneFile):
+    root = ET.parse(sceneFile).getroot()
+    return [entity.get('meshFile') for entity in root.iter('entity') if entity.get('meshFile')]
+
+
+def scanMapXml(xmlFile):
+    # any attribute can name a resource, e.g. the file of a start_script action
+    names = []
+    for elem in ET.parse(xmlFile).getroot().iter():
+        for value in elem.attrib.values():
+            if resourceType(value):
+                names.append(value)
+    return names
+
+
+def makeManifest(sceneFile, xmlFile, packFiles=None):
+    """packFiles: names of the files in the pack, resources of other packs are not listed"""
+    available = None
+    if packFiles is not None:
+        available = set(ntpath.basename(f).lower() for f in packFiles)
+
+    lines = []
+    seen = set()
+    for name in scanScene(sceneFile) + scanMapXml(xmlFile):
+        if name in seen:
+            continue
+        seen.add(name)
+        if available is not None and ntpath.basename(name).lower() not in available:
+            continue
+        lines.append('%s %s\n' % (resourceType(name), name))
+    return ''.join(lines)
+
+
+if __name__ == '__main__':
+    if len(sys.argv) < 3:
+        sys.stderr.write(__doc__)
+        sys.exit(1)
+
+    output = sys.argv[3] if len(sys.argv) > 3 else sys.argv[1][:-len('.scene')] + MANIFEST_EXTENSION
+    with open(output, 'w') as f:
+        f.write(makeManifest(sys.argv[1], sys.argv[2]))
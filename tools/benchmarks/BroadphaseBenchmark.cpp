@@ -0,0 +1,209 @@
+/*****************************************************************************
+ * Copyright 2014 Christoph Wick
+ *
+ * This file is part of Zelda.
+ *
+ * Zelda is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zelda is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Zelda. If not, see http://www.gnu.org/licenses/.
+ *****************************************************************************/
+
+// Compares the two broadphases a map can choose (see CPhysicsManager::setBroadphase)
+// under churn: bodies are spawned and removed at a constant rate, like the
+// objects, drops and projectiles of a busy map. Only bullet is used, the world
+// is set up like the world of CPhysicsManager (60 Hz steps, the bounds of
+// CMap::createBroadphase) in the units of the game. Several map sizes are run
+// in one go: the sizes of inner_house_link and link_house and two larger maps,
+// scenery (trees) is placed with the same density on all of them. A fraction
+// of the bodies can be spawned outside of the bounds, btAxisSweep3 clamps them
+// to its border cells.
+//
+// usage: BroadphaseBenchmark [seconds per run] [spawns per second] [lifetime in seconds] [fraction outside of the bounds]
+
+#include <btBulletDynamicsCommon.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace {
+  const btScalar TIME_STEP(1.0 / 60);
+  // see CPhysicsManager::GRAVITY_FACTOR
+  const btScalar GRAVITY(-4);
+  // see CMap::createBroadphase
+  const btScalar BROADPHASE_EXTENT_FACTOR(1.5);
+  const btScalar BROADPHASE_MARGIN(5);
+  // spawn height above the floor
+  const btScalar SPAWN_HEIGHT(1);
+  // trees per square unit of the map
+  const btScalar SCENERY_DENSITY(4);
+
+  //! global_size of a map pack
+  struct SMapSize {
+    const char *pName;
+    btScalar fSizeX;
+    btScalar fSizeZ;
+  };
+  const SMapSize MAP_SIZES[] = {
+    {"inner_house_link", 1.4, 1.0},
+    {"link_house", 3.2, 3.2},
+    {"4x link_house", 12.8, 12.8},
+    {"16x link_house", 51.2, 51.2},
+  };
+
+  struct SResult {
+    double fChurnMs;          //!< adding and removing per frame
+    double fStepMs;           //!< stepping per frame
+    double fMaxFrameMs;
+    size_t uiMaxPairs;
+  };
+
+  btRigidBody *createBody(btCollisionShape *pShape, btScalar fMass, const btVector3 &vPosition) {
+    btVector3 vInertia(0, 0, 0);
+    if (fMass > 0) {pShape->calculateLocalInertia(fMass, vInertia);}
+    btDefaultMotionState *pMotionState(new btDefaultMotionState(btTransform(btQuaternion::getIdentity(), vPosition)));
+    return new btRigidBody(btRigidBody::btRigidBodyConstructionInfo(fMass, pMotionState, pShape, vInertia));
+  }
+
+  void destroyBody(btDiscreteDynamicsWorld &world, btRigidBody *pBody) {
+    world.removeRigidBody(pBody);
+    delete pBody->getMotionState();
+    delete pBody;
+  }
+
+  //! half extent of the broadphase bounds of CMap::createBroadphase
+  btVector3 getHalfExtent(const SMapSize &size) {
+    return btVector3(size.fSizeX * BROADPHASE_EXTENT_FACTOR + BROADPHASE_MARGIN,
+                     std::max(size.fSizeX, size.fSizeZ) * BROADPHASE_EXTENT_FACTOR + BROADPHASE_MARGIN,
+                     size.fSizeZ * BROADPHASE_EXTENT_FACTOR + BROADPHASE_MARGIN);
+  }
+
+  SResult run(btBroadphaseInterface *pBroadphase, const SMapSize &size, double fSeconds, double fSpawnsPerSecond, double fLifetime, double fOutside) {
+    btDefaultCollisionConfiguration collisionConfig;
+    btCollisionDispatcher dispatcher(&collisionConfig);
+    btSequentialImpulseConstraintSolver solver;
+    btDiscreteDynamicsWorld world(&dispatcher, pBroadphase, &solver, &collisionConfig);
+    world.setGravity(btVector3(0, GRAVITY, 0));
+
+    const btScalar fHalfX(size.fSizeX / 2);
+    const btScalar fHalfZ(size.fSizeZ / 2);
+    const btVector3 vHalfExtent(getHalfExtent(size));
+    // see GCST_FALLING_OBJECT_SPHERE and GCST_TREE
+    btBoxShape groundShape(btVector3(fHalfX, 0.1, fHalfZ));
+    btSphereShape sphereShape(0.02);
+    btCylinderShape treeShape(btVector3(0.173, 0.2, 0.173));
+    btRigidBody *pGround(createBody(&groundShape, 0, btVector3(0, -0.1, 0)));
+    world.addRigidBody(pGround);
+
+    // same sequence for both broadphases
+    std::mt19937 random(42);
+    std::uniform_real_distribution<btScalar> insideX(-fHalfX, fHalfX);
+    std::uniform_real_distribution<btScalar> insideZ(-fHalfZ, fHalfZ);
+    std::uniform_real_distribution<btScalar> outside(vHalfExtent.x(), 2 * vHalfExtent.x());
+    std::uniform_real_distribution<btScalar> height(0.1, SPAWN_HEIGHT);
+    std::uniform_real_distribution<double> chance(0, 1);
+
+    std::vector<btRigidBody*> vScenery;
+    const size_t uiSceneryCount(static_cast<size_t>(size.fSizeX * size.fSizeZ * SCENERY_DENSITY));
+    for (size_t i = 0; i < uiSceneryCount; i++) {
+      vScenery.push_back(createBody(&treeShape, 0, btVector3(insideX(random), 0.2, insideZ(random))));
+      world.addRigidBody(vScenery.back());
+    }
+
+    struct SSpawned {
+      btRigidBody *pBody;
+      double fRemoveTime;
+    };
+    std::deque<SSpawned> dBodies;
+
+    SResult result = {0, 0, 0, 0};
+    const size_t uiFrames(static_cast<size_t>(fSeconds / TIME_STEP));
+    double fTime(0);
+    double fSpawnDebt(0);
+    for (size_t f = 0; f < uiFrames; f++) {
+      fTime += TIME_STEP;
+      const auto start(std::chrono::steady_clock::now());
+
+      while (!dBodies.empty() && dBodies.front().fRemoveTime <= fTime) {
+        destroyBody(world, dBodies.front().pBody);
+        dBodies.pop_front();
+      }
+      fSpawnDebt += fSpawnsPerSecond * TIME_STEP;
+      for (; fSpawnDebt >= 1; fSpawnDebt -= 1) {
+        const bool bOutside(chance(random) < fOutside);
+        const btVector3 vPosition(bOutside ? outside(random) : insideX(random), height(random), insideZ(random));
+        btRigidBody *pBody(createBody(&sphereShape, 1, vPosition));
+        world.addRigidBody(pBody);
+        dBodies.push_back({pBody, fTime + fLifetime});
+      }
+
+      const auto churned(std::chrono::steady_clock::now());
+      world.stepSimulation(TIME_STEP, 1, TIME_STEP);
+      const auto end(std::chrono::steady_clock::now());
+
+      result.fChurnMs += std::chrono::duration<double, std::milli>(churned - start).count();
+      result.fStepMs += std::chrono::duration<double, std::milli>(end - churned).count();
+      result.fMaxFrameMs = std::max(result.fMaxFrameMs, std::chrono::duration<double, std::milli>(end - start).count());
+      result.uiMaxPairs = std::max<size_t>(result.uiMaxPairs, pBroadphase->getOverlappingPairCache()->getNumOverlappingPairs());
+    }
+
+    for (const SSpawned &spawned : dBodies) {
+      destroyBody(world, spawned.pBody);
+    }
+    for (btRigidBody *pBody : vScenery) {
+      destroyBody(world, pBody);
+    }
+    destroyBody(world, pGround);
+
+    result.fChurnMs /= uiFrames;
+    result.fStepMs /= uiFrames;
+    return result;
+  }
+
+  void print(const char *pMap, const char *pBroadphase, size_t uiScenery, const SResult &result, double fReferenceMs) {
+    const double fFrameMs(result.fChurnMs + result.fStepMs);
+    printf("%-18s %8zu %-14s %12.3f %12.3f %14.3f %10zu %9.2fx\n", pMap, uiScenery, pBroadphase, result.fChurnMs,
+           result.fStepMs, result.fMaxFrameMs, result.uiMaxPairs, fReferenceMs / fFrameMs);
+  }
+}
+
+int main(int argc, char **argv) {
+  const double fSeconds(argc > 1 ? atof(argv[1]) : 5);
+  const double fSpawnsPerSecond(argc > 2 ? atof(argv[2]) : 1000);
+  const double fLifetime(argc > 3 ? atof(argv[3]) : 2);
+  const double fOutside(argc > 4 ? atof(argv[4]) : 0);
+  if (fSeconds <= 0 || fSpawnsPerSecond <= 0 || fLifetime <= 0 || fOutside < 0 || fOutside > 1) {
+    printf("usage: %s [seconds per run] [spawns per second] [lifetime in seconds] [fraction outside of the bounds]\n", argv[0]);
+    return 1;
+  }
+
+  printf("%.0f s per run at 60 Hz, %.0f spawns per second, %.1f s lifetime (about %.0f bodies alive), %.0f%% outside of the bounds\n",
+         fSeconds, fSpawnsPerSecond, fLifetime, fSpawnsPerSecond * fLifetime, fOutside * 100);
+  printf("%-18s %8s %-14s %12s %12s %14s %10s %10s\n", "map", "scenery", "broadphase", "churn [ms]", "step [ms]",
+         "max frame [ms]", "max pairs", "vs sweep");
+
+  for (const SMapSize &size : MAP_SIZES) {
+    const size_t uiScenery(static_cast<size_t>(size.fSizeX * size.fSizeZ * SCENERY_DENSITY));
+    const btVector3 vHalfExtent(getHalfExtent(size));
+    std::unique_ptr<btBroadphaseInterface> pAxisSweep(new btAxisSweep3(-vHalfExtent, vHalfExtent));
+    const SResult axisSweep(run(pAxisSweep.get(), size, fSeconds, fSpawnsPerSecond, fLifetime, fOutside));
+    const double fAxisSweepMs(axisSweep.fChurnMs + axisSweep.fStepMs);
+    print(size.pName, "btAxisSweep3", uiScenery, axisSweep, fAxisSweepMs);
+    std::unique_ptr<btBroadphaseInterface> pDbvt(new btDbvtBroadphase());
+    print(size.pName, "btDbvt", uiScenery, run(pDbvt.get(), size, fSeconds, fSpawnsPerSecond, fLifetime, fOutside), fAxisSweepMs);
+  }
+  return 0;
+}
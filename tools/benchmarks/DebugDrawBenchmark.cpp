@@ -0,0 +1,294 @@
+/*****************************************************************************
+ * Copyright 2014 Christoph Wick
+ *
+ * This file is part of Zelda.
+ *
+ * Zelda is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zelda is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Zelda. If not, see http://www.gnu.org/licenses/.
+ *****************************************************************************/
+
+
+// Frame time of the physics debug lines (BtOgre::DebugDrawer) on a world
+// shaped like link_house: the collision shapes of its scene (6 small triangle
+// meshes with the triangle counts of its physics meshes, 21 cylinders, 6
+// boxes, 2 convex hulls), five characters that walk around and a few falling
+// objects that come to rest. Several copies of the map can be placed next to
+// each other. Every frame steps the world, draws the lines and renders one
+// frame, the variants are:
+//   hidden:       the lines are off, DebugDrawer::step does nothing
+//   full redraw:  debugDrawWorld into the line buffer in every frame, the
+//                 drawer before the static lines were cached
+//   step:         DebugDrawer::step without a camera
+//   step, culled: DebugDrawer::step with the camera, it sees about half of a map
+// The delta to the hidden variant is the cost of the lines per frame. All
+// variants draw the contact points and constraints (see PHYSICS_DEBUG_DRAW_MODE
+// of CPhysicsManager). The render system and the window are taken from the
+// ogre.cfg of the game, vsync should be off.
+//
+// usage: DebugDrawBenchmark plugins.cfg ogre.cfg [frames] [copies of the map]
+
+#include <btBulletDynamicsCommon.h>
+#include "Common/Physics/BtOgreExtras.hpp"
+#include <Ogre.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace {
+  typedef std::chrono::steady_clock Clock;
+
+  const btScalar TIME_STEP(1.0 / 60);
+  // see CPhysicsManager::GRAVITY_FACTOR
+  const btScalar GRAVITY(-4);
+  // see PHYSICS_DEBUG_DRAW_MODE of CPhysicsManager
+  const int DEBUG_DRAW_MODE(btIDebugDraw::DBG_DrawWireframe | btIDebugDraw::DBG_DrawContactPoints | btIDebugDraw::DBG_DrawConstraints);
+  // global_size of link_house
+  const btScalar MAP_SIZE(3.2);
+  // triangles of wall_bot_right, physics_border_top, wall_to_water, wall_bot, physics_floor_top and physics_floor
+  const int TRIANGLE_MESH_TRIANGLES[] = {9, 20, 56, 22, 46, 12};
+  const int CYLINDER_COUNT(21);
+  const int BOX_COUNT(6);
+  const int CONVEX_HULL_COUNT(2);
+  const int CHARACTER_COUNT(5);
+  const int FALLING_OBJECT_COUNT(10);
+
+  enum EVariant {
+    V_HIDDEN,
+    V_FULL_REDRAW,
+    V_STEP,
+    V_STEP_CULLED,
+    V_COUNT,
+  };
+  const char *VARIANT_NAMES[V_COUNT] = {"hidden", "full redraw", "step", "step, culled"};
+
+  //! the drawer before the static lines were cached, the whole world is drawn in every frame
+  class CFullRedrawDrawer : public BtOgre::DebugDrawer {
+  public:
+    CFullRedrawDrawer(Ogre::SceneNode *pNode, btDiscreteDynamicsWorld *pWorld) : BtOgre::DebugDrawer(pNode, pWorld) {}
+    void stepFullRedraw() {
+      mLineDrawer->clear();
+      mWorld->debugDrawWorld();
+      mLineDrawer->update();
+      mNode->needUpdate();
+    }
+  };
+
+  //! the physics of a number of copies of link_house
+  class CWorld {
+  private:
+    btDefaultCollisionConfiguration m_CollisionConfig;
+    btCollisionDispatcher m_Dispatcher;
+    btAxisSweep3 m_Broadphase;
+    btSequentialImpulseConstraintSolver m_Solver;
+    btDiscreteDynamicsWorld m_World;
+    std::vector<std::unique_ptr<btTriangleMesh> > m_vMeshes;
+    std::vector<std::unique_ptr<btCollisionShape> > m_vShapes;
+    std::vector<std::unique_ptr<btDefaultMotionState> > m_vMotionStates;
+    std::vector<std::unique_ptr<btRigidBody> > m_vBodies;
+    std::vector<btRigidBody*> m_vCharacters;
+  public:
+    //! the broadphase bounds of CMap::createBroadphase
+    static btVector3 getHalfExtent(int iCopies) {
+      return btVector3(iCopies * MAP_SIZE * 1.5 + 5, iCopies * MAP_SIZE * 1.5 + 5, MAP_SIZE * 1.5 + 5);
+    }
+
+    CWorld(int iCopies)
+      : m_Dispatcher(&m_CollisionConfig),
+        m_Broadphase(-getHalfExtent(iCopies), getHalfExtent(iCopies)),
+        m_World(&m_Dispatcher, &m_Broadphase, &m_Solver, &m_CollisionConfig) {
+      m_World.setGravity(btVector3(0, GRAVITY, 0));
+
+      // same world for every variant
+      std::mt19937 random(42);
+      std::uniform_real_distribution<btScalar> position(-MAP_SIZE / 2, MAP_SIZE / 2);
+      std::uniform_real_distribution<btScalar> angle(0, SIMD_2_PI);
+
+      // see GCST_TREE, GCST_PERSON_CAPSULE and GCST_FALLING_OBJECT_SPHERE
+      btCollisionShape *pGround(addShape(new btBoxShape(btVector3(MAP_SIZE / 2, 0.1, MAP_SIZE / 2))));
+      btCollisionShape *pCylinder(addShape(new btCylinderShape(btVector3(0.173, 0.2, 0.173))));
+      btCollisionShape *pBox(addShape(new btBoxShape(btVector3(0.1, 0.1, 0.1))));
+      btConvexHullShape *pHull(new btConvexHullShape());
+      for (int i = 0; i < 12; i++) {
+        pHull->addPoint(btVector3(std::cos(i * SIMD_2_PI / 12) * 0.1, (i % 2) * 0.1, std::sin(i * SIMD_2_PI / 12) * 0.1));
+      }
+      addShape(pHull);
+      btCollisionShape *pCapsule(addShape(new btCapsuleShape(0.03, 0.1 - 2 * 0.03)));
+      btCollisionShape *pSphere(addShape(new btSphereShape(0.02)));
+      std::vector<btCollisionShape*> vTriangleMeshes;
+      for (int iTriangles : TRIANGLE_MESH_TRIANGLES) {
+        vTriangleMeshes.push_back(addShape(createWall(iTriangles)));
+      }
+
+      for (int c = 0; c < iCopies; c++) {
+        const btVector3 vOffset((c - (iCopies - 1) * 0.5f) * MAP_SIZE, 0, 0);
+        auto randomPosition = [&](btScalar y) {return vOffset + btVector3(position(random), y, position(random));};
+        auto randomTransform = [&](btScalar y) {return btTransform(btQuaternion(btVector3(0, 1, 0), angle(random)), randomPosition(y));};
+
+        addBody(pGround, 0, btTransform(btQuaternion::getIdentity(), vOffset + btVector3(0, -0.1, 0)));
+        for (btCollisionShape *pMesh : vTriangleMeshes) {addBody(pMesh, 0, randomTransform(0));}
+        for (int i = 0; i < CYLINDER_COUNT; i++) {addBody(pCylinder, 0, randomTransform(0.2));}
+        for (int i = 0; i < BOX_COUNT; i++) {addBody(pBox, 0, randomTransform(0.1));}
+        for (int i = 0; i < CONVEX_HULL_COUNT; i++) {addBody(pHull, 0, randomTransform(0));}
+        for (int i = 0; i < CHARACTER_COUNT; i++) {
+          m_vCharacters.push_back(addBody(pCapsule, 1, randomTransform(0.05)));
+          m_vCharacters.back()->setAngularFactor(0);
+          m_vCharacters.back()->setActivationState(DISABLE_DEACTIVATION);
+        }
+        for (int i = 0; i < FALLING_OBJECT_COUNT; i++) {addBody(pSphere, 0.1, randomTransform(0.5));}
+      }
+    }
+
+    ~CWorld() {
+      for (auto &pBody : m_vBodies) {
+        m_World.removeRigidBody(pBody.get());
+      }
+    }
+
+    btDiscreteDynamicsWorld &getWorld() {return m_World;}
+
+    void step(int iFrame) {
+      // the characters walk in circles
+      for (size_t i = 0; i < m_vCharacters.size(); i++) {
+        const btScalar fAngle(iFrame * 0.02f + i);
+        const btVector3 &vVelocity(m_vCharacters[i]->getLinearVelocity());
+        m_vCharacters[i]->setLinearVelocity(btVector3(std::cos(fAngle) * 0.3f, vVelocity.y(), std::sin(fAngle) * 0.3f));
+      }
+      m_World.stepSimulation(TIME_STEP, 1, TIME_STEP);
+    }
+
+  private:
+    btCollisionShape *addShape(btCollisionShape *pShape) {
+      m_vShapes.emplace_back(pShape);
+      return pShape;
+    }
+
+    //! a wall of quads, the physics meshes of link_house are walls and floors of some triangles
+    btCollisionShape *createWall(int iTriangles) {
+      m_vMeshes.emplace_back(new btTriangleMesh());
+      btTriangleMesh *pMesh(m_vMeshes.back().get());
+      const btScalar fWidth(0.05);
+      for (int i = 0; i < iTriangles; i++) {
+        const btScalar x(fWidth * (i / 2));
+        if (i % 2 == 0) {
+          pMesh->addTriangle(btVector3(x, 0, 0), btVector3(x + fWidth, 0, 0), btVector3(x, 0.1, 0));
+        }
+        else {
+          pMesh->addTriangle(btVector3(x + fWidth, 0, 0), btVector3(x + fWidth, 0.1, 0), btVector3(x, 0.1, 0));
+        }
+      }
+      return new btBvhTriangleMeshShape(pMesh, true);
+    }
+
+    btRigidBody *addBody(btCollisionShape *pShape, btScalar fMass, const btTransform &transform) {
+      btVector3 vInertia(0, 0, 0);
+      if (fMass > 0) {pShape->calculateLocalInertia(fMass, vInertia);}
+      m_vMotionStates.emplace_back(new btDefaultMotionState(transform));
+      m_vBodies.emplace_back(new btRigidBody(btRigidBody::btRigidBodyConstructionInfo(fMass, m_vMotionStates.back().get(), pShape, vInertia)));
+      m_World.addRigidBody(m_vBodies.back().get());
+      return m_vBodies.back().get();
+    }
+  };
+
+  struct SResult {
+    double fStepMs;           //!< of the world, the reference
+    double fDrawMs;           //!< generation and upload of the lines
+    double fRenderMs;         //!< renderOneFrame
+    double fMaxDrawMs;
+  };
+
+  SResult run(EVariant eVariant, Ogre::Root &root, Ogre::SceneManager *pSceneManager, Ogre::Camera *pCamera, int iFrames, int iCopies) {
+    CWorld world(iCopies);
+    Ogre::SceneNode *pNode(pSceneManager->getRootSceneNode()->createChildSceneNode());
+    std::unique_ptr<CFullRedrawDrawer> pDrawer(new CFullRedrawDrawer(pNode, &world.getWorld()));
+    world.getWorld().setDebugDrawer(pDrawer.get());
+    pDrawer->setDebugMode(eVariant == V_HIDDEN ? btIDebugDraw::DBG_NoDebug : DEBUG_DRAW_MODE);
+
+    SResult result = {0, 0, 0, 0};
+    for (int f = 0; f < iFrames; f++) {
+      const auto start(Clock::now());
+      world.step(f);
+      const auto stepped(Clock::now());
+      switch (eVariant) {
+      case V_FULL_REDRAW:
+        pDrawer->stepFullRedraw();
+        break;
+      case V_STEP_CULLED:
+        // no body is added or removed, the generation is constant
+        pDrawer->step(pCamera, 0);
+        break;
+      default:
+        pDrawer->step(nullptr, 0);
+        break;
+      }
+      const auto drawn(Clock::now());
+      root.renderOneFrame();
+      const auto end(Clock::now());
+
+      const double fDrawMs(std::chrono::duration<double, std::milli>(drawn - stepped).count());
+      result.fStepMs += std::chrono::duration<double, std::milli>(stepped - start).count();
+      result.fDrawMs += fDrawMs;
+      result.fRenderMs += std::chrono::duration<double, std::milli>(end - drawn).count();
+      result.fMaxDrawMs = std::max(result.fMaxDrawMs, fDrawMs);
+    }
+
+    world.getWorld().setDebugDrawer(nullptr);
+    pDrawer.reset();
+    pSceneManager->destroySceneNode(pNode);
+
+    result.fStepMs /= iFrames;
+    result.fDrawMs /= iFrames;
+    result.fRenderMs /= iFrames;
+    return result;
+  }
+}
+
+int main(int argc, char **argv) {
+  const int iFrames(argc > 3 ? atoi(argv[3]) : 600);
+  const int iCopies(argc > 4 ? atoi(argv[4]) : 1);
+  if (argc < 3 || iFrames <= 0 || iCopies <= 0) {
+    printf("usage: %s plugins.cfg ogre.cfg [frames] [copies of the map]\n", argv[0]);
+    return 1;
+  }
+
+  Ogre::Root root(argv[1], argv[2], "DebugDrawBenchmark.log");
+  if (!root.restoreConfig()) {
+    printf("%s has no valid configuration, start the game once to create it\n", argv[2]);
+    return 1;
+  }
+  Ogre::RenderWindow *pWindow(root.initialise(true, "DebugDrawBenchmark"));
+  Ogre::SceneManager *pSceneManager(root.createSceneManager(Ogre::ST_GENERIC));
+  Ogre::Camera *pCamera(pSceneManager->createCamera("Camera"));
+  // looks down onto the center map, like the camera of the game it sees a part of the map
+  pCamera->setPosition(0, 2, 1);
+  pCamera->lookAt(0, 0, 0);
+  pCamera->setNearClipDistance(0.01);
+  Ogre::Viewport *pViewport(pWindow->addViewport(pCamera));
+  pCamera->setAspectRatio(Ogre::Real(pViewport->getActualWidth()) / Ogre::Real(pViewport->getActualHeight()));
+
+  printf("%d frames, %d copies of link_house, %s\n", iFrames, iCopies, root.getRenderSystem()->getName().c_str());
+  printf("%-14s %10s %10s %14s %12s %12s\n", "lines", "step [ms]", "draw [ms]", "max draw [ms]", "render [ms]", "delta [ms]");
+  double fHiddenMs(0);
+  for (int v = 0; v < V_COUNT; v++) {
+    const SResult result(run(static_cast<EVariant>(v), root, pSceneManager, pCamera, iFrames, iCopies));
+    const double fFrameMs(result.fStepMs + result.fDrawMs + result.fRenderMs);
+    if (v == V_HIDDEN) {fHiddenMs = fFrameMs;}
+    printf("%-14s %10.3f %10.3f %14.3f %12.3f %12.3f\n", VARIANT_NAMES[v], result.fStepMs, result.fDrawMs,
+           result.fMaxDrawMs, result.fRenderMs, fFrameMs - fHiddenMs);
+  }
+  return 0;
+}
@@ -0,0 +1,155 @@
+/*****************************************************************************
+ * Copyright 2014 Christoph Wick
+ *
+ * This file is part of Zelda.
+ *
+ * Zelda is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zelda is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Zelda. If not, see http://www.gnu.org/licenses/.
+ *****************************************************************************/
+
+// Lookup of entities by their id (CEntity::getChildRecursive) in a tree of
+// 10k entities, with the hash index of the CEntityRegistry and with the
+// recursive walk through the children lists it replaced (the walk is used
+// if there is no registry). The tree is shaped like the maps of the game:
+// the root has some maps, every map has groups of objects and every object
+// has a few inner children that all use the same ids.
+//   hit:   id of an entity in the searched map
+//   inner: id of an inner child, it exists in every object of the map
+//   miss:  id of an entity in an other map, the walk visits the whole map
+// The ids are created as atoms beforehand, like the ids parsed from the map
+// files. Both lookups have to return the same entity.
+//
+// usage: EntityLookupBenchmark [entities] [lookups] [maps]
+
+#include "Common/GameLogic/Entity.hpp"
+#include "Common/GameLogic/EntityRegistry.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+  const int GROUPS_PER_MAP(4);
+  const int INNER_CHILDREN(3);
+
+  struct SLookup {
+    CEntity *pScope;
+    CAtom sID;
+  };
+
+  struct STree {
+    std::unique_ptr<CEntity> pRoot;
+    std::vector<CEntity*> vMaps;
+    std::vector<std::vector<CEntity*> > vObjects;     //!< per map
+    size_t uiEntities;
+  };
+
+  void createTree(STree &tree, int iEntities, int iMaps) {
+    tree.pRoot.reset(new CEntity("root", nullptr));
+    tree.uiEntities = 1;
+    tree.vObjects.resize(iMaps);
+
+    // every object comes with its inner children
+    const int iObjectsPerMap(std::max(1, iEntities / iMaps / (INNER_CHILDREN + 1)));
+    for (int m = 0; m < iMaps; m++) {
+      CEntity *pMap(new CEntity("map_" + std::to_string(m), tree.pRoot.get()));
+      tree.vMaps.push_back(pMap);
+      std::vector<CEntity*> vGroups;
+      for (int g = 0; g < GROUPS_PER_MAP; g++) {
+        vGroups.push_back(new CEntity("group_" + std::to_string(g), pMap));
+      }
+      tree.uiEntities += 1 + GROUPS_PER_MAP;
+
+      for (int o = 0; o < iObjectsPerMap; o++) {
+        CEntity *pObject(new CEntity("object_" + std::to_string(m) + "_" + std::to_string(o), vGroups[o % GROUPS_PER_MAP]));
+        tree.vObjects[m].push_back(pObject);
+        for (int i = 0; i < INNER_CHILDREN; i++) {
+          new CEntity("inner_" + std::to_string(i), pObject);
+        }
+        tree.uiEntities += 1 + INNER_CHILDREN;
+      }
+    }
+  }
+
+  //! ns per lookup, the found entities are stored
+  double run(const std::vector<SLookup> &vLookups, std::vector<CEntity*> &vFound) {
+    vFound.resize(vLookups.size());
+    const auto start(std::chrono::steady_clock::now());
+    for (size_t i = 0; i < vLookups.size(); i++) {
+      vFound[i] = vLookups[i].pScope->getChildRecursive(vLookups[i].sID);
+    }
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / vLookups.size();
+  }
+}
+
+int main(int argc, char **argv) {
+  const int iEntities(argc > 1 ? atoi(argv[1]) : 10000);
+  const int iLookups(argc > 2 ? atoi(argv[2]) : 100000);
+  const int iMaps(argc > 3 ? atoi(argv[3]) : 4);
+  if (iEntities <= 0 || iLookups <= 0 || iMaps <= 1) {
+    printf("usage: %s [entities] [lookups] [maps, at least 2]\n", argv[0]);
+    return 1;
+  }
+
+  // the entities register themselves while they are attached
+  std::unique_ptr<CEntityRegistry> pRegistry(new CEntityRegistry());
+  STree tree;
+  createTree(tree, iEntities, iMaps);
+
+  // same lookups for both
+  std::mt19937 random(42);
+  const char *pKinds[3] = {"hit", "inner", "miss"};
+  std::vector<SLookup> vLookups[3];
+  for (int i = 0; i < iLookups; i++) {
+    const int iMap(random() % iMaps);
+    const std::vector<CEntity*> &vObjects(tree.vObjects[iMap]);
+    CEntity *pObject(vObjects[random() % vObjects.size()]);
+    vLookups[0].push_back({tree.vMaps[iMap], pObject->getID()});
+    vLookups[1].push_back({pObject, CAtom("inner_" + std::to_string(random() % INNER_CHILDREN))});
+    const std::vector<CEntity*> &vOther(tree.vObjects[(iMap + 1) % iMaps]);
+    vLookups[2].push_back({tree.vMaps[iMap], vOther[random() % vOther.size()]->getID()});
+  }
+
+  printf("%zu entities in %d maps, %d lookups\n", tree.uiEntities, iMaps, iLookups);
+  printf("%-8s %14s %14s %10s\n", "lookup", "registry [ns]", "walk [ns]", "speedup");
+
+  double fRegistry[3];
+  std::vector<CEntity*> vFound[3];
+  for (int k = 0; k < 3; k++) {
+    fRegistry[k] = run(vLookups[k], vFound[k]);
+  }
+
+  // without a registry getChildRecursive walks through the children
+  pRegistry.reset();
+  size_t uiMismatches(0);
+  for (int k = 0; k < 3; k++) {
+    std::vector<CEntity*> vWalkFound;
+    const double fWalk(run(vLookups[k], vWalkFound));
+    for (size_t i = 0; i < vWalkFound.size(); i++) {
+      if (vWalkFound[i] != vFound[k][i]) {uiMismatches++;}
+    }
+    printf("%-8s %14.1f %14.1f %9.1fx\n", pKinds[k], fRegistry[k], fWalk, fWalk / fRegistry[k]);
+  }
+
+  tree.pRoot.reset();
+
+  if (uiMismatches > 0) {
+    printf("%zu lookups returned different entities\n", uiMismatches);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,197 @@
+/*****************************************************************************
+ * Copyright 2014 Christoph Wick
+ *
+ * This file is part of Zelda.
+ *
+ * Zelda is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zelda is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Zelda. If not, see http://www.gnu.org/licenses/.
+ *****************************************************************************/
+
+// Frame update of a map with 1k and 10k children, called from the flat per
+// phase arrays of the CEntityUpdateLayout and with the recursive walk through
+// the children list it replaced (CEntity without enableChildUpdateLayout).
+// The children are a mix like in a map, created in an interleaved order:
+//   regions:    no phase at all (setUpdatePhases(EUPM_NONE), like CRegion)
+//   objects:    the default phases, a small update
+//   characters: additionally a prepare update (like CCharacter), that runs
+//               on the job system in the layout. In the walk it is done in
+//               their update, so both variants do the same work.
+// Every frame calls all phases on the map like the atlas does. The work that
+// was done is counted and has to be equal in both variants.
+//
+// usage: EntityUpdateBenchmark [frames] [workers, 0: one less than the cores]
+
+#include "Common/GameLogic/Entity.hpp"
+#include "Common/GameLogic/EntityUpdateLayout.hpp"
+#include "Common/Jobs/JobSystem.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+
+namespace {
+  const unsigned int TYPE_REGION(1);
+  const unsigned int TYPE_OBJECT(2);
+  const unsigned int TYPE_CHARACTER(3);
+  // iterations of the prepare update of a character, stands in for the controller
+  const int PREPARE_ITERATIONS(64);
+  const Ogre::Real TIME_PER_FRAME(1.0f / 60);
+
+  std::atomic<size_t> g_uiPrepared(0);
+  size_t g_uiUpdated(0);
+  size_t g_uiRendered(0);
+
+  class CObjectEntity : public CEntity {
+  private:
+    Ogre::Real m_fPosition;
+    Ogre::Real m_fVelocity;
+  public:
+    CObjectEntity(const std::string &sID, CEntity *pParent)
+      : CEntity(sID, TYPE_OBJECT, pParent), m_fPosition(0), m_fVelocity(1) {}
+
+    void update(Ogre::Real tpf) {
+      CEntity::update(tpf);
+      m_fPosition += m_fVelocity * tpf;
+      g_uiUpdated++;
+    }
+    void render(Ogre::Real tpf) {
+      CEntity::render(tpf);
+      g_uiRendered++;
+    }
+  };
+
+  class CRegionEntity : public CEntity {
+  public:
+    CRegionEntity(const std::string &sID, CEntity *pParent)
+      : CEntity(sID, TYPE_REGION, pParent) {
+      setUpdatePhases(EUPM_NONE);
+    }
+  };
+
+  class CCharacterEntity : public CEntity {
+  private:
+    Ogre::Real m_fYaw;
+    Ogre::Real m_fTarget;
+  public:
+    CCharacterEntity(const std::string &sID, CEntity *pParent)
+      : CEntity(sID, TYPE_CHARACTER, pParent), m_fYaw(0), m_fTarget(0) {
+      setUpdatePhases(getUpdatePhases() | EUPM_PREPARE_UPDATE);
+    }
+
+    void prepareUpdate(Ogre::Real tpf) {
+      Ogre::Real fTarget(m_fYaw);
+      for (int i = 0; i < PREPARE_ITERATIONS; i++) {
+        fTarget = std::sin(fTarget + tpf);
+      }
+      m_fTarget = fTarget;
+      g_uiPrepared.fetch_add(1, std::memory_order_relaxed);
+    }
+    void update(Ogre::Real tpf) {
+      if (!getParent()->getChildUpdateLayout()) {
+        // the walk has no prepare phase
+        prepareUpdate(tpf);
+      }
+      CEntity::update(tpf);
+      m_fYaw += (m_fTarget - m_fYaw) * tpf;
+      g_uiUpdated++;
+    }
+    void render(Ogre::Real tpf) {
+      CEntity::render(tpf);
+      g_uiRendered++;
+    }
+  };
+
+  struct SResult {
+    double fFrameMs;              //!< per frame
+    double fMaxFrameMs;
+    size_t uiWork;                //!< prepared, updated and rendered entities
+  };
+
+  SResult run(bool bLayout, int iChildren, int iFrames) {
+    std::unique_ptr<CEntity> pMap(new CEntity("map", nullptr));
+    if (bLayout) {
+      pMap->enableChildUpdateLayout();
+    }
+    for (int i = 0; i < iChildren; i++) {
+      const std::string sID("child_" + std::to_string(i));
+      // 20% regions, 60% objects, 20% characters
+      switch (i % 5) {
+      case 0:
+        new CRegionEntity(sID, pMap.get());
+        break;
+      case 1:
+        new CCharacterEntity(sID, pMap.get());
+        break;
+      default:
+        new CObjectEntity(sID, pMap.get());
+        break;
+      }
+    }
+
+    g_uiPrepared = 0;
+    g_uiUpdated = 0;
+    g_uiRendered = 0;
+    Ogre::FrameEvent evt;
+    evt.timeSinceLastEvent = TIME_PER_FRAME;
+    evt.timeSinceLastFrame = TIME_PER_FRAME;
+
+    SResult result = {0, 0, 0};
+    for (int f = 0; f < iFrames; f++) {
+      const auto start(std::chrono::steady_clock::now());
+      pMap->frameStarted(evt);
+      pMap->update(TIME_PER_FRAME);
+      pMap->preRender(TIME_PER_FRAME);
+      pMap->render(TIME_PER_FRAME);
+      pMap->renderDebug(TIME_PER_FRAME);
+      const double fFrameMs(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+      result.fFrameMs += fFrameMs;
+      result.fMaxFrameMs = std::max(result.fMaxFrameMs, fFrameMs);
+    }
+
+    result.fFrameMs /= iFrames;
+    result.uiWork = g_uiPrepared + g_uiUpdated + g_uiRendered;
+    return result;
+  }
+}
+
+int main(int argc, char **argv) {
+  const int iFrames(argc > 1 ? atoi(argv[1]) : 1000);
+  const int iWorkers(argc > 2 ? atoi(argv[2]) : 0);
+  if (iFrames <= 0 || iWorkers < 0) {
+    printf("usage: %s [frames] [workers, 0: one less than the cores]\n", argv[0]);
+    return 1;
+  }
+
+  CJobSystem jobSystem(static_cast<unsigned int>(iWorkers));
+  printf("%d frames, %u workers\n", iFrames, jobSystem.getWorkerCount());
+  printf("%-10s %-8s %12s %16s %10s\n", "entities", "update", "frame [ms]", "max frame [ms]", "speedup");
+
+  size_t uiMismatches(0);
+  for (int iChildren : {1000, 10000}) {
+    const SResult walk(run(false, iChildren, iFrames));
+    printf("%-10d %-8s %12.3f %16.3f %10s\n", iChildren, "walk", walk.fFrameMs, walk.fMaxFrameMs, "-");
+    const SResult layout(run(true, iChildren, iFrames));
+    printf("%-10d %-8s %12.3f %16.3f %9.2fx\n", iChildren, "layout", layout.fFrameMs, layout.fMaxFrameMs, walk.fFrameMs / layout.fFrameMs);
+    if (walk.uiWork != layout.uiWork) {uiMismatches++;}
+  }
+
+  if (uiMismatches > 0) {
+    printf("the walk and the layout did a different amount of work\n");
+    return 1;
+  }
+  return 0;
+}
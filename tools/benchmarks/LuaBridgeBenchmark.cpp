@@ -0,0 +1,188 @@
+/*****************************************************************************
+ * Copyright 2014 Christoph Wick
+ *
+ * This file is part of Zelda.
+ *
+ * Zelda is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zelda is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Zelda. If not, see http://www.gnu.org/licenses/.
+ *****************************************************************************/
+
+// Overhead of a bridge call (LUA_BRIDGE_START) that resolves the calling
+// script. Every script runs a loop of bridge calls in a coroutine.
+//   none:     the bridge function does not resolve the script, the base line
+//   scan:     the former CLuaScriptManager::getByLuaState, it locks the
+//             manager and casts and compares every loaded script, every
+//             script has its own lua state
+//   registry: the owner table of LuaThreadOwner (CLuaScript::getFromLuaState)
+//             in one shared lua state
+// Every call checks that the lookup returns the calling script.
+//
+// usage: LuaBridgeBenchmark [scripts] [calls per script]
+
+extern "C"{
+  #include <lua.h>
+  #include <lualib.h>
+  #include <lauxlib.h>
+}
+#include "Common/Lua/LuaThreadOwner.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+  // stand ins for Ogre::Resource and CLuaScript, the manager stores the base class
+  class CResource {
+  public:
+    virtual ~CResource() {}
+  };
+  class CScript : public CResource {
+  public:
+    lua_State *pState;          //!< own state (scan) or the shared state (registry)
+    lua_State *pThread;         //!< coroutine running the loop
+    CScript() : pState(nullptr), pThread(nullptr) {}
+  };
+
+  // the resource map and the auto mutex of the manager
+  std::recursive_mutex g_ManagerMutex;
+  std::map<unsigned long, std::shared_ptr<CResource> > g_Resources;
+
+  const CScript *g_pCaller = nullptr;
+  size_t g_uiWrongLookups = 0;
+
+  const CScript *getByLuaStateScan(lua_State *l) {
+    std::lock_guard<std::recursive_mutex> lock(g_ManagerMutex);
+
+    // scripts are running in coroutines, resolve the main thread that is owned by the script
+    lua_rawgeti(l, LUA_REGISTRYINDEX, LUA_RIDX_MAINTHREAD);
+    lua_State *mainThread = lua_tothread(l, -1);
+    lua_pop(l, 1);
+
+    for (auto &entry : g_Resources) {
+      std::shared_ptr<CScript> ptr(std::dynamic_pointer_cast<CScript>(entry.second));
+      if (ptr->pState == mainThread) {
+        return ptr.get();
+      }
+    }
+    return nullptr;
+  }
+
+  int bridgeNone(lua_State *l) {
+    lua_pushinteger(l, 1);
+    return 1;
+  }
+
+  int bridgeScan(lua_State *l) {
+    if (getByLuaStateScan(l) != g_pCaller) {g_uiWrongLookups++;}
+    lua_pushinteger(l, 1);
+    return 1;
+  }
+
+  int bridgeRegistry(lua_State *l) {
+    if (LuaThreadOwner::get(l) != g_pCaller) {g_uiWrongLookups++;}
+    lua_pushinteger(l, 1);
+    return 1;
+  }
+
+  const char *LOOP = "local f, n = ... for i = 1, n do f() end";
+
+  lua_State *createState() {
+    lua_State *l(luaL_newstate());
+    luaL_openlibs(l);
+    return l;
+  }
+
+  void createThread(CScript &script) {
+    script.pThread = lua_newthread(script.pState);
+    // keep the thread alive
+    luaL_ref(script.pState, LUA_REGISTRYINDEX);
+  }
+
+  //! ns per call of all scripts
+  double run(const std::vector<std::shared_ptr<CScript> > &vScripts, lua_CFunction fBridge, int iCalls) {
+    double fSeconds(0);
+    for (const auto &pScript : vScripts) {
+      g_pCaller = pScript.get();
+      lua_State *pThread(pScript->pThread);
+      if (luaL_loadstring(pThread, LOOP) != LUA_OK) {
+        printf("%s\n", lua_tostring(pThread, -1));
+        exit(1);
+      }
+      lua_pushcfunction(pThread, fBridge);
+      lua_pushinteger(pThread, iCalls);
+
+      const auto start(std::chrono::steady_clock::now());
+      const int status(lua_resume(pThread, nullptr, 2));
+      fSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      if (status != LUA_OK) {
+        printf("%s\n", lua_tostring(pThread, -1));
+        exit(1);
+      }
+      lua_settop(pThread, 0);
+    }
+    return fSeconds * 1e9 / (static_cast<double>(iCalls) * vScripts.size());
+  }
+}
+
+int main(int argc, char **argv) {
+  const int iScripts(argc > 1 ? atoi(argv[1]) : 50);
+  const int iCalls(argc > 2 ? atoi(argv[2]) : 200000);
+  if (iScripts <= 0 || iCalls <= 0) {
+    printf("usage: %s [scripts] [calls per script]\n", argv[0]);
+    return 1;
+  }
+
+  // a state per script, registered in the manager
+  std::vector<std::shared_ptr<CScript> > vOwnStates;
+  for (int i = 0; i < iScripts; i++) {
+    std::shared_ptr<CScript> pScript(new CScript());
+    pScript->pState = createState();
+    createThread(*pScript);
+    g_Resources[i] = pScript;
+    vOwnStates.push_back(pScript);
+  }
+
+  // the shared state, every script owns a thread
+  lua_State *pShared(createState());
+  std::vector<std::shared_ptr<CScript> > vSharedState;
+  for (int i = 0; i < iScripts; i++) {
+    std::shared_ptr<CScript> pScript(new CScript());
+    pScript->pState = pShared;
+    createThread(*pScript);
+    LuaThreadOwner::set(pScript->pThread, pScript.get());
+    vSharedState.push_back(pScript);
+  }
+
+  printf("%d scripts, %d calls per script\n", iScripts, iCalls);
+  printf("%-10s %14s %16s\n", "lookup", "call [ns]", "overhead [ns]");
+  const double fNone(run(vSharedState, &bridgeNone, iCalls));
+  printf("%-10s %14.1f %16s\n", "none", fNone, "-");
+  const double fScan(run(vOwnStates, &bridgeScan, iCalls));
+  printf("%-10s %14.1f %16.1f\n", "scan", fScan, fScan - fNone);
+  const double fRegistry(run(vSharedState, &bridgeRegistry, iCalls));
+  printf("%-10s %14.1f %16.1f\n", "registry", fRegistry, fRegistry - fNone);
+
+  for (const auto &pScript : vOwnStates) {
+    lua_close(pScript->pState);
+  }
+  lua_close(pShared);
+
+  if (g_uiWrongLookups > 0) {
+    printf("%zu lookups returned the wrong script\n", g_uiWrongLookups);
+    return 1;
+  }
+  return 0;
+}
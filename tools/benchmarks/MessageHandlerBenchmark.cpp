@@ -0,0 +1,252 @@
+/*****************************************************************************
+ * Copyright 2014 Christoph Wick
+ *
+ * This file is part of Zelda.
+ *
+ * Zelda is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zelda is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Zelda. If not, see http://www.gnu.org/licenses/.
+ *****************************************************************************/
+
+// Adding and delivering a burst of messages per frame with CMessageHandler,
+// compared with the mutex protected std::list of heap messages it replaced.
+// The producer threads add far more messages than the ring holds, so most of
+// them take the overflow queue of the handler. Two consumers:
+//   frame end:   the main thread processes after the producers are done, like CGame
+//   concurrent:  the main thread processes while the producers add, so the ring is
+//                refilled while overflow entries are pending
+// Every message carries its producer and a sequence number, the receiver checks
+// that the messages of each producer arrive complete and in order. The enqueue
+// latency includes reading the clock twice.
+//
+// usage: MessageHandlerBenchmark [frames] [messages per frame] [producers]
+
+#include "Common/Message/MessageHandler.hpp"
+#include "Common/Message/MessageInjector.hpp"
+#include "Common/Message/Message.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+  typedef std::chrono::steady_clock Clock;
+
+  class CBenchmarkMessage : public CMessage {
+  public:
+    static const unsigned int MESSAGE_TYPE = MSG_USER;
+    const unsigned int uiProducer;
+    const size_t uiSequence;
+    CBenchmarkMessage(unsigned int producer, size_t sequence)
+      : CMessage(MESSAGE_TYPE), uiProducer(producer), uiSequence(sequence) {}
+  };
+
+  //! checks that the messages of each producer arrive complete and in order
+  class CChecker {
+  private:
+    std::vector<size_t> m_vExpected;
+  public:
+    size_t uiReceived;
+    size_t uiOutOfOrder;
+
+    CChecker(unsigned int uiProducers) : m_vExpected(uiProducers, 0), uiReceived(0), uiOutOfOrder(0) {}
+
+    void receive(const CMessage &message) {
+      const CBenchmarkMessage &m(message.getAs<CBenchmarkMessage>());
+      if (m.uiSequence != m_vExpected[m.uiProducer]) {uiOutOfOrder++;}
+      m_vExpected[m.uiProducer] = m.uiSequence + 1;
+      uiReceived++;
+    }
+  };
+
+  class CReceiver : public CMessageInjector {
+  private:
+    CChecker &m_Checker;
+  public:
+    CReceiver(CChecker &checker) : CMessageInjector(false), m_Checker(checker) {
+      subscribeMessage(CBenchmarkMessage::MESSAGE_TYPE);
+    }
+    void sendMessageToAll(const CMessage &message) {m_Checker.receive(message);}
+  };
+
+  //! the real handler, the messages are constructed in place
+  class CHandlerQueue {
+  private:
+    CMessageHandler m_Handler;
+    CReceiver m_Receiver;
+  public:
+    CHandlerQueue(CChecker &checker) : m_Receiver(checker) {}
+    void push(unsigned int uiProducer, size_t uiSequence) {
+      m_Handler.createMessage<CBenchmarkMessage>(uiProducer, uiSequence);
+    }
+    void process() {m_Handler.process();}
+    size_t getOverflowCount() const {return m_Handler.getOverflowCount();}
+  };
+
+  //! the handler before the ring: a heap message and a heap entry per message
+  class CListQueue {
+  private:
+    struct SMessageEntry {
+      bool bAutoDelete;
+      const CMessage *pMessage;
+
+      ~SMessageEntry() {
+        if (bAutoDelete) {
+          delete pMessage;
+        }
+      }
+    };
+
+    CChecker &m_Checker;
+    std::mutex mMutex;
+    std::list<std::unique_ptr<SMessageEntry> > m_lMessages;
+  public:
+    CListQueue(CChecker &checker) : m_Checker(checker) {}
+    void push(unsigned int uiProducer, size_t uiSequence) {
+      const CMessage *m(new CBenchmarkMessage(uiProducer, uiSequence));
+      mMutex.lock();
+      m_lMessages.push_back(std::unique_ptr<SMessageEntry>(new SMessageEntry()));
+      m_lMessages.back()->bAutoDelete = true;
+      m_lMessages.back()->pMessage = m;
+      mMutex.unlock();
+    }
+    void process() {
+      mMutex.lock();
+      std::list<std::unique_ptr<SMessageEntry> > l;
+      l.splice(l.end(), m_lMessages);
+      mMutex.unlock();
+
+      while (l.size() > 0) {
+        m_Checker.receive(*l.front()->pMessage);
+        l.pop_front();
+      }
+    }
+    size_t getOverflowCount() const {return 0;}
+  };
+
+  struct SResult {
+    double fEnqueueMsPerFrame;      //!< wall time of the producers per frame
+    double fProcessMsPerFrame;      //!< time of the main thread in process() per frame
+    double fMessagesPerSecond;      //!< throughput of the producers
+    double fLatencyNs[4];           //!< 50, 99, 99.9 percentile and maximum of one enqueue
+    size_t uiOverflow;
+    size_t uiLost;
+    size_t uiOutOfOrder;
+  };
+
+  template <class Queue>
+  SResult run(bool bConcurrent, size_t uiFrames, size_t uiMessagesPerFrame, unsigned int uiProducers) {
+    const size_t uiPerProducer(uiMessagesPerFrame / uiProducers);
+    CChecker checker(uiProducers);
+    std::unique_ptr<Queue> pQueue(new Queue(checker));
+    std::vector<std::vector<uint32_t> > vLatencies(uiProducers);
+    for (auto &v : vLatencies) {v.reserve(uiPerProducer * uiFrames);}
+
+    SResult result = {0, 0, 0, {0, 0, 0, 0}, 0, 0, 0};
+    double fEnqueueSeconds(0);
+    for (size_t f = 0; f < uiFrames; f++) {
+      std::atomic<bool> bStart(false);
+      std::atomic<unsigned int> uiRunning(uiProducers);
+      std::vector<std::thread> vThreads;
+      for (unsigned int p = 0; p < uiProducers; p++) {
+        vThreads.push_back(std::thread([&, p, f]() {
+              std::vector<uint32_t> &vLatency(vLatencies[p]);
+              while (!bStart.load(std::memory_order_acquire)) {}
+              for (size_t i = 0; i < uiPerProducer; i++) {
+                const auto start(Clock::now());
+                pQueue->push(p, f * uiPerProducer + i);
+                vLatency.push_back(static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count()));
+              }
+              uiRunning.fetch_sub(1, std::memory_order_release);
+            }));
+      }
+
+      const auto start(Clock::now());
+      bStart.store(true, std::memory_order_release);
+      double fProcessSeconds(0);
+      if (bConcurrent) {
+        while (uiRunning.load(std::memory_order_acquire) > 0) {
+          const auto processStart(Clock::now());
+          pQueue->process();
+          fProcessSeconds += std::chrono::duration<double>(Clock::now() - processStart).count();
+        }
+      }
+      for (std::thread &t : vThreads) {t.join();}
+      fEnqueueSeconds += std::chrono::duration<double>(Clock::now() - start).count();
+
+      // everything of the frame is delivered at its end
+      const auto processStart(Clock::now());
+      pQueue->process();
+      fProcessSeconds += std::chrono::duration<double>(Clock::now() - processStart).count();
+      result.fProcessMsPerFrame += fProcessSeconds * 1000;
+    }
+
+    std::vector<uint32_t> vAll;
+    for (auto &v : vLatencies) {vAll.insert(vAll.end(), v.begin(), v.end());}
+    std::sort(vAll.begin(), vAll.end());
+    const double fPercentiles[3] = {0.5, 0.99, 0.999};
+    for (int i = 0; i < 3; i++) {
+      result.fLatencyNs[i] = vAll[std::min(vAll.size() - 1, static_cast<size_t>(fPercentiles[i] * vAll.size()))];
+    }
+    result.fLatencyNs[3] = vAll.back();
+
+    result.fEnqueueMsPerFrame = fEnqueueSeconds * 1000 / uiFrames;
+    result.fProcessMsPerFrame /= uiFrames;
+    result.fMessagesPerSecond = vAll.size() / fEnqueueSeconds;
+    result.uiOverflow = pQueue->getOverflowCount();
+    result.uiLost = vAll.size() - checker.uiReceived;
+    result.uiOutOfOrder = checker.uiOutOfOrder;
+    return result;
+  }
+
+  void print(const char *pName, const SResult &result) {
+    printf("%-20s %12.2f %12.2f %10.2f %8.0f %8.0f %8.0f %9.0f %10zu %6zu %8zu\n", pName,
+           result.fEnqueueMsPerFrame, result.fProcessMsPerFrame, result.fMessagesPerSecond / 1e6,
+           result.fLatencyNs[0], result.fLatencyNs[1], result.fLatencyNs[2], result.fLatencyNs[3],
+           result.uiOverflow, result.uiLost, result.uiOutOfOrder);
+  }
+}
+
+int main(int argc, char **argv) {
+  const long iFrames(argc > 1 ? atol(argv[1]) : 20);
+  const long iMessagesPerFrame(argc > 2 ? atol(argv[2]) : 100000);
+  const long iProducers(argc > 3 ? atol(argv[3]) : 4);
+  if (iFrames <= 0 || iProducers <= 0 || iMessagesPerFrame < iProducers) {
+    printf("usage: %s [frames] [messages per frame] [producers]\n", argv[0]);
+    return 1;
+  }
+  const size_t uiFrames(iFrames);
+  const size_t uiMessagesPerFrame(iMessagesPerFrame);
+  const unsigned int uiProducers(iProducers);
+
+  printf("%zu frames with %zu messages from %u producers, ring of %zu slots, %u hardware threads\n",
+         uiFrames, uiMessagesPerFrame, uiProducers, CMessageHandler::MESSAGE_QUEUE_CAPACITY, std::thread::hardware_concurrency());
+  printf("%-20s %12s %12s %10s %8s %8s %8s %9s %10s %6s %8s\n", "queue", "enqueue [ms]", "process [ms]", "M msg/s",
+         "p50 [ns]", "p99 [ns]", "p99.9", "max [ns]", "overflow", "lost", "order");
+
+  size_t uiErrors(0);
+  for (bool bConcurrent : {false, true}) {
+    const SResult handler(run<CHandlerQueue>(bConcurrent, uiFrames, uiMessagesPerFrame, uiProducers));
+    print(bConcurrent ? "handler, concurrent" : "handler, frame end", handler);
+    const SResult list(run<CListQueue>(bConcurrent, uiFrames, uiMessagesPerFrame, uiProducers));
+    print(bConcurrent ? "list, concurrent" : "list, frame end", list);
+    uiErrors += handler.uiLost + handler.uiOutOfOrder + list.uiLost + list.uiOutOfOrder;
+  }
+  return uiErrors == 0 ? 0 : 1;
+}
@@ -0,0 +1,192 @@
+/*****************************************************************************
+ * Copyright 2014 Christoph Wick
+ *
+ * This file is part of Zelda.
+ *
+ * Zelda is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zelda is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Zelda. If not, see http://www.gnu.org/licenses/.
+ *****************************************************************************/
+
+// Compares the message ring of CMessageHandler with the mutex protected
+// std::list it replaced. Like in the game, several producer threads add the
+// messages of a frame concurrently and the main thread takes all of them
+// afterwards (CMessageHandler::process). A frame never fills the ring, see
+// MessageHandlerBenchmark for bursts that take the overflow queue.
+//
+// usage: MessageRingBenchmark [frames] [messages per frame]
+
+#include "Common/Message/MessageRing.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+  // same capacity and slot size as CMessageHandler
+  const size_t CAPACITY = 1024;
+  const size_t SLOT_SIZE = 128;
+
+  struct SMessage {
+    size_t uiValue;
+    char pPayload[SLOT_SIZE - sizeof(size_t)];
+  };
+
+  class CRingQueue {
+  private:
+    CMessageRing<SMessage, CAPACITY> m_Ring;
+  public:
+    void push(size_t uiValue) {
+      size_t uiPosition;
+      SMessage *pMessage;
+      // a frame never fills the ring, the handler would use its overflow queue
+      if (!(pMessage = m_Ring.reserve(uiPosition))) {
+        printf("error: ring full\n");
+        exit(1);
+      }
+      pMessage->uiValue = uiValue;
+      m_Ring.publish(uiPosition);
+    }
+    bool pop(size_t &uiValue) {
+      SMessage *pMessage(m_Ring.front());
+      if (!pMessage) {return false;}
+      uiValue = pMessage->uiValue;
+      m_Ring.pop();
+      return true;
+    }
+  };
+
+  //! the queue of the message handler before the ring: one heap entry per message
+  class CListQueue {
+  private:
+    std::mutex m_Mutex;
+    std::list<SMessage*> m_lMessages;
+  public:
+    void push(size_t uiValue) {
+      SMessage *pMessage(new SMessage);
+      pMessage->uiValue = uiValue;
+      std::lock_guard<std::mutex> lock(m_Mutex);
+      m_lMessages.push_back(pMessage);
+    }
+    bool pop(size_t &uiValue) {
+      SMessage *pMessage;
+      {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        if (m_lMessages.empty()) {return false;}
+        pMessage = m_lMessages.front();
+        m_lMessages.pop_front();
+      }
+      uiValue = pMessage->uiValue;
+      delete pMessage;
+      return true;
+    }
+  };
+
+  //! runs the producers of a frame, they wait for the next frame in between
+  class CFrameProducers {
+  private:
+    std::mutex m_Mutex;
+    std::condition_variable m_Condition;
+    unsigned int m_uiFrame;
+    unsigned int m_uiRunning;
+    bool m_bQuit;
+    std::vector<std::thread> m_vThreads;
+  public:
+    template <class F>
+    CFrameProducers(unsigned int uiProducers, const F &fProduce)
+      : m_uiFrame(0), m_uiRunning(0), m_bQuit(false) {
+      for (unsigned int p = 0; p < uiProducers; p++) {
+        m_vThreads.push_back(std::thread([this, fProduce]() {
+              unsigned int uiFrame(0);
+              while (true) {
+                {
+                  std::unique_lock<std::mutex> lock(m_Mutex);
+                  m_Condition.wait(lock, [this, uiFrame]() {return m_bQuit || m_uiFrame != uiFrame;});
+                  if (m_bQuit) {return;}
+                  uiFrame = m_uiFrame;
+                }
+                fProduce();
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                if (--m_uiRunning == 0) {m_Condition.notify_all();}
+              }
+            }));
+      }
+    }
+    ~CFrameProducers() {
+      {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_bQuit = true;
+      }
+      m_Condition.notify_all();
+      for (std::thread &t : m_vThreads) {t.join();}
+    }
+    //! let all producers add their messages and wait until they are finished
+    void frame() {
+      std::unique_lock<std::mutex> lock(m_Mutex);
+      m_uiRunning = static_cast<unsigned int>(m_vThreads.size());
+      ++m_uiFrame;
+      m_Condition.notify_all();
+      m_Condition.wait(lock, [this]() {return m_uiRunning == 0;});
+    }
+  };
+
+  //! returns the time in milliseconds, the sum of the consumed values is checked
+  template <class Queue>
+  double run(unsigned int uiProducers, size_t uiFrames, size_t uiMessagesPerFrame) {
+    Queue *pQueue(new Queue);
+    const size_t uiPerProducer(uiMessagesPerFrame / uiProducers);
+    CFrameProducers producers(uiProducers, [pQueue, uiPerProducer]() {
+        for (size_t i = 1; i <= uiPerProducer; i++) {pQueue->push(i);}
+      });
+
+    size_t uiSum(0);
+    size_t uiValue;
+    const auto start(std::chrono::steady_clock::now());
+    for (size_t f = 0; f < uiFrames; f++) {
+      producers.frame();
+      while (pQueue->pop(uiValue)) {
+        uiSum += uiValue;
+      }
+    }
+    const auto end(std::chrono::steady_clock::now());
+    delete pQueue;
+
+    if (uiSum != uiFrames * uiProducers * (uiPerProducer * (uiPerProducer + 1) / 2)) {
+      printf("error: lost or duplicated messages\n");
+      exit(1);
+    }
+    return std::chrono::duration<double, std::milli>(end - start).count();
+  }
+}
+
+int main(int argc, char **argv) {
+  const size_t uiFrames(argc > 1 ? strtoul(argv[1], nullptr, 10) : 5000);
+  const size_t uiMessagesPerFrame(argc > 2 ? strtoul(argv[2], nullptr, 10) : CAPACITY / 2);
+  if (uiMessagesPerFrame > CAPACITY) {
+    printf("at most %zu messages per frame\n", CAPACITY);
+    return 1;
+  }
+
+  printf("%zu frames with %zu messages of %zu bytes, %u hardware threads\n",
+         uiFrames, uiMessagesPerFrame, sizeof(SMessage), std::thread::hardware_concurrency());
+  printf("%10s %14s %14s %12s\n", "producers", "ring [ms]", "list [ms]", "speed up");
+  for (unsigned int uiProducers : {1u, 2u, 4u, 8u}) {
+    const double fRing(run<CRingQueue>(uiProducers, uiFrames, uiMessagesPerFrame));
+    const double fList(run<CListQueue>(uiProducers, uiFrames, uiMessagesPerFrame));
+    printf("%10u %14.1f %14.1f %11.2fx\n", uiProducers, fRing, fList, fList / fRing);
+  }
+  return 0;
+}
@@ -0,0 +1,239 @@
+/*****************************************************************************
+ * Copyright 2014 Christoph Wick
+ *
+ * This file is part of Zelda.
+ *
+ * Zelda is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zelda is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Zelda. If not, see http://www.gnu.org/licenses/.
+ *****************************************************************************/
+
+// Stress test of CPhysicsQueries with the line of sight queries of many
+// enemies. Every enemy keeps one visibility query in flight like
+// CSimpleEnemyController::queryPlayerVisibility, walls block a part of the
+// rays. Enemies die and respawn at random, which cancels their queries, some
+// of them from inside of their own callback and some from the callback of an
+// other enemy. Every frame checks that no enemy waits for a query that is
+// never answered and that no cancelled query calls back, the execution of
+// the queries is timed serial and on the job system.
+//
+// usage: PhysicsQueriesStress [frames] [enemies] [workers, 0: one less than the cores]
+
+#include <btBulletCollisionCommon.h>
+#include "Common/Physics/PhysicsQueries.hpp"
+#include "Common/Physics/PhysicsMasks.hpp"
+#include "Common/Physics/BtOgreExtras.hpp"
+#include "Common/Jobs/JobSystem.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace {
+  const btScalar MAP_HALF_SIZE(50);
+  const size_t WALL_COUNT(60);
+  // an enemy that did not get an answer for this many frames is stuck
+  const size_t MAX_ANSWER_DELAY(3);
+  const double DIE_CHANCE(0.005);
+  const double CANCEL_SELF_CHANCE(0.01);
+  const double CANCEL_OTHER_CHANCE(0.01);
+
+  struct SEnemy {
+    btCollisionObject object;
+    CPhysicsQueries::QueryId uiQuery;
+    unsigned int uiLife;          //!< increased on every death, callbacks of an earlier life are errors
+    size_t uiLastAnswer;          //!< frame of the last callback
+    bool bPlayerVisible;
+  };
+
+  struct SResult {
+    double fExecuteMs;            //!< per frame
+    double fMaxExecuteMs;
+    double fDispatchMs;           //!< per frame
+    double fVisible;              //!< fraction of the enemies that see the player
+    size_t uiQueries;
+    size_t uiStaleCallbacks;      //!< callbacks of cancelled queries
+    size_t uiStuck;               //!< enemies that waited longer than MAX_ANSWER_DELAY
+    size_t uiPendingAfterCancel;  //!< queries that were still pending after their owner was cancelled
+  };
+
+  btVector3 randomPosition(std::mt19937 &random) {
+    std::uniform_real_distribution<btScalar> position(-MAP_HALF_SIZE, MAP_HALF_SIZE);
+    return btVector3(position(random), 1, position(random));
+  }
+
+  SResult run(bool bParallel, size_t uiFrames, size_t uiEnemyCount) {
+    btDefaultCollisionConfiguration collisionConfig;
+    btCollisionDispatcher dispatcher(&collisionConfig);
+    btDbvtBroadphase broadphase;
+    btCollisionWorld world(&dispatcher, &broadphase, &collisionConfig);
+
+    CPhysicsQueries queries;
+    queries.setParallel(bParallel);
+
+    // same sequence for every run
+    std::mt19937 random(42);
+    std::uniform_real_distribution<double> chance(0, 1);
+    std::uniform_real_distribution<btScalar> step(-0.1, 0.1);
+
+    btBoxShape wallShape(btVector3(4, 2, 0.5));
+    std::vector<std::unique_ptr<btCollisionObject> > vWalls;
+    for (size_t i = 0; i < WALL_COUNT; i++) {
+      vWalls.emplace_back(new btCollisionObject());
+      btCollisionObject *pWall(vWalls.back().get());
+      pWall->setCollisionShape(&wallShape);
+      pWall->setWorldTransform(btTransform(btQuaternion(btVector3(0, 1, 0), chance(random) * SIMD_PI), randomPosition(random)));
+      world.addCollisionObject(pWall, COL_STATIC, MASK_STATIC_COLLIDES_WITH);
+    }
+
+    btCapsuleShape personShape(0.3, 1);
+    btCollisionObject player;
+    player.setCollisionShape(&personShape);
+    player.setWorldTransform(btTransform(btQuaternion::getIdentity(), btVector3(0, 1, 0)));
+    world.addCollisionObject(&player, COL_CHARACTER_P, MASK_PLAYER_P_COLLIDES_WITH);
+
+    std::vector<SEnemy> vEnemies(uiEnemyCount);
+    for (SEnemy &enemy : vEnemies) {
+      enemy.object.setCollisionShape(&personShape);
+      enemy.object.setWorldTransform(btTransform(btQuaternion::getIdentity(), randomPosition(random)));
+      world.addCollisionObject(&enemy.object, COL_CHARACTER_N, MASK_PLAYER_N_COLLIDES_WITH);
+      enemy.uiQuery = 0;
+      enemy.uiLife = 0;
+      enemy.uiLastAnswer = 0;
+      enemy.bPlayerVisible = false;
+    }
+
+    SResult result = {0, 0, 0, 0, 0, 0, 0, 0};
+    size_t uiFrame(0);
+    // like CCharacter::exit and CCharacter::enterMap, the queries are cancelled before the object leaves the world
+    auto kill = [&](SEnemy &enemy) {
+      const CPhysicsQueries::QueryId uiQuery(enemy.uiQuery);
+      queries.cancel(&enemy);
+      if (uiQuery != 0 && queries.isPending(uiQuery)) {result.uiPendingAfterCancel++;}
+      queries.forget(&enemy.object);
+      world.removeCollisionObject(&enemy.object);
+      enemy.uiLife++;
+      // the new life has not been answered yet
+      enemy.uiLastAnswer = uiFrame - 1;
+      enemy.object.setWorldTransform(btTransform(btQuaternion::getIdentity(), randomPosition(random)));
+      world.addCollisionObject(&enemy.object, COL_CHARACTER_N, MASK_PLAYER_N_COLLIDES_WITH);
+    };
+
+    for (uiFrame = 1; uiFrame <= uiFrames; uiFrame++) {
+      const btScalar fAngle(uiFrame * 0.01f);
+      player.getWorldTransform().setOrigin(btVector3(20 * std::cos(fAngle), 1, 20 * std::sin(fAngle)));
+
+      size_t uiVisible(0);
+      for (SEnemy &enemy : vEnemies) {
+        if (chance(random) < DIE_CHANCE) {
+          kill(enemy);
+        }
+        else {
+          enemy.object.getWorldTransform().getOrigin() += btVector3(step(random), 0, step(random));
+        }
+        if (enemy.bPlayerVisible) {uiVisible++;}
+
+        if (uiFrame - enemy.uiLastAnswer > MAX_ANSWER_DELAY) {
+          result.uiStuck++;
+          enemy.uiLastAnswer = uiFrame;
+        }
+
+        if (enemy.uiQuery != 0 && queries.isPending(enemy.uiQuery)) {continue;}
+
+        const unsigned int uiLife(enemy.uiLife);
+        SEnemy *pEnemy(&enemy);
+        enemy.uiQuery = queries.ray(&enemy,
+          BtOgre::Convert::toOgre(enemy.object.getWorldTransform().getOrigin()),
+          BtOgre::Convert::toOgre(player.getWorldTransform().getOrigin()),
+          COL_CHARACTER_N, COL_STATIC | COL_CHARACTER_P,
+          [&, pEnemy, uiLife](const SPhysicsQueryResult &query) {
+            if (pEnemy->uiLife != uiLife) {result.uiStaleCallbacks++; return;}
+            pEnemy->uiQuery = 0;
+            pEnemy->uiLastAnswer = uiFrame;
+            pEnemy->bPlayerVisible = !query.bHit || query.pCollisionObject == &player;
+            if (chance(random) < CANCEL_SELF_CHANCE) {
+              // the running callback must survive the cancellation of its owner
+              queries.cancel(pEnemy);
+            }
+            if (chance(random) < CANCEL_OTHER_CHANCE) {
+              kill(vEnemies[random() % vEnemies.size()]);
+            }
+          });
+        result.uiQueries++;
+      }
+      result.fVisible += static_cast<double>(uiVisible) / vEnemies.size();
+
+      world.updateAabbs();
+
+      const auto start(std::chrono::steady_clock::now());
+      queries.execute(&world);
+      const auto executed(std::chrono::steady_clock::now());
+      queries.dispatch();
+      const auto end(std::chrono::steady_clock::now());
+
+      const double fExecuteMs(std::chrono::duration<double, std::milli>(executed - start).count());
+      result.fExecuteMs += fExecuteMs;
+      result.fMaxExecuteMs = std::max(result.fMaxExecuteMs, fExecuteMs);
+      result.fDispatchMs += std::chrono::duration<double, std::milli>(end - executed).count();
+    }
+
+    queries.clear();
+    for (SEnemy &enemy : vEnemies) {
+      world.removeCollisionObject(&enemy.object);
+    }
+    world.removeCollisionObject(&player);
+    for (auto &pWall : vWalls) {
+      world.removeCollisionObject(pWall.get());
+    }
+
+    result.fExecuteMs /= uiFrames;
+    result.fDispatchMs /= uiFrames;
+    result.fVisible /= uiFrames;
+    return result;
+  }
+
+  void print(const char *pName, const SResult &result) {
+    printf("%-10s %12.3f %16.3f %13.3f %9.0f%% %10zu %8zu %7zu %8zu\n", pName, result.fExecuteMs, result.fMaxExecuteMs,
+           result.fDispatchMs, result.fVisible * 100, result.uiQueries, result.uiStaleCallbacks, result.uiStuck, result.uiPendingAfterCancel);
+  }
+}
+
+int main(int argc, char **argv) {
+  const long iFrames(argc > 1 ? atol(argv[1]) : 3600);
+  const long iEnemies(argc > 2 ? atol(argv[2]) : 200);
+  const long iWorkers(argc > 3 ? atol(argv[3]) : 0);
+  if (iFrames <= 0 || iEnemies <= 0 || iWorkers < 0) {
+    printf("usage: %s [frames] [enemies] [workers, 0: one less than the cores]\n", argv[0]);
+    return 1;
+  }
+
+  CJobSystem jobSystem(static_cast<unsigned int>(iWorkers));
+  printf("%ld frames, %ld enemies, %u workers\n", iFrames, iEnemies, jobSystem.getWorkerCount());
+  printf("%-10s %12s %16s %13s %10s %10s %8s %7s %8s\n", "execution", "execute [ms]", "max execute [ms]", "dispatch [ms]", "visible", "queries", "stale", "stuck", "pending");
+
+  SResult serial(run(false, iFrames, iEnemies));
+  print("serial", serial);
+  size_t uiErrors(serial.uiStaleCallbacks + serial.uiStuck + serial.uiPendingAfterCancel);
+#if PHYSICS_QUERIES_PARALLEL == 1
+  SResult parallel(run(true, iFrames, iEnemies));
+  print("parallel", parallel);
+  uiErrors += parallel.uiStaleCallbacks + parallel.uiStuck + parallel.uiPendingAfterCancel;
+#else
+  printf("bullet is not thread safe (BT_THREADSAFE), the queries are executed serially only\n");
+#endif
+
+  return uiErrors == 0 ? 0 : 1;
+}
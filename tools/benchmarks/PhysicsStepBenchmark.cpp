@@ -0,0 +1,158 @@
+/*****************************************************************************
+ * Copyright 2014 Christoph Wick
+ *
+ * This file is part of Zelda.
+ *
+ * Zelda is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zelda is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Zelda. If not, see http://www.gnu.org/licenses/.
+ *****************************************************************************/
+
+// Step time of a populated world on 1, 2, 4 and 8 threads. The world is
+// created like the world of CPhysicsManager (multithreaded dispatcher, solver
+// pool and world of bullet) and the loops of bullet run on the job system by
+// the CPhysicsTaskScheduler, so this measures the scaling of the game's
+// setup. Boxes and spheres are dropped onto piles, they are kept awake so
+// that every step has the same load.
+//
+// usage: PhysicsStepBenchmark [seconds] [bodies] [max threads]
+
+#include <btBulletDynamicsCommon.h>
+#include "Common/Physics/PhysicsTaskScheduler.hpp"
+#include "Common/Jobs/JobSystem.hpp"
+#if PHYSICS_MULTITHREADED == 1
+#include <BulletCollision/CollisionDispatch/btCollisionDispatcherMt.h>
+#include <BulletDynamics/Dynamics/btDiscreteDynamicsWorldMt.h>
+#include <BulletDynamics/ConstraintSolver/btSequentialImpulseConstraintSolverMt.h>
+#endif
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace {
+  const btScalar TIME_STEP(1.0 / 60);
+  // see CPhysicsManager::GRAVITY_FACTOR
+  const btScalar GRAVITY(-4);
+  // see PHYSICS_DISPATCH_GRAIN_SIZE of CPhysicsManager
+  const int DISPATCH_GRAIN_SIZE(40);
+  const int PILES_PER_SIDE(5);
+  const btScalar PILE_DISTANCE(8);
+
+  struct SResult {
+    double fStepMs;               //!< per step
+    double fMaxStepMs;
+    int iManifolds;               //!< contact manifolds of the last step
+  };
+
+  SResult run(double fSeconds, int iBodyCount) {
+    btDefaultCollisionConfiguration collisionConfig;
+    btDbvtBroadphase broadphase;
+#if PHYSICS_MULTITHREADED == 1
+    btCollisionDispatcherMt dispatcher(&collisionConfig, DISPATCH_GRAIN_SIZE);
+    btConstraintSolverPoolMt solverPool(btGetTaskScheduler()->getMaxNumThreads());
+    btSequentialImpulseConstraintSolverMt solver;
+    btDiscreteDynamicsWorldMt world(&dispatcher, &broadphase, &solverPool, &solver, &collisionConfig);
+#else
+    btCollisionDispatcher dispatcher(&collisionConfig);
+    btSequentialImpulseConstraintSolver solver;
+    btDiscreteDynamicsWorld world(&dispatcher, &broadphase, &solver, &collisionConfig);
+#endif
+    world.setGravity(btVector3(0, GRAVITY, 0));
+    world.getSolverInfo().m_splitImpulse = true;
+
+    const btScalar fHalfSize(PILES_PER_SIDE * PILE_DISTANCE / 2);
+    btBoxShape groundShape(btVector3(fHalfSize, 1, fHalfSize));
+    btBoxShape boxShape(btVector3(0.25, 0.25, 0.25));
+    btSphereShape sphereShape(0.25);
+
+    std::vector<std::unique_ptr<btDefaultMotionState> > vMotionStates;
+    std::vector<std::unique_ptr<btRigidBody> > vBodies;
+    auto add = [&](btCollisionShape *pShape, btScalar fMass, const btVector3 &vPosition) {
+      btVector3 vInertia(0, 0, 0);
+      if (fMass > 0) {pShape->calculateLocalInertia(fMass, vInertia);}
+      vMotionStates.emplace_back(new btDefaultMotionState(btTransform(btQuaternion::getIdentity(), vPosition)));
+      vBodies.emplace_back(new btRigidBody(btRigidBody::btRigidBodyConstructionInfo(fMass, vMotionStates.back().get(), pShape, vInertia)));
+      if (fMass > 0) {vBodies.back()->setActivationState(DISABLE_DEACTIVATION);}
+      world.addRigidBody(vBodies.back().get());
+    };
+    add(&groundShape, 0, btVector3(0, -1, 0));
+
+    // same piles for every thread count
+    std::mt19937 random(42);
+    std::uniform_real_distribution<btScalar> jitter(-0.05, 0.05);
+    const int iPiles(PILES_PER_SIDE * PILES_PER_SIDE);
+    for (int i = 0; i < iBodyCount; i++) {
+      const int iPile(i % iPiles);
+      const int iLevel(i / iPiles);
+      const btVector3 vPosition((iPile % PILES_PER_SIDE + 0.5f) * PILE_DISTANCE - fHalfSize + jitter(random),
+                                0.5f + iLevel * 0.6f,
+                                (iPile / PILES_PER_SIDE + 0.5f) * PILE_DISTANCE - fHalfSize + jitter(random));
+      add(i % 2 == 0 ? static_cast<btCollisionShape*>(&boxShape) : &sphereShape, 1, vPosition);
+    }
+
+    SResult result = {0, 0, 0};
+    const int iSteps(static_cast<int>(fSeconds / TIME_STEP));
+    for (int i = 0; i < iSteps; i++) {
+      const auto start(std::chrono::steady_clock::now());
+      world.stepSimulation(TIME_STEP, 1, TIME_STEP);
+      const double fStepMs(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+      result.fStepMs += fStepMs;
+      result.fMaxStepMs = std::max(result.fMaxStepMs, fStepMs);
+    }
+    result.iManifolds = dispatcher.getNumManifolds();
+
+    for (auto &pBody : vBodies) {
+      world.removeRigidBody(pBody.get());
+    }
+
+    result.fStepMs /= iSteps;
+    return result;
+  }
+}
+
+int main(int argc, char **argv) {
+  const double fSeconds(argc > 1 ? atof(argv[1]) : 10);
+  const int iBodyCount(argc > 2 ? atoi(argv[2]) : 2000);
+  const int iMaxThreads(argc > 3 ? atoi(argv[3]) : 8);
+  if (fSeconds <= 0 || iBodyCount <= 0 || iMaxThreads <= 0) {
+    printf("usage: %s [seconds] [bodies] [max threads]\n", argv[0]);
+    return 1;
+  }
+
+  // the solver pool of bullet is sized by the maximum, so the scheduler is
+  // created once with all workers and limited for every run
+  CJobSystem jobSystem(static_cast<unsigned int>(iMaxThreads - 1));
+  CPhysicsTaskScheduler taskScheduler;
+  if (!CPhysicsTaskScheduler::isSupported()) {
+    printf("bullet is not thread safe (BT_THREADSAFE, 2.88 or newer), only one thread is measured\n");
+  }
+
+  printf("%.0f s at 60 Hz, %d bodies\n", fSeconds, iBodyCount);
+  printf("%-8s %12s %16s %10s %10s\n", "threads", "step [ms]", "max step [ms]", "speedup", "manifolds");
+
+  double fSingleThreadMs(0);
+  for (int iThreads = 1; iThreads <= std::min(iMaxThreads, 8); iThreads *= 2) {
+    if (iThreads > 1 && !CPhysicsTaskScheduler::isSupported()) {break;}
+    taskScheduler.setMultithreaded(iThreads > 1);
+    taskScheduler.setThreadCount(iThreads);
+
+    const SResult result(run(fSeconds, iBodyCount));
+    if (iThreads == 1) {fSingleThreadMs = result.fStepMs;}
+    printf("%-8d %12.3f %16.3f %9.2fx %10d\n", taskScheduler.getThreadCount(), result.fStepMs, result.fMaxStepMs,
+           fSingleThreadMs / result.fStepMs, result.iManifolds);
+  }
+  return 0;
+}